@@ -16,6 +16,7 @@
 #include <limits.h>
 #include <stddef.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -125,6 +126,20 @@ static struct option long_options[] =
 	{"direct-color", no_argument, 0, 58},
 	{"csv-trim-width", required_argument, 0, 59},
 	{"csv-trim-rows", required_argument, 0, 60},
+	{"regex-search", no_argument, 0, 61},
+	{"highlight-changes", no_argument, 0, 62},
+	{"binary-results", no_argument, 0, 63},
+	{"watch-history", required_argument, 0, 64},
+	{"stream-max-rows", required_argument, 0, 65},
+	{"arrow", no_argument, 0, 66},
+	{"copy-binary", no_argument, 0, 67},
+	{"jsonl", no_argument, 0, 68},
+	{"columns", required_argument, 0, 69},
+	{"exclude-columns", required_argument, 0, 72},
+	{"max-rows", required_argument, 0, 74},
+	{"tail", required_argument, 0, 75},
+	{"sample", required_argument, 0, 76},
+	{"start-at-end", no_argument, 0, 77},
 	{0, 0, 0, 0}
 };
 
@@ -422,6 +437,7 @@ readargs(char **argv,
 					fprintf(stdout, "  --esc-delay=NUM          specify escape delay in ms (-1 inf, 0 not used, )\n");
 					fprintf(stdout, "  --interactive            force interactive mode\n");
 					fprintf(stdout, "  --ignore_file_suffix     don't try to deduce format from file suffix\n");
+					fprintf(stdout, "  --max-rows=N             keep only first N data rows\n");
 					fprintf(stdout, "  --ni                     not interactive mode (only for csv and query)\n");
 					fprintf(stdout, "  --no-mouse               don't use own mouse handling\n");
 					fprintf(stdout, "  --no-progressive-load    don't use progressive data load\n");
@@ -436,7 +452,11 @@ readargs(char **argv,
 					fprintf(stdout,  "  --querystream            read queries from stream forever\n");
 					fprintf(stdout, "  --quit-on-f3             exit on F3 like mc viewers\n");
 					fprintf(stdout, "  --rr=ROWNUM              rows reserved for specific purposes\n");
+					fprintf(stdout, "  --sample=N               keep random sample of N data rows\n");
+					fprintf(stdout, "  --start-at-end, +G       show the end of data after start\n");
 					fprintf(stdout, "  --stream                 read input forever\n");
+					fprintf(stdout, "  --stream-max-rows=N      append stream to data and keep only last N rows\n");
+					fprintf(stdout, "  --tail=N                 keep only last N data rows\n");
 					fprintf(stdout, "  -X, --reprint-on-exit    preserve content after exit\n");
 					fprintf(stdout, "\nOutput format options:\n");
 					fprintf(stdout, "  -a, --ascii decor        force ascii\n");
@@ -457,6 +477,7 @@ readargs(char **argv,
 					fprintf(stdout, "                           don't highlight lines for searches\n");
 					fprintf(stdout, "  -i --ignore-case         ignore case in searches that do not contain uppercase\n");
 					fprintf(stdout, "  -I --IGNORE-CASE         ignore case in all searches\n");
+					fprintf(stdout, "  --regex-search           search patterns are extended regular expressions\n");
 					fprintf(stdout, "\nInterface options:\n");
 					fprintf(stdout, "  -c, --freezecols=N       freeze N columns (0..9)\n");
 					fprintf(stdout, "  --less-status-bar        status bar like less pager\n");
@@ -471,6 +492,9 @@ readargs(char **argv,
 					fprintf(stdout, "  --tabular-cursor         cursor is visible only when data has table format\n");
 					fprintf(stdout, "  --vertical-cursor        show vertical column cursor\n");
 					fprintf(stdout, "\nInput format options:\n");
+					fprintf(stdout, "  --arrow                  input stream has Arrow IPC (Feather) format\n");
+					fprintf(stdout, "  --columns=LIST           load only listed columns (names, patterns or numbers)\n");
+					fprintf(stdout, "  --copy-binary            input stream has PostgreSQL COPY BINARY format\n");
 					fprintf(stdout, "  --csv                    input stream has csv format\n");
 					fprintf(stdout, "  --csv-separator          char used as field separator\n");
 					fprintf(stdout, "  --csv-header [on/off]    specify header line usage\n");
@@ -478,6 +502,8 @@ readargs(char **argv,
 					fprintf(stdout, "                           columns with substr in name are ignored\n");
 					fprintf(stdout, "  --csv-trim-width=NUM     trim value after NUM chars\n");
 					fprintf(stdout, "  --csv-trim-rows=NUM      trim value after NUM rows\n");
+					fprintf(stdout, "  --exclude-columns=LIST   don't load listed columns\n");
+					fprintf(stdout, "  --jsonl                  input stream has JSON Lines (NDJSON) format\n");
 					fprintf(stdout, "  --tsv                    input stream has tsv format\n");
 					fprintf(stdout, "\nOn exit options:\n");
 					fprintf(stdout, "  --on-exit-reset          sends reset terminal sequence \"\\33c\"\n");
@@ -487,12 +513,15 @@ readargs(char **argv,
 					fprintf(stdout, "\nWatch mode options:\n");
 					fprintf(stdout, "  -q, --query=QUERY        execute query\n");
 					fprintf(stdout, "  -w, --watch time         the query (or read file) is repeated every time (sec)\n");
+					fprintf(stdout, "  --highlight-changes      highlight cells changed by last refresh\n");
+					fprintf(stdout, "  --watch-history=MB       memory for history of refreshed data (default 10)\n");
 					fprintf(stdout, "\nConnection options:\n");
 					fprintf(stdout, "  -d, --dbname=DBNAME      database name\n");
 					fprintf(stdout, "  -h, --host=HOSTNAME      database server host (default: \"local socket\")\n");
 					fprintf(stdout, "  -p, --port=PORT          database server port (default: \"5432\")\n");
 					fprintf(stdout, "  -U, --username=USERNAME  database user name\n");
 					fprintf(stdout, "  -W, --password           force password prompt\n");
+					fprintf(stdout, "  --binary-results         fetch numeric, date and timestamp values in binary format\n");
 					fprintf(stdout, "\nDebug options:\n");
 					fprintf(stdout, "  --log=FILE               log debug info to file\n");
 					fprintf(stdout, "  --wait=NUM               wait NUM seconds to allow attach from a debugger\n");
@@ -731,6 +760,9 @@ readargs(char **argv,
 			case 'F':
 				state->quit_if_one_screen = true;
 				break;
+			case 77:
+				state->start_at_end = true;
+				break;
 			case 'g':
 				opts->no_highlight_lines = true;
 				break;
@@ -859,6 +891,66 @@ readargs(char **argv,
 
 				opts->csv_trim_rows = (unsigned int) lopt;
 				break;
+			case 61:
+				opts->regex_search = true;
+				break;
+			case 62:
+				opts->highlight_changes = true;
+				break;
+			case 63:
+				opts->binary_results = true;
+				break;
+			case 64:
+				opts->watch_history = atoi(optarg);
+				if (opts->watch_history < 0 || opts->watch_history > 4096)
+				{
+					state->errstr = "watch history size can be between 0 and 4096 MB";
+					return false;
+				}
+				break;
+			case 65:
+				opts->stream_max_rows = atoi(optarg);
+				if (opts->stream_max_rows < 0 || opts->stream_max_rows > 100000000)
+				{
+					state->errstr = "stream max rows can be between 0 and 100000000";
+					return false;
+				}
+				break;
+			case 66:
+				opts->arrow_format = true;
+				break;
+			case 67:
+				opts->copy_binary_format = true;
+				break;
+			case 68:
+				opts->jsonl_format = true;
+				break;
+			case 69:
+				opts->columns = sstrdup(optarg);
+				break;
+			case 72:
+				opts->exclude_columns = sstrdup(optarg);
+				break;
+			case 74:
+			case 75:
+			case 76:
+				{
+					int		n = atoi(optarg);
+
+					if (n < 1 || n > 100000000)
+					{
+						state->errstr = "number of kept rows can be between 1 and 100000000";
+						return false;
+					}
+
+					if (opt == 74)
+						opts->max_rows = n;
+					else if (opt == 75)
+						opts->tail_rows = n;
+					else
+						opts->sample_rows = n;
+				}
+				break;
 
 			default:
 				{
@@ -870,6 +962,13 @@ readargs(char **argv,
 
 	for (; optind < argc; optind++)
 	{
+		/* less like command for start at the end of data */
+		if (strcmp(argv[optind], "+G") == 0)
+		{
+			state->start_at_end = true;
+			continue;
+		}
+
 		if (opts->pathname)
 		{
 			state->errstr = "only one file can be browsed";
@@ -890,9 +989,18 @@ get_format_type(char *path)
 {
 	char		buffer[4];
 	char	   *r_ptr, *w_ptr;
+	char	   *suffix;
 	int			i;
 	int			l;
 
+	if ((suffix = strrchr(path, '.')) &&
+		(strcasecmp(suffix, ".arrow") == 0 || strcasecmp(suffix, ".feather") == 0))
+		return FILE_ARROW;
+
+	if (suffix &&
+		(strcasecmp(suffix, ".jsonl") == 0 || strcasecmp(suffix, ".ndjson") == 0))
+		return FILE_JSONL;
+
 	l = strlen(path);
 	if (l < 5)
 		return FILE_MATRIX;
@@ -942,12 +1050,15 @@ args_are_consistent(Options *opts, StateData *state)
 		return false;
 	}
 
-	if (opts->csv_format && opts->tsv_format)
+	if ((opts->csv_format ? 1 : 0) + (opts->tsv_format ? 1 : 0) +
+		(opts->arrow_format ? 1 : 0) + (opts->copy_binary_format ? 1 : 0) +
+		(opts->jsonl_format ? 1 : 0) > 1)
 	{
-		state->errstr = "option --csv and --tsv cannot be used together";
+		state->errstr = "only one of options --csv, --tsv, --arrow, --copy-binary and --jsonl can be used";
 		return false;
 	}
 
+
 	if (opts->watch_time && !(opts->query || opts->pathname))
 	{
 		state->errstr = "cannot use watch mode when query or file is missing";
@@ -965,6 +1076,7 @@ args_are_consistent(Options *opts, StateData *state)
 		state->file_format_from_suffix = get_format_type(opts->pathname);
 
 	if (!opts->csv_format && !opts->tsv_format &&
+		!opts->arrow_format && !opts->copy_binary_format && !opts->jsonl_format &&
 		state->file_format_from_suffix != FILE_UNDEF &&
 		!state->ignore_file_suffix)
 	{
@@ -972,6 +1084,24 @@ args_are_consistent(Options *opts, StateData *state)
 			opts->csv_format = true;
 		else if (state->file_format_from_suffix == FILE_TSV)
 			opts->tsv_format = true;
+		else if (state->file_format_from_suffix == FILE_ARROW)
+			opts->arrow_format = true;
+		else if (state->file_format_from_suffix == FILE_JSONL)
+			opts->jsonl_format = true;
+	}
+
+	if ((opts->max_rows ? 1 : 0) + (opts->tail_rows ? 1 : 0) + (opts->sample_rows ? 1 : 0) > 1)
+	{
+		state->errstr = "only one of options --max-rows, --tail and --sample can be used";
+		return false;
+	}
+
+	if ((opts->max_rows || opts->tail_rows || opts->sample_rows) &&
+		(opts->arrow_format || opts->copy_binary_format || opts->jsonl_format ||
+		 opts->query || opts->querystream || state->stream_mode))
+	{
+		state->errstr = "options --max-rows, --tail and --sample can be used only for data in psql, text, csv or tsv format";
+		return false;
 	}
 
 	/* use progressive load mode only for data */
@@ -0,0 +1,990 @@
+/*-------------------------------------------------------------------------
+ *
+ * arrow.c
+ *	  writer of Apache Arrow IPC file format (Feather v2)
+ *
+ * Portions Copyright (c) 2017-2026 Pavel Stehule
+ *
+ * IDENTIFICATION
+ *	  src/arrow.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pspg.h"
+
+/*
+ * The file holds a schema message, record batches and a footer. The
+ * metadata of messages are flatbuffers, that are built by simple builder
+ * below (the buffer is filled from the end, so the referenced objects
+ * should be created before the objects that use them).
+ */
+#define ARROW_MAGIC					"ARROW1"
+#define ARROW_METADATA_V5			4
+
+#define ARROW_HEADER_SCHEMA			1
+#define ARROW_HEADER_RECORD_BATCH	3
+
+#define ARROW_TYPE_INT				2
+#define ARROW_TYPE_FLOATING_POINT	3
+#define ARROW_TYPE_UTF8				5
+
+#define ARROW_PRECISION_DOUBLE		2
+
+/* rows of one record batch */
+#define ARROW_BATCH_ROWS			65536
+
+/* the batch is written early, when it holds too much string data */
+#define ARROW_BATCH_MAX_BYTES		(256 * 1024 * 1024)
+
+#define FB_MAX_SLOTS				8
+
+typedef struct
+{
+	unsigned char *buf;
+	int			cap;
+	int			size;			/* used bytes at the end of buf */
+	int			minalign;
+	int			table_start;
+	int			nslots;
+	int			slots[FB_MAX_SLOTS];
+} FlatBuilder;
+
+/*
+ * Types of columns. The type of column is the most general type
+ * of all not null values of column.
+ */
+typedef enum
+{
+	COLUMN_TYPE_NULL,
+	COLUMN_TYPE_INT64,
+	COLUMN_TYPE_FLOAT64,
+	COLUMN_TYPE_UTF8
+} ColumnType;
+
+typedef struct
+{
+	char	   *data;
+	int			size;
+	int			maxsize;
+} ArrowBuffer;
+
+typedef struct
+{
+	char	   *name;
+	ColumnType	type;
+	bool		is_numeric;		/* the source type of column is numeric */
+	int			nvalues_spaces;	/* number of values with known spaces */
+	int			lspaces;		/* spaces before first value */
+	int			rspaces;		/* spaces after first value */
+	bool		lspaces_differ;	/* values are not aligned to left */
+	bool		rspaces_differ;	/* values are not aligned to right */
+	ArrowBuffer	validity;
+	ArrowBuffer	offsets;		/* used only by utf8 columns */
+	ArrowBuffer	data;
+	int			nvalues;		/* values in current batch */
+	long		null_count;
+} ArrowColumn;
+
+typedef struct
+{
+	int64_t		offset;
+	int			metadata_length;
+	int64_t		body_length;
+} ArrowBlock;
+
+struct ArrowWriter
+{
+	FILE	   *fp;
+	int64_t		offset;			/* number of written bytes */
+	int			maxcolumns;
+	int			ncolumns;
+	ArrowColumn *columns;
+	int			nrows;			/* rows in current batch */
+	ArrowBlock *blocks;
+	int			nblocks;
+	int			maxblocks;
+};
+
+/*
+ * Flatbuffer builder
+ */
+static void
+fb_init(FlatBuilder *fb)
+{
+	fb->cap = 1024;
+	fb->buf = smalloc(fb->cap);
+	fb->size = 0;
+	fb->minalign = 1;
+}
+
+static void
+fb_reserve(FlatBuilder *fb, int bytes)
+{
+	if (fb->size + bytes > fb->cap)
+	{
+		int			newcap = fb->cap;
+		unsigned char *newbuf;
+
+		while (fb->size + bytes > newcap)
+			newcap *= 2;
+
+		/* the data are stored at the end of buffer */
+		newbuf = smalloc(newcap);
+		memcpy(newbuf + newcap - fb->size, fb->buf + fb->cap - fb->size, fb->size);
+
+		free(fb->buf);
+		fb->buf = newbuf;
+		fb->cap = newcap;
+	}
+}
+
+static void
+fb_push(FlatBuilder *fb, const void *data, int bytes)
+{
+	fb_reserve(fb, bytes);
+
+	fb->size += bytes;
+	memcpy(fb->buf + fb->cap - fb->size, data, bytes);
+}
+
+/* scalars are stored in little endian */
+static void
+fb_push_scalar(FlatBuilder *fb, uint64_t value, int bytes)
+{
+	unsigned char data[8];
+	int			i;
+
+	for (i = 0; i < bytes; i++)
+		data[i] = (value >> (8 * i)) & 0xff;
+
+	fb_push(fb, data, bytes);
+}
+
+/*
+ * Add padding, so the data of specified size written after padding
+ * will be aligned.
+ */
+static void
+fb_prep(FlatBuilder *fb, int align, int bytes)
+{
+	int			pad;
+
+	if (align > fb->minalign)
+		fb->minalign = align;
+
+	pad = (align - ((fb->size + bytes) % align)) % align;
+
+	while (pad-- > 0)
+		fb_push_scalar(fb, 0, 1);
+}
+
+static int
+fb_create_string(FlatBuilder *fb, const char *str, int size)
+{
+	fb_prep(fb, 4, size + 1);
+	fb_push_scalar(fb, 0, 1);
+	fb_push(fb, str, size);
+	fb_push_scalar(fb, size, 4);
+
+	return fb->size;
+}
+
+static int
+fb_create_offsets_vector(FlatBuilder *fb, int *offsets, int n)
+{
+	int			i;
+
+	fb_prep(fb, 4, 4 * n);
+
+	for (i = n - 1; i >= 0; i--)
+		fb_push_scalar(fb, fb->size + 4 - offsets[i], 4);
+
+	fb_push_scalar(fb, n, 4);
+
+	return fb->size;
+}
+
+/*
+ * Vector of structs with two 64bit fields (FieldNode and Buffer)
+ */
+static int
+fb_create_pairs_vector(FlatBuilder *fb, int64_t *values, int n)
+{
+	int			i;
+
+	fb_prep(fb, 4, 16 * n);
+	fb_prep(fb, 8, 16 * n);
+
+	for (i = 2 * n - 1; i >= 0; i--)
+		fb_push_scalar(fb, (uint64_t) values[i], 8);
+
+	fb_push_scalar(fb, n, 4);
+
+	return fb->size;
+}
+
+static int
+fb_create_blocks_vector(FlatBuilder *fb, ArrowBlock *blocks, int n)
+{
+	int			i;
+
+	fb_prep(fb, 4, 24 * n);
+	fb_prep(fb, 8, 24 * n);
+
+	for (i = n - 1; i >= 0; i--)
+	{
+		fb_push_scalar(fb, (uint64_t) blocks[i].body_length, 8);
+		fb_push_scalar(fb, 0, 4);
+		fb_push_scalar(fb, (uint32_t) blocks[i].metadata_length, 4);
+		fb_push_scalar(fb, (uint64_t) blocks[i].offset, 8);
+	}
+
+	fb_push_scalar(fb, n, 4);
+
+	return fb->size;
+}
+
+static void
+fb_start_table(FlatBuilder *fb, int nslots)
+{
+	fb->table_start = fb->size;
+	fb->nslots = nslots;
+	memset(fb->slots, 0, sizeof(fb->slots));
+}
+
+static void
+fb_add_scalar(FlatBuilder *fb, int slot, uint64_t value, int bytes)
+{
+	fb_prep(fb, bytes, 0);
+	fb_push_scalar(fb, value, bytes);
+	fb->slots[slot] = fb->size;
+}
+
+static void
+fb_add_offset(FlatBuilder *fb, int slot, int offset)
+{
+	fb_prep(fb, 4, 0);
+	fb_push_scalar(fb, fb->size + 4 - offset, 4);
+	fb->slots[slot] = fb->size;
+}
+
+/*
+ * Write vtable of table, and returns offset of table
+ */
+static int
+fb_end_table(FlatBuilder *fb)
+{
+	int			object;
+	int			nslots = fb->nslots;
+	int32_t		soffset;
+	int			i;
+
+	fb_prep(fb, 4, 0);
+	fb_push_scalar(fb, 0, 4);
+	object = fb->size;
+
+	while (nslots > 0 && fb->slots[nslots - 1] == 0)
+		nslots -= 1;
+
+	for (i = nslots - 1; i >= 0; i--)
+		fb_push_scalar(fb, fb->slots[i] ? object - fb->slots[i] : 0, 2);
+
+	fb_push_scalar(fb, object - fb->table_start, 2);
+	fb_push_scalar(fb, 2 * (nslots + 2), 2);
+
+	/* vtable is stored before table, so the offset is positive */
+	soffset = fb->size - object;
+	for (i = 0; i < 4; i++)
+		fb->buf[fb->cap - object + i] = ((uint32_t) soffset >> (8 * i)) & 0xff;
+
+	return object;
+}
+
+static void
+fb_finish(FlatBuilder *fb, int root)
+{
+	fb_prep(fb, fb->minalign > 8 ? fb->minalign : 8, 4);
+	fb_push_scalar(fb, fb->size + 4 - root, 4);
+}
+
+static unsigned char *
+fb_data(FlatBuilder *fb)
+{
+	return fb->buf + fb->cap - fb->size;
+}
+
+/*
+ * Write data to output and count written bytes
+ */
+static bool
+arrow_write(ArrowWriter *aw, const void *data, size_t size)
+{
+	if (size == 0)
+		return true;
+
+	errno = 0;
+	if (fwrite(data, size, 1, aw->fp) != 1)
+	{
+		if (errno == 0)
+			errno = EIO;
+
+		return false;
+	}
+
+	aw->offset += size;
+
+	return true;
+}
+
+static bool
+arrow_write_padding(ArrowWriter *aw, size_t size)
+{
+	static const char zeros[8] = {0};
+
+	return arrow_write(aw, zeros, (8 - (size % 8)) % 8);
+}
+
+static bool
+arrow_write_int32(ArrowWriter *aw, uint32_t value)
+{
+	unsigned char data[4];
+	int			i;
+
+	for (i = 0; i < 4; i++)
+		data[i] = (value >> (8 * i)) & 0xff;
+
+	return arrow_write(aw, data, 4);
+}
+
+/*
+ * Write encapsulated message - continuation marker, size of metadata
+ * and metadata padded to 8 bytes. The size of all these parts is
+ * returned in metadata_length.
+ */
+static bool
+arrow_write_message(ArrowWriter *aw, FlatBuilder *fb, int *metadata_length)
+{
+	int			size = (fb->size + 7) & ~7;
+
+	*metadata_length = 8 + size;
+
+	return arrow_write_int32(aw, 0xFFFFFFFF) &&
+		   arrow_write_int32(aw, size) &&
+		   arrow_write(aw, fb_data(fb), fb->size) &&
+		   arrow_write_padding(aw, fb->size);
+}
+
+static void
+arrow_buffer_reserve(ArrowBuffer *buf, int size)
+{
+	if (buf->size + size > buf->maxsize)
+	{
+		int			newsize = buf->maxsize > 0 ? buf->maxsize : 1024;
+
+		while (buf->size + size > newsize)
+			newsize *= 2;
+
+		buf->data = srealloc(buf->data, newsize);
+		buf->maxsize = newsize;
+	}
+}
+
+static void
+arrow_buffer_append(ArrowBuffer *buf, const void *data, int size)
+{
+	arrow_buffer_reserve(buf, size);
+	memcpy(buf->data + buf->size, data, size);
+	buf->size += size;
+}
+
+static void
+arrow_buffer_append_le(ArrowBuffer *buf, uint64_t value, int bytes)
+{
+	int			i;
+
+	arrow_buffer_reserve(buf, bytes);
+
+	for (i = 0; i < bytes; i++)
+		buf->data[buf->size++] = (value >> (8 * i)) & 0xff;
+}
+
+/*
+ * Returns true, when the string is an integer that can be stored
+ * in int64 without overflow.
+ */
+static bool
+parse_int64(const char *str, int size, int64_t *value)
+{
+	bool		negative = false;
+	uint64_t	result = 0;
+	uint64_t	limit = INT64_MAX;
+
+	if (size > 0 && *str == '-')
+	{
+		negative = true;
+		str += 1;
+		size -= 1;
+	}
+
+	/* "+5" or "007" would not be stored in the form as it is displayed */
+	if (size == 0 || (size > 1 && *str == '0'))
+		return false;
+
+	if (negative)
+		limit += 1;
+
+	while (size-- > 0)
+	{
+		int			digit = *str++ - '0';
+
+		if (digit < 0 || digit > 9)
+			return false;
+
+		if (result > (limit - digit) / 10)
+			return false;
+
+		result = result * 10 + digit;
+	}
+
+	*value = negative ? (int64_t) (0 - result) : (int64_t) result;
+
+	return true;
+}
+
+/*
+ * Returns true, when the string is a decimal number. Like integers,
+ * numbers with leading '+' or with leading zeros are not accepted.
+ */
+static bool
+parse_float64(const char *str, int size, double *value)
+{
+	char		buffer[64];
+	char	   *endptr;
+	bool		has_digit = false;
+	bool		result;
+	int			saved_errno;
+	int			i;
+
+	if (size == 0 || size > (int) sizeof(buffer) - 1)
+		return false;
+
+	i = *str == '-' ? 1 : 0;
+	if (i < size && (str[i] == '+' ||
+					 (str[i] == '0' && i + 1 < size &&
+					  str[i + 1] >= '0' && str[i + 1] <= '9')))
+		return false;
+
+	/* don't allow inf, nan or hexadecimal numbers */
+	for (i = 0; i < size; i++)
+	{
+		char		c = str[i];
+
+		if (c >= '0' && c <= '9')
+			has_digit = true;
+		else if (!(c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E'))
+			return false;
+	}
+
+	if (!has_digit)
+		return false;
+
+	memcpy(buffer, str, size);
+	buffer[size] = '\0';
+
+	/* errno should not be changed, it is used for detection of write errors */
+	saved_errno = errno;
+
+	errno = 0;
+	*value = strtod(buffer, &endptr);
+	result = *endptr == '\0' && errno == 0;
+
+	errno = saved_errno;
+
+	return result;
+}
+
+/*
+ * Create writer of Arrow IPC file. The columns are defined by
+ * arrow_set_column_name and arrow_infer_value.
+ */
+ArrowWriter *
+arrow_writer_new(FILE *fp, int maxcolumns)
+{
+	ArrowWriter *aw = smalloc(sizeof(ArrowWriter));
+
+	aw->fp = fp;
+	aw->maxcolumns = maxcolumns;
+	aw->columns = smalloc(maxcolumns * sizeof(ArrowColumn));
+
+	return aw;
+}
+
+void
+arrow_writer_free(ArrowWriter *aw)
+{
+	int			i;
+
+	if (!aw)
+		return;
+
+	for (i = 0; i < aw->maxcolumns; i++)
+	{
+		free(aw->columns[i].name);
+		free(aw->columns[i].validity.data);
+		free(aw->columns[i].offsets.data);
+		free(aw->columns[i].data.data);
+	}
+
+	free(aw->columns);
+	free(aw->blocks);
+	free(aw);
+}
+
+void
+arrow_set_column_name(ArrowWriter *aw, int colno, const char *name, int size)
+{
+	if (colno < 0 || colno >= aw->maxcolumns)
+		return;
+
+	free(aw->columns[colno].name);
+	aw->columns[colno].name = sstrndup(name, size);
+
+	if (colno >= aw->ncolumns)
+		aw->ncolumns = colno + 1;
+}
+
+/*
+ * Mark column as numeric column, when the type of source column is known
+ */
+void
+arrow_set_column_numeric(ArrowWriter *aw, int colno)
+{
+	if (colno < 0 || colno >= aw->maxcolumns)
+		return;
+
+	aw->columns[colno].is_numeric = true;
+
+	if (colno >= aw->ncolumns)
+		aw->ncolumns = colno + 1;
+}
+
+/*
+ * Update type of column by the value. This should be called for
+ * all values before the schema is written. The spaces around displayed
+ * value are used for detection of alignment of column, when the type
+ * of source column is not known. Text columns are aligned to left,
+ * numeric columns to right.
+ */
+void
+arrow_infer_value(ArrowWriter *aw, int colno,
+				  const char *str, int size,
+				  bool isnull, int lspaces, int rspaces)
+{
+	ArrowColumn *col;
+	int64_t		ival;
+	double		dval;
+
+	if (colno < 0 || colno >= aw->maxcolumns)
+		return;
+
+	if (colno >= aw->ncolumns)
+		aw->ncolumns = colno + 1;
+
+	col = &aw->columns[colno];
+
+	if (isnull)
+		return;
+
+	if (col->nvalues_spaces++ == 0)
+	{
+		col->lspaces = lspaces;
+		col->rspaces = rspaces;
+	}
+	else
+	{
+		col->lspaces_differ |= col->lspaces != lspaces;
+		col->rspaces_differ |= col->rspaces != rspaces;
+	}
+
+	if (col->type == COLUMN_TYPE_UTF8)
+		return;
+
+	if (col->type <= COLUMN_TYPE_INT64 && parse_int64(str, size, &ival))
+		col->type = COLUMN_TYPE_INT64;
+	else if (parse_float64(str, size, &dval))
+		col->type = COLUMN_TYPE_FLOAT64;
+	else
+		col->type = COLUMN_TYPE_UTF8;
+}
+
+/*
+ * Build Schema table - it is used by schema message and by footer
+ */
+static int
+arrow_build_schema(ArrowWriter *aw, FlatBuilder *fb)
+{
+	int		   *fields = smalloc(aw->ncolumns * sizeof(int));
+	int			fields_vector;
+	int			i;
+
+	for (i = 0; i < aw->ncolumns; i++)
+	{
+		ArrowColumn *col = &aw->columns[i];
+		char		namebuf[32];
+		const char *name = col->name;
+		int			name_offset;
+		int			type_offset;
+		int			children;
+		int			type_type;
+
+		/* the names are required by some readers */
+		if (!name || *name == '\0')
+		{
+			snprintf(namebuf, sizeof(namebuf), "column%d", i + 1);
+			name = namebuf;
+		}
+
+		name_offset = fb_create_string(fb, name, strlen(name));
+		children = fb_create_offsets_vector(fb, NULL, 0);
+
+		if (col->type == COLUMN_TYPE_INT64)
+		{
+			fb_start_table(fb, 2);
+			fb_add_scalar(fb, 0, 64, 4);
+			fb_add_scalar(fb, 1, 1, 1);
+			type_type = ARROW_TYPE_INT;
+		}
+		else if (col->type == COLUMN_TYPE_FLOAT64)
+		{
+			fb_start_table(fb, 1);
+			fb_add_scalar(fb, 0, ARROW_PRECISION_DOUBLE, 2);
+			type_type = ARROW_TYPE_FLOATING_POINT;
+		}
+		else
+		{
+			fb_start_table(fb, 0);
+			type_type = ARROW_TYPE_UTF8;
+		}
+
+		type_offset = fb_end_table(fb);
+
+		fb_start_table(fb, 7);
+		fb_add_offset(fb, 0, name_offset);
+		fb_add_offset(fb, 3, type_offset);
+		fb_add_offset(fb, 5, children);
+		fb_add_scalar(fb, 1, 1, 1);
+		fb_add_scalar(fb, 2, type_type, 1);
+		fields[i] = fb_end_table(fb);
+	}
+
+	fields_vector = fb_create_offsets_vector(fb, fields, aw->ncolumns);
+	free(fields);
+
+	fb_start_table(fb, 4);
+	fb_add_offset(fb, 1, fields_vector);
+
+	return fb_end_table(fb);
+}
+
+/*
+ * Write file header and schema. Column names and types should be
+ * known already.
+ */
+bool
+arrow_write_schema(ArrowWriter *aw)
+{
+	FlatBuilder fb;
+	int			schema;
+	int			message;
+	int			metadata_length;
+	bool		isok;
+	int			i;
+
+	/*
+	 * The values of columns that are not known as numeric are stored
+	 * as strings (the numbers in text column can be codes, and they
+	 * should not be changed).
+	 */
+	for (i = 0; i < aw->ncolumns; i++)
+	{
+		ArrowColumn *col = &aw->columns[i];
+
+		if ((col->type == COLUMN_TYPE_INT64 ||
+			 col->type == COLUMN_TYPE_FLOAT64) &&
+			!col->is_numeric &&
+			!(col->lspaces_differ && !col->rspaces_differ))
+			col->type = COLUMN_TYPE_UTF8;
+	}
+
+	if (!arrow_write(aw, ARROW_MAGIC "\0\0", 8))
+		return false;
+
+	fb_init(&fb);
+
+	schema = arrow_build_schema(aw, &fb);
+
+	fb_start_table(&fb, 5);
+	fb_add_scalar(&fb, 3, 0, 8);
+	fb_add_offset(&fb, 2, schema);
+	fb_add_scalar(&fb, 0, ARROW_METADATA_V5, 2);
+	fb_add_scalar(&fb, 1, ARROW_HEADER_SCHEMA, 1);
+	message = fb_end_table(&fb);
+
+	fb_finish(&fb, message);
+
+	isok = arrow_write_message(aw, &fb, &metadata_length);
+
+	free(fb.buf);
+
+	return isok;
+}
+
+/*
+ * Append value to column in current row
+ */
+void
+arrow_append_value(ArrowWriter *aw, int colno, const char *str, int size, bool isnull)
+{
+	ArrowColumn *col;
+	int64_t		ival = 0;
+	double		dval = 0.0;
+
+	if (colno < 0 || colno >= aw->ncolumns)
+		return;
+
+	col = &aw->columns[colno];
+
+	/* value was already appended */
+	if (col->nvalues > aw->nrows)
+		return;
+
+	if (!isnull)
+	{
+		if (col->type == COLUMN_TYPE_INT64)
+			isnull = !parse_int64(str, size, &ival);
+		else if (col->type == COLUMN_TYPE_FLOAT64)
+			isnull = !parse_float64(str, size, &dval);
+	}
+
+	if ((col->nvalues % 8) == 0)
+		arrow_buffer_append_le(&col->validity, 0, 1);
+
+	if (isnull)
+		col->null_count += 1;
+	else
+		col->validity.data[col->nvalues / 8] |= 1 << (col->nvalues % 8);
+
+	if (col->type == COLUMN_TYPE_INT64)
+		arrow_buffer_append_le(&col->data, (uint64_t) ival, 8);
+	else if (col->type == COLUMN_TYPE_FLOAT64)
+	{
+		uint64_t	bits;
+
+		memcpy(&bits, &dval, sizeof(bits));
+		arrow_buffer_append_le(&col->data, bits, 8);
+	}
+	else
+	{
+		if (col->nvalues == 0)
+			arrow_buffer_append_le(&col->offsets, 0, 4);
+
+		if (!isnull)
+			arrow_buffer_append(&col->data, str, size);
+
+		arrow_buffer_append_le(&col->offsets, col->data.size, 4);
+	}
+
+	col->nvalues += 1;
+}
+
+/*
+ * Write current batch as record batch message
+ */
+static bool
+arrow_write_batch(ArrowWriter *aw)
+{
+	FlatBuilder fb;
+	int64_t	   *nodes;
+	int64_t	   *buffers;
+	int			nbuffers = 0;
+	int64_t		body_length = 0;
+	int			nodes_vector;
+	int			buffers_vector;
+	int			batch;
+	int			message;
+	int			metadata_length;
+	int64_t		offset = aw->offset;
+	bool		isok;
+	int			i;
+
+	nodes = smalloc(2 * aw->ncolumns * sizeof(int64_t));
+	buffers = smalloc(2 * 3 * aw->ncolumns * sizeof(int64_t));
+
+	for (i = 0; i < aw->ncolumns; i++)
+	{
+		ArrowColumn *col = &aw->columns[i];
+		int			validity_size = col->null_count > 0 ? col->validity.size : 0;
+
+		nodes[2 * i] = aw->nrows;
+		nodes[2 * i + 1] = col->null_count;
+
+		buffers[2 * nbuffers] = body_length;
+		buffers[2 * nbuffers++ + 1] = validity_size;
+		body_length += (validity_size + 7) & ~7;
+
+		if (col->type != COLUMN_TYPE_INT64 && col->type != COLUMN_TYPE_FLOAT64)
+		{
+			buffers[2 * nbuffers] = body_length;
+			buffers[2 * nbuffers++ + 1] = col->offsets.size;
+			body_length += (col->offsets.size + 7) & ~7;
+		}
+
+		buffers[2 * nbuffers] = body_length;
+		buffers[2 * nbuffers++ + 1] = col->data.size;
+		body_length += (col->data.size + 7) & ~7;
+	}
+
+	fb_init(&fb);
+
+	nodes_vector = fb_create_pairs_vector(&fb, nodes, aw->ncolumns);
+	buffers_vector = fb_create_pairs_vector(&fb, buffers, nbuffers);
+
+	free(nodes);
+	free(buffers);
+
+	fb_start_table(&fb, 5);
+	fb_add_scalar(&fb, 0, aw->nrows, 8);
+	fb_add_offset(&fb, 1, nodes_vector);
+	fb_add_offset(&fb, 2, buffers_vector);
+	batch = fb_end_table(&fb);
+
+	fb_start_table(&fb, 5);
+	fb_add_scalar(&fb, 3, (uint64_t) body_length, 8);
+	fb_add_offset(&fb, 2, batch);
+	fb_add_scalar(&fb, 0, ARROW_METADATA_V5, 2);
+	fb_add_scalar(&fb, 1, ARROW_HEADER_RECORD_BATCH, 1);
+	message = fb_end_table(&fb);
+
+	fb_finish(&fb, message);
+
+	isok = arrow_write_message(aw, &fb, &metadata_length);
+
+	free(fb.buf);
+
+	for (i = 0; isok && i < aw->ncolumns; i++)
+	{
+		ArrowColumn *col = &aw->columns[i];
+
+		if (col->null_count > 0)
+			isok = arrow_write(aw, col->validity.data, col->validity.size) &&
+				   arrow_write_padding(aw, col->validity.size);
+
+		if (isok && col->type != COLUMN_TYPE_INT64 && col->type != COLUMN_TYPE_FLOAT64)
+			isok = arrow_write(aw, col->offsets.data, col->offsets.size) &&
+				   arrow_write_padding(aw, col->offsets.size);
+
+		if (isok)
+			isok = arrow_write(aw, col->data.data, col->data.size) &&
+				   arrow_write_padding(aw, col->data.size);
+
+		/* buffers are reused by next batch */
+		col->validity.size = 0;
+		col->offsets.size = 0;
+		col->data.size = 0;
+		col->nvalues = 0;
+		col->null_count = 0;
+	}
+
+	if (aw->nblocks == aw->maxblocks)
+	{
+		aw->maxblocks = aw->maxblocks > 0 ? aw->maxblocks * 2 : 16;
+		aw->blocks = srealloc(aw->blocks, aw->maxblocks * sizeof(ArrowBlock));
+	}
+
+	aw->blocks[aw->nblocks].offset = offset;
+	aw->blocks[aw->nblocks].metadata_length = metadata_length;
+	aw->blocks[aw->nblocks++].body_length = body_length;
+
+	aw->nrows = 0;
+
+	return isok;
+}
+
+/*
+ * Complete current row (missing values are NULL), and write the batch
+ * when it is full.
+ */
+bool
+arrow_end_row(ArrowWriter *aw)
+{
+	bool		flush = false;
+	int			i;
+
+	for (i = 0; i < aw->ncolumns; i++)
+	{
+		ArrowColumn *col = &aw->columns[i];
+
+		if (col->nvalues <= aw->nrows)
+			arrow_append_value(aw, i, NULL, 0, true);
+
+		if (col->data.size > ARROW_BATCH_MAX_BYTES)
+			flush = true;
+	}
+
+	aw->nrows += 1;
+
+	if (flush || aw->nrows == ARROW_BATCH_ROWS)
+		return arrow_write_batch(aw);
+
+	return true;
+}
+
+/*
+ * Write last batch, end of stream marker and footer
+ */
+bool
+arrow_write_footer(ArrowWriter *aw)
+{
+	FlatBuilder fb;
+	int			schema;
+	int			dictionaries;
+	int			batches;
+	int			footer;
+	bool		isok;
+
+	if (aw->nrows > 0 && !arrow_write_batch(aw))
+		return false;
+
+	if (!arrow_write_int32(aw, 0xFFFFFFFF) ||
+		!arrow_write_int32(aw, 0))
+		return false;
+
+	fb_init(&fb);
+
+	schema = arrow_build_schema(aw, &fb);
+	dictionaries = fb_create_blocks_vector(&fb, NULL, 0);
+	batches = fb_create_blocks_vector(&fb, aw->blocks, aw->nblocks);
+
+	fb_start_table(&fb, 5);
+	fb_add_offset(&fb, 1, schema);
+	fb_add_offset(&fb, 2, dictionaries);
+	fb_add_offset(&fb, 3, batches);
+	fb_add_scalar(&fb, 0, ARROW_METADATA_V5, 2);
+	footer = fb_end_table(&fb);
+
+	fb_finish(&fb, footer);
+
+	isok = arrow_write(aw, fb_data(&fb), fb.size) &&
+		   arrow_write_int32(aw, fb.size) &&
+		   arrow_write(aw, ARROW_MAGIC, 6);
+
+	free(fb.buf);
+
+	return isok;
+}
@@ -0,0 +1,1535 @@
+/*-------------------------------------------------------------------------
+ *
+ * binary-input.c
+ *	  read data in Apache Arrow IPC or PostgreSQL COPY BINARY format
+ *
+ * Portions Copyright (c) 2017-2026 Pavel Stehule
+ *
+ * IDENTIFICATION
+ *	  src/binary-input.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pspg.h"
+#include "rowbuilder.h"
+
+#define ARROW_MAGIC					"ARROW1"
+
+#define ARROW_HEADER_SCHEMA			1
+#define ARROW_HEADER_DICTIONARY_BATCH	2
+#define ARROW_HEADER_RECORD_BATCH	3
+
+#define ARROW_TYPE_NULL				1
+#define ARROW_TYPE_INT				2
+#define ARROW_TYPE_FLOATING_POINT	3
+#define ARROW_TYPE_BINARY			4
+#define ARROW_TYPE_UTF8				5
+#define ARROW_TYPE_BOOL				6
+#define ARROW_TYPE_DECIMAL			7
+#define ARROW_TYPE_DATE				8
+#define ARROW_TYPE_TIME				9
+#define ARROW_TYPE_TIMESTAMP		10
+#define ARROW_TYPE_FIXED_SIZE_BINARY	15
+#define ARROW_TYPE_LARGE_BINARY		19
+#define ARROW_TYPE_LARGE_UTF8		20
+
+/* the size of metadata and body of one message are limited by int */
+#define ARROW_MAX_MESSAGE_SIZE		(INT32_MAX - 8)
+
+#define PGCOPY_SIGNATURE			"PGCOPY\n\377\r\n"
+#define PGCOPY_SIGNATURE_SIZE		11
+#define PGCOPY_HEADER_SIZE			19
+#define PGCOPY_WITH_OIDS			(1 << 16)
+
+static uint64_t
+read_le(const unsigned char *ptr, int width)
+{
+	uint64_t	result = 0;
+	int			i;
+
+	for (i = width - 1; i >= 0; i--)
+		result = (result << 8) | ptr[i];
+
+	return result;
+}
+
+static uint64_t
+read_be(const unsigned char *ptr, int width)
+{
+	uint64_t	result = 0;
+	int			i;
+
+	for (i = 0; i < width; i++)
+		result = (result << 8) | ptr[i];
+
+	return result;
+}
+
+static int64_t
+sign_extend(uint64_t value, int width)
+{
+	if (width < 8 && (value & ((uint64_t) 1 << (width * 8 - 1))))
+		value |= ~(uint64_t) 0 << (width * 8);
+
+	return (int64_t) value;
+}
+
+/*
+ * Simple reader of flatbuffers (the format of metadata of Arrow
+ * messages). Any position is checked against the size of buffer.
+ */
+typedef struct
+{
+	const unsigned char *data;
+	int64_t		size;
+	bool		broken;
+} FlatReader;
+
+static bool
+fb_check(FlatReader *fr, int64_t pos, int64_t size)
+{
+	if (pos < 0 || size < 0 || pos > fr->size - size)
+	{
+		fr->broken = true;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Returns position of field of table or 0, when the field is not stored
+ */
+static int64_t
+fb_field(FlatReader *fr, int64_t table, int fieldno)
+{
+	int64_t		vtable;
+	int			vtsize;
+	int			offset;
+
+	if (!fb_check(fr, table, 4))
+		return 0;
+
+	vtable = table - sign_extend(read_le(fr->data + table, 4), 4);
+	if (!fb_check(fr, vtable, 4))
+		return 0;
+
+	vtsize = read_le(fr->data + vtable, 2);
+	if (4 + 2 * fieldno + 2 > vtsize || !fb_check(fr, vtable, 4 + 2 * fieldno + 2))
+		return 0;
+
+	offset = read_le(fr->data + vtable + 4 + 2 * fieldno, 2);
+
+	return offset > 0 ? table + offset : 0;
+}
+
+static int64_t
+fb_int(FlatReader *fr, int64_t table, int fieldno, int width, int64_t defval)
+{
+	int64_t		pos = fb_field(fr, table, fieldno);
+
+	if (!pos || !fb_check(fr, pos, width))
+		return defval;
+
+	return sign_extend(read_le(fr->data + pos, width), width);
+}
+
+/*
+ * Returns position of table, vector or string referenced by field
+ */
+static int64_t
+fb_ref(FlatReader *fr, int64_t table, int fieldno)
+{
+	int64_t		pos = fb_field(fr, table, fieldno);
+
+	if (!pos || !fb_check(fr, pos, 4))
+		return 0;
+
+	return pos + (int64_t) read_le(fr->data + pos, 4);
+}
+
+/*
+ * Returns position of first item of vector and number of items
+ */
+static int64_t
+fb_vector(FlatReader *fr, int64_t table, int fieldno, int itemsize, int64_t *nitems)
+{
+	int64_t		pos = fb_ref(fr, table, fieldno);
+
+	*nitems = 0;
+
+	if (!pos || !fb_check(fr, pos, 4))
+		return 0;
+
+	*nitems = read_le(fr->data + pos, 4);
+	if (!fb_check(fr, pos + 4, *nitems * itemsize))
+	{
+		*nitems = 0;
+		return 0;
+	}
+
+	return pos + 4;
+}
+
+/*
+ * Returns position of table that is item of vector of tables
+ */
+static int64_t
+fb_vector_table(FlatReader *fr, int64_t item)
+{
+	return item + (int64_t) read_le(fr->data + item, 4);
+}
+
+static char *
+fb_string(FlatReader *fr, int64_t table, int fieldno)
+{
+	int64_t		pos = fb_ref(fr, table, fieldno);
+	int64_t		size;
+	char	   *result;
+
+	if (!pos || !fb_check(fr, pos, 4))
+		return sstrdup("");
+
+	size = read_le(fr->data + pos, 4);
+	if (!fb_check(fr, pos + 4, size))
+		return sstrdup("");
+
+	/* the string can be at the end of message, so don't use sstrndup */
+	result = smalloc(size + 1);
+	memcpy(result, fr->data + pos + 4, size);
+
+	return result;
+}
+
+/*
+ * Values of one column of record batch
+ */
+typedef struct
+{
+	int64_t		length;
+	bool		all_null;
+	const unsigned char *validity;		/* NULL when all values are valid */
+	const unsigned char *offsets;
+	const unsigned char *values;
+	int64_t		values_size;
+} ArrowArray;
+
+typedef struct
+{
+	char	   *name;
+	ValueKind	kind;
+	int			width;				/* size of value in bytes, 0 for variable size */
+	bool		is_unsigned;
+	bool		is_large;			/* offsets of variable size values are 64bit */
+	int			scale;				/* scale of decimal */
+	int64_t		multiplier;			/* transforms time unit to microseconds */
+	int64_t		divisor;
+	bool		is_dictionary;
+	int64_t		dictionary_id;
+	int			index_width;
+	bool		index_is_signed;
+} ArrowColumn;
+
+typedef struct
+{
+	int64_t		id;
+	ArrowArray	array;
+	char	   *body;
+} ArrowDictionary;
+
+typedef struct
+{
+	FILE	   *fp;
+	unsigned char *meta;
+	int			meta_size;
+	unsigned char *body;
+	int			body_size;
+	int64_t		body_length;		/* size of body of current message */
+	FlatReader	fr;
+	int64_t		header;				/* position of message header */
+	int			header_type;
+	ArrowColumn columns[1024];
+	int			ncolumns;
+	ArrowDictionary *dictionaries;
+	int			ndictionaries;
+} ArrowReader;
+
+/*
+ * Iterator over nodes and buffers of record batch
+ */
+typedef struct
+{
+	FlatReader *fr;
+	int64_t		nodes;
+	int64_t		nnodes;
+	int64_t		buffers;
+	int64_t		nbuffers;
+	int			nodeno;
+	int			bufno;
+	const unsigned char *body;
+	int64_t		body_size;
+} BatchIterator;
+
+static bool
+arrow_next_buffer(BatchIterator *bi, const unsigned char **ptr, int64_t *size)
+{
+	int64_t		pos;
+	int64_t		offset;
+
+	if (bi->bufno >= bi->nbuffers)
+		return false;
+
+	pos = bi->buffers + 16 * bi->bufno++;
+
+	offset = (int64_t) read_le(bi->fr->data + pos, 8);
+	*size = (int64_t) read_le(bi->fr->data + pos + 8, 8);
+
+	if (offset < 0 || *size < 0 || offset > bi->body_size - *size)
+		return false;
+
+	*ptr = *size > 0 ? bi->body + offset : NULL;
+
+	return true;
+}
+
+/*
+ * Read description of next column of record batch. The layout of
+ * buffers depends on type. For dictionary encoded column, the
+ * array holds indexes to dictionary.
+ */
+static bool
+arrow_read_array(BatchIterator *bi, ArrowColumn *col, bool is_dictionary_data, ArrowArray *arr)
+{
+	const unsigned char *validity;
+	int64_t		validity_size;
+	int64_t		null_count;
+	int64_t		pos;
+	ValueKind	kind = col->kind;
+	int			width = col->width;
+
+	if (bi->nodeno >= bi->nnodes)
+		return false;
+
+	memset(arr, 0, sizeof(ArrowArray));
+
+	pos = bi->nodes + 16 * bi->nodeno++;
+	arr->length = (int64_t) read_le(bi->fr->data + pos, 8);
+	null_count = (int64_t) read_le(bi->fr->data + pos + 8, 8);
+
+	if (arr->length < 0)
+		return false;
+
+	/* null type has not any buffer */
+	if (kind == VALUE_NULL)
+	{
+		arr->all_null = true;
+		return true;
+	}
+
+	/* any value needs one bit at least */
+	if (arr->length / 8 > bi->body_size + 1)
+		return false;
+
+	if (col->is_dictionary && !is_dictionary_data)
+	{
+		kind = VALUE_INT;
+		width = col->index_width;
+	}
+
+	if (!arrow_next_buffer(bi, &validity, &validity_size))
+		return false;
+
+	if (null_count > 0 && null_count == arr->length)
+		arr->all_null = true;
+	else if (null_count != 0 && validity)
+	{
+		if (validity_size < (arr->length + 7) / 8)
+			return false;
+
+		arr->validity = validity;
+	}
+
+	if ((kind == VALUE_TEXT || kind == VALUE_BINARY) && width == 0)
+	{
+		const unsigned char *offsets;
+		int64_t		offsets_size;
+
+		if (!arrow_next_buffer(bi, &offsets, &offsets_size))
+			return false;
+
+		if (arr->length > 0 &&
+			offsets_size < (arr->length + 1) * (col->is_large ? 8 : 4))
+			return false;
+
+		arr->offsets = offsets;
+
+		if (!arrow_next_buffer(bi, &arr->values, &arr->values_size))
+			return false;
+	}
+	else
+	{
+		if (!arrow_next_buffer(bi, &arr->values, &arr->values_size))
+			return false;
+
+		if (kind == VALUE_BOOL)
+		{
+			if (arr->values_size < (arr->length + 7) / 8)
+				return false;
+		}
+		else if (arr->length > 0 && arr->values_size / width < arr->length)
+			return false;
+	}
+
+	return true;
+}
+
+static double
+half_to_double(uint16_t h)
+{
+	int			exponent = (h >> 10) & 0x1f;
+	int			mantissa = h & 0x3ff;
+	double		result;
+
+	if (exponent == 0)
+		result = ldexp(mantissa, -24);
+	else if (exponent == 31)
+		result = mantissa ? NAN : INFINITY;
+	else
+		result = ldexp(mantissa + 1024, exponent - 25);
+
+	return (h & 0x8000) ? -result : result;
+}
+
+/*
+ * Converts value in some time unit to microseconds (round down).
+ * Values out of range are saturated.
+ */
+static int64_t
+to_usecs(ArrowColumn *col, int64_t value)
+{
+	if (col->divisor > 1)
+	{
+		int64_t		result = value / col->divisor;
+
+		if (value % col->divisor < 0)
+			result -= 1;
+
+		return result;
+	}
+
+	/* keep space for shift to PostgreSQL epoch */
+	if (value > (INT64_MAX / 2) / col->multiplier)
+		return INT64_MAX / 2;
+	else if (value < (INT64_MIN / 2) / col->multiplier)
+		return INT64_MIN / 2;
+
+	return value * col->multiplier;
+}
+
+/*
+ * Reads value of array. Returns false, when data are broken.
+ */
+static bool
+arrow_get_value(ArrowColumn *col, ArrowArray *arr, int64_t rowno, Value *v)
+{
+	const unsigned char *ptr;
+
+	memset(v, 0, sizeof(Value));
+
+	if (arr->all_null ||
+		(arr->validity && !(arr->validity[rowno >> 3] & (1 << (rowno & 7)))))
+	{
+		v->isnull = true;
+		return true;
+	}
+
+	ptr = arr->values + rowno * col->width;
+
+	switch (col->kind)
+	{
+		case VALUE_INT:
+			if (col->is_unsigned)
+				v->i = (int64_t) read_le(ptr, col->width);
+			else
+				v->i = sign_extend(read_le(ptr, col->width), col->width);
+			break;
+
+		case VALUE_UINT:
+			v->u = read_le(ptr, 8);
+			break;
+
+		case VALUE_FLOAT4:
+			if (col->width == 2)
+				v->d = half_to_double((uint16_t) read_le(ptr, 2));
+			else
+			{
+				uint32_t	bits = (uint32_t) read_le(ptr, 4);
+				float		f;
+
+				memcpy(&f, &bits, sizeof(f));
+				v->d = f;
+			}
+			break;
+
+		case VALUE_FLOAT8:
+			{
+				uint64_t	bits = read_le(ptr, 8);
+
+				memcpy(&v->d, &bits, sizeof(double));
+			}
+			break;
+
+		case VALUE_DECIMAL:
+			if (col->width == 16)
+			{
+				v->u = read_le(ptr, 8);
+				v->i = (int64_t) read_le(ptr + 8, 8);
+			}
+			else
+			{
+				v->u = (uint64_t) sign_extend(read_le(ptr, col->width), col->width);
+				v->i = (int64_t) v->u < 0 ? -1 : 0;
+			}
+			break;
+
+		case VALUE_BOOL:
+			v->i = (arr->values[rowno >> 3] >> (rowno & 7)) & 1;
+			break;
+
+		case VALUE_DATE:
+			v->i = sign_extend(read_le(ptr, col->width), col->width);
+
+			/* date64 is in milliseconds */
+			if (col->width == 8)
+				v->i = v->i / 86400000 - (v->i % 86400000 < 0 ? 1 : 0);
+			break;
+
+		case VALUE_TIME:
+		case VALUE_TIMESTAMP:
+			v->i = to_usecs(col, sign_extend(read_le(ptr, col->width), col->width));
+			break;
+
+		case VALUE_TEXT:
+		case VALUE_BINARY:
+			if (col->width > 0)
+			{
+				v->str = (const char *) ptr;
+				v->size = col->width;
+			}
+			else
+			{
+				int			owidth = col->is_large ? 8 : 4;
+				int64_t		start;
+				int64_t		end;
+
+				start = (int64_t) read_le(arr->offsets + rowno * owidth, owidth);
+				end = (int64_t) read_le(arr->offsets + (rowno + 1) * owidth, owidth);
+
+				if (start < 0 || end < start || end > arr->values_size ||
+					end - start > INT32_MAX / 2 - 8)
+					return false;
+
+				v->str = (const char *) arr->values + start;
+				v->size = (int) (end - start);
+			}
+			break;
+
+		default:
+			v->isnull = true;
+			break;
+	}
+
+	return true;
+}
+
+/*
+ * Set kind of column from Arrow type. Returns false, when the type
+ * is not supported.
+ */
+static bool
+arrow_set_type(FlatReader *fr, ArrowColumn *col, int type_type, int64_t type)
+{
+	int64_t		unit;
+
+	col->multiplier = 1;
+	col->divisor = 1;
+
+	switch (type_type)
+	{
+		case ARROW_TYPE_NULL:
+			col->kind = VALUE_NULL;
+			return true;
+
+		case ARROW_TYPE_INT:
+			{
+				int			bitwidth = fb_int(fr, type, 0, 4, 0);
+				bool		is_signed = fb_int(fr, type, 1, 1, 0);
+
+				if (bitwidth != 8 && bitwidth != 16 && bitwidth != 32 && bitwidth != 64)
+					return false;
+
+				col->width = bitwidth / 8;
+				col->is_unsigned = !is_signed;
+				col->kind = (!is_signed && bitwidth == 64) ? VALUE_UINT : VALUE_INT;
+			}
+			return true;
+
+		case ARROW_TYPE_FLOATING_POINT:
+			switch (fb_int(fr, type, 0, 2, 0))
+			{
+				case 0:
+					col->kind = VALUE_FLOAT4;
+					col->width = 2;
+					return true;
+				case 1:
+					col->kind = VALUE_FLOAT4;
+					col->width = 4;
+					return true;
+				case 2:
+					col->kind = VALUE_FLOAT8;
+					col->width = 8;
+					return true;
+			}
+			return false;
+
+		case ARROW_TYPE_BINARY:
+		case ARROW_TYPE_LARGE_BINARY:
+			col->kind = VALUE_BINARY;
+			col->is_large = type_type == ARROW_TYPE_LARGE_BINARY;
+			return true;
+
+		case ARROW_TYPE_UTF8:
+		case ARROW_TYPE_LARGE_UTF8:
+			col->kind = VALUE_TEXT;
+			col->is_large = type_type == ARROW_TYPE_LARGE_UTF8;
+			return true;
+
+		case ARROW_TYPE_FIXED_SIZE_BINARY:
+			col->kind = VALUE_BINARY;
+			col->width = fb_int(fr, type, 0, 4, 0);
+			return col->width > 0 && col->width < INT32_MAX / 2 - 8;
+
+		case ARROW_TYPE_BOOL:
+			col->kind = VALUE_BOOL;
+			return true;
+
+		case ARROW_TYPE_DECIMAL:
+			{
+				int			bitwidth = fb_int(fr, type, 2, 4, 128);
+
+				col->kind = VALUE_DECIMAL;
+				col->width = bitwidth / 8;
+				col->scale = fb_int(fr, type, 1, 4, 0);
+
+				return (bitwidth == 32 || bitwidth == 64 || bitwidth == 128) &&
+						col->scale >= -40 && col->scale <= 40;
+			}
+
+		case ARROW_TYPE_DATE:
+			col->kind = VALUE_DATE;
+			col->width = fb_int(fr, type, 0, 2, 1) == 0 ? 4 : 8;
+			return true;
+
+		case ARROW_TYPE_TIME:
+		case ARROW_TYPE_TIMESTAMP:
+			if (type_type == ARROW_TYPE_TIME)
+			{
+				col->kind = VALUE_TIME;
+				col->width = fb_int(fr, type, 1, 4, 32) / 8;
+				unit = fb_int(fr, type, 0, 2, 1);
+
+				if (col->width != 4 && col->width != 8)
+					return false;
+			}
+			else
+			{
+				col->kind = VALUE_TIMESTAMP;
+				col->width = 8;
+				unit = fb_int(fr, type, 0, 2, 0);
+			}
+
+			switch (unit)
+			{
+				case 0:
+					col->multiplier = USECS_PER_SEC;
+					return true;
+				case 1:
+					col->multiplier = 1000;
+					return true;
+				case 2:
+					return true;
+				case 3:
+					col->divisor = 1000;
+					return true;
+			}
+			return false;
+	}
+
+	return false;
+}
+
+static bool
+arrow_read_schema(ArrowReader *ar, RowBuilder *b)
+{
+	FlatReader *fr = &ar->fr;
+	const char *names[1024];
+	int64_t		fields;
+	int64_t		nfields;
+	int			i;
+
+	if (fb_int(fr, ar->header, 0, 2, 0) != 0)
+	{
+		format_error("Arrow data in big endian format are not supported");
+		return false;
+	}
+
+	fields = fb_vector(fr, ar->header, 1, 4, &nfields);
+
+	if (nfields == 0)
+	{
+		format_error("Arrow data has not any column");
+		return false;
+	}
+	else if (nfields > 1024)
+	{
+		format_error("too much columns");
+		return false;
+	}
+
+	for (i = 0; i < nfields; i++)
+	{
+		ArrowColumn *col = &ar->columns[i];
+		int64_t		field = fb_vector_table(fr, fields + 4 * i);
+		int64_t		dictionary;
+
+		col->name = fb_string(fr, field, 0);
+		ar->ncolumns += 1;
+
+		if (!arrow_set_type(fr, col, fb_int(fr, field, 2, 1, 0), fb_ref(fr, field, 3)))
+		{
+			format_error("Arrow type of column \"%s\" is not supported", col->name);
+			return false;
+		}
+
+		b->kinds[i] = col->kind;
+		b->scales[i] = col->scale;
+
+		if ((dictionary = fb_ref(fr, field, 4)))
+		{
+			int64_t		index_type = fb_ref(fr, dictionary, 1);
+
+			col->is_dictionary = true;
+			col->dictionary_id = fb_int(fr, dictionary, 0, 8, 0);
+			col->index_width = 4;
+			col->index_is_signed = true;
+
+			if (index_type)
+			{
+				col->index_width = fb_int(fr, index_type, 0, 4, 32) / 8;
+				col->index_is_signed = fb_int(fr, index_type, 1, 1, 0);
+
+				if (col->index_width != 1 && col->index_width != 2 &&
+					col->index_width != 4 && col->index_width != 8)
+				{
+					format_error("Arrow type of column \"%s\" is not supported", col->name);
+					return false;
+				}
+			}
+		}
+	}
+
+	if (fr->broken)
+	{
+		format_error("broken Arrow schema");
+		return false;
+	}
+
+	for (i = 0; i < ar->ncolumns; i++)
+		names[i] = ar->columns[i].name;
+
+	return builder_set_columns(b, ar->ncolumns, names);
+}
+
+static bool
+arrow_init_batch(ArrowReader *ar, int64_t batch, const unsigned char *body, BatchIterator *bi)
+{
+	FlatReader *fr = &ar->fr;
+
+	memset(bi, 0, sizeof(BatchIterator));
+
+	bi->fr = fr;
+	bi->body = body;
+	bi->body_size = ar->body_length;
+
+	bi->nodes = fb_vector(fr, batch, 1, 16, &bi->nnodes);
+	bi->buffers = fb_vector(fr, batch, 2, 16, &bi->nbuffers);
+
+	if (fb_ref(fr, batch, 3))
+	{
+		format_error("compressed Arrow data are not supported");
+		return false;
+	}
+
+	return !fr->broken;
+}
+
+static ArrowDictionary *
+arrow_find_dictionary(ArrowReader *ar, int64_t id)
+{
+	int			i;
+
+	for (i = 0; i < ar->ndictionaries; i++)
+		if (ar->dictionaries[i].id == id)
+			return &ar->dictionaries[i];
+
+	return NULL;
+}
+
+/*
+ * The dictionary is stored until it is replaced by other dictionary
+ * with same id.
+ */
+static bool
+arrow_read_dictionary(ArrowReader *ar)
+{
+	FlatReader *fr = &ar->fr;
+	ArrowColumn *col = NULL;
+	ArrowDictionary *dict;
+	BatchIterator bi;
+	int64_t		id;
+	int64_t		batch;
+	char	   *body;
+	int			i;
+
+	id = fb_int(fr, ar->header, 0, 8, 0);
+	batch = fb_ref(fr, ar->header, 1);
+
+	if (fb_int(fr, ar->header, 2, 1, 0))
+	{
+		format_error("delta dictionaries of Arrow data are not supported");
+		return false;
+	}
+
+	for (i = 0; i < ar->ncolumns; i++)
+	{
+		if (ar->columns[i].is_dictionary && ar->columns[i].dictionary_id == id)
+		{
+			col = &ar->columns[i];
+			break;
+		}
+	}
+
+	/* dictionary is not used */
+	if (!col)
+		return true;
+
+	if (!batch)
+		goto broken;
+
+	body = smalloc(ar->body_length > 0 ? ar->body_length : 1);
+	if (ar->body_length > 0)
+		memcpy(body, ar->body, ar->body_length);
+
+	if (!(dict = arrow_find_dictionary(ar, id)))
+	{
+		ar->dictionaries = srealloc(ar->dictionaries,
+									(ar->ndictionaries + 1) * sizeof(ArrowDictionary));
+		dict = &ar->dictionaries[ar->ndictionaries++];
+		dict->body = NULL;
+	}
+
+	free(dict->body);
+	dict->id = id;
+	dict->body = body;
+
+	memset(&dict->array, 0, sizeof(ArrowArray));
+
+	if (!arrow_init_batch(ar, batch, (unsigned char *) body, &bi))
+	{
+		if (!fr->broken)
+			return false;
+
+		goto broken;
+	}
+
+	if (!arrow_read_array(&bi, col, true, &dict->array))
+	{
+		memset(&dict->array, 0, sizeof(ArrowArray));
+		goto broken;
+	}
+
+	return true;
+
+broken:
+	format_error("broken Arrow dictionary");
+	return false;
+}
+
+static bool
+arrow_read_record_batch(ArrowReader *ar, RowBuilder *b)
+{
+	FlatReader *fr = &ar->fr;
+	ArrowArray	arrays[1024];
+	ArrowDictionary *dicts[1024];
+	BatchIterator bi;
+	int64_t		nrows;
+	int64_t		rowno;
+	int			i;
+
+	if (!arrow_init_batch(ar, ar->header, ar->body, &bi))
+	{
+		if (!fr->broken)
+			return false;
+
+		goto broken;
+	}
+
+	nrows = fb_int(fr, ar->header, 0, 8, 0);
+
+	for (i = 0; i < ar->ncolumns; i++)
+	{
+		ArrowColumn *col = &ar->columns[i];
+
+		if (!arrow_read_array(&bi, col, false, &arrays[i]))
+			goto broken;
+
+		if (arrays[i].length < nrows)
+			goto broken;
+
+		dicts[i] = NULL;
+
+		if (col->is_dictionary && !arrays[i].all_null &&
+			!(dicts[i] = arrow_find_dictionary(ar, col->dictionary_id)))
+		{
+			format_error("missing dictionary of column \"%s\"", col->name);
+			return false;
+		}
+	}
+
+	for (rowno = 0; rowno < nrows; rowno++)
+	{
+		for (i = 0; i < ar->ncolumns; i++)
+		{
+			ArrowColumn *col = &ar->columns[i];
+			Value		v;
+
+			if (dicts[i])
+			{
+				ArrowColumn index_col;
+				int64_t		index;
+
+				memset(&index_col, 0, sizeof(ArrowColumn));
+				index_col.kind = VALUE_INT;
+				index_col.width = col->index_width;
+				index_col.is_unsigned = !col->index_is_signed;
+
+				if (!arrow_get_value(&index_col, &arrays[i], rowno, &v))
+					goto broken;
+
+				if (!v.isnull)
+				{
+					index = v.i;
+
+					if (index < 0 || index >= dicts[i]->array.length)
+						goto broken;
+
+					if (!arrow_get_value(col, &dicts[i]->array, index, &v))
+						goto broken;
+				}
+			}
+			else if (!arrow_get_value(col, &arrays[i], rowno, &v))
+				goto broken;
+
+			builder_add(b, &v);
+		}
+
+		builder_end_row(b);
+	}
+
+	return true;
+
+broken:
+	format_error("broken Arrow record batch");
+	return false;
+}
+
+static bool
+read_exactly(FILE *fp, void *ptr, size_t size)
+{
+	return fread(ptr, 1, size, fp) == size;
+}
+
+/*
+ * Reads next message. Returns false on error, eos is true on the
+ * end of stream.
+ */
+static bool
+arrow_read_message(ArrowReader *ar, unsigned char *prefix, bool *eos)
+{
+	FlatReader *fr = &ar->fr;
+	unsigned char buf[4];
+	int64_t		len;
+	int64_t		message;
+
+	*eos = false;
+
+	if (prefix)
+		memcpy(buf, prefix, 4);
+	else
+	{
+		size_t		n = fread(buf, 1, 4, ar->fp);
+
+		if (n == 0 && !ferror(ar->fp))
+		{
+			*eos = true;
+			return true;
+		}
+		else if (n != 4)
+			goto broken;
+	}
+
+	/* continuation mark is not used by old format */
+	if (read_le(buf, 4) == 0xFFFFFFFF && !read_exactly(ar->fp, buf, 4))
+		goto broken;
+
+	len = read_le(buf, 4);
+
+	if (len == 0)
+	{
+		*eos = true;
+		return true;
+	}
+	else if (len > ARROW_MAX_MESSAGE_SIZE)
+		goto broken;
+
+	if (len > ar->meta_size)
+	{
+		ar->meta = srealloc(ar->meta, len);
+		ar->meta_size = len;
+	}
+
+	if (!read_exactly(ar->fp, ar->meta, len))
+		goto broken;
+
+	fr->data = ar->meta;
+	fr->size = len;
+	fr->broken = false;
+
+	if (!fb_check(fr, 0, 4))
+		goto broken;
+
+	message = read_le(fr->data, 4);
+
+	ar->header_type = fb_int(fr, message, 1, 1, 0);
+	ar->header = fb_ref(fr, message, 2);
+	ar->body_length = fb_int(fr, message, 3, 8, 0);
+
+	if (fr->broken || !ar->header ||
+		ar->body_length < 0 || ar->body_length > ARROW_MAX_MESSAGE_SIZE)
+		goto broken;
+
+	if (ar->body_length > ar->body_size)
+	{
+		ar->body = srealloc(ar->body, ar->body_length);
+		ar->body_size = ar->body_length;
+	}
+
+	if (!read_exactly(ar->fp, ar->body, ar->body_length))
+		goto broken;
+
+	return true;
+
+broken:
+	format_error("broken or incomplete Arrow data");
+	return false;
+}
+
+static bool
+read_arrow(FILE *fp, RowBuilder *b)
+{
+	ArrowReader *ar;
+	unsigned char buf[8];
+	unsigned char *prefix = NULL;
+	bool		has_schema = false;
+	bool		result = true;
+	int			i;
+
+	if (!read_exactly(fp, buf, 4))
+	{
+		format_error("missing data");
+		return false;
+	}
+
+	/* Arrow file format starts by magic, and then holds stream format */
+	if (memcmp(buf, ARROW_MAGIC, 4) == 0)
+	{
+		if (!read_exactly(fp, buf + 4, 4) ||
+			memcmp(buf, ARROW_MAGIC "\0\0", 8) != 0)
+		{
+			format_error("input is not in Arrow IPC format");
+			return false;
+		}
+	}
+	else
+		prefix = buf;
+
+	ar = smalloc(sizeof(ArrowReader));
+	ar->fp = fp;
+
+	while (result)
+	{
+		bool		eos;
+
+		if (!(result = arrow_read_message(ar, prefix, &eos)) || eos)
+			break;
+
+		prefix = NULL;
+
+		if (ar->header_type == ARROW_HEADER_SCHEMA)
+		{
+			if (has_schema)
+			{
+				format_error("broken Arrow data (more schemas)");
+				result = false;
+			}
+			else
+				result = has_schema = arrow_read_schema(ar, b);
+		}
+		else if (!has_schema)
+		{
+			format_error("input is not in Arrow IPC format");
+			result = false;
+		}
+		else if (ar->header_type == ARROW_HEADER_DICTIONARY_BATCH)
+			result = arrow_read_dictionary(ar);
+		else if (ar->header_type == ARROW_HEADER_RECORD_BATCH)
+			result = arrow_read_record_batch(ar, b);
+	}
+
+	if (result && !has_schema)
+	{
+		format_error("missing data");
+		result = false;
+	}
+
+	for (i = 0; i < ar->ncolumns; i++)
+		free(ar->columns[i].name);
+
+	for (i = 0; i < ar->ndictionaries; i++)
+		free(ar->dictionaries[i].body);
+
+	free(ar->dictionaries);
+	free(ar->meta);
+	free(ar->body);
+	free(ar);
+
+	return result;
+}
+
+/*
+ * COPY BINARY data has not any information about types. The type
+ * is guessed from values of column.
+ */
+typedef struct
+{
+	bool		has_values;
+	bool		is_text;
+	bool		is_bool;
+	bool		is_numeric;
+	bool		is_float;
+	int			size;				/* size of all values or -1 */
+} TypeGuess;
+
+static bool
+is_text_value(const unsigned char *ptr, int size)
+{
+	const unsigned char *end = ptr + size;
+
+	while (ptr < end)
+	{
+		unsigned char c = *ptr;
+
+		if (c < 0x20)
+		{
+			if (c != '\t' && c != '\n' && c != '\r')
+				return false;
+
+			ptr += 1;
+		}
+		else if (c < 0x80 || !use_utf8)
+		{
+			if (c == 0x7f)
+				return false;
+
+			ptr += 1;
+		}
+		else
+		{
+			int			clen;
+			int			i;
+
+			if ((c & 0xe0) == 0xc0)
+				clen = 2;
+			else if ((c & 0xf0) == 0xe0)
+				clen = 3;
+			else if ((c & 0xf8) == 0xf0)
+				clen = 4;
+			else
+				return false;
+
+			if (end - ptr < clen)
+				return false;
+
+			for (i = 1; i < clen; i++)
+				if ((ptr[i] & 0xc0) != 0x80)
+					return false;
+
+			ptr += clen;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Returns true, when the value has a format of binary numeric
+ */
+static bool
+is_numeric_value(const unsigned char *ptr, int size)
+{
+	int			ndigits;
+	int			sign;
+	int			dscale;
+	int			i;
+
+	if (size < 8)
+		return false;
+
+	ndigits = (int16_t) read_be(ptr, 2);
+	sign = read_be(ptr + 4, 2);
+	dscale = (int16_t) read_be(ptr + 6, 2);
+
+	if (ndigits < 0 || size != 8 + 2 * ndigits || dscale < 0 || dscale > 0x3fff)
+		return false;
+
+	if (sign != 0 && sign != 0x4000 &&
+		!((sign == 0xC000 || sign == 0xD000 || sign == 0xF000) && ndigits == 0))
+		return false;
+
+	for (i = 0; i < ndigits; i++)
+		if (read_be(ptr + 8 + 2 * i, 2) > 9999)
+			return false;
+
+	return true;
+}
+
+/*
+ * Integers are more common than floats, so the value is a float only
+ * when it is zero, or when the exponent of float is not too small
+ * or too big (the small integers has zero exponent). Special values
+ * like NaN or Infinity are not detected.
+ */
+static bool
+is_float_value(const unsigned char *ptr, int size)
+{
+	uint64_t	bits = read_be(ptr, size);
+	int			exponent;
+
+	if (size == 4)
+	{
+		if ((bits & 0x7fffffff) == 0)
+			return true;
+
+		exponent = (bits >> 23) & 0xff;
+		return exponent >= 127 - 40 && exponent <= 127 + 40;
+	}
+
+	if ((bits & INT64_C(0x7fffffffffffffff)) == 0)
+		return true;
+
+	exponent = (bits >> 52) & 0x7ff;
+	return exponent >= 1023 - 300 && exponent <= 1023 + 300;
+}
+
+static void
+guess_type(TypeGuess *tg, const unsigned char *ptr, int size)
+{
+	if (!tg->has_values)
+	{
+		tg->has_values = true;
+		tg->is_text = true;
+		tg->is_bool = true;
+		tg->is_numeric = true;
+		tg->is_float = true;
+		tg->size = size;
+	}
+
+	if (tg->size != size)
+		tg->size = -1;
+
+	if (tg->is_text)
+		tg->is_text = is_text_value(ptr, size);
+
+	if (tg->is_bool)
+		tg->is_bool = size == 1 && *ptr <= 1;
+
+	if (tg->is_numeric)
+		tg->is_numeric = is_numeric_value(ptr, size);
+
+	if (tg->is_float)
+		tg->is_float = (size == 4 || size == 8) && is_float_value(ptr, size);
+}
+
+static ValueKind
+guessed_kind(TypeGuess *tg)
+{
+	if (!tg->has_values || tg->is_text)
+		return VALUE_TEXT;
+	else if (tg->is_bool)
+		return VALUE_BOOL;
+	else if (tg->size == 2)
+		return VALUE_INT;
+	else if (tg->size == 4 || tg->size == 8)
+		return tg->is_float ? (tg->size == 4 ? VALUE_FLOAT4 : VALUE_FLOAT8) : VALUE_INT;
+	else if (tg->is_numeric)
+		return VALUE_NUMERIC;
+
+	return VALUE_BINARY;
+}
+
+static bool
+read_copy_binary(FILE *fp, RowBuilder *b)
+{
+	unsigned char *data = NULL;
+	TypeGuess  *guesses = NULL;
+	size_t		size = 0;
+	size_t		allocated = 0;
+	size_t		pos;
+	size_t		start;
+	size_t		n;
+	long		ntuples = 0;
+	int			nfields = 0;
+	int			i;
+
+	/* read all data, the types are known after reading of all values */
+	do
+	{
+		if (allocated - size < 65536)
+		{
+			allocated = allocated > 0 ? allocated * 2 : 1024 * 1024;
+
+			if (!(data = realloc(data, allocated)))
+				leave("out of memory");
+		}
+
+		n = fread(data + size, 1, allocated - size, fp);
+		size += n;
+	} while (n > 0);
+
+	if (size < PGCOPY_HEADER_SIZE ||
+		memcmp(data, PGCOPY_SIGNATURE, PGCOPY_SIGNATURE_SIZE) != 0)
+	{
+		if (size == 0)
+			format_error("missing data");
+		else
+			format_error("input is not in PostgreSQL COPY BINARY format");
+
+		free(data);
+		return false;
+	}
+
+	if (read_be(data + 11, 4) & PGCOPY_WITH_OIDS)
+	{
+		format_error("COPY BINARY data with oids are not supported");
+		free(data);
+		return false;
+	}
+
+	start = PGCOPY_HEADER_SIZE + read_be(data + 15, 4);
+	if (start > size)
+		goto broken;
+
+	/* first pass - check format and guess types */
+	pos = start;
+	while (pos + 2 <= size)
+	{
+		int			nf = (int16_t) read_be(data + pos, 2);
+
+		pos += 2;
+
+		/* trailer */
+		if (nf == -1)
+			break;
+
+		if (ntuples == 0)
+		{
+			if (nf <= 0 || nf > 1024)
+				goto broken;
+
+			nfields = nf;
+			guesses = smalloc(nfields * sizeof(TypeGuess));
+		}
+		else if (nf != nfields)
+			goto broken;
+
+		for (i = 0; i < nfields; i++)
+		{
+			int32_t		len;
+
+			if (pos + 4 > size)
+				goto broken;
+
+			len = (int32_t) read_be(data + pos, 4);
+			pos += 4;
+
+			if (len == -1)
+				continue;
+
+			if (len < 0 || (size_t) len > size - pos || len > INT32_MAX / 2 - 8)
+				goto broken;
+
+			guess_type(&guesses[i], data + pos, len);
+			pos += len;
+		}
+
+		ntuples += 1;
+	}
+
+	if (ntuples == 0)
+	{
+		format_error("missing data");
+		free(data);
+		return false;
+	}
+
+	for (i = 0; i < nfields; i++)
+		b->kinds[i] = guessed_kind(&guesses[i]);
+
+	if (!builder_set_columns(b, nfields, NULL))
+	{
+		free(data);
+		return false;
+	}
+
+	/* second pass - store values */
+	pos = start;
+	while (ntuples-- > 0)
+	{
+		pos += 2;
+
+		for (i = 0; i < nfields; i++)
+		{
+			const unsigned char *ptr;
+			int32_t		len;
+			Value		v;
+
+			len = (int32_t) read_be(data + pos, 4);
+			pos += 4;
+
+			memset(&v, 0, sizeof(Value));
+
+			if (len == -1)
+			{
+				v.isnull = true;
+				builder_add(b, &v);
+				continue;
+			}
+
+			ptr = data + pos;
+			pos += len;
+
+			switch (b->kinds[i])
+			{
+				case VALUE_INT:
+					v.i = sign_extend(read_be(ptr, len), len);
+					break;
+
+				case VALUE_FLOAT4:
+					{
+						uint32_t	bits = (uint32_t) read_be(ptr, 4);
+						float		f;
+
+						memcpy(&f, &bits, sizeof(f));
+						v.d = f;
+					}
+					break;
+
+				case VALUE_FLOAT8:
+					{
+						uint64_t	bits = read_be(ptr, 8);
+
+						memcpy(&v.d, &bits, sizeof(double));
+					}
+					break;
+
+				case VALUE_BOOL:
+					v.i = *ptr;
+					break;
+
+				default:
+					v.str = (const char *) ptr;
+					v.size = len;
+					break;
+			}
+
+			builder_add(b, &v);
+		}
+
+		builder_end_row(b);
+	}
+
+	free(guesses);
+	free(data);
+
+	return true;
+
+broken:
+	format_error("broken PostgreSQL COPY BINARY data");
+	free(guesses);
+	free(data);
+
+	return false;
+}
+
+/*
+ * Read data in binary format. The result is in same format like
+ * the result of query (see pg_exec_query).
+ */
+bool
+read_binary_input(Options *opts,
+				  FILE *fp,
+				  RowBucketType *rb,
+				  PrintDataDesc *pdesc,
+				  ColumnStats **colstats,
+				  TypedColumn **typed_columns)
+{
+	RowBuilder	b;
+	bool		result;
+
+	builder_init(&b, opts, rb, pdesc);
+
+	if (opts->arrow_format)
+		result = read_arrow(fp, &b);
+	else
+		result = read_copy_binary(fp, &b);
+
+	if (!result)
+	{
+		builder_free(&b, rb);
+		return false;
+	}
+
+	free(b.buffer);
+
+	*colstats = b.colstats;
+	*typed_columns = b.typed_columns;
+
+	return true;
+}
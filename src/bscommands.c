@@ -220,6 +220,17 @@ parse_exported_spec(const char *instr,
 				spec->format = CLIPBOARD_FORMAT_SQL_VALUES;
 				format_specified = true;
 			}
+			else if (IS_TOKEN(token, n, "pgcopy"))
+			{
+				spec->format = CLIPBOARD_FORMAT_COPY_TEXT;
+				format_specified = true;
+			}
+			else if (IS_TOKEN(token, n, "arrow") ||
+					 IS_TOKEN(token, n, "feather"))
+			{
+				spec->format = CLIPBOARD_FORMAT_ARROW;
+				format_specified = true;
+			}
 			else if (IS_TOKEN(token, n, "text"))
 			{
 				spec->format = CLIPBOARD_FORMAT_TEXT;
@@ -371,11 +382,18 @@ substr_column_name_search(DataDesc *desc,
 
 	*colno = -1;
 
+	/* there are not column names */
+	if (!desc->namesline)
+		return 0;
+
 	for (i = first_colno; i <= desc->columns; i++)
 	{
 		char	   *name = desc->namesline + desc->cranges[i - 1].name_offset;
 		int			size = desc->cranges[i - 1].name_size;
 
+		if (desc->cranges[i - 1].name_offset < 0)
+			continue;
+
 		if (use_utf8)
 		{
 			if (utf8_nstrstr_with_sizes(name, size, pattern, len))
@@ -553,6 +571,170 @@ parse_search_spec(DataDesc *desc,
 	return instr;
 }
 
+/*
+ * Parse filter specification: column operator value. The value is
+ * rest of command line (like search pattern).
+ */
+static bool
+parse_filter_spec(DataDesc *desc,
+				  const char *instr,
+				  RowFilter *filter)
+{
+	const char *ident;
+	const char *value;
+	char	   *endptr;
+	int			len;
+
+	memset(filter, 0, sizeof(RowFilter));
+
+	if (!desc->headline_transl || desc->is_expanded_mode || desc->columns == 0)
+	{
+		show_info_wait(" Filter is available only for tabular data",
+					   NULL, true, true, false, true);
+		return false;
+	}
+
+	instr = get_identifier(instr, &ident, &len, true);
+	if (len == 0)
+	{
+		show_info_wait(" Invalid identifier (expected column name)",
+					   NULL, true, true, false, true);
+		return false;
+	}
+
+	if (isdigit(*ident))
+	{
+		filter->colno = strtol(ident, NULL, 10);
+		if (filter->colno < 1 || filter->colno > desc->columns)
+		{
+			show_info_wait(" Column number is out of range",
+						   NULL, true, true, false, true);
+			return false;
+		}
+	}
+	else
+	{
+		ident = trim_quoted_str(ident, &len);
+		if (substr_column_name_search(desc, ident, len, 1, &filter->colno) == 0)
+		{
+			show_info_wait(" Cannot to identify column",
+						   NULL, true, true, false, true);
+			return false;
+		}
+	}
+
+	while (instr && *instr == ' ')
+		instr += 1;
+
+	if (!instr || *instr == '\0')
+	{
+		show_info_wait(" Syntax error (expected operator)",
+					   NULL, true, true, false, true);
+		return false;
+	}
+
+	if (strncmp(instr, "<>", 2) == 0 || strncmp(instr, "!=", 2) == 0)
+	{
+		filter->op = FILTER_OP_NE;
+		instr += 2;
+	}
+	else if (strncmp(instr, "<=", 2) == 0)
+	{
+		filter->op = FILTER_OP_LE;
+		instr += 2;
+	}
+	else if (strncmp(instr, ">=", 2) == 0)
+	{
+		filter->op = FILTER_OP_GE;
+		instr += 2;
+	}
+	else if (strncmp(instr, "==", 2) == 0)
+	{
+		filter->op = FILTER_OP_EQ;
+		instr += 2;
+	}
+	else if (*instr == '=')
+	{
+		filter->op = FILTER_OP_EQ;
+		instr += 1;
+	}
+	else if (*instr == '<')
+	{
+		filter->op = FILTER_OP_LT;
+		instr += 1;
+	}
+	else if (*instr == '>')
+	{
+		filter->op = FILTER_OP_GT;
+		instr += 1;
+	}
+	else if (*instr == '~')
+	{
+		filter->op = FILTER_OP_CONTAINS;
+		instr += 1;
+	}
+	else
+	{
+		show_info_wait(" Syntax error (expected operator =, <>, <, <=, >, >= or ~)",
+					   NULL, true, true, false, true);
+		return false;
+	}
+
+	len = strlen(instr);
+	value = trim_quoted_str(instr, &len);
+
+	/* single quote char */
+	if (len < 0)
+		len = 0;
+
+	if (len == 0 && filter->op == FILTER_OP_CONTAINS)
+	{
+		show_info_wait(" Syntax error (expected non empty)",
+					   NULL, true, true, false, true);
+		return false;
+	}
+
+	if (len > (int) sizeof(filter->value) - 1)
+		len = sizeof(filter->value) - 1;
+
+	memcpy(filter->value, value, len);
+	filter->value[len] = '\0';
+
+	if (len > 0)
+	{
+		errno = 0;
+		filter->value_num = strtod(filter->value, &endptr);
+		filter->value_is_num = errno == 0 && *endptr == '\0';
+	}
+
+	return true;
+}
+
+/*
+ * Returns true, when next backslash command exports data. These commands
+ * are evaluated immediately (not by next_command), so the caller should
+ * defer them until all data are loaded.
+ */
+bool
+bscommand_require_complete_load(const char *cmdline)
+{
+	int			n = 0;
+
+	if (!cmdline)
+		return false;
+
+	while (*cmdline == ' ')
+		cmdline++;
+
+	if (*cmdline++ != '\\')
+		return false;
+
+	while (isalpha(cmdline[n]))
+		n += 1;
+
+	return IS_TOKEN(cmdline, n, "save") || IS_TOKEN(cmdline, n, "copy");
+}
+
 /*
  * Parse and processes one backslash command.
  * Returns pointer to next backslash command.
@@ -798,7 +980,7 @@ parse_and_eval_bscommand(const char *cmdline,
 		const char   *ident;
 		int		len;
 		bool	is_desc;
-		PspgCommand OrderCommand;
+		SortSpec spec;
 
 		is_desc = IS_TOKEN(cmdline, n, "ordd") ||
 				  IS_TOKEN(cmdline, n, "orderd") ||
@@ -808,20 +990,31 @@ parse_and_eval_bscommand(const char *cmdline,
 				  IS_TOKEN(cmdline, n, "rsort") ||
 				  IS_TOKEN(cmdline, n, "desc");
 
-		OrderCommand = is_desc ? cmd_SortDesc : cmd_SortAsc;
-		cmdline = get_identifier(cmdline + n, &ident, &len, true);
+		cmdline += n;
+		spec.nkeys = 0;
 
-		if (len > 0)
+		/* list of columns separated by comma, like \sort a, b desc, c */
+		while (true)
 		{
+			const char *token;
+			int		colno;
+			int		toklen;
+
+			cmdline = get_identifier(cmdline, &ident, &len, true);
+
+			if (len == 0)
+			{
+				show_info_wait(" Invalid identifier (expected column name)",
+							   NULL, true, true, false, true);
+				return NULL;
+			}
+
 			if (isdigit(*ident))
 			{
 				/* entered column number */
-				*long_argument = strtol(ident, NULL, 10);
-				*long_argument_is_valid = true;
+				colno = strtol(ident, NULL, 10);
 
-				if (*long_argument >= 1 && *long_argument <= desc->columns)
-					*next_command = OrderCommand;
-				else
+				if (colno < 1 || colno > desc->columns)
 				{
 					show_info_wait(" Column number is out of range",
 								   NULL, true, true, false, true);
@@ -830,33 +1023,119 @@ parse_and_eval_bscommand(const char *cmdline,
 			}
 			else
 			{
-				int		count;
-				int		colno;
-
 				ident = trim_quoted_str(ident, &len);
-				count = substr_column_name_search(desc, ident, len, 1, &colno);
 
-				*long_argument = colno;
+				if (substr_column_name_search(desc, ident, len, 1, &colno) == 0)
+				{
+					show_info_wait(" Cannot to identify column",
+								   NULL, true, true, false, true);
+					return NULL;
+				}
+			}
+
+			if (spec.nkeys == MAX_SORT_KEYS)
+			{
+				show_info_wait(" Too much sorted columns",
+							   NULL, true, true, false, true);
+				return NULL;
+			}
+
+			spec.colnos[spec.nkeys] = colno;
+			spec.desc[spec.nkeys] = is_desc;
+
+			/* optional direction */
+			token = NULL;
+			if (cmdline)
+				(void) get_token(cmdline, &token, &toklen);
+
+			if (token && (IS_TOKEN(token, toklen, "asc") || IS_TOKEN(token, toklen, "desc")))
+			{
+				spec.desc[spec.nkeys] = IS_TOKEN(token, toklen, "desc");
+				cmdline = token + toklen;
+			}
+
+			spec.nkeys += 1;
+
+			while (cmdline && *cmdline == ' ')
+				cmdline += 1;
+
+			if (!cmdline || *cmdline != ',')
+				break;
+
+			cmdline += 1;
+		}
 
-				if (count > 0)
+		if (spec.nkeys == 1)
+		{
+			*long_argument = spec.colnos[0];
+			*long_argument_is_valid = true;
+			*next_command = spec.desc[0] ? cmd_SortDesc : cmd_SortAsc;
+		}
+		else
+		{
+			memcpy(&scrdesc->sortspec, &spec, sizeof(SortSpec));
+			*next_command = cmd_SortByColumns;
+		}
+	}
+	else if (IS_TOKEN(cmdline, n, "stats"))
+	{
+		const char   *ident;
+		int		len;
+
+		cmdline = get_identifier(cmdline + n, &ident, &len, true);
+
+		/* without identifier, the column under vertical cursor is used */
+		if (len > 0)
+		{
+			if (isdigit(*ident))
+			{
+				*long_argument = strtol(ident, NULL, 10);
+
+				if (*long_argument < 1 || *long_argument > desc->columns)
 				{
-					*long_argument_is_valid = true;
-					*next_command = OrderCommand;
+					show_info_wait(" Column number is out of range",
+								   NULL, true, true, false, true);
+					return NULL;
 				}
-				else
+			}
+			else
+			{
+				int		colno;
+
+				ident = trim_quoted_str(ident, &len);
+				if (substr_column_name_search(desc, ident, len, 1, &colno) == 0)
 				{
 					show_info_wait(" Cannot to identify column",
 								   NULL, true, true, false, true);
 					return NULL;
 				}
+
+				*long_argument = colno;
 			}
+
+			*long_argument_is_valid = true;
 		}
-		else
+
+		*next_command = cmd_ShowColumnStats;
+	}
+	else if (IS_TOKEN(cmdline, n, "filter"))
+	{
+		const char *ptr = cmdline + n;
+		RowFilter	filter;
+
+		while (*ptr == ' ')
+			ptr += 1;
+
+		if (*ptr == '\0')
+			*next_command = cmd_CancelFilter;
+		else if (parse_filter_spec(desc, ptr, &filter))
 		{
-			show_info_wait(" Invalid identifier (expected column name)",
-						   NULL, true, true, false, true);
-			return NULL;
+			memcpy(&scrdesc->next_filter, &filter, sizeof(RowFilter));
+			*next_command = cmd_ApplyFilter;
 		}
+
+		/* value is rest of command line */
+		return NULL;
 	}
 	else if (IS_TOKEN(cmdline, n, "save"))
 	{
@@ -0,0 +1,399 @@
+/*-------------------------------------------------------------------------
+ *
+ * colstats.c
+ *	  incremental statistics of columns
+ *
+ * Portions Copyright (c) 2017-2026 Pavel Stehule
+ *
+ * IDENTIFICATION
+ *	  src/colstats.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pspg.h"
+
+#define TDIGEST_COMPRESSION			100
+#define TDIGEST_MAX_CENTROIDS		(2 * TDIGEST_COMPRESSION)
+#define TDIGEST_BUFFER_SIZE			512
+
+typedef struct
+{
+	double	mean;
+	double	weight;
+} Centroid;
+
+/*
+ * Merging t-digest. New values are stored in buffer, and when buffer
+ * is full, then the values are merged with centroids. The size of
+ * centroids is limited by scale function, so the centroids on tails
+ * are smaller than centroids in the middle, and then the extreme
+ * quantiles are more accurate.
+ */
+struct _TDigest
+{
+	int		ncentroids;
+	int		nbuffered;
+	double	total_weight;			/* weight of centroids (without buffer) */
+	Centroid centroids[TDIGEST_MAX_CENTROIDS];
+	double	buffer[TDIGEST_BUFFER_SIZE];
+};
+
+static int
+centroid_cmp(const void *a, const void *b)
+{
+	double		m1 = ((const Centroid *) a)->mean;
+	double		m2 = ((const Centroid *) b)->mean;
+
+	return m1 < m2 ? -1 : (m1 > m2 ? 1 : 0);
+}
+
+/*
+ * k1 scale function
+ */
+static double
+tdigest_k(double q)
+{
+	return TDIGEST_COMPRESSION / (2.0 * M_PI) * asin(2.0 * q - 1.0);
+}
+
+static void
+tdigest_compress(TDigest *td)
+{
+	Centroid	merged[TDIGEST_MAX_CENTROIDS + TDIGEST_BUFFER_SIZE];
+	Centroid   *cur;
+	double		total;
+	double		so_far = 0.0;
+	double		k_left;
+	int			n = 0;
+	int			i;
+
+	if (td->nbuffered == 0)
+		return;
+
+	memcpy(merged, td->centroids, td->ncentroids * sizeof(Centroid));
+	n = td->ncentroids;
+
+	for (i = 0; i < td->nbuffered; i++)
+	{
+		merged[n].mean = td->buffer[i];
+		merged[n++].weight = 1.0;
+	}
+
+	qsort(merged, n, sizeof(Centroid), centroid_cmp);
+
+	total = td->total_weight + td->nbuffered;
+
+	cur = td->centroids;
+	*cur = merged[0];
+	k_left = tdigest_k(0.0);
+
+	for (i = 1; i < n; i++)
+	{
+		double		q = (so_far + cur->weight + merged[i].weight) / total;
+
+		if (tdigest_k(q) - k_left <= 1.0 ||
+			cur == &td->centroids[TDIGEST_MAX_CENTROIDS - 1])
+		{
+			cur->weight += merged[i].weight;
+			cur->mean += (merged[i].mean - cur->mean) * merged[i].weight / cur->weight;
+		}
+		else
+		{
+			so_far += cur->weight;
+			k_left = tdigest_k(so_far / total);
+			*++cur = merged[i];
+		}
+	}
+
+	td->ncentroids = cur - td->centroids + 1;
+	td->total_weight = total;
+	td->nbuffered = 0;
+}
+
+static void
+tdigest_add(TDigest *td, double value)
+{
+	if (td->nbuffered == TDIGEST_BUFFER_SIZE)
+		tdigest_compress(td);
+
+	td->buffer[td->nbuffered++] = value;
+}
+
+/*
+ * Returns estimated quantile. The values between centers of centroids
+ * are interpolated, and the tails are interpolated to known min and max.
+ */
+static double
+tdigest_quantile(TDigest *td, double q, double min, double max)
+{
+	Centroid   *c = td->centroids;
+	double		index;
+	double		cum = 0.0;
+	int			n;
+	int			i;
+
+	tdigest_compress(td);
+
+	n = td->ncentroids;
+	if (n == 1)
+		return c[0].mean;
+
+	index = q * td->total_weight;
+
+	if (index < c[0].weight / 2.0)
+		return min + (c[0].mean - min) * index / (c[0].weight / 2.0);
+
+	for (i = 0; i < n - 1; i++)
+	{
+		double		left_center = cum + c[i].weight / 2.0;
+		double		right_center = cum + c[i].weight + c[i + 1].weight / 2.0;
+
+		if (index <= right_center)
+			return c[i].mean + (c[i + 1].mean - c[i].mean) *
+						(index - left_center) / (right_center - left_center);
+
+		cum += c[i].weight;
+	}
+
+	index -= td->total_weight - c[n - 1].weight / 2.0;
+
+	return c[n - 1].mean + (max - c[n - 1].mean) * index / (c[n - 1].weight / 2.0);
+}
+
+/*
+ * 64bit FNV-1a with murmur3 finalizer. The finalizer is necessary,
+ * because HyperLogLog requires well distributed bits.
+ */
+static uint64_t
+hash_string(const char *str)
+{
+	uint64_t	h = UINT64_C(14695981039346656037);
+
+	while (*str)
+	{
+		h ^= (unsigned char) *str++;
+		h *= UINT64_C(1099511628211);
+	}
+
+	h ^= h >> 33;
+	h *= UINT64_C(0xff51afd7ed558ccd);
+	h ^= h >> 33;
+	h *= UINT64_C(0xc4ceb9fe1a85ec53);
+	h ^= h >> 33;
+
+	return h;
+}
+
+static void
+hll_add(unsigned char *registers, const char *str)
+{
+	uint64_t	h = hash_string(str);
+	int			index = h >> (64 - COLSTATS_HLL_BITS);
+	uint64_t	w = h << COLSTATS_HLL_BITS;
+	unsigned char rank = 1;
+
+	while (rank <= 64 - COLSTATS_HLL_BITS && !(w & (UINT64_C(1) << 63)))
+	{
+		rank += 1;
+		w <<= 1;
+	}
+
+	if (rank > registers[index])
+		registers[index] = rank;
+}
+
+/*
+ * Returns true, when str is number. Only decimal numbers are accepted
+ * (strtod accepts inf, nan and hex numbers too).
+ */
+static bool
+parse_number(const char *str, double *d)
+{
+	const char *ptr = str;
+	char	   *endptr;
+
+	if (*ptr == '-' || *ptr == '+')
+		ptr += 1;
+
+	if (!isdigit((unsigned char) *ptr) &&
+		!(*ptr == '.' && isdigit((unsigned char) ptr[1])))
+		return false;
+
+	if (*ptr == '0' && (ptr[1] == 'x' || ptr[1] == 'X'))
+		return false;
+
+	*d = strtod(str, &endptr);
+
+	return *endptr == '\0';
+}
+
+static void
+replace_str(char **dest, const char *str)
+{
+	free(*dest);
+	*dest = sstrdup(str);
+}
+
+/*
+ * Add numeric value to statistics. The string is used for
+ * estimation of distinct values.
+ */
+void
+colstats_add_number(ColumnStats *cs, const char *str, double d)
+{
+	cs->is_valid = true;
+	cs->count += 1;
+
+	hll_add(cs->hll, str);
+
+	if (cs->numbers == 0)
+	{
+		cs->min = d;
+		cs->max = d;
+	}
+	else
+	{
+		if (d < cs->min)
+			cs->min = d;
+		if (d > cs->max)
+			cs->max = d;
+	}
+
+	cs->sum += d;
+	cs->numbers += 1;
+
+	if (!cs->tdigest)
+		cs->tdigest = smalloc(sizeof(TDigest));
+
+	tdigest_add(cs->tdigest, d);
+}
+
+/*
+ * Add value to statistics. The value should be trimmed already.
+ */
+void
+colstats_add_value(ColumnStats *cs, const char *str, bool isnull)
+{
+	double		d;
+
+	if (isnull)
+	{
+		cs->is_valid = true;
+		cs->nulls += 1;
+		return;
+	}
+
+	if (parse_number(str, &d))
+		colstats_add_number(cs, str, d);
+	else
+	{
+		cs->is_valid = true;
+		cs->count += 1;
+
+		hll_add(cs->hll, str);
+
+		if (!cs->min_str || strcoll(str, cs->min_str) < 0)
+			replace_str(&cs->min_str, str);
+
+		if (!cs->max_str || strcoll(str, cs->max_str) > 0)
+			replace_str(&cs->max_str, str);
+	}
+}
+
+/*
+ * Returns HyperLogLog estimation of number of distinct values
+ */
+double
+colstats_distinct(ColumnStats *cs)
+{
+	double		m = COLSTATS_HLL_REGISTERS;
+	double		alpha = 0.7213 / (1.0 + 1.079 / m);
+	double		sum = 0.0;
+	int			zeros = 0;
+	double		estimate;
+	int			i;
+
+	for (i = 0; i < COLSTATS_HLL_REGISTERS; i++)
+	{
+		sum += ldexp(1.0, -cs->hll[i]);
+
+		if (cs->hll[i] == 0)
+			zeros += 1;
+	}
+
+	estimate = alpha * m * m / sum;
+
+	/* small range correction - linear counting */
+	if (estimate <= 2.5 * m && zeros > 0)
+		estimate = m * log(m / zeros);
+
+	/* the estimation cannot be higher than number of values */
+	if (estimate > cs->count)
+		estimate = cs->count;
+
+	return estimate;
+}
+
+/*
+ * Returns false, when column has not any numeric value
+ */
+bool
+colstats_quantile(ColumnStats *cs, double q, double *result)
+{
+	if (cs->numbers == 0 || !cs->tdigest)
+		return false;
+
+	*result = tdigest_quantile(cs->tdigest, q, cs->min, cs->max);
+
+	if (*result < cs->min)
+		*result = cs->min;
+	if (*result > cs->max)
+		*result = cs->max;
+
+	return true;
+}
+
+/*
+ * Returns zeroed array of statistics, or enlarged array (the
+ * new items are zeroed).
+ */
+ColumnStats *
+colstats_realloc(ColumnStats *colstats, int oldn, int newn)
+{
+	colstats = srealloc(colstats, newn * sizeof(ColumnStats));
+
+	if (newn > oldn)
+		memset(colstats + oldn, 0, (newn - oldn) * sizeof(ColumnStats));
+
+	return colstats;
+}
+
+void
+colstats_free_item(ColumnStats *cs)
+{
+	free(cs->min_str);
+	free(cs->max_str);
+	free(cs->tdigest);
+
+	memset(cs, 0, sizeof(ColumnStats));
+}
+
+void
+colstats_free(ColumnStats *colstats, int n)
+{
+	int		i;
+
+	if (!colstats)
+		return;
+
+	for (i = 0; i < n; i++)
+		colstats_free_item(&colstats[i]);
+
+	free(colstats);
+}
@@ -167,6 +167,8 @@ cmd_string(int cmd)
 			return "CISearchSet";
 		case cmd_USSearchSet:
 			return "USSearchSet";
+		case cmd_RegexSearchToggle:
+			return "RegexSearchToggle";
 		case cmd_HighlightLines:
 			return "HighlightLines";
 		case cmd_HighlightValues:
@@ -338,10 +340,24 @@ cmd_string(int cmd)
 			return "SortDesc";
 		case cmd_OriginalSort:
 			return "OriginalSort";
+		case cmd_SortByColumns:
+			return "SortByColumns";
+		case cmd_ApplyFilter:
+			return "ApplyFilter";
+		case cmd_CancelFilter:
+			return "CancelFilter";
+		case cmd_ShowColumnStats:
+			return "ShowColumnStats";
 
 		case cmd_TogglePause:
 			return "TogglePause";
 
+		case cmd_HistoryOlder:
+			return "HistoryOlder";
+
+		case cmd_HistoryNewer:
+			return "HistoryNewer";
+
 		case cmd_Refresh:
 			return "Refresh";
 
@@ -364,6 +380,10 @@ cmd_string(int cmd)
 			return "UseClipboardFormatINSERT";
 		case cmd_UseClipboard_INSERT_with_comments:
 			return "UseClipboardFormatINSERTwithcomments";
+		case cmd_UseClipboard_COPY_text:
+			return "UseClipboardFormatCOPYtext";
+		case cmd_UseClipboard_Arrow:
+			return "UseClipboardFormatArrow";
 		case cmd_TogleEmptyStringIsNULL:
 			return "TogleEmptyStringIsNULL";
 		case cmd_SetOwnNULLString:
@@ -554,6 +574,10 @@ translate_event(int c, bool alt, Options *opts, int *nested_command)
 				return cmd_Escape;
 			case ' ':
 				return opts->watch_time > 0 ? cmd_TogglePause : cmd_PageDown;
+			case '<':
+				return opts->watch_time > 0 ? cmd_HistoryOlder : cmd_Invalid;
+			case '>':
+				return opts->watch_time > 0 ? cmd_HistoryNewer : cmd_Invalid;
 			case 6:		/* CTRL F */
 			case KEY_NPAGE:
 				return cmd_PageDown;
@@ -796,6 +820,9 @@ require_complete_load(int cmd)
 		case cmd_SortAsc:
 		case cmd_SortDesc:
 		case cmd_OriginalSort:
+		case cmd_SortByColumns:
+		case cmd_ApplyFilter:
+		case cmd_ShowColumnStats:
 		case cmd_SaveData:
 		case cmd_Copy:
 		case cmd_GotoLine:
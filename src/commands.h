@@ -42,6 +42,7 @@ typedef enum PspgCommand
 	cmd_CSSearchSet,
 	cmd_CISearchSet,
 	cmd_USSearchSet,
+	cmd_RegexSearchToggle,
 	cmd_HighlightLines,
 	cmd_HighlightValues,
 	cmd_NoHighlight,
@@ -126,7 +127,13 @@ typedef enum PspgCommand
 	cmd_SortAsc,
 	cmd_SortDesc,
 	cmd_OriginalSort,
+	cmd_SortByColumns,
+	cmd_ApplyFilter,
+	cmd_CancelFilter,
+	cmd_ShowColumnStats,
 	cmd_TogglePause,
+	cmd_HistoryOlder,
+	cmd_HistoryNewer,
 	cmd_Refresh,
 	cmd_SetCopyFile,
 	cmd_SetCopyClipboard,
@@ -137,6 +144,8 @@ typedef enum PspgCommand
 	cmd_UseClipboard_pipe_separated,
 	cmd_UseClipboard_INSERT,
 	cmd_UseClipboard_INSERT_with_comments,
+	cmd_UseClipboard_COPY_text,
+	cmd_UseClipboard_Arrow,
 	cmd_TogleEmptyStringIsNULL,
 	cmd_SetOwnNULLString,
 
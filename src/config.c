@@ -129,6 +129,9 @@ save_config(const char *path, Options *opts)
 	SAFE_SAVE_BOOL_OPTION("bold_cursor", opts->bold_cursor);
 	SAFE_SAVE_BOOL_OPTION("ignore_case", opts->ignore_case);
 	SAFE_SAVE_BOOL_OPTION("ignore_lower_case", opts->ignore_lower_case);
+	SAFE_SAVE_BOOL_OPTION("regex_search", opts->regex_search);
+	SAFE_SAVE_BOOL_OPTION("highlight_changes", opts->highlight_changes);
+	SAFE_SAVE_BOOL_OPTION("binary_results", opts->binary_results);
 	SAFE_SAVE_BOOL_OPTION("no_cursor", opts->no_cursor);
 	SAFE_SAVE_BOOL_OPTION("no_sound", quiet_mode);
 	SAFE_SAVE_BOOL_OPTION("no_mouse", opts->no_mouse);
@@ -179,6 +182,14 @@ save_config(const char *path, Options *opts)
 	if (result < 0)
 		return false;
 
+	result = fprintf(f, "watch_history = %d\n", opts->watch_history);
+	if (result < 0)
+		return false;
+
+	result = fprintf(f, "stream_max_rows = %d\n", opts->stream_max_rows);
+	if (result < 0)
+		return false;
+
 	if (opts->nullstr)
 	{
 		result = fprintf(f, "nullstr = \"%s\"\n", opts->nullstr);
@@ -284,6 +295,12 @@ load_config(FILE *f, Options *opts)
 				is_valid = assign_bool(key, &opts->ignore_case, bool_val, res);
 			else if (strcmp(key, "ignore_lower_case") == 0)
 				is_valid = assign_bool(key, &opts->ignore_lower_case, bool_val, res);
+			else if (strcmp(key, "regex_search") == 0)
+				is_valid = assign_bool(key, &opts->regex_search, bool_val, res);
+			else if (strcmp(key, "highlight_changes") == 0)
+				is_valid = assign_bool(key, &opts->highlight_changes, bool_val, res);
+			else if (strcmp(key, "binary_results") == 0)
+				is_valid = assign_bool(key, &opts->binary_results, bool_val, res);
 			else if (strcmp(key, "no_sound") == 0)
 				is_valid = assign_bool(key, &quiet_mode, bool_val, res);
 			else if (strcmp(key, "no_cursor") == 0)
@@ -321,7 +338,7 @@ load_config(FILE *f, Options *opts)
 			else if (strcmp(key, "pgcli_fix") == 0)
 				is_valid = assign_bool(key, &opts->pgcli_fix, bool_val, res);
 			else if (strcmp(key, "default_clipboard_format") == 0)
-				is_valid = assign_int(key, (int *) &opts->clipboard_format, int_val, res, 0, CLIPBOARD_FORMAT_INSERT_WITH_COMMENTS);
+				is_valid = assign_int(key, (int *) &opts->clipboard_format, int_val, res, 0, CLIPBOARD_FORMAT_ARROW);
 			else if (strcmp(key, "clipboard_app") == 0)
 				is_valid = assign_int(key, &opts->clipboard_app, int_val, res, 0, 3);
 			else if (strcmp(key, "xterm_mouse_mode") == 0)
@@ -338,6 +355,10 @@ load_config(FILE *f, Options *opts)
 				is_valid = assign_bool(key, &opts->last_row_search, bool_val, res);
 			else if (strcmp(key, "hist_size") == 0)
 				is_valid = assign_int(key, (int *) &opts->hist_size, int_val, res, 0, INT_MAX);
+			else if (strcmp(key, "watch_history") == 0)
+				is_valid = assign_int(key, &opts->watch_history, int_val, res, 0, 4096);
+			else if (strcmp(key, "stream_max_rows") == 0)
+				is_valid = assign_int(key, &opts->stream_max_rows, int_val, res, 0, 100000000);
 			else if (strcmp(key, "progressive_load_mode") == 0)
 				is_valid = assign_bool(key, &opts->progressive_load_mode, bool_val, res);
 			else if (strcmp(key, "custom_theme_name") == 0)
@@ -26,10 +26,13 @@ typedef enum
 	CLIPBOARD_FORMAT_PIPE_SEPARATED,
 	CLIPBOARD_FORMAT_SQL_VALUES,
 	CLIPBOARD_FORMAT_INSERT,
-	CLIPBOARD_FORMAT_INSERT_WITH_COMMENTS
+	CLIPBOARD_FORMAT_INSERT_WITH_COMMENTS,
+	CLIPBOARD_FORMAT_COPY_TEXT,
+	CLIPBOARD_FORMAT_ARROW
 } ClipboardFormat;
 
-#define DSV_FORMAT_TYPE(f)		(f == CLIPBOARD_FORMAT_CSV || f == CLIPBOARD_FORMAT_TSVC || f == CLIPBOARD_FORMAT_SQL_VALUES)
+#define DSV_FORMAT_TYPE(f)		(f == CLIPBOARD_FORMAT_CSV || f == CLIPBOARD_FORMAT_TSVC || \
+								 f == CLIPBOARD_FORMAT_SQL_VALUES || f == CLIPBOARD_FORMAT_COPY_TEXT)
 #define INSERT_FORMAT_TYPE(f)	(f == CLIPBOARD_FORMAT_INSERT || f == CLIPBOARD_FORMAT_INSERT_WITH_COMMENTS)
 
 typedef enum
@@ -44,6 +47,7 @@ typedef struct
 	char   *log_pathname;
 	bool	ignore_case;
 	bool	ignore_lower_case;
+	bool	regex_search;
 	bool	no_mouse;
 	bool	less_status_bar;
 	bool	no_highlight_search;
@@ -63,12 +67,17 @@ typedef struct
 	bool	bold_cursor;
 	bool	tsv_format;
 	bool	csv_format;
+	bool	arrow_format;
+	bool	copy_binary_format;
+	bool	jsonl_format;
 	char	csv_separator;
 	char	csv_header;			/* a - auto, - off, + on */
 	unsigned int csv_trim_width;
 	unsigned int csv_trim_rows;
 	char   *nullstr;
 	char   *csv_skip_columns_like;
+	char   *columns;			/* list of displayed columns */
+	char   *exclude_columns;	/* list of not displayed columns */
 	bool	ignore_short_rows;
 	bool	pgcli_fix;			/* hints for using from pgcli */
 	bool	double_header;
@@ -77,6 +86,13 @@ typedef struct
 	bool	no_sigint_search_reset;
 	char   *query;
 	int		watch_time;
+	bool	highlight_changes;		/* highlight changed cells in watch mode */
+	int		watch_history;			/* memory limit of watch history in MB */
+	int		stream_max_rows;		/* max rows kept in stream mode, 0 is unlimited */
+	int		max_rows;				/* keep only first N data rows, 0 is unlimited */
+	int		tail_rows;				/* keep only last N data rows, 0 is unlimited */
+	int		sample_rows;			/* keep random sample of N data rows, 0 is unlimited */
+	bool	binary_results;			/* request query result in binary format */
 	char   *host;
 	char   *username;
 	char   *port;
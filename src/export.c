@@ -13,8 +13,11 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
+#include <signal.h>
 #include <string.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #include "pspg.h"
 #include "commands.h"
@@ -112,6 +115,95 @@ csv_format(char *str, int *slen,
 	return result;
 }
 
+/*
+ * Returns true, when the value is NULL (specified by nullstr, the NULL
+ * symbol or empty string when empty_string_is_null is true).
+ */
+static bool
+is_null_value(char *str, int slen,
+			  bool empty_string_is_null,
+			  char *nullstr, int nullstrlen)
+{
+	if (nullstrlen > 0 &&
+		slen == nullstrlen &&
+		strncmp(str, nullstr, nullstrlen) == 0)
+		return true;
+
+	if (use_utf8 &&
+		slen == 3 && strncmp(str, "\342\210\205", 3) == 0)
+		return true;
+
+	return slen == 0 && empty_string_is_null;
+}
+
+/*
+ * Ensure correct formatting of value for text format of PostgreSQL's
+ * COPY command. NULL is written as \N, and backslash and control chars
+ * are escaped. Can returns malloc ed string when value should be escaped.
+ */
+static char *
+copy_text_format(char *str, int *slen,
+				 bool empty_string_is_null,
+				 char *nullstr, int nullstrlen)
+{
+	char   *ptr = str;
+	char   *result;
+	bool	needs_escaping = false;
+	int		_slen;
+
+	if (is_null_value(str, *slen, empty_string_is_null, nullstr, nullstrlen))
+	{
+		*slen = 2;
+		return sstrdup("\\N");
+	}
+
+	_slen = *slen;
+	while (_slen > 0)
+	{
+		if (*ptr == '\\' || *ptr == '\t' || *ptr == '\r' || *ptr == '\n')
+		{
+			needs_escaping = true;
+			break;
+		}
+
+		ptr += 1;
+		_slen -= 1;
+	}
+
+	if (!needs_escaping)
+		return str;
+
+	result = ptr = smalloc2(*slen * 2 + 1,
+							"COPY format output buffer allocation");
+
+	_slen = *slen;
+	*slen = 0;
+	while (_slen-- > 0)
+	{
+		char	c = *str++;
+
+		if (c == '\\' || c == '\t' || c == '\r' || c == '\n')
+		{
+			*ptr++ = '\\';
+			*slen += 1;
+
+			if (c == '\t')
+				c = 't';
+			else if (c == '\r')
+				c = 'r';
+			else if (c == '\n')
+				c = 'n';
+		}
+
+		*ptr++ = c;
+		*slen += 1;
+	}
+
+	*ptr = '\0';
+
+	return result;
+}
+
 /*
  * Ensure correct format for SQL identifier
  */
@@ -360,8 +452,88 @@ typedef struct
 	char		linestyle;
 
 	int			nlines;			/* for debug purposes */
+	int			read_rows;
+	int			processed_rows;
+
+	/* range and parts of data that should be exported */
+	PspgCommand	cmd;
+	ClipboardFormat data_format;
+	int			min_row;
+	int			max_row;
+	bool		print_header;
+	bool		print_footer;
+	bool		print_border;
+	bool		print_header_line;
+
+	int			_errno;			/* errno of failed write */
+
+	ArrowWriter *arrow;			/* used by Arrow format */
+	bool		arrow_infer;	/* first pass - detection of types */
+
+	bool		use_spans;		/* fields are cut by field spans */
+	FieldSpan  *spans;			/* field spans of exported row, or NULL */
+
+	struct _ExportTask *task;	/* not NULL for export in background */
 } ExportState;
 
+/*
+ * Background export works with own snapshot of DataDesc and order map,
+ * so the data can be browsed, sorted or filtered meanwhile. The lines
+ * are shared with pager, and pager doesn't release them until the
+ * export is finished.
+ */
+typedef struct _ExportTask
+{
+	pthread_t	thread;
+	pthread_mutex_t mutex;
+
+	ExportState expstate;
+	DataDesc	desc;
+
+	char		path[MAXPATHLEN];
+	char	   *nullstr;
+	char		table_name[255];
+
+	time_t		start_sec;
+	long		start_ms;
+
+	/* following fields are protected by mutex */
+	time_t		end_sec;
+	long		end_ms;
+	long		rows;
+	long		bytes;
+	bool		canceled;
+	bool		finished;
+	bool		isok;
+} ExportTask;
+
+static ExportTask *export_task = NULL;
+
+/* how often (in processed rows) the progress is published */
+#define EXPORT_PROGRESS_ROWS		1024
+
+/*
+ * Publish progress of background export. Returns false, when the
+ * export was canceled.
+ */
+static bool
+export_task_progress(ExportTask *task, long rows)
+{
+	off_t		bytes = ftello(task->expstate.fp);
+	bool		canceled;
+
+	pthread_mutex_lock(&task->mutex);
+
+	task->rows = rows;
+	if (bytes != -1)
+		task->bytes = bytes;
+	canceled = task->canceled;
+
+	pthread_mutex_unlock(&task->mutex);
+
+	return !canceled;
+}
+
 /*
  * Export one segment of format (decoration or field) to output file.
  */
@@ -572,6 +744,62 @@ process_item(ExportState *expstate,
 		}
 	}
 
+	/*
+	 * Values are passed to Arrow writer. In first pass the types
+	 * of columns are detected, in second pass values are stored.
+	 */
+	else if (expstate->format == CLIPBOARD_FORMAT_ARROW)
+	{
+		errno = 0;
+
+		if (typ == 'N' && !is_colname && !has_continue_mark)
+		{
+			if (!expstate->arrow_infer && !arrow_end_row(expstate->arrow))
+			{
+				expstate->_errno = errno;
+				return false;
+			}
+
+			expstate->nlines += 1;
+		}
+		else if (typ == 'd')
+		{
+			int		lspaces = 0;
+			int		rspaces = 0;
+
+			/* spaces around value are used for detection of alignment */
+			while (lspaces < size && field[lspaces] == ' ')
+				lspaces += 1;
+
+			while (rspaces < size - lspaces && field[size - rspaces - 1] == ' ')
+				rspaces += 1;
+
+			field = trim_str(field, &size);
+
+			if (is_colname)
+			{
+				if (expstate->arrow_infer)
+					arrow_set_column_name(expstate->arrow, expstate->colno, field, size);
+			}
+			else
+			{
+				bool	isnull = is_null_value(field, size,
+											   expstate->empty_string_is_null,
+											   expstate->nullstr,
+											   expstate->nullstrlen);
+
+				if (expstate->arrow_infer)
+					arrow_infer_value(expstate->arrow, expstate->colno,
+									  field, size, isnull,
+									  lspaces, rspaces);
+				else
+					arrow_append_value(expstate->arrow, expstate->colno, field, size, isnull);
+			}
+
+			expstate->colno += 1;
+		}
+	}
+
 	/*
 	 * Export in formatted text format
 	 */
@@ -638,7 +866,9 @@ process_item(ExportState *expstate,
 	 */
 	else if (DSV_FORMAT_TYPE(expstate->format))
 	{
-		if (expstate->format == CLIPBOARD_FORMAT_SQL_VALUES && is_colname)
+		/* SQL VALUES and COPY formats has not header */
+		if ((expstate->format == CLIPBOARD_FORMAT_SQL_VALUES ||
+			 expstate->format == CLIPBOARD_FORMAT_COPY_TEXT) && is_colname)
 			return true;
 
 		if (typ == 'N' &&
@@ -665,6 +895,12 @@ process_item(ExportState *expstate,
 											   expstate->empty_string_is_null,
 											   expstate->nullstr,
 											   expstate->nullstrlen);
+				else if (expstate->format == CLIPBOARD_FORMAT_COPY_TEXT)
+					_field = copy_text_format(field,
+											  &size,
+											  expstate->empty_string_is_null,
+											  expstate->nullstr,
+											  expstate->nullstrlen);
 				else
 
 					_field = csv_format(field, &size,
@@ -703,7 +939,8 @@ process_item(ExportState *expstate,
 						if (expstate->format == CLIPBOARD_FORMAT_CSV ||
 							expstate->format == CLIPBOARD_FORMAT_SQL_VALUES)
 							fputc(',', expstate->fp);
-						else if (expstate->format == CLIPBOARD_FORMAT_TSVC)
+						else if (expstate->format == CLIPBOARD_FORMAT_TSVC ||
+								 expstate->format == CLIPBOARD_FORMAT_COPY_TEXT)
 							fputc('\t', expstate->fp);
 					}
 
@@ -732,9 +969,7 @@ process_item(ExportState *expstate,
 
 	if (errno != 0)
 	{
-		current_state->_errno = errno;
-		format_error("%s", strerror(errno));
-		log_row("Cannot write (%s)", current_state->errstr);
+		expstate->_errno = errno;
 
 		return false;
 	}
@@ -743,21 +978,22 @@ process_item(ExportState *expstate,
 }
 
 /*
- * Exports data to defined stream in requested format.
- * Returns true, when the operation was successfull
+ * Initialize export state - calculate range of exported rows and
+ * parts of data that should be exported.
  */
-bool
-export_data(Options *opts,
-			ScrDesc *scrdesc,
-			DataDesc *desc,
-			int cursor_row,
-			int cursor_column,
-			FILE *fp,
-			int rows,
-			double percent,
-			char *table_name,
-			PspgCommand cmd,
-			ClipboardFormat format)
+static bool
+init_export_state(ExportState *expstate,
+				  Options *opts,
+				  ScrDesc *scrdesc,
+				  DataDesc *desc,
+				  int cursor_row,
+				  int cursor_column,
+				  FILE *fp,
+				  int rows,
+				  double percent,
+				  char *table_name,
+				  PspgCommand cmd,
+				  ClipboardFormat format)
 {
 	LineBufferIter	lbi;
 	LineBufferMark	lbm;
@@ -771,36 +1007,35 @@ export_data(Options *opts,
 	bool	save_column_names = false;
 	bool	has_selection;
 
-	int		debug_read_rows = 0;
-	int		debug_processed_rows = 0;
-
 	int		min_row = desc->first_data_row;
 	int		max_row = desc->last_row;
 
-	bool	prev_continuation_mark = false;
-
-	bool	isok = true;
-
-	ExportState expstate;
-
 	/* force export type CLIPBOARD_FORMAT_TEXT for non tabular data */
 	if (!desc->headline_transl)
 		format = CLIPBOARD_FORMAT_TEXT;
 
-	expstate.format = format;
-	expstate.fp = fp;
-	expstate.empty_string_is_null = opts->empty_string_is_null;
-	expstate.nullstr = opts->nullstr;
-	expstate.nullstrlen = opts->nullstr ? strlen(opts->nullstr) : 0;
-	expstate.xmin = -1;
-	expstate.xmax = -1;
-	expstate.table_name = NULL;
-	expstate.colnames = NULL;
-	expstate.lines = NULL;
-	expstate.columns = desc->columns;
-	expstate.copy_line_extended = (cmd == cmd_CopyLineExtended);
-	expstate.linestyle = desc->linestyle;
-	expstate.nlines = 0;
+	expstate->format = format;
+	expstate->fp = fp;
+	expstate->empty_string_is_null = opts->empty_string_is_null;
+	expstate->nullstr = opts->nullstr;
+	expstate->nullstrlen = opts->nullstr ? strlen(opts->nullstr) : 0;
+	expstate->xmin = -1;
+	expstate->xmax = -1;
+	expstate->table_name = NULL;
+	expstate->colnames = NULL;
+	expstate->lines = NULL;
+	expstate->columns = desc->columns;
+	expstate->copy_line_extended = (cmd == cmd_CopyLineExtended);
+	expstate->linestyle = desc->linestyle;
+	expstate->nlines = 0;
+	expstate->read_rows = 0;
+	expstate->processed_rows = 0;
+	expstate->_errno = 0;
+	expstate->arrow = NULL;
+	expstate->arrow_infer = false;
+	expstate->use_spans = false;
+	expstate->spans = NULL;
+	expstate->task = NULL;
 
 	current_state->errstr = NULL;
 
@@ -808,17 +1043,19 @@ export_data(Options *opts,
 		((scrdesc->selected_first_row != -1 && scrdesc->selected_rows > 0 ) ||
 		 (scrdesc->selected_first_column != -1 && scrdesc->selected_columns > 0));
 
-	if (cmd == cmd_CopyLineExtended && !DSV_FORMAT_TYPE(format))
+	if (cmd == cmd_CopyLineExtended &&
+		(!DSV_FORMAT_TYPE(format) || format == CLIPBOARD_FORMAT_COPY_TEXT))
 		format = CLIPBOARD_FORMAT_CSV;
 
 	if (cmd == cmd_CopyLineExtended ||
-		INSERT_FORMAT_TYPE(format))
+		INSERT_FORMAT_TYPE(format) ||
+		format == CLIPBOARD_FORMAT_ARROW)
 	{
 		if (INSERT_FORMAT_TYPE(format))
 		{
 			int		slen = strlen(table_name);
 
-			expstate.table_name = quote_sql_identifier(table_name, &slen);
+			expstate->table_name = quote_sql_identifier(table_name, &slen);
 		}
 
 		save_column_names = true;
@@ -835,8 +1072,8 @@ export_data(Options *opts,
 	if ((cmd == cmd_Copy && opts->vertical_cursor) ||
 		cmd == cmd_CopyColumn)
 	{
-		expstate.xmin = desc->cranges[cursor_column - 1].xmin;
-		expstate.xmax = desc->cranges[cursor_column - 1].xmax;
+		expstate->xmin = desc->cranges[cursor_column - 1].xmin;
+		expstate->xmax = desc->cranges[cursor_column - 1].xmax;
 
 		print_footer = false;
 	}
@@ -888,8 +1125,8 @@ export_data(Options *opts,
 
 		if (scrdesc->selected_first_column != -1 && scrdesc->selected_columns > 0)
 		{
-			expstate.xmin = scrdesc->selected_first_column;
-			expstate.xmax = expstate.xmin + scrdesc->selected_columns - 1;
+			expstate->xmin = scrdesc->selected_first_column;
+			expstate->xmax = expstate->xmin + scrdesc->selected_columns - 1;
 		}
 
 		if (min_row > desc->first_data_row || max_row < desc->last_data_row)
@@ -974,15 +1211,82 @@ export_data(Options *opts,
 
 			free(multiline_map);
 
-			expstate.lines = smalloc(desc->columns * sizeof(ExtStr));
+			expstate->lines = smalloc(desc->columns * sizeof(ExtStr));
 		}
 	}
 
+	/*
+	 * The fields of formats that export only values can be cut by
+	 * field spans, when whole rows or complete column are exported.
+	 */
+	if (desc->cranges && desc->columns > 0 && !desc->is_expanded_mode &&
+		(DSV_FORMAT_TYPE(expstate->format) ||
+		 INSERT_FORMAT_TYPE(expstate->format) ||
+		 expstate->format == CLIPBOARD_FORMAT_ARROW))
+	{
+		if (expstate->xmin == -1)
+			expstate->use_spans = true;
+		else
+		{
+			int		i;
+
+			for (i = 0; i < desc->columns; i++)
+			{
+				if (desc->cranges[i].xmin == expstate->xmin &&
+					desc->cranges[i].xmax == expstate->xmax)
+				{
+					expstate->use_spans = true;
+					break;
+				}
+			}
+		}
+	}
+
+	/*
+	 * The spans are calculated for every exported row again (the rows
+	 * are processed once), so they are not stored in line buffers.
+	 */
+	if (expstate->use_spans)
+		expstate->spans = smalloc(desc->columns * sizeof(FieldSpan));
+
 	log_row("export: desc->first_data_row: %d, desc->last_data_row: %d",
 			desc->first_data_row, desc->last_data_row);
 	log_row("export: min_row: %d, max_row: %d", min_row, max_row);
 
-	init_lbi_ddesc(&lbi, desc, 0);
+	expstate->cmd = cmd;
+	expstate->data_format = format;
+	expstate->min_row = min_row;
+	expstate->max_row = max_row;
+	expstate->print_header = print_header;
+	expstate->print_footer = print_footer;
+	expstate->print_border = print_border;
+	expstate->print_header_line = print_header_line;
+
+	return true;
+}
+
+/*
+ * Export rows of data from position start_pos to position end_pos
+ * (exclusive). This routine can be executed by background thread,
+ * so it should not to touch global state.
+ */
+static bool
+export_rows(ExportState *expstate,
+			Options *opts,
+			ScrDesc *scrdesc,
+			DataDesc *desc,
+			int start_pos,
+			int end_pos)
+{
+	LineBufferIter	lbi;
+	LineBufferMark	lbm;
+
+	int		rn;
+	char   *rowstr;
+	bool	prev_continuation_mark = false;
+	bool	isok = true;
+
+	init_lbi_ddesc(&lbi, desc, start_pos);
 
 	while (lbi_set_mark_next(&lbi, &lbm))
 	{
@@ -997,22 +1301,25 @@ export_data(Options *opts,
 		bool	is_colname = false;
 		bool	continuation_mark = false;
 
+		if (lbm.lineno >= end_pos)
+			break;
+
 		(void) lbm_get_line(&lbm, &rowstr, &linfo, &rn);
 
-		debug_read_rows += 1;
+		expstate->read_rows += 1;
 
 		/* reduce rows from export */
 		if (rn >= desc->first_data_row && rn <= desc->last_data_row)
 		{
-			if (rn < min_row || rn > max_row)
+			if (rn < expstate->min_row || rn > expstate->max_row)
 				continue;
 
-			if (cmd == cmd_CopyMarkedLines)
+			if (expstate->cmd == cmd_CopyMarkedLines)
 			{
 				if (!linfo || ((linfo->mask & LINEINFO_BOOKMARK) == 0))
 					continue;
 			}
-			if (cmd == cmd_CopySearchedLines)
+			if (expstate->cmd == cmd_CopySearchedLines)
 			{
 				/* force lineinfo setting */
 				linfo = set_line_info(opts, scrdesc, desc, &lbm, rowstr);
@@ -1028,18 +1335,18 @@ export_data(Options *opts,
 						  rn != desc->border_head_row &&
 						  rn <= desc->fixed_rows);
 
-			if (format != CLIPBOARD_FORMAT_TEXT && rn < desc->border_top_row)
+			if (expstate->data_format != CLIPBOARD_FORMAT_TEXT && rn < desc->border_top_row)
 				continue;
-			if (!print_border &&
+			if (!expstate->print_border &&
 				(rn == desc->border_top_row ||
 				 rn == desc->border_bottom_row))
 				continue;
-			if (!print_header_line &&
+			if (!expstate->print_header_line &&
 				rn == desc->border_head_row)
 				continue;
-			if (!print_header && rn < desc->fixed_rows)
+			if (!expstate->print_header && rn < desc->fixed_rows)
 				continue;
-			if (!print_footer && desc->footer_row != -1 && rn >= desc->footer_row)
+			if (!expstate->print_footer && desc->footer_row != -1 && rn >= desc->footer_row)
 				continue;
 		}
 
@@ -1049,18 +1356,54 @@ export_data(Options *opts,
 
 		field = NULL; field_size = 0; field_xpos = -1;
 
-		expstate.colno = 0;
+		expstate->colno = 0;
 
 		/* for text format we have not concate lines of multiline field */
-		if (format != CLIPBOARD_FORMAT_TEXT)
+		if (expstate->data_format != CLIPBOARD_FORMAT_TEXT)
 			continuation_mark = linfo && linfo->mask & LINEINFO_CONTINUATION;
 
-		debug_processed_rows += 1;
+		expstate->processed_rows += 1;
+
+		if (expstate->use_spans)
+		{
+			FieldSpan  *spans = expstate->spans;
+			int			i;
+
+			calculate_field_spans(desc, rowstr, spans, desc->columns);
+
+			for (i = 0; i < desc->columns; i++)
+			{
+				field = rowstr + spans[i].offset;
+				field_size = spans[i].size;
+
+				/* separator of columns is part of field with border 0 */
+				if (desc->border_type == 0 && i > 0 && field_size > 0)
+				{
+					field += 1;
+					field_size -= 1;
+				}
+
+				if (field_size == 0)
+					continue;
+
+				isok = process_item(expstate, 'd',
+									field, field_size,
+									desc->cranges[i].xmax - 1,
+									is_colname,
+									continuation_mark,
+									prev_continuation_mark);
+				if (!isok)
+					goto exit_export;
+			}
+
+			field = NULL;
+		}
 
 		/*
 		 * line parser - separates fields on line
 		 */
-		while ((ptr = next_char(&iter, &typ, &size, &width, &xpos)))
+		while (!expstate->use_spans &&
+			   (ptr = next_char(&iter, &typ, &size, &width, &xpos)))
 		{
 			if (typ == 'd')
 			{
@@ -1074,7 +1417,7 @@ export_data(Options *opts,
 
 			if (field)
 			{
-				isok = process_item(&expstate, 'd',
+				isok = process_item(expstate, 'd',
 									field, field_size, field_xpos,
 									is_colname,
 									continuation_mark,
@@ -1085,7 +1428,7 @@ export_data(Options *opts,
 				field = NULL; field_size = 0; field_xpos = -1;
 			}
 
-			isok = process_item(&expstate, typ,
+			isok = process_item(expstate, typ,
 								ptr, size, xpos,
 								is_colname,
 								continuation_mark,
@@ -1097,7 +1440,7 @@ export_data(Options *opts,
 
 		if (field)
 		{
-			isok = process_item(&expstate, 'd',
+			isok = process_item(expstate, 'd',
 								field, field_size, field_xpos,
 								is_colname,
 								continuation_mark,
@@ -1106,7 +1449,7 @@ export_data(Options *opts,
 				goto exit_export;
 		}
 
-		isok = process_item(&expstate, 'N',
+		isok = process_item(expstate, 'N',
 							NULL, 0, -1, is_colname,
 							continuation_mark,
 							prev_continuation_mark);
@@ -1114,36 +1457,686 @@ export_data(Options *opts,
 			goto exit_export;
 
 		prev_continuation_mark = continuation_mark;
+
+		if (expstate->task &&
+			(expstate->processed_rows % EXPORT_PROGRESS_ROWS) == 0 &&
+			!export_task_progress(expstate->task, expstate->processed_rows))
+		{
+			isok = false;
+			break;
+		}
 	}
 
 exit_export:
 
-	log_row("export: read rows: %d, procesed rows: %d", debug_read_rows, debug_processed_rows);
+	return isok;
+}
+
+/*
+ * Formatting of CSV, TSV, SQL VALUES or INSERT rows is more expensive
+ * than writing, so for larger data the rows are formatted in parallel.
+ * The data rows are divided to chunks, that are formatted by workers
+ * to own memory buffers, and these buffers are written in order.
+ */
+#define EXPORT_CHUNK_ROWS			16384
+#define EXPORT_MAX_WORKERS			16
 
-	if (expstate.colnames)
+typedef struct
+{
+	pthread_t	thread;
+	bool		started;
+	ExportState expstate;
+	DataDesc   *desc;
+	int			start_pos;
+	int			end_pos;
+	char	   *buffer;
+	size_t		size;
+	bool		isok;
+} ExportChunk;
+
+/*
+ * The size of chunks and the number of workers can be forced by
+ * environment variables PSPG_EXPORT_CHUNK_ROWS and PSPG_EXPORT_WORKERS.
+ * It is used by tests/export-parallel.sh, that compares the parallel
+ * export of small data with serial export.
+ */
+static int
+export_env_value(const char *name, int defval, int maxval)
+{
+	char	   *str = getenv(name);
+
+	if (str)
 	{
+		int			value = atoi(str);
+
+		if (value > 0)
+			return value < maxval ? value : maxval;
+	}
+
+	return defval;
+}
+
+/*
+ * Returns number of workers that should be used for export of rows
+ * (1 when the parallel export is not possible or is not effective).
+ */
+static int
+export_workers(ExportState *expstate, int chunk_rows)
+{
+	long		ncpus;
+	int			forced_workers;
+
+	if (!(DSV_FORMAT_TYPE(expstate->format) ||
+		  INSERT_FORMAT_TYPE(expstate->format)) ||
+		expstate->copy_line_extended ||
+		expstate->cmd == cmd_CopyMarkedLines ||
+		expstate->cmd == cmd_CopySearchedLines)
+		return 1;
+
+	forced_workers = export_env_value("PSPG_EXPORT_WORKERS", 0, EXPORT_MAX_WORKERS);
+	if (forced_workers > 0)
+		return forced_workers;
+
+	if (expstate->max_row - expstate->min_row + 1 < 2 * chunk_rows)
+		return 1;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return ncpus > EXPORT_MAX_WORKERS ? EXPORT_MAX_WORKERS : (ncpus > 1 ? (int) ncpus : 1);
+}
+
+/*
+ * Returns position of first line of chunk. The chunk cannot to start
+ * inside multiline record, because the values of multiline fields are
+ * assembled from more lines.
+ */
+static int
+next_chunk_pos(DataDesc *desc, int pos, int end_pos)
+{
+	while (desc->has_multilines && pos < end_pos)
+	{
+		LineBufferMark lbm;
+		LineInfo   *linfo;
+		char	   *rowstr;
+		int			rn;
+
+		if (!ddesc_set_mark(&lbm, desc, pos - 1))
+			break;
+
+		(void) lbm_get_line(&lbm, &rowstr, &linfo, &rn);
+
+		if (!linfo || (linfo->mask & LINEINFO_CONTINUATION) == 0)
+			break;
+
+		pos += 1;
+	}
+
+	return pos < end_pos ? pos : end_pos;
+}
+
+static void *
+export_chunk_worker(void *arg)
+{
+	ExportChunk *chunk = (ExportChunk *) arg;
+
+	errno = 0;
+	chunk->expstate.fp = open_memstream(&chunk->buffer, &chunk->size);
+	if (!chunk->expstate.fp)
+	{
+		chunk->expstate._errno = errno;
+		chunk->isok = false;
+
+		return NULL;
+	}
+
+	chunk->isok = export_rows(&chunk->expstate, NULL, NULL, chunk->desc,
+							  chunk->start_pos, chunk->end_pos);
+
+	errno = 0;
+	if (fclose(chunk->expstate.fp) != 0 && chunk->isok)
+	{
+		chunk->expstate._errno = errno;
+		chunk->isok = false;
+	}
+
+	return NULL;
+}
+
+static bool
+export_rows_parallel(ExportState *expstate, DataDesc *desc, int nworkers, int chunk_rows)
+{
+	ExportChunk chunks[EXPORT_MAX_WORKERS];
+	int			end_pos;
+	int			pos;
+
+	end_pos = desc->order_map ? desc->order_map_items : desc->total_rows;
+
+	/* rows of header are exported first, workers need column names */
+	if (!export_rows(expstate, NULL, NULL, desc, 0, desc->first_data_row))
+		return false;
+
+	pos = desc->first_data_row;
+
+	while (pos < end_pos)
+	{
+		int			nchunks;
+		int			i;
+		bool		isok = true;
+
+		for (nchunks = 0; nchunks < nworkers && pos < end_pos; nchunks++)
+		{
+			ExportChunk *chunk = &chunks[nchunks];
+
+			memcpy(&chunk->expstate, expstate, sizeof(ExportState));
+
+			chunk->expstate.nlines = 0;
+			chunk->expstate.read_rows = 0;
+			chunk->expstate.processed_rows = 0;
+			chunk->expstate._errno = 0;
+			chunk->expstate.task = NULL;
+
+			if (expstate->lines)
+				chunk->expstate.lines = smalloc(expstate->columns * sizeof(ExtStr));
+
+			if (expstate->spans)
+				chunk->expstate.spans = smalloc(expstate->columns * sizeof(FieldSpan));
+
+			chunk->desc = desc;
+			chunk->start_pos = pos;
+			chunk->end_pos = next_chunk_pos(desc, pos + chunk_rows, end_pos);
+			chunk->buffer = NULL;
+			chunk->size = 0;
+
+			chunk->started = pthread_create(&chunk->thread, NULL,
+											export_chunk_worker, chunk) == 0;
+
+			/* fallback, process chunk by current thread */
+			if (!chunk->started)
+				(void) export_chunk_worker(chunk);
+
+			pos = chunk->end_pos;
+		}
+
+		for (i = 0; i < nchunks; i++)
+		{
+			ExportChunk *chunk = &chunks[i];
+
+			if (chunk->started)
+				pthread_join(chunk->thread, NULL);
+
+			if (isok && !chunk->isok)
+			{
+				expstate->_errno = chunk->expstate._errno;
+				isok = false;
+			}
+
+			if (isok && chunk->size > 0)
+			{
+				errno = 0;
+				if (fwrite(chunk->buffer, chunk->size, 1, expstate->fp) != 1)
+				{
+					expstate->_errno = errno ? errno : EIO;
+					isok = false;
+				}
+			}
+
+			expstate->nlines += chunk->expstate.nlines;
+			expstate->read_rows += chunk->expstate.read_rows;
+			expstate->processed_rows += chunk->expstate.processed_rows;
+
+			free(chunk->buffer);
+
+			if (chunk->expstate.lines)
+			{
+				int		j;
+
+				for (j = 0; j < expstate->columns; j++)
+					free(chunk->expstate.lines[j].data);
+
+				free(chunk->expstate.lines);
+			}
+
+			free(chunk->expstate.spans);
+		}
+
+		if (!isok)
+			return false;
+
+		if (expstate->task &&
+			!export_task_progress(expstate->task, expstate->processed_rows))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Arrow IPC file starts by schema, so the rows are processed twice.
+ * The types of columns are detected by first pass, and the values
+ * are written by second pass. Values are stored to column's buffers
+ * that are reused by all record batches.
+ */
+static bool
+export_arrow_rows(ExportState *expstate,
+				  Options *opts,
+				  ScrDesc *scrdesc,
+				  DataDesc *desc)
+{
+	bool		isok;
+
+	expstate->arrow = arrow_writer_new(expstate->fp, expstate->columns);
+	expstate->arrow_infer = true;
+
+	/*
+	 * Columns received in binary format have known types. Only numeric,
+	 * date and timestamp columns have typed values, and dates cannot be
+	 * parsed as numbers.
+	 */
+	if (desc->typed_columns && !desc->is_expanded_mode)
+	{
+		int		colno = 0;
 		int		i;
 
-		for (i = 0; i < expstate.columns; i++)
-			free(expstate.colnames[i]);
+		for (i = 0; i < desc->columns && i < desc->ntyped_columns; i++)
+		{
+			int		xpos = desc->cranges[i].xmax - 1;
+
+			/* same filter as in process_item */
+			if (expstate->xmin != -1 &&
+				  (xpos <= expstate->xmin || expstate->xmax <= xpos))
+				continue;
+
+			if (desc->typed_columns[i].values)
+				arrow_set_column_numeric(expstate->arrow, colno);
+
+			colno += 1;
+		}
+	}
+
+	isok = export_rows(expstate, opts, scrdesc, desc, 0, INT_MAX);
+
+	if (isok)
+	{
+		expstate->arrow_infer = false;
+		expstate->nlines = 0;
+		expstate->read_rows = 0;
+		expstate->processed_rows = 0;
 
-		free(expstate.colnames);
+		errno = 0;
+		if (!arrow_write_schema(expstate->arrow))
+		{
+			expstate->_errno = errno;
+			isok = false;
+		}
 	}
 
-	if (expstate.table_name && expstate.table_name != table_name)
-		free(expstate.table_name);
+	if (isok)
+		isok = export_rows(expstate, opts, scrdesc, desc, 0, INT_MAX);
 
-	if (expstate.lines)
+	if (isok)
+	{
+		errno = 0;
+		if (!arrow_write_footer(expstate->arrow))
+		{
+			expstate->_errno = errno;
+			isok = false;
+		}
+	}
+
+	arrow_writer_free(expstate->arrow);
+	expstate->arrow = NULL;
+
+	return isok;
+}
+
+/*
+ * Export all rows - in parallel when it is possible
+ */
+static bool
+export_all_rows(ExportState *expstate,
+				Options *opts,
+				ScrDesc *scrdesc,
+				DataDesc *desc)
+{
+	int			nworkers;
+	int			chunk_rows;
+
+	if (expstate->format == CLIPBOARD_FORMAT_ARROW)
+		return export_arrow_rows(expstate, opts, scrdesc, desc);
+
+	chunk_rows = export_env_value("PSPG_EXPORT_CHUNK_ROWS", EXPORT_CHUNK_ROWS, INT_MAX);
+	nworkers = export_workers(expstate, chunk_rows);
+
+	if (nworkers > 1)
+		return export_rows_parallel(expstate, desc, nworkers, chunk_rows);
+
+	return export_rows(expstate, opts, scrdesc, desc, 0, INT_MAX);
+}
+
+/*
+ * Release memory used by export state
+ */
+static void
+free_export_state(ExportState *expstate, char *table_name)
+{
+	if (expstate->colnames)
 	{
 		int		i;
 
-		for (i = 0; i < expstate.columns; i++)
-			free(expstate.lines[i].data);
+		for (i = 0; i < expstate->columns; i++)
+			free(expstate->colnames[i]);
 
-		free(expstate.lines);
+		free(expstate->colnames);
 	}
 
+	if (expstate->table_name && expstate->table_name != table_name)
+		free(expstate->table_name);
+
+	if (expstate->lines)
+	{
+		int		i;
+
+		for (i = 0; i < expstate->columns; i++)
+			free(expstate->lines[i].data);
+
+		free(expstate->lines);
+	}
+
+	free(expstate->spans);
+}
+
+/*
+ * Exports data to defined stream in requested format.
+ * Returns true, when the operation was successfull
+ */
+bool
+export_data(Options *opts,
+			ScrDesc *scrdesc,
+			DataDesc *desc,
+			int cursor_row,
+			int cursor_column,
+			FILE *fp,
+			int rows,
+			double percent,
+			char *table_name,
+			PspgCommand cmd,
+			ClipboardFormat format)
+{
+	ExportState expstate;
+	bool		isok;
+
+	isok = init_export_state(&expstate, opts, scrdesc, desc,
+							 cursor_row, cursor_column,
+							 fp, rows, percent, table_name,
+							 cmd, format);
+
+	if (isok)
+	{
+		isok = export_all_rows(&expstate, opts, scrdesc, desc);
+
+		log_row("export: read rows: %d, procesed rows: %d",
+				expstate.read_rows, expstate.processed_rows);
+	}
+
+	if (expstate._errno != 0)
+	{
+		current_state->_errno = expstate._errno;
+		format_error("%s", strerror(expstate._errno));
+		log_row("Cannot write (%s)", current_state->errstr);
+	}
+
+	free_export_state(&expstate, table_name);
+
 	log_row("exported %d rows with result %d", expstate.nlines, isok);
 
 	return isok;
 }
+
+/*
+ * Body of export thread. The output stream is closed here, so all
+ * buffered data are written before the export is marked as finished.
+ */
+static void *
+export_worker(void *arg)
+{
+	ExportTask *task = (ExportTask *) arg;
+	off_t		bytes;
+	time_t		sec;
+	long		ms;
+	bool		isok;
+
+	isok = export_all_rows(&task->expstate, NULL, NULL, &task->desc);
+
+	bytes = ftello(task->expstate.fp);
+
+	errno = 0;
+	if (fclose(task->expstate.fp) != 0 && isok)
+	{
+		task->expstate._errno = errno;
+		isok = false;
+	}
+
+	current_time(&sec, &ms);
+
+	pthread_mutex_lock(&task->mutex);
+
+	task->end_sec = sec;
+	task->end_ms = ms;
+
+	task->rows = task->expstate.processed_rows;
+	if (bytes != -1)
+		task->bytes = bytes;
+	task->isok = isok;
+	task->finished = true;
+
+	pthread_mutex_unlock(&task->mutex);
+
+	return NULL;
+}
+
+/*
+ * Starts export of data to file in background thread. The stream is
+ * owned and closed by the export. Returns false when the export cannot
+ * be started (the stream is not closed in this case).
+ */
+bool
+export_data_background(Options *opts,
+					   ScrDesc *scrdesc,
+					   DataDesc *desc,
+					   int cursor_row,
+					   int cursor_column,
+					   FILE *fp,
+					   const char *path,
+					   int rows,
+					   double percent,
+					   char *table_name,
+					   PspgCommand cmd,
+					   ClipboardFormat format)
+{
+	ExportTask *task;
+	sigset_t	fullset, oldset;
+	int			res;
+
+	if (export_task)
+	{
+		format_error("previous export is not finished");
+		return false;
+	}
+
+	task = smalloc(sizeof(ExportTask));
+
+	strncpy(task->path, path, sizeof(task->path) - 1);
+	if (INSERT_FORMAT_TYPE(format))
+		strncpy(task->table_name, table_name, sizeof(task->table_name) - 1);
+
+	if (!init_export_state(&task->expstate, opts, scrdesc, desc,
+						   cursor_row, cursor_column,
+						   fp, rows, percent, task->table_name,
+						   cmd, format))
+	{
+		free_export_state(&task->expstate, task->table_name);
+		free(task);
+
+		return false;
+	}
+
+	/* options can be released before end of export */
+	if (task->expstate.nullstr)
+	{
+		task->nullstr = sstrdup(task->expstate.nullstr);
+		task->expstate.nullstr = task->nullstr;
+	}
+
+	/*
+	 * Pager can sort or filter data while export is running, so
+	 * the export should to use own copy of order map.
+	 */
+	memcpy(&task->desc, desc, sizeof(DataDesc));
+
+	if (desc->order_map)
+	{
+		task->desc.order_map = smalloc(desc->order_map_items * sizeof(MappedLine));
+		memcpy(task->desc.order_map, desc->order_map,
+			   desc->order_map_items * sizeof(MappedLine));
+	}
+
+	task->desc.pending_sort = NULL;
+
+	task->expstate.task = task;
+
+	current_time(&task->start_sec, &task->start_ms);
+
+	pthread_mutex_init(&task->mutex, NULL);
+
+	/* signals should be processed by main thread only */
+	sigfillset(&fullset);
+	pthread_sigmask(SIG_SETMASK, &fullset, &oldset);
+
+	res = pthread_create(&task->thread, NULL, export_worker, task);
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+	if (res != 0)
+	{
+		format_error("%s", strerror(res));
+		log_row("Cannot to start export thread (%s)", current_state->errstr);
+
+		pthread_mutex_destroy(&task->mutex);
+		free_export_state(&task->expstate, task->table_name);
+		free(task->desc.order_map);
+		free(task->nullstr);
+		free(task);
+
+		return false;
+	}
+
+	export_task = task;
+
+	log_row("export: started background export to \"%s\"", task->path);
+
+	return true;
+}
+
+/*
+ * Returns true, when some background export is active (running or
+ * finished and not released yet).
+ */
+bool
+export_is_running(void)
+{
+	return export_task != NULL;
+}
+
+/*
+ * Fills progress of background export. Returns false, when there
+ * is not any background export.
+ */
+bool
+export_get_progress(ExportProgress *progress)
+{
+	time_t		sec;
+	long		ms;
+
+	if (!export_task)
+		return false;
+
+	pthread_mutex_lock(&export_task->mutex);
+
+	progress->rows = export_task->rows;
+	progress->bytes = export_task->bytes;
+	progress->canceled = export_task->canceled;
+	progress->finished = export_task->finished;
+	progress->isok = export_task->isok;
+
+	sec = export_task->end_sec;
+	ms = export_task->end_ms;
+
+	pthread_mutex_unlock(&export_task->mutex);
+
+	if (!progress->finished)
+		current_time(&sec, &ms);
+
+	progress->elapsed_ms = (sec - export_task->start_sec) * 1000 + ms - export_task->start_ms;
+	progress->_errno = 0;
+
+	strcpy(progress->path, export_task->path);
+
+	return true;
+}
+
+/*
+ * Ask export thread to stop. The stream is closed by export thread
+ * and already exported data are not removed.
+ */
+void
+export_cancel(void)
+{
+	if (!export_task)
+		return;
+
+	pthread_mutex_lock(&export_task->mutex);
+	export_task->canceled = true;
+	pthread_mutex_unlock(&export_task->mutex);
+
+	log_row("export: background export was canceled");
+}
+
+/*
+ * Release finished background export, and returns its final state.
+ * When "wait" is true, then waits on end of export. Returns false
+ * when there is not background export or when the export is not
+ * finished yet.
+ */
+bool
+export_finish(bool wait, ExportProgress *progress)
+{
+	ExportTask *task = export_task;
+
+	if (!export_get_progress(progress))
+		return false;
+
+	if (!progress->finished && !wait)
+		return false;
+
+	pthread_join(task->thread, NULL);
+
+	/* read final state, thread is finished now */
+	(void) export_get_progress(progress);
+
+	progress->_errno = task->expstate._errno;
+
+	log_row("export: read rows: %d, procesed rows: %d",
+			task->expstate.read_rows, task->expstate.processed_rows);
+	log_row("exported %d rows with result %d in %ld ms",
+			task->expstate.nlines, progress->isok, progress->elapsed_ms);
+
+	pthread_mutex_destroy(&task->mutex);
+	free_export_state(&task->expstate, task->table_name);
+	free(task->desc.order_map);
+	free(task->nullstr);
+	free(task);
+
+	export_task = NULL;
+
+	return true;
+}
@@ -0,0 +1,351 @@
+/*-------------------------------------------------------------------------
+ *
+ * history.c
+ *	  history of snapshots of data displayed in watch mode
+ *
+ * Portions Copyright (c) 2017-2026 Pavel Stehule
+ *
+ * IDENTIFICATION
+ *	  src/history.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pspg.h"
+
+#define HISTORY_MAX_SNAPSHOTS		256
+
+/*
+ * Lines are shared between snapshots. Usually only few lines are
+ * changed between two refreshes, so a new snapshot stores only
+ * changed lines, and unchanged lines are referenced from previous
+ * snapshot (by increasing reference counter).
+ */
+typedef struct _HistoryLine
+{
+	struct _HistoryLine *next;		/* next line with same hash */
+	uint32_t	hash;
+	int			refs;
+	size_t		size;
+	char		data[];
+} HistoryLine;
+
+typedef struct
+{
+	DataDesc	desc;				/* metadata of snapshot without rows */
+	int			namesline_rowno;	/* -1, when namesline is not available */
+	int			headline_rowno;		/* -1, when headline is not available */
+	HistoryLine **lines;
+	time_t		timestamp;
+	size_t		size;				/* memory used by snapshot without lines */
+} Snapshot;
+
+/* ring buffer of snapshots, the newest snapshot is the last */
+static Snapshot *snapshots[HISTORY_MAX_SNAPSHOTS];
+static int first_snapshot = 0;
+static int nsnapshots = 0;
+
+static HistoryLine **hashtab = NULL;
+static uint32_t hashtab_size = 0;
+static long hashtab_items = 0;
+
+/* memory used by snapshots and shared lines */
+static size_t history_size = 0;
+
+static uint32_t
+hash_line(const char *str, size_t size)
+{
+	uint32_t	hash = 2166136261u;
+
+	while (size--)
+	{
+		hash ^= (unsigned char) *str++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void
+hashtab_resize(uint32_t newsize)
+{
+	HistoryLine **newtab = smalloc(newsize * sizeof(HistoryLine *));
+	uint32_t	i;
+
+	for (i = 0; i < hashtab_size; i++)
+	{
+		HistoryLine *hl = hashtab[i];
+
+		while (hl)
+		{
+			HistoryLine *next = hl->next;
+
+			hl->next = newtab[hl->hash & (newsize - 1)];
+			newtab[hl->hash & (newsize - 1)] = hl;
+
+			hl = next;
+		}
+	}
+
+	free(hashtab);
+	hashtab = newtab;
+	hashtab_size = newsize;
+}
+
+/*
+ * Returns shared line with same content, or creates new line. The
+ * memory of lines is counted only here and in release_line.
+ */
+static HistoryLine *
+intern_line(const char *str)
+{
+	size_t		size = strlen(str);
+	uint32_t	hash = hash_line(str, size);
+	HistoryLine *hl;
+
+	if (hashtab_items >= (long) hashtab_size)
+		hashtab_resize(hashtab_size > 0 ? hashtab_size * 2 : 4096);
+
+	for (hl = hashtab[hash & (hashtab_size - 1)]; hl; hl = hl->next)
+	{
+		if (hl->hash == hash && hl->size == size &&
+			memcmp(hl->data, str, size) == 0)
+		{
+			hl->refs += 1;
+			return hl;
+		}
+	}
+
+	hl = smalloc(offsetof(HistoryLine, data) + size + 1);
+	hl->hash = hash;
+	hl->refs = 1;
+	hl->size = size;
+	memcpy(hl->data, str, size + 1);
+
+	hl->next = hashtab[hash & (hashtab_size - 1)];
+	hashtab[hash & (hashtab_size - 1)] = hl;
+	hashtab_items += 1;
+
+	history_size += offsetof(HistoryLine, data) + size + 1;
+
+	return hl;
+}
+
+static void
+release_line(HistoryLine *hl)
+{
+	HistoryLine **ptr;
+
+	if (--hl->refs > 0)
+		return;
+
+	for (ptr = &hashtab[hl->hash & (hashtab_size - 1)]; *ptr; ptr = &(*ptr)->next)
+	{
+		if (*ptr == hl)
+		{
+			*ptr = hl->next;
+			break;
+		}
+	}
+
+	hashtab_items -= 1;
+	history_size -= offsetof(HistoryLine, data) + hl->size + 1;
+
+	free(hl);
+}
+
+static void
+free_snapshot(Snapshot *s)
+{
+	int			i;
+
+	for (i = 0; i < s->desc.total_rows; i++)
+		release_line(s->lines[i]);
+
+	history_size -= s->size;
+
+	free(s->lines);
+	free(s->desc.headline_transl);
+	free(s->desc.cranges);
+	free(s);
+}
+
+/*
+ * Returns row number of line in first line buffer or -1
+ */
+static int
+get_rowno(DataDesc *desc, char *line)
+{
+	int			i;
+
+	if (!line)
+		return -1;
+
+	for (i = 0; i < desc->rows.nrows; i++)
+		if (desc->rows.rows[i] == line)
+			return i;
+
+	return -1;
+}
+
+/*
+ * Stores processed data to history. The oldest snapshots are removed,
+ * when the memory used by history is higher than limit (but the newest
+ * snapshot is stored every time).
+ */
+void
+watch_history_push(DataDesc *desc, size_t limit)
+{
+	Snapshot   *s = smalloc(sizeof(Snapshot));
+	LineBuffer *lnb;
+	int			lineno = 0;
+	int			i;
+
+	memcpy(&s->desc, desc, sizeof(DataDesc));
+
+	s->namesline_rowno = get_rowno(desc, desc->namesline);
+	s->headline_rowno = get_rowno(desc, desc->headline);
+	s->timestamp = time(NULL);
+
+	/* only metadata are copied, pointers should be cleaned */
+	memset(&s->desc.rows, 0, sizeof(LineBuffer));
+	s->desc.order_map = NULL;
+	s->desc.order_map_items = 0;
+	s->desc.pending_sort = NULL;
+	s->desc.is_filtered = false;
+	s->desc.filtered_rows = 0;
+	s->desc.unfiltered_order_map = NULL;
+	s->desc.unfiltered_order_map_items = 0;
+	s->desc.pending_filter = NULL;
+	s->desc.multilines_already_tested = false;
+	s->desc.has_multilines = false;
+	s->desc.namesline = NULL;
+	s->desc.headline = NULL;
+	s->desc.last_buffer = NULL;
+	s->desc.colstats = NULL;
+	s->desc.ncolstats = 0;
+	s->desc.typed_columns = NULL;
+	s->desc.ntyped_columns = 0;
+	s->desc.projection = NULL;
+	s->desc.capture = NULL;
+	s->desc.is_tail_preview = false;
+	s->desc.pending_load = NULL;
+
+	s->size = sizeof(Snapshot) + desc->total_rows * sizeof(HistoryLine *);
+
+	if (desc->headline_transl)
+	{
+		s->desc.headline_transl = sstrdup(desc->headline_transl);
+		s->size += strlen(desc->headline_transl) + 1;
+	}
+
+	if (desc->cranges)
+	{
+		s->desc.cranges = smalloc(desc->columns * sizeof(CRange));
+		memcpy(s->desc.cranges, desc->cranges, desc->columns * sizeof(CRange));
+		s->size += desc->columns * sizeof(CRange);
+	}
+
+	s->lines = smalloc(desc->total_rows * sizeof(HistoryLine *));
+
+	for (lnb = &desc->rows; lnb && lineno < desc->total_rows; lnb = lnb->next)
+		for (i = 0; i < lnb->nrows && lineno < desc->total_rows; i++)
+			s->lines[lineno++] = intern_line(lnb->rows[i]);
+
+	/* protect against inconsistent total_rows */
+	s->desc.total_rows = lineno;
+
+	history_size += s->size;
+
+	if (nsnapshots == HISTORY_MAX_SNAPSHOTS)
+	{
+		free_snapshot(snapshots[first_snapshot]);
+		first_snapshot = (first_snapshot + 1) % HISTORY_MAX_SNAPSHOTS;
+		nsnapshots -= 1;
+	}
+
+	snapshots[(first_snapshot + nsnapshots) % HISTORY_MAX_SNAPSHOTS] = s;
+	nsnapshots += 1;
+
+	while (nsnapshots > 1 && history_size > limit)
+	{
+		free_snapshot(snapshots[first_snapshot]);
+		first_snapshot = (first_snapshot + 1) % HISTORY_MAX_SNAPSHOTS;
+		nsnapshots -= 1;
+	}
+
+	log_row("history has %d snapshots (%zu bytes)", nsnapshots, history_size);
+}
+
+/*
+ * Returns number of stored snapshots
+ */
+int
+watch_history_count(void)
+{
+	return nsnapshots;
+}
+
+/*
+ * Fill desc by snapshot. The snapshot is specified by age, 0 is the
+ * newest snapshot. The desc holds own copy of data.
+ */
+bool
+watch_history_get(int age, DataDesc *desc, time_t *timestamp)
+{
+	Snapshot   *s;
+	LineBuffer *rows;
+	int			i;
+
+	if (age < 0 || age >= nsnapshots)
+		return false;
+
+	s = snapshots[(first_snapshot + nsnapshots - 1 - age) % HISTORY_MAX_SNAPSHOTS];
+
+	memcpy(desc, &s->desc, sizeof(DataDesc));
+
+	if (s->desc.headline_transl)
+		desc->headline_transl = sstrdup(s->desc.headline_transl);
+
+	if (s->desc.cranges)
+	{
+		desc->cranges = smalloc(s->desc.columns * sizeof(CRange));
+		memcpy(desc->cranges, s->desc.cranges, s->desc.columns * sizeof(CRange));
+	}
+
+	rows = &desc->rows;
+
+	for (i = 0; i < s->desc.total_rows; i++)
+	{
+		HistoryLine *hl = s->lines[i];
+
+		if (rows->nrows == LINEBUFFER_LINES)
+		{
+			LineBuffer *newrows = smalloc(sizeof(LineBuffer));
+
+			rows->next = newrows;
+			newrows->prev = rows;
+			rows = newrows;
+		}
+
+		rows->rows[rows->nrows] = smalloc(hl->size + 1);
+		memcpy(rows->rows[rows->nrows++], hl->data, hl->size + 1);
+	}
+
+	desc->last_buffer = rows != &desc->rows ? rows : NULL;
+
+	if (s->namesline_rowno != -1)
+		desc->namesline = desc->rows.rows[s->namesline_rowno];
+
+	if (s->headline_rowno != -1)
+		desc->headline = desc->rows.rows[s->headline_rowno];
+
+	*timestamp = s->timestamp;
+
+	return true;
+}
@@ -11,6 +11,8 @@
  *-------------------------------------------------------------------------
  */
 #include <errno.h>
+#include <fnmatch.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,6 +25,8 @@
 
 FILE	   *logfile = NULL;
 
+extern char **environ;
+
 /*
  * Print entry to log file
  */
@@ -514,85 +518,92 @@ ExtStrTrimEnd(ExtStr *estr, bool replace_nl)
 
 /*
  * read write stderr poopen function
+ *
+ * The child is started by posix_spawn, so the address space of pspg
+ * (that can be large) is not copied (glibc uses vfork like clone).
  */
 int
 rwe_popen(char *command, int *fin, int *fout, int *ferr)
 {
-	int		in[2];
-	int		out[2];
-	int		err[2];
-	int		rc;
-	int		saved_errno;
+	posix_spawn_file_actions_t actions;
+	char	   *argv[4];
+	int			in[2];
+	int			out[2];
+	int			err[2];
+	pid_t		pid;
+	int			rc;
+
+	if (pipe(in) != 0)
+		return -1;
+
+	if (pipe(out) != 0)
+	{
+		rc = errno;
+		close(in[0]);
+		close(in[1]);
+		errno = rc;
 
-	errno = 0;
-	saved_errno = 0;
+		return -1;
+	}
 
-	rc = pipe(in);
-	if (rc == 0)
+	if (pipe(err) != 0)
 	{
-		rc = pipe(out);
-		if (rc == 0)
-		{
-			rc = pipe(err);
-			if (rc == 0)
-			{
-				int		pid = fork();
+		rc = errno;
+		close(in[0]);
+		close(in[1]);
+		close(out[0]);
+		close(out[1]);
+		errno = rc;
 
-				if (pid > 0)
-				{
-					/* parent */
-					close(in[0]);
-					close(out[1]);
-					close(err[1]);
+		return -1;
+	}
 
-					*fin = in[1];
-					*fout = out[0];
-					*ferr = err[0];
+	rc = posix_spawn_file_actions_init(&actions);
+	if (rc == 0)
+	{
+		/* child uses only one side of pipes */
+		posix_spawn_file_actions_addclose(&actions, in[1]);
+		posix_spawn_file_actions_addclose(&actions, out[0]);
+		posix_spawn_file_actions_addclose(&actions, err[0]);
 
-					return pid;
-				}
-				else if (pid == 0)
-				{
-					/* child */
-					close(in[1]);
-					close(out[0]);
-					close(err[0]);
+		posix_spawn_file_actions_adddup2(&actions, in[0], 0);
+		posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+		posix_spawn_file_actions_adddup2(&actions, err[1], 2);
 
-					dup2(in[0], 0);
-					dup2(out[1], 1);
-					dup2(err[1], 2);
+		posix_spawn_file_actions_addclose(&actions, in[0]);
+		posix_spawn_file_actions_addclose(&actions, out[1]);
+		posix_spawn_file_actions_addclose(&actions, err[1]);
 
-					close(in[0]);
-					close(out[1]);
-					close(err[1]);
+		argv[0] = "sh";
+		argv[1] = "-c";
+		argv[2] = command;
+		argv[3] = NULL;
 
-					execl("/bin/sh", "sh", "-c", command, NULL);
-					exit(127);
-				}
-				else
-					saved_errno = errno;
+		rc = posix_spawn(&pid, "/bin/sh", &actions, NULL, argv, environ);
 
-				close(err[0]);
-				close(err[1]);
-			}
-			else
-				saved_errno = errno;
+		posix_spawn_file_actions_destroy(&actions);
+	}
 
-			close(out[0]);
-			close(out[1]);
-		}
-		else
-			saved_errno = errno;
+	/* the child side of pipes is not used by parent */
+	close(in[0]);
+	close(out[1]);
+	close(err[1]);
 
-		close(in[0]);
-		close(out[1]);
+	if (rc != 0)
+	{
+		close(in[1]);
+		close(out[0]);
+		close(err[0]);
+		errno = rc;
+
+		return -1;
 	}
-	else
-		saved_errno = errno;
 
-	errno = saved_errno;
+	*fin = in[1];
+	*fout = out[0];
+	*ferr = err[0];
 
-	return -1;
+	return pid;
 }
 
 /*
@@ -638,3 +649,125 @@ tilde(char *dest, const char *path)
 
 	return dest;
 }
+
+/*
+ * Returns true, when the column is in comma separated list of column
+ * names, patterns (with wildcards *, ? and [) or column numbers (starts
+ * by 1). The name can be NULL, when the name of column is not known.
+ */
+static bool
+is_listed_column(const char *list, const char *name, int colno)
+{
+	const char *ptr = list;
+
+	while (*ptr)
+	{
+		const char *start;
+		const char *end;
+		char		localbuf[256];
+		char	   *item;
+		bool		result;
+		int			size;
+
+		while (*ptr == ' ')
+			ptr++;
+
+		start = ptr;
+		while (*ptr && *ptr != ',')
+			ptr++;
+
+		end = ptr;
+		while (end > start && end[-1] == ' ')
+			end--;
+
+		if (*ptr == ',')
+			ptr++;
+
+		size = end - start;
+		if (size == 0)
+			continue;
+
+		if (strspn(start, "0123456789") >= (size_t) size)
+		{
+			if (atoi(start) == colno)
+				return true;
+
+			continue;
+		}
+
+		if (!name)
+			continue;
+
+		item = size < (int) sizeof(localbuf) ? localbuf : smalloc(size + 1);
+		memcpy(item, start, size);
+		item[size] = '\0';
+
+		if (strpbrk(item, "*?["))
+			result = fnmatch(item, name, 0) == 0;
+		else
+			result = strcmp(item, name) == 0;
+
+		if (item != localbuf)
+			free(item);
+
+		if (result)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Returns true, when the column should not be displayed (and should
+ * not be loaded). Words of csv_skip_columns_like can be prefix (^),
+ * suffix ($) or substring of names of hidden columns.
+ */
+bool
+is_hidden_column(Options *opts, const char *name, int colno)
+{
+	if (opts->columns && !is_listed_column(opts->columns, name, colno))
+		return true;
+
+	if (opts->exclude_columns && is_listed_column(opts->exclude_columns, name, colno))
+		return true;
+
+	if (opts->csv_skip_columns_like && name)
+	{
+		const char *ptr = opts->csv_skip_columns_like;
+		size_t		name_len = strlen(name);
+
+		while (*ptr)
+		{
+			size_t		len = strcspn(ptr, " ");
+
+			if (len > 0)
+			{
+				if (*ptr == '^')
+				{
+					if (name_len >= len - 1 && strncmp(name, ptr + 1, len - 1) == 0)
+						return true;
+				}
+				else if (ptr[len - 1] == '$')
+				{
+					if (name_len > len - 1 &&
+						strncmp(name + name_len - len + 1, ptr, len - 1) == 0)
+						return true;
+				}
+				else
+				{
+					const char *str;
+
+					for (str = name; str + len <= name + name_len; str++)
+						if (strncmp(str, ptr, len) == 0)
+							return true;
+				}
+			}
+
+			ptr += len;
+			if (*ptr == ' ')
+				ptr++;
+		}
+	}
+
+	return false;
+}
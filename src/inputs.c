@@ -19,6 +19,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <stdint.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -37,6 +38,21 @@
 #include "inputs.h"
 #include "pspg.h"
 
+/*
+ * On Linux the events are waited by epoll. The timeouts are implemented
+ * by timerfd, and signals are received by signalfd.
+ */
+#if defined(__linux__) && !defined(PDCURSES)
+
+#define HAVE_EPOLL
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#endif
+
 #define PSPG_NOTASSIGNED_CODE					0
 
 static char	pathname[MAXPATHLEN] = "";
@@ -48,11 +64,29 @@ unsigned int f_data_opts = 0;						/* describe properties of content input */
 
 int		f_data_fileno = -1;					/* content input used by poll */
 
-static struct pollfd fds[2];
+static struct pollfd fds[3];
 
 static long last_data_pos = -1;
 static int open_data_stream_prev_errno = 0;
 
+/*
+ * Signature of content of regular file read in non stream mode. It is
+ * used for detection of append only change of file.
+ */
+#define SIGNATURE_BLOCK_SIZE		4096
+
+static off_t loaded_size = -1;
+static dev_t loaded_dev;
+static ino_t loaded_ino;
+static uint32_t loaded_head_hash;
+static uint32_t loaded_tail_hash;
+
+/*
+ * The end of regular file is read immediately (option --start-at-end),
+ * only when the skipped part of file is larger than this size.
+ */
+#define TAIL_PREVIEW_MIN_SKIPPED_SIZE		(4 * 1024 * 1024)
+
 #if defined(HAVE_INOTIFY) || defined(HAVE_KQUEUE)
 
 static int notify_fd = -1;
@@ -68,6 +102,24 @@ static int inotify_wd = -1;
 static NCursesEventData saved_event;
 static bool saved_event_is_valid = false;
 
+/*
+ * Read data event can be delayed (the content of file can be incomplete
+ * when file notification is too fast). In this time the tty events are
+ * processed.
+ */
+static bool read_data_event_is_delayed = false;
+static long read_data_event_time = 0;
+
+#if defined(HAVE_EPOLL)
+
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int signal_fd = -1;
+static sigset_t event_sigmask;
+static bool epoll_is_broken = false;
+
+#endif
+
 static bool close_f_tty = false;
 
 #ifdef PDCURSES
@@ -349,6 +401,273 @@ repeat:
 	return ok;
 }
 
+/*
+ * Delays read data event about delay ms
+ */
+static void
+delay_read_data_event(int delay)
+{
+	time_t		sec;
+	long		ms;
+
+	current_time(&sec, &ms);
+
+	read_data_event_time = sec * 1000 + ms + delay;
+	read_data_event_is_delayed = true;
+}
+
+/*
+ * Returns time (in ms) to delayed read data event or -1 when there
+ * is not any delayed event.
+ */
+static long
+delayed_read_data_event_timeout(void)
+{
+	time_t		sec;
+	long		ms;
+	long		now;
+
+	if (!read_data_event_is_delayed)
+		return -1;
+
+	current_time(&sec, &ms);
+	now = sec * 1000 + ms;
+
+	return now >= read_data_event_time ? 0 : read_data_event_time - now;
+}
+
+#if defined(HAVE_EPOLL)
+
+/*
+ * Creates epoll instance, timer and signal descriptors. When some of
+ * these descriptors cannot be created, then poll is used.
+ */
+static bool
+init_epoll(void)
+{
+	struct epoll_event ev;
+
+	if (epoll_fd != -1)
+		return true;
+
+	if (epoll_is_broken)
+		return false;
+
+	sigemptyset(&event_sigmask);
+	sigaddset(&event_sigmask, SIGINT);
+	sigaddset(&event_sigmask, SIGWINCH);
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1)
+		goto broken;
+
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd == -1)
+		goto broken;
+
+	signal_fd = signalfd(-1, &event_sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (signal_fd == -1)
+		goto broken;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+
+	ev.data.fd = timer_fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) != 0)
+		goto broken;
+
+	ev.data.fd = signal_fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev) != 0)
+		goto broken;
+
+	return true;
+
+broken:
+
+	log_row("cannot to initialize epoll (%s)", strerror(errno));
+
+	if (epoll_fd != -1)
+		close(epoll_fd);
+	if (timer_fd != -1)
+		close(timer_fd);
+	if (signal_fd != -1)
+		close(signal_fd);
+
+	epoll_fd = timer_fd = signal_fd = -1;
+	epoll_is_broken = true;
+
+	return false;
+}
+
+static void
+set_timer(int timeout)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+
+	its.it_value.tv_sec = timeout / 1000;
+	its.it_value.tv_nsec = (timeout % 1000) * 1000000L;
+
+	if (timerfd_settime(timer_fd, 0, &its, NULL) != 0)
+		log_row("cannot to set timer (%s)", strerror(errno));
+}
+
+/*
+ * Replacement of poll based on epoll. The descriptors from fds are
+ * registered when they are not registered already. The closed
+ * descriptors are removed from epoll instance by kernel, and the
+ * descriptors, that are not wanted now, are removed when they got
+ * some event. The timeout is implemented by timer descriptor.
+ *
+ * Signals SIGINT and SIGWINCH are blocked when we wait on events,
+ * and they are received by signal descriptor. Then the same flags
+ * like in signal handlers are set, and the function fails with
+ * EINTR like poll.
+ */
+static int
+wait_on_events(struct pollfd *fds, int nfds, int timeout)
+{
+	struct epoll_event events[8];
+	sigset_t	oldmask;
+	bool		sigint_before = handle_sigint;
+	bool		sigwinch_before = handle_sigwinch;
+	bool		has_signal = false;
+	bool		timer_is_set = false;
+	int			result = 0;
+	int			i;
+
+	if (!init_epoll())
+		return poll(fds, nfds, timeout);
+
+	for (i = 0; i < nfds; i++)
+	{
+		struct epoll_event ev;
+
+		fds[i].revents = 0;
+
+		if (fds[i].fd < 0)
+			continue;
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = fds[i].fd;
+
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fds[i].fd, &ev) != 0 &&
+			errno != EEXIST)
+		{
+			log_row("cannot to register descriptor in epoll (%s)", strerror(errno));
+			return poll(fds, nfds, timeout);
+		}
+	}
+
+	if (timeout > 0)
+	{
+		set_timer(timeout);
+		timer_is_set = true;
+	}
+
+	sigprocmask(SIG_BLOCK, &event_sigmask, &oldmask);
+
+	/* signal can be handled by signal handler before blocking */
+	if ((handle_sigint && !sigint_before) ||
+		(handle_sigwinch && !sigwinch_before))
+		has_signal = true;
+
+	while (!has_signal && result == 0)
+	{
+		bool		timeouted = false;
+		int			n;
+
+		n = epoll_wait(epoll_fd, events, 8, timeout == 0 ? 0 : -1);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+
+			result = -1;
+			break;
+		}
+
+		for (i = 0; i < n; i++)
+		{
+			int			fd = events[i].data.fd;
+
+			if (fd == timer_fd)
+			{
+				uint64_t	expirations;
+
+				if (read(timer_fd, &expirations, sizeof(expirations)) > 0)
+					timeouted = true;
+			}
+			else if (fd == signal_fd)
+			{
+				struct signalfd_siginfo si;
+
+				while (read(signal_fd, &si, sizeof(si)) == sizeof(si))
+				{
+					if (si.ssi_signo == SIGINT)
+						handle_sigint = true;
+					else if (si.ssi_signo == SIGWINCH)
+						handle_sigwinch = true;
+
+					has_signal = true;
+				}
+			}
+			else
+			{
+				bool		found = false;
+				int			j;
+
+				for (j = 0; j < nfds; j++)
+				{
+					if (fds[j].fd == fd)
+					{
+						if (events[i].events & EPOLLIN)
+							fds[j].revents |= POLLIN;
+						if (events[i].events & EPOLLHUP)
+							fds[j].revents |= POLLHUP;
+						if (events[i].events & EPOLLERR)
+							fds[j].revents |= POLLERR;
+
+						found = true;
+					}
+				}
+
+				/* the descriptor is not wanted now */
+				if (!found)
+					(void) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+			}
+		}
+
+		for (i = 0; i < nfds; i++)
+			if (fds[i].revents)
+				result += 1;
+
+		if (timeouted || timeout == 0)
+			break;
+	}
+
+	sigprocmask(SIG_SETMASK, &oldmask, NULL);
+
+	if (timer_is_set)
+		set_timer(0);
+
+	if (result == 0 && has_signal)
+	{
+		errno = EINTR;
+		return -1;
+	}
+
+	return result;
+}
+
+#else
+
+#define wait_on_events(fds, nfds, timeout)		poll(fds, nfds, timeout)
+
+#endif
+
 /*
  * When only_tty_events is true, then we don't want to return events related to processed
  * content - new data, inotify event, .. These events are saved, but for this moment ignored.
@@ -373,6 +692,7 @@ _get_pspg_event(NCursesEventData *nced,
 #endif
 
 	int		nfds;
+	int		query_fd_index = -1;
 
 	/*
 	 * Return saved events.
@@ -393,6 +713,13 @@ _get_pspg_event(NCursesEventData *nced,
 		handle_sigwinch = false;
 		return PSPG_SIGWINCH_EVENT;
 	}
+	else if (!only_tty_events && has_pending_stream_query())
+		return PSPG_READ_DATA_EVENT;
+	else if (!only_tty_events && delayed_read_data_event_timeout() == 0)
+	{
+		read_data_event_is_delayed = false;
+		return PSPG_READ_DATA_EVENT;
+	}
 
 	/*
 	 * Simply way, when we need only tty events and timeout is zero,
@@ -452,11 +779,19 @@ _get_pspg_event(NCursesEventData *nced,
 
 #endif
 
+		/* socket of asynchronous query */
+		if (pg_query_socket() != -1)
+		{
+			fds[nfds].fd = pg_query_socket();
+			fds[nfds].events = POLLIN;
+			query_fd_index = nfds++;
+		}
 	}
 
 	while (timeout >= 0 || without_timeout)
 	{
 		int		poll_num;
+		int		wait_timeout;
 		time_t	t1_sec, t2_sec;
 		long	t1_ms, t2_ms;
 
@@ -474,6 +809,22 @@ _get_pspg_event(NCursesEventData *nced,
 		else
 			first_loop = false;
 
+		wait_timeout = without_timeout ? -1 : timeout;
+
+		/* wait to delayed read data event, but not inside escape sequence */
+		if (!only_tty_events && first_event)
+		{
+			long		delay = delayed_read_data_event_timeout();
+
+			if (delay == 0)
+			{
+				read_data_event_is_delayed = false;
+				return PSPG_READ_DATA_EVENT;
+			}
+			else if (delay > 0 && (wait_timeout == -1 || delay < wait_timeout))
+				wait_timeout = (int) delay;
+		}
+
 		/*
 		 * ESCAPE key is used (by ncurses applications) like switcher to alternative
 		 * keyboard. The escape event is forced by 2x press of ESCAPE key. The ESCAPE
@@ -490,7 +841,7 @@ repeat_reading:
 		if (!without_timeout && !zero_timeout)
 			current_time(&t1_sec, &t1_ms);
 
-		poll_num = poll(fds, nfds, without_timeout ? -1 : timeout);
+		poll_num = wait_on_events(fds, nfds, wait_timeout);
 
 		if (!without_timeout && !zero_timeout)
 		{
@@ -596,7 +947,13 @@ ncurses_get:
 					return PSPG_SIGWINCH_EVENT;
 				}
 			}
-			else if (fds[1].revents)
+			else if (query_fd_index != -1 && fds[query_fd_index].revents)
+			{
+				/* wait to next data, when query is not finished */
+				if (pg_consume_query())
+					return PSPG_QUERY_EVENT;
+			}
+			else if (nfds > 1 && fds[1].revents)
 			{
 				short revents = fds[1].revents;
 
@@ -612,10 +969,11 @@ ncurses_get:
 
 					log_row("force close stream after POLLHUP");
 					close_data_stream();
+					fds[1].fd = -1;
 
-					/* we don't want to reopen stream too quickly, sleep 100ms */
-					usleep(1000 * 100);
-					return PSPG_READ_DATA_EVENT;
+					/* we don't want to reopen stream too quickly, wait 100ms */
+					delay_read_data_event(100);
+					continue;
 				}
 				else if (revents & POLLIN)
 				{
@@ -651,18 +1009,26 @@ ncurses_get:
 							len = read(notify_fd, buff, sizeof(buff));
 						}
 
+						/*
+						 * The file with saved signature of content is not closed
+						 * here. It can be only appended, and then only new lines
+						 * are read. Else it is reopened before reading.
+						 */
 						if (stream_closed)
 						{
 							log_row("detected CLOSE WRITE by inotify");
-							close_data_stream();
+							if (loaded_size == -1)
+								close_data_stream();
 						}
 
 						/*
 						 * wait 200ms - sometimes inotify is too fast, and the content
 						 * of is not ready for pspg and we get inotify event too prematurely.
-						 * Use longer waiting in streaming mode, because detected event is MODIFY
+						 * Use longer waiting in streaming mode, because detected event is MODIFY.
+						 * Meanwhile tty events are processed.
 						 */
-						usleep(1000 * (stream_closed ? 100 : 250));
+						delay_read_data_event(stream_closed ? 100 : 250);
+						continue;
 					}
 
 #elif defined(HAVE_KQUEUE)
@@ -692,13 +1058,20 @@ ncurses_get:
 						if (rc == -1)
 							log_row("kqueue error (%s)", strerror(errno));
 
+						/*
+						 * The file with saved signature of content is not closed
+						 * here. It can be only appended, and then only new lines
+						 * are read. Else it is reopened before reading.
+						 */
 						if (stream_closed)
 						{
 							log_row("detected CLOSE WRITE by kqueue");
-							close_data_stream();
+							if (loaded_size == -1)
+								close_data_stream();
 						}
 
-						usleep(1000 * (stream_closed ? 100 : 250));
+						delay_read_data_event(stream_closed ? 100 : 250);
+						continue;
 					}
 
 #endif
@@ -766,6 +1139,9 @@ get_pspg_event(NCursesEventData *nced,
 		case PSPG_NOTHING_VALID_EVENT:
 			event_name = "NOTHING VALID EVENT";
 			break;
+		case PSPG_QUERY_EVENT:
+			event_name = "QUERY";
+			break;
 		default:
 			event_name = "undefined event";
 	}
@@ -1081,6 +1457,8 @@ close_data_stream(void)
 {
 	log_row("closing data stream");
 
+	loaded_size = -1;
+
 	if ((f_data_opts & STREAM_CAN_BE_CLOSED) && (f_data_opts & STREAM_IS_OPEN))
 	{
 		log_row("stream is closed");
@@ -1223,11 +1601,200 @@ detect_file_truncation(void)
 	}
 }
 
+/*
+ * Returns hash of block of file, or false when the block cannot be read.
+ */
+static bool
+hash_file_block(int fd, off_t offset, size_t size, uint32_t *hash)
+{
+	char		buffer[SIGNATURE_BLOCK_SIZE];
+	char	   *ptr = buffer;
+	uint32_t	h = 2166136261u;
+
+	if (pread(fd, buffer, size, offset) != (ssize_t) size)
+		return false;
+
+	while (size--)
+	{
+		h ^= (unsigned char) *ptr++;
+		h *= 16777619u;
+	}
+
+	*hash = h;
+
+	return true;
+}
+
+/*
+ * Saves signature of content of file read in non stream mode. The
+ * signature is used (when file is changed) for detection if only new
+ * lines were appended to file.
+ */
+static void
+save_loaded_content_signature(void)
+{
+	struct stat stats;
+	off_t		size;
+	size_t		head_size;
+	size_t		tail_size;
+	char		last_char;
+	int			fd = fileno(f_data);
+
+	loaded_size = -1;
+
+	if (fstat(fd, &stats) != 0)
+		return;
+
+	size = ftello(f_data);
+	if (size <= 0)
+		return;
+
+	/* the last line should be complete, else it can be continued */
+	if (pread(fd, &last_char, 1, size - 1) != 1 || last_char != '\n')
+		return;
+
+	head_size = size < SIGNATURE_BLOCK_SIZE ? (size_t) size : SIGNATURE_BLOCK_SIZE;
+	tail_size = head_size;
+
+	if (!hash_file_block(fd, 0, head_size, &loaded_head_hash) ||
+		!hash_file_block(fd, size - tail_size, tail_size, &loaded_tail_hash))
+		return;
+
+	loaded_dev = stats.st_dev;
+	loaded_ino = stats.st_ino;
+	loaded_size = size;
+}
+
 void
 save_file_position(void)
 {
-	if (current_state->stream_mode && f_data_opts & STREAM_IS_FILE)
+	if (!(f_data_opts & STREAM_IS_FILE))
+		return;
+
+	if (current_state->stream_mode)
 		last_data_pos = ftell(f_data);
+	else
+		save_loaded_content_signature();
+}
+
+/*
+ * Returns true, when the file read in non stream mode was changed only
+ * by appending new lines. The file is same (it was not replaced), it is
+ * larger, and the start and the end of previously read content are not
+ * changed. When it returns true, the data stream is positioned after
+ * previously read content, and only new lines can be read.
+ *
+ * This detection is not exact (the middle of content can be changed
+ * by same size content), but it is good enough for log like files.
+ */
+bool
+is_append_only_change(void)
+{
+	struct stat stats;
+	struct stat fstats;
+	size_t		block_size;
+	uint32_t	hash;
+	int			fd;
+
+	if (loaded_size == -1 || !f_data || current_state->stream_mode ||
+		!(f_data_opts & STREAM_IS_FILE))
+		return false;
+
+	fd = fileno(f_data);
+
+	/* the file can be replaced (renamed) */
+	if (stat(pathname, &stats) != 0 || fstat(fd, &fstats) != 0)
+		return false;
+
+	if (stats.st_dev != loaded_dev || stats.st_ino != loaded_ino ||
+		fstats.st_dev != loaded_dev || fstats.st_ino != loaded_ino)
+		return false;
+
+	if (fstats.st_size <= loaded_size)
+		return false;
+
+	block_size = loaded_size < SIGNATURE_BLOCK_SIZE ? (size_t) loaded_size : SIGNATURE_BLOCK_SIZE;
+
+	if (!hash_file_block(fd, 0, block_size, &hash) || hash != loaded_head_hash)
+		return false;
+
+	if (!hash_file_block(fd, loaded_size - block_size, block_size, &hash) ||
+		hash != loaded_tail_hash)
+		return false;
+
+	clearerr(f_data);
+
+	if (fseeko(f_data, loaded_size, SEEK_SET) != 0)
+		return false;
+
+	log_row("file \"%s\" was appended (%lld bytes)",
+			pathname, (long long) (fstats.st_size - loaded_size));
+
+	return true;
+}
+
+/*
+ * Returns offset of first of last nlines lines of regular file, when
+ * these lines are after current position, and the content between
+ * current position and these lines is large. Else returns -1. The file
+ * is read backward by blocks, so only the end of file is read.
+ */
+off_t
+get_tail_lines_offset(int nlines)
+{
+	char		buffer[65536];
+	struct stat stats;
+	off_t		start;
+	off_t		end;
+	int			fd;
+
+	if (!f_data || !(f_data_opts & STREAM_IS_FILE) || current_state->stream_mode)
+		return -1;
+
+	fd = fileno(f_data);
+
+	start = ftello(f_data);
+	if (start == -1 || fstat(fd, &stats) != 0)
+		return -1;
+
+	if (stats.st_size - start < TAIL_PREVIEW_MIN_SKIPPED_SIZE)
+		return -1;
+
+	end = stats.st_size;
+
+	while (end > start)
+	{
+		size_t		size;
+		ssize_t		i;
+
+		size = end - start < (off_t) sizeof(buffer) ? (size_t) (end - start) : sizeof(buffer);
+
+		if (pread(fd, buffer, size, end - size) != (ssize_t) size)
+			return -1;
+
+		for (i = size - 1; i >= 0; i--)
+		{
+			off_t		offset = end - size + i;
+
+			/* the newline at the end of file doesn't start new line */
+			if (buffer[i] == '\n' && offset != stats.st_size - 1)
+			{
+				if (--nlines == 0)
+				{
+					if (offset + 1 - start < TAIL_PREVIEW_MIN_SKIPPED_SIZE)
+						return -1;
+
+					log_row("last lines of file starts on %lld", (long long) (offset + 1));
+
+					return offset + 1;
+				}
+			}
+		}
+
+		end -= size;
+	}
+
+	return -1;
 }
 
 const char *
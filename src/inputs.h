@@ -52,6 +52,7 @@ typedef enum
 	PSPG_FATAL_EVENT,						/* got a fatal error */
 	PSPG_ERROR_EVENT,						/* got a error with error message */
 	PSPG_NOTHING_VALID_EVENT,				/* got an error, but this error can be ignored */
+	PSPG_QUERY_EVENT,						/* asynchronous query is finished */
 } PspgEventType;
 
 enum
@@ -79,6 +80,8 @@ extern void unget_pspg_event(NCursesEventData *nced);
 
 extern void detect_file_truncation(void);
 extern void save_file_position(void);
+extern bool is_append_only_change(void);
+extern off_t get_tail_lines_offset(int nlines);
 extern bool open_data_stream(Options *opts);
 extern void close_data_stream(void);
 
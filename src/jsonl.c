@@ -0,0 +1,937 @@
+/*-------------------------------------------------------------------------
+ *
+ * jsonl.c
+ *	  read data in JSON Lines (newline delimited JSON) format
+ *
+ * Portions Copyright (c) 2017-2026 Pavel Stehule
+ *
+ * IDENTIFICATION
+ *	  src/jsonl.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pspg.h"
+#include "rowbuilder.h"
+
+/*
+ * Every object is one row. The keys of objects are columns in order
+ * of first occurrence. Missing keys are displayed as NULL. When there
+ * are more different keys than possible columns, then the values of
+ * these keys are displayed together (as JSON object) in last column.
+ * Nested objects and arrays are displayed as compact JSON. The column
+ * is numeric, when all values (that are not null) are numbers.
+ *
+ * The input is read to memory and parsed two times. First pass checks
+ * the syntax and collects keys and types of columns, second pass
+ * builds rows. The strings are scanned by 8 bytes together.
+ */
+#define JSONL_MAX_COLUMNS		1024
+#define JSONL_OTHERS_COLUMN		(JSONL_MAX_COLUMNS - 1)
+#define JSONL_OTHERS_NAME		"(other keys)"
+#define JSONL_MAX_DEPTH			256
+#define JSONL_HASHTAB_SIZE		(2 * JSONL_MAX_COLUMNS)
+
+#define ONES					UINT64_C(0x0101010101010101)
+#define HIGHS					UINT64_C(0x8080808080808080)
+
+/* true, when some byte of word is zero or is less than n */
+#define HAS_ZERO(w)				(((w) - ONES) & ~(w) & HIGHS)
+#define HAS_LESS(w, n)			(((w) - ONES * (n)) & ~(w) & HIGHS)
+
+typedef enum
+{
+	JSON_NULL,
+	JSON_BOOL,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_NESTED					/* object or array */
+} JsonType;
+
+typedef struct
+{
+	char	   *name;
+	int			name_size;
+	bool		has_number;
+	bool		has_other;			/* has not null value that is not number */
+} JsonColumn;
+
+/*
+ * Value of one field of current row. The text is stored in input data
+ * (when it can be displayed without change) or in buffer of reader.
+ */
+typedef struct
+{
+	long		rowno;				/* value is valid only for current row */
+	JsonType	type;
+	const char *str;
+	int			offset;				/* offset in buffer, when str is NULL */
+	int			size;
+} JsonField;
+
+typedef struct
+{
+	const char *data;
+	const char *ptr;
+	const char *end;
+	int			depth;
+	JsonColumn	columns[JSONL_MAX_COLUMNS];
+	int			ncolumns;
+	int			hashtab[JSONL_HASHTAB_SIZE];	/* column number + 1 */
+	JsonField  *fields;
+	long		rowno;
+	char	   *buffer;				/* unescaped strings and compact JSON */
+	int			used;
+	int			size;
+	char	   *others;				/* values of keys without own column */
+	int			others_used;
+	int			others_size;
+	const bool *dropped;			/* columns that are not loaded */
+} JsonReader;
+
+/*
+ * Returns first quote, backslash or control char. Usually the strings
+ * are without special chars, so 8 bytes are checked together.
+ */
+static const char *
+find_string_special(const char *ptr, const char *end)
+{
+	while (end - ptr >= 8)
+	{
+		uint64_t	w;
+
+		memcpy(&w, ptr, 8);
+
+		if (HAS_ZERO(w ^ (ONES * '"')) |
+			HAS_ZERO(w ^ (ONES * '\\')) |
+			HAS_LESS(w, 0x20))
+			break;
+
+		ptr += 8;
+	}
+
+	while (ptr < end && *ptr != '"' && *ptr != '\\' && (unsigned char) *ptr >= 0x20)
+		ptr++;
+
+	return ptr;
+}
+
+static void
+skip_whitespaces(JsonReader *jr)
+{
+	while (jr->ptr < jr->end &&
+		   (*jr->ptr == ' ' || *jr->ptr == '\n' || *jr->ptr == '\t' || *jr->ptr == '\r'))
+		jr->ptr++;
+}
+
+static bool
+is_hexdigit(char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/*
+ * Check string, and returns its content (without quotes)
+ */
+static bool
+parse_string(JsonReader *jr, const char **str, int *size, bool *has_escapes)
+{
+	const char *start = ++jr->ptr;
+
+	*has_escapes = false;
+
+	for (;;)
+	{
+		const char *ptr = find_string_special(jr->ptr, jr->end);
+
+		if (ptr >= jr->end)
+			return false;
+
+		if (*ptr == '"')
+		{
+			if (ptr - start > INT32_MAX / 4)
+				return false;
+
+			*str = start;
+			*size = ptr - start;
+			jr->ptr = ptr + 1;
+
+			return true;
+		}
+		else if (*ptr == '\\')
+		{
+			if (ptr + 1 >= jr->end)
+				return false;
+
+			if (ptr[1] == 'u')
+			{
+				int			i;
+
+				if (jr->end - ptr < 6)
+					return false;
+
+				for (i = 2; i < 6; i++)
+					if (!is_hexdigit(ptr[i]))
+						return false;
+
+				jr->ptr = ptr + 6;
+			}
+			else if (strchr("\"\\/bfnrt", ptr[1]) && ptr[1] != '\0')
+				jr->ptr = ptr + 2;
+			else
+				return false;
+
+			*has_escapes = true;
+		}
+		else
+			/* control chars should be escaped */
+			return false;
+	}
+}
+
+static bool
+parse_number(JsonReader *jr)
+{
+	const char *ptr = jr->ptr;
+	const char *end = jr->end;
+
+	if (ptr < end && *ptr == '-')
+		ptr++;
+
+	if (ptr < end && *ptr == '0')
+		ptr++;
+	else if (ptr < end && *ptr >= '1' && *ptr <= '9')
+	{
+		while (ptr < end && *ptr >= '0' && *ptr <= '9')
+			ptr++;
+	}
+	else
+		return false;
+
+	if (ptr < end && *ptr == '.')
+	{
+		ptr++;
+
+		if (ptr >= end || *ptr < '0' || *ptr > '9')
+			return false;
+
+		while (ptr < end && *ptr >= '0' && *ptr <= '9')
+			ptr++;
+	}
+
+	if (ptr < end && (*ptr == 'e' || *ptr == 'E'))
+	{
+		ptr++;
+
+		if (ptr < end && (*ptr == '+' || *ptr == '-'))
+			ptr++;
+
+		if (ptr >= end || *ptr < '0' || *ptr > '9')
+			return false;
+
+		while (ptr < end && *ptr >= '0' && *ptr <= '9')
+			ptr++;
+	}
+
+	jr->ptr = ptr;
+
+	return true;
+}
+
+static bool
+parse_literal(JsonReader *jr, const char *literal, int size)
+{
+	if (jr->end - jr->ptr < size || memcmp(jr->ptr, literal, size) != 0)
+		return false;
+
+	jr->ptr += size;
+
+	return true;
+}
+
+/*
+ * Check syntax of any value, and returns its type
+ */
+static bool
+skip_value(JsonReader *jr, JsonType *type)
+{
+	const char *str;
+	int			size;
+	bool		has_escapes;
+
+	if (jr->ptr >= jr->end)
+		return false;
+
+	switch (*jr->ptr)
+	{
+		case '"':
+			*type = JSON_STRING;
+			return parse_string(jr, &str, &size, &has_escapes);
+
+		case 'n':
+			*type = JSON_NULL;
+			return parse_literal(jr, "null", 4);
+
+		case 't':
+			*type = JSON_BOOL;
+			return parse_literal(jr, "true", 4);
+
+		case 'f':
+			*type = JSON_BOOL;
+			return parse_literal(jr, "false", 5);
+
+		case '{':
+		case '[':
+			{
+				char		close = *jr->ptr == '{' ? '}' : ']';
+				bool		is_object = *jr->ptr == '{';
+				JsonType	t;
+
+				*type = JSON_NESTED;
+
+				if (++jr->depth > JSONL_MAX_DEPTH)
+					return false;
+
+				jr->ptr++;
+				skip_whitespaces(jr);
+
+				if (jr->ptr < jr->end && *jr->ptr == close)
+				{
+					jr->ptr++;
+					jr->depth--;
+					return true;
+				}
+
+				for (;;)
+				{
+					if (is_object)
+					{
+						if (jr->ptr >= jr->end || *jr->ptr != '"' ||
+							!parse_string(jr, &str, &size, &has_escapes))
+							return false;
+
+						skip_whitespaces(jr);
+
+						if (jr->ptr >= jr->end || *jr->ptr++ != ':')
+							return false;
+
+						skip_whitespaces(jr);
+					}
+
+					if (!skip_value(jr, &t))
+						return false;
+
+					skip_whitespaces(jr);
+
+					if (jr->ptr >= jr->end)
+						return false;
+
+					if (*jr->ptr == close)
+						break;
+
+					if (*jr->ptr++ != ',')
+						return false;
+
+					skip_whitespaces(jr);
+				}
+
+				jr->ptr++;
+				jr->depth--;
+
+				return true;
+			}
+
+		default:
+			*type = JSON_NUMBER;
+			return parse_number(jr);
+	}
+}
+
+static void
+reserve(char **buffer, int *size, int used, int needed)
+{
+	if (used + needed > *size)
+	{
+		while (used + needed > *size)
+			*size = *size > 0 ? *size * 2 : 1024;
+
+		*buffer = srealloc(*buffer, *size);
+	}
+}
+
+static int
+hex_value(const char *ptr)
+{
+	int			result = 0;
+	int			i;
+
+	for (i = 0; i < 4; i++)
+	{
+		char		c = ptr[i];
+
+		result = result * 16 +
+			(c <= '9' ? c - '0' : (c <= 'F' ? c - 'A' : c - 'a') + 10);
+	}
+
+	return result;
+}
+
+/*
+ * Decode escape sequences of checked string. Returns size of result.
+ */
+static int
+unescape_string(char *dest, const char *str, int size)
+{
+	const char *end = str + size;
+	char	   *ptr = dest;
+
+	while (str < end)
+	{
+		unsigned int c;
+
+		if (*str != '\\')
+		{
+			*ptr++ = *str++;
+			continue;
+		}
+
+		switch (str[1])
+		{
+			case 'b': *ptr++ = '\b'; str += 2; continue;
+			case 'f': *ptr++ = '\f'; str += 2; continue;
+			case 'n': *ptr++ = '\n'; str += 2; continue;
+			case 'r': *ptr++ = '\r'; str += 2; continue;
+			case 't': *ptr++ = '\t'; str += 2; continue;
+			case 'u': break;
+			default: *ptr++ = str[1]; str += 2; continue;
+		}
+
+		c = hex_value(str + 2);
+		str += 6;
+
+		if (c >= 0xD800 && c <= 0xDBFF &&
+			end - str >= 6 && str[0] == '\\' && str[1] == 'u')
+		{
+			unsigned int low = hex_value(str + 2);
+
+			if (low >= 0xDC00 && low <= 0xDFFF)
+			{
+				c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+				str += 6;
+			}
+		}
+
+		/* unpaired surrogate is replaced by replacement char */
+		if (c >= 0xD800 && c <= 0xDFFF)
+			c = 0xFFFD;
+
+		if (c < 0x80)
+			*ptr++ = c;
+		else if (c < 0x800)
+		{
+			*ptr++ = 0xC0 | (c >> 6);
+			*ptr++ = 0x80 | (c & 0x3F);
+		}
+		else if (c < 0x10000)
+		{
+			*ptr++ = 0xE0 | (c >> 12);
+			*ptr++ = 0x80 | ((c >> 6) & 0x3F);
+			*ptr++ = 0x80 | (c & 0x3F);
+		}
+		else
+		{
+			*ptr++ = 0xF0 | (c >> 18);
+			*ptr++ = 0x80 | ((c >> 12) & 0x3F);
+			*ptr++ = 0x80 | ((c >> 6) & 0x3F);
+			*ptr++ = 0x80 | (c & 0x3F);
+		}
+	}
+
+	return ptr - dest;
+}
+
+/*
+ * Copy checked JSON value without whitespaces. Returns size of result.
+ */
+static int
+compact_json(char *dest, const char *str, int size)
+{
+	const char *end = str + size;
+	char	   *ptr = dest;
+
+	while (str < end)
+	{
+		if (*str == '"')
+		{
+			const char *start = str++;
+
+			for (;;)
+			{
+				str = find_string_special(str, end);
+
+				if (*str == '"')
+					break;
+
+				/* skip escaped char */
+				str += 2;
+			}
+
+			str++;
+			memcpy(ptr, start, str - start);
+			ptr += str - start;
+		}
+		else if (*str == ' ' || *str == '\n' || *str == '\t' || *str == '\r')
+			str++;
+		else
+			*ptr++ = *str++;
+	}
+
+	return ptr - dest;
+}
+
+static uint32_t
+hash_key(const char *str, int size)
+{
+	uint32_t	hash = 2166136261u;
+
+	while (size--)
+	{
+		hash ^= (unsigned char) *str++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Returns column number of key. New column is created, when it is
+ * allowed and when there is free space. The keys without own column
+ * are displayed in others column.
+ */
+static int
+get_column(JsonReader *jr, const char *str, int size, bool has_escapes, bool create)
+{
+	char		localbuf[256];
+	char	   *name = localbuf;
+	uint32_t	pos;
+	int			colno;
+
+	if (has_escapes)
+	{
+		if (size > (int) sizeof(localbuf))
+			name = smalloc(size);
+
+		size = unescape_string(name, str, size);
+	}
+	else
+		name = (char *) str;
+
+	pos = hash_key(name, size) & (JSONL_HASHTAB_SIZE - 1);
+
+	while (jr->hashtab[pos])
+	{
+		JsonColumn *col = &jr->columns[jr->hashtab[pos] - 1];
+
+		if (col->name_size == size && memcmp(col->name, name, size) == 0)
+		{
+			colno = jr->hashtab[pos] - 1;
+			goto done;
+		}
+
+		pos = (pos + 1) & (JSONL_HASHTAB_SIZE - 1);
+	}
+
+	if (create && jr->ncolumns < JSONL_OTHERS_COLUMN)
+	{
+		JsonColumn *col = &jr->columns[jr->ncolumns];
+
+		col->name = smalloc(size + 1);
+		memcpy(col->name, name, size);
+		col->name_size = size;
+
+		jr->hashtab[pos] = jr->ncolumns + 1;
+		colno = jr->ncolumns++;
+	}
+	else
+		colno = JSONL_OTHERS_COLUMN;
+
+done:
+	if (name != localbuf && name != str)
+		free(name);
+
+	return colno;
+}
+
+/*
+ * Store value of key without own column to others column
+ */
+static void
+add_other(JsonReader *jr, const char *key, int key_size, const char *value, int size)
+{
+	/* "key":value and comma or brace */
+	reserve(&jr->others, &jr->others_size, jr->others_used, key_size + size + 4);
+
+	jr->others[jr->others_used] = jr->others_used == 0 ? '{' : ',';
+	jr->others_used += 1;
+	jr->others[jr->others_used++] = '"';
+	memcpy(jr->others + jr->others_used, key, key_size);
+	jr->others_used += key_size;
+	jr->others[jr->others_used++] = '"';
+	jr->others[jr->others_used++] = ':';
+
+	jr->others_used += compact_json(jr->others + jr->others_used, value, size);
+}
+
+/*
+ * Read one object. In first pass the columns are collected, in second
+ * pass the values of fields are stored.
+ */
+static bool
+read_object(JsonReader *jr, bool first_pass)
+{
+	skip_whitespaces(jr);
+
+	if (jr->ptr >= jr->end || *jr->ptr != '{')
+		return false;
+
+	jr->ptr++;
+	jr->depth = 1;
+
+	skip_whitespaces(jr);
+
+	if (jr->ptr < jr->end && *jr->ptr == '}')
+	{
+		jr->ptr++;
+		return true;
+	}
+
+	for (;;)
+	{
+		const char *key;
+		const char *value;
+		int			key_size;
+		bool		has_escapes;
+		JsonType	type;
+		int			colno;
+
+		if (jr->ptr >= jr->end || *jr->ptr != '"' ||
+			!parse_string(jr, &key, &key_size, &has_escapes))
+			return false;
+
+		skip_whitespaces(jr);
+
+		if (jr->ptr >= jr->end || *jr->ptr++ != ':')
+			return false;
+
+		skip_whitespaces(jr);
+
+		value = jr->ptr;
+		if (!skip_value(jr, &type))
+			return false;
+
+		if (jr->ptr - value > INT32_MAX / 4)
+			return false;
+
+		colno = get_column(jr, key, key_size, has_escapes, first_pass);
+
+		if (first_pass)
+		{
+			if (colno == JSONL_OTHERS_COLUMN)
+				jr->columns[colno].has_other = true;
+			else if (type == JSON_NUMBER)
+				jr->columns[colno].has_number = true;
+			else if (type != JSON_NULL)
+				jr->columns[colno].has_other = true;
+		}
+		else if (jr->dropped[colno])
+		{
+			/* value of not loaded column is not unescaped */
+		}
+		else if (colno == JSONL_OTHERS_COLUMN)
+			add_other(jr, key, key_size, value, jr->ptr - value);
+		else
+		{
+			JsonField  *field = &jr->fields[colno];
+			int			size = jr->ptr - value;
+
+			field->rowno = jr->rowno;
+			field->type = type;
+			field->str = value;
+			field->size = size;
+
+			if (type == JSON_STRING)
+			{
+				const char *str;
+				bool		string_has_escapes;
+
+				/* parse again to get content without quotes */
+				jr->ptr = value;
+				(void) parse_string(jr, &str, &size, &string_has_escapes);
+
+				if (string_has_escapes)
+				{
+					reserve(&jr->buffer, &jr->size, jr->used, size);
+
+					field->str = NULL;
+					field->offset = jr->used;
+					field->size = unescape_string(jr->buffer + jr->used, str, size);
+					jr->used += field->size;
+				}
+				else
+				{
+					field->str = str;
+					field->size = size;
+				}
+			}
+			else if (type == JSON_NESTED)
+			{
+				reserve(&jr->buffer, &jr->size, jr->used, size);
+
+				field->str = NULL;
+				field->offset = jr->used;
+				field->size = compact_json(jr->buffer + jr->used, value, size);
+				jr->used += field->size;
+			}
+		}
+
+		skip_whitespaces(jr);
+
+		if (jr->ptr >= jr->end)
+			return false;
+
+		if (*jr->ptr == '}')
+			break;
+
+		if (*jr->ptr++ != ',')
+			return false;
+
+		skip_whitespaces(jr);
+	}
+
+	jr->ptr++;
+
+	return true;
+}
+
+/*
+ * Build row from values of current row
+ */
+static void
+add_row(JsonReader *jr, RowBuilder *b)
+{
+	int			i;
+
+	for (i = 0; i < jr->ncolumns; i++)
+	{
+		Value		v;
+
+		memset(&v, 0, sizeof(Value));
+
+		if (i == JSONL_OTHERS_COLUMN)
+		{
+			if (jr->others_used > 0)
+			{
+				reserve(&jr->others, &jr->others_size, jr->others_used, 1);
+				jr->others[jr->others_used++] = '}';
+
+				v.str = jr->others;
+				v.size = jr->others_used;
+			}
+			else
+				v.isnull = true;
+		}
+		else
+		{
+			JsonField  *field = &jr->fields[i];
+
+			if (field->rowno != jr->rowno || field->type == JSON_NULL)
+				v.isnull = true;
+			else
+			{
+				v.str = field->str ? field->str : jr->buffer + field->offset;
+				v.size = field->size;
+
+				/* the number is followed by some char that is not part of number */
+				if (b->kinds[i] == VALUE_NUMBER)
+					v.d = strtod(v.str, NULL);
+			}
+		}
+
+		builder_add(b, &v);
+	}
+
+	builder_end_row(b);
+}
+
+static long
+get_lineno(JsonReader *jr, const char *pos)
+{
+	const char *ptr = jr->data;
+	long		lineno = 1;
+
+	while ((ptr = memchr(ptr, '\n', pos - ptr)))
+	{
+		lineno++;
+		ptr++;
+	}
+
+	return lineno;
+}
+
+static bool
+read_jsonl(FILE *fp, RowBuilder *b)
+{
+	JsonReader *jr;
+	char	   *data = NULL;
+	const char *start;
+	size_t		size = 0;
+	size_t		allocated = 0;
+	size_t		n;
+	bool		result = false;
+	const char *names[JSONL_MAX_COLUMNS];
+	int			i;
+
+	/* read all data, the columns are known after reading of all rows */
+	do
+	{
+		if (allocated - size < 65536)
+		{
+			allocated = allocated > 0 ? allocated * 2 : 1024 * 1024;
+
+			if (!(data = realloc(data, allocated)))
+				leave("out of memory");
+		}
+
+		n = fread(data + size, 1, allocated - size - 1, fp);
+		size += n;
+	} while (n > 0);
+
+	/* numbers are parsed by strtod, so data should be terminated */
+	data[size] = '\0';
+
+	jr = smalloc(sizeof(JsonReader));
+	jr->data = data;
+	jr->end = data + size;
+
+	/* skip UTF8 BOM */
+	start = size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0 ? data + 3 : data;
+
+	/* first pass - check syntax and collect columns */
+	jr->ptr = start;
+	skip_whitespaces(jr);
+
+	if (jr->ptr >= jr->end)
+	{
+		format_error("missing data");
+		goto done;
+	}
+
+	while (jr->ptr < jr->end)
+	{
+		const char *object_start = jr->ptr;
+
+		if (!read_object(jr, true))
+		{
+			format_error("broken JSON data or value is not an object (line %ld)",
+						 get_lineno(jr, object_start));
+			goto done;
+		}
+
+		skip_whitespaces(jr);
+	}
+
+	if (jr->ncolumns == 0)
+	{
+		format_error("JSON data has not any key");
+		goto done;
+	}
+
+	/* there are keys without own column */
+	if (jr->columns[JSONL_OTHERS_COLUMN].has_other)
+	{
+		jr->columns[JSONL_OTHERS_COLUMN].name = sstrdup(JSONL_OTHERS_NAME);
+		jr->ncolumns += 1;
+	}
+
+	for (i = 0; i < jr->ncolumns; i++)
+	{
+		JsonColumn *col = &jr->columns[i];
+
+		b->kinds[i] = col->has_number && !col->has_other ? VALUE_NUMBER : VALUE_TEXT;
+	}
+
+	for (i = 0; i < jr->ncolumns; i++)
+		names[i] = jr->columns[i].name;
+
+	if (!builder_set_columns(b, jr->ncolumns, names))
+		goto done;
+
+	/* second pass - build rows, values of dropped columns are skipped */
+	jr->dropped = b->dropped;
+	jr->fields = smalloc(jr->ncolumns * sizeof(JsonField));
+	for (i = 0; i < jr->ncolumns; i++)
+		jr->fields[i].rowno = -1;
+
+	jr->ptr = start;
+	skip_whitespaces(jr);
+
+	while (jr->ptr < jr->end)
+	{
+		jr->used = 0;
+		jr->others_used = 0;
+
+		(void) read_object(jr, false);
+		add_row(jr, b);
+
+		jr->rowno += 1;
+		skip_whitespaces(jr);
+	}
+
+	result = true;
+
+done:
+	for (i = 0; i < JSONL_MAX_COLUMNS; i++)
+		free(jr->columns[i].name);
+
+	free(jr->fields);
+	free(jr->buffer);
+	free(jr->others);
+	free(jr);
+	free(data);
+
+	return result;
+}
+
+/*
+ * Read data in JSON Lines format. The result is in same format like
+ * the result of query (see pg_exec_query).
+ */
+bool
+read_jsonl_input(Options *opts,
+				 FILE *fp,
+				 RowBucketType *rb,
+				 PrintDataDesc *pdesc,
+				 ColumnStats **colstats,
+				 TypedColumn **typed_columns)
+{
+	RowBuilder	b;
+
+	builder_init(&b, opts, rb, pdesc);
+
+	if (!read_jsonl(fp, &b))
+	{
+		builder_free(&b, rb);
+		return false;
+	}
+
+	free(b.buffer);
+
+	*colstats = b.colstats;
+	*typed_columns = b.typed_columns;
+
+	return true;
+}
@@ -15,6 +15,7 @@
 
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 /*
  * Initialize line buffer iterator
@@ -502,6 +503,8 @@ lb_free(DataDesc *desc)
 			free(lb->rows[i]);
 
 		free(lb->lineinfo);
+		free(lb->spans);
+		free(lb->changed_cols);
 		next = lb->next;
 
 		if (lb != &desc->rows)
@@ -511,6 +514,61 @@ lb_free(DataDesc *desc)
 	}
 }
 
+/*
+ * Removes oldest line buffers, so at least max_rows rows are kept.
+ * Only complete line buffers are removed. The first line buffer is
+ * owned by data desc, so the content of the second line buffer is
+ * moved there. Returns number of removed rows.
+ */
+int
+lb_retire_rows(DataDesc *desc, int max_rows)
+{
+	int		retired_rows = 0;
+
+	while (desc->rows.next &&
+		   desc->total_rows - desc->rows.nrows >= max_rows)
+	{
+		LineBuffer *next = desc->rows.next;
+		int		i;
+
+		for (i = 0; i < desc->rows.nrows; i++)
+			free(desc->rows.rows[i]);
+
+		free(desc->rows.lineinfo);
+		free(desc->rows.spans);
+		free(desc->rows.changed_cols);
+
+		desc->total_rows -= desc->rows.nrows;
+		retired_rows += desc->rows.nrows;
+
+		memcpy(&desc->rows, next, sizeof(LineBuffer));
+		desc->rows.prev = NULL;
+
+		if (desc->rows.next)
+			desc->rows.next->prev = &desc->rows;
+
+		if (desc->last_buffer == next)
+			desc->last_buffer = NULL;
+
+		free(next);
+	}
+
+	if (retired_rows > 0)
+	{
+		desc->retired_rows += retired_rows;
+
+		desc->last_row -= retired_rows;
+		desc->last_data_row -= retired_rows;
+		desc->maxy = desc->last_row;
+
+		desc->multilines_already_tested = false;
+
+		log_row("retired %d rows", retired_rows);
+	}
+
+	return retired_rows;
+}
+
 /*
  * Print all lines to stream
  */
@@ -67,6 +67,8 @@ ST_MENU_ITEM _copy[] = {
 	{"_4_Use commented INSERT format", cmd_UseClipboard_INSERT_with_comments, NULL, 0, 0, 0, NULL},
 	{"_5_Use SQL Values format", cmd_UseClipboard_SQL_values, NULL, 0, 0, 0, NULL},
 	{"_6_Use pipe separated text", cmd_UseClipboard_pipe_separated, NULL, 0, 0, 0, NULL},
+	{"_7_Use COPY text format", cmd_UseClipboard_COPY_text, NULL, 0, 0, 0, NULL},
+	{"_8_Use Arrow IPC (Feather) format", cmd_UseClipboard_Arrow, NULL, 0, 0, 0, NULL},
 	{NULL, 0, NULL, 0, 0, 0, NULL}
 };
 
@@ -128,6 +130,8 @@ ST_MENU_ITEM _command[] = {
 	{"As~c~ending order", cmd_SortAsc, "a", 0, 0, 0, NULL},
 	{"~D~escending order", cmd_SortDesc, "d", 0, 0, 0, NULL},
 	{"~O~riginal order", cmd_OriginalSort, "u", 0, 0, 0, NULL},
+	{"Cancel f~i~lter", cmd_CancelFilter, NULL, 0, 0, 0, NULL},
+	{"Column s~t~atistics", cmd_ShowColumnStats, NULL, 0, 0, 0, NULL},
 	{"--", 0, NULL, 0, 0, 0, NULL},
 	{"To~g~gle mark", cmd_Mark, "F3", 0, 0, 0, NULL},
 	{"~M~ark column", cmd_MarkColumn, "F13", 0, 0, 0, NULL},
@@ -172,6 +176,7 @@ ST_MENU_ITEM _options[] = {
 	{"~C~ase sensitive search", cmd_CSSearchSet, NULL, 0, 0, 0, NULL},
 	{"Case ~i~nsensitive search", cmd_CISearchSet, NULL, 0, 0, 0, NULL},
 	{"~U~pper case sensitive search", cmd_USSearchSet, NULL, 0, 0, 0, NULL},
+	{"~R~egular expression search", cmd_RegexSearchToggle, NULL, 0, 0, 0, NULL},
 	{"--", 0, NULL, 0, 0, 0, NULL},
 	{"Highlight searched ~l~ines", cmd_HighlightLines, NULL, 0, 0, 0, NULL},
 	{"Highlight searched ~v~alues", cmd_HighlightValues, NULL, 0, 0, 0, NULL},
@@ -398,6 +403,7 @@ post_menu(Options *opts, struct ST_MENU *menu, bool is_text)
 									  !(opts->ignore_case || opts->ignore_lower_case));
 	st_menu_set_option(menu, cmd_CISearchSet, ST_MENU_OPTION_MARKED, opts->ignore_case);
 	st_menu_set_option(menu, cmd_USSearchSet, ST_MENU_OPTION_MARKED, opts->ignore_lower_case);
+	st_menu_set_option(menu, cmd_RegexSearchToggle, ST_MENU_OPTION_MARKED, opts->regex_search);
 
 	st_menu_set_option(menu, cmd_ShowTopBar, ST_MENU_OPTION_MARKED, !opts->no_topbar);
 	st_menu_set_option(menu, cmd_ShowBottomBar, ST_MENU_OPTION_MARKED, !opts->no_commandbar);
@@ -440,6 +446,8 @@ refresh_clipboard_options(Options *opts, struct ST_MENU *menu,  bool is_text)
 
 	st_menu_set_option(menu, cmd_UseClipboard_SQL_values, ST_MENU_OPTION_MARKED, !is_text && opts->clipboard_format == CLIPBOARD_FORMAT_SQL_VALUES);
 	st_menu_set_option(menu, cmd_UseClipboard_pipe_separated, ST_MENU_OPTION_MARKED, !is_text && opts->clipboard_format == CLIPBOARD_FORMAT_PIPE_SEPARATED);
+	st_menu_set_option(menu, cmd_UseClipboard_COPY_text, ST_MENU_OPTION_MARKED, !is_text && opts->clipboard_format == CLIPBOARD_FORMAT_COPY_TEXT);
+	st_menu_set_option(menu, cmd_UseClipboard_Arrow, ST_MENU_OPTION_MARKED, !is_text && opts->clipboard_format == CLIPBOARD_FORMAT_ARROW);
 
 	st_menu_set_option(menu, cmd_UseClipboard_CSV, ST_MENU_OPTION_DISABLED, is_text);
 	st_menu_set_option(menu, cmd_UseClipboard_TSVC, ST_MENU_OPTION_DISABLED, is_text);
@@ -447,6 +455,8 @@ refresh_clipboard_options(Options *opts, struct ST_MENU *menu,  bool is_text)
 	st_menu_set_option(menu, cmd_UseClipboard_INSERT_with_comments, ST_MENU_OPTION_DISABLED, is_text);
 	st_menu_set_option(menu, cmd_UseClipboard_SQL_values, ST_MENU_OPTION_DISABLED, is_text);
 	st_menu_set_option(menu, cmd_UseClipboard_pipe_separated, ST_MENU_OPTION_DISABLED, is_text);
+	st_menu_set_option(menu, cmd_UseClipboard_COPY_text, ST_MENU_OPTION_DISABLED, is_text);
+	st_menu_set_option(menu, cmd_UseClipboard_Arrow, ST_MENU_OPTION_DISABLED, is_text);
 }
 
 void
@@ -11,44 +11,231 @@
  *-------------------------------------------------------------------------
  */
 
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "pspg.h"
 #include "unicode.h"
 
-#ifdef HAVE_POSTGRESQL
+/* 2000-01-01 in unix time */
+#define POSTGRES_EPOCH_UNIX		INT64_C(946684800)
 
-#include <libpq-fe.h>
+/*
+ * Output of values in binary format. These routines don't need libpq,
+ * because they are used by binary input formats (binary-input.c) too.
+ */
 
-char errmsg[1024];
+static uint16_t
+read_uint16(const char *ptr)
+{
+	const unsigned char *u = (const unsigned char *) ptr;
 
-static RowBucketType *
-push_row(RowBucketType *rb, RowType *row, bool is_multiline)
+	return (uint16_t) ((u[0] << 8) | u[1]);
+}
+
+/*
+ * Prints shortest text, that can be read back to same value. Exponent
+ * is used for too small or too big values like float output functions
+ * of Postgres do.
+ */
+void
+pg_format_float(char *buf, int size, double d, bool is_float4)
 {
-	if (rb->nrows >= 1000)
+	int		max_precision = is_float4 ? 9 : 17;
+	int		precision;
+	int		exponent;
+
+	if (isnan(d))
 	{
-		RowBucketType *new = malloc(sizeof(RowBucketType));
+		snprintf(buf, size, "NaN");
+		return;
+	}
+	else if (isinf(d))
+	{
+		snprintf(buf, size, d > 0 ? "Infinity" : "-Infinity");
+		return;
+	}
+	else if (d == 0.0)
+	{
+		snprintf(buf, size, signbit(d) ? "-0" : "0");
+		return;
+	}
 
-		if (!new)
-			return NULL;
+	for (precision = 1; precision < max_precision; precision++)
+	{
+		snprintf(buf, size, "%.*e", precision - 1, d);
 
-		new->nrows = 0;
-		new->allocated = true;
-		new->next_bucket = NULL;
+		if (is_float4 ? (float) strtod(buf, NULL) == (float) d : strtod(buf, NULL) == d)
+			break;
+	}
 
-		rb->next_bucket = new;
-		rb = new;
+	snprintf(buf, size, "%.*e", precision - 1, d);
+	exponent = atoi(strchr(buf, 'e') + 1);
+
+	if (exponent < -4 || exponent >= (is_float4 ? 6 : 15))
+	{
+		/* Postgres doesn't print ".0" in exponential format */
+		if (precision == 1)
+			snprintf(buf, size, "%.0e", d);
+
+		return;
 	}
 
-	rb->rows[rb->nrows] = row;
-	rb->multilines[rb->nrows++] = is_multiline;
+	snprintf(buf, size, "%.*f", precision - 1 - exponent > 0 ? precision - 1 - exponent : 0, d);
+}
 
-	return rb;
+/*
+ * Transforms binary numeric (base 10000 digits) to text
+ */
+char *
+pg_numeric_to_text(const char *value)
+{
+	int			ndigits = (int16_t) read_uint16(value);
+	int			weight = (int16_t) read_uint16(value + 2);
+	uint16_t	sign = read_uint16(value + 4);
+	int			dscale = (int16_t) read_uint16(value + 6);
+	const char *digits = value + 8;
+	char	   *result;
+	char	   *ptr;
+	int			i;
+
+	if (sign == 0xC000)
+		return sstrdup("NaN");
+	else if (sign == 0xD000)
+		return sstrdup("Infinity");
+	else if (sign == 0xF000)
+		return sstrdup("-Infinity");
+
+	result = ptr = smalloc((weight > 0 ? weight + 1 : 1) * 4 + dscale + 8);
+
+	if (sign == 0x4000)
+		*ptr++ = '-';
+
+	if (weight < 0)
+		*ptr++ = '0';
+	else
+	{
+		for (i = 0; i <= weight; i++)
+		{
+			int		dig = i < ndigits ? (int16_t) read_uint16(digits + 2 * i) : 0;
+
+			ptr += sprintf(ptr, i == 0 ? "%d" : "%04d", dig);
+		}
+	}
+
+	if (dscale > 0)
+	{
+		int		written = 0;
+
+		*ptr++ = '.';
+
+		for (i = weight + 1; written < dscale; i++)
+		{
+			int		dig = (i >= 0 && i < ndigits) ? (int16_t) read_uint16(digits + 2 * i) : 0;
+			char	buf[8];
+			int		k;
+
+			sprintf(buf, "%04d", dig);
+
+			for (k = 0; k < 4 && written < dscale; k++, written++)
+				*ptr++ = buf[k];
+		}
+	}
+
+	*ptr = '\0';
+
+	return result;
+}
+
+/*
+ * Print date part of timestamp in ISO format
+ */
+int
+pg_format_date(char *buf, int size, int64_t unix_sec)
+{
+	time_t		t = (time_t) unix_sec;
+	struct tm	tm;
+	int			year;
+
+	if (!gmtime_r(&t, &tm))
+		return snprintf(buf, size, "out of range");
+
+	year = tm.tm_year + 1900;
+
+	if (year <= 0)
+		return snprintf(buf, size, "%04d-%02d-%02d BC", 1 - year, tm.tm_mon + 1, tm.tm_mday);
+
+	return snprintf(buf, size, "%04d-%02d-%02d", year, tm.tm_mon + 1, tm.tm_mday);
+}
+
+void
+pg_format_timestamp(char *buf, int size, int64_t value)
+{
+	int64_t		sec;
+	int64_t		usec;
+	time_t		t;
+	struct tm	tm;
+	bool		is_bc;
+	char		datebuf[32];
+	char	   *bc;
+	int			len;
+
+	sec = value / 1000000;
+	usec = value % 1000000;
+	if (usec < 0)
+	{
+		sec -= 1;
+		usec += 1000000;
+	}
+
+	t = (time_t) (sec + POSTGRES_EPOCH_UNIX);
+	if (!gmtime_r(&t, &tm))
+	{
+		snprintf(buf, size, "out of range");
+		return;
+	}
+
+	(void) pg_format_date(datebuf, sizeof(datebuf), sec + POSTGRES_EPOCH_UNIX);
+
+	/* BC should be after time */
+	bc = strstr(datebuf, " BC");
+	is_bc = bc != NULL;
+	if (bc)
+		*bc = '\0';
+
+	len = snprintf(buf, size, "%s %02d:%02d:%02d", datebuf, tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+	if (usec > 0)
+	{
+		len += snprintf(buf + len, size - len, ".%06d", (int) usec);
+
+		/* remove trailing zeros */
+		while (buf[len - 1] == '0')
+			buf[--len] = '\0';
+	}
+
+	if (is_bc)
+		snprintf(buf + len, size - len, " BC");
 }
 
+#ifdef HAVE_POSTGRESQL
+
+#include <libpq-fe.h>
+
+#define PSPG_STMT_NAME		"pspg_stmt"
+
+#define QUERY_CACHE_SIZE	8
+
 /*
  * Correct solution is importing header file catalog/pg_type_d.h,
  * but this file is not in basic libpq headers, so instead enhancing
@@ -64,12 +251,46 @@ push_row(RowBucketType *rb, RowType *row, bool is_multiline)
 #define CASHOID 790
 #define NUMERICOID 1700
 #define OIDOID 26
- 
-static char
-column_type_class(Oid ftype)
+#define BOOLOID 16
+#define NAMEOID 19
+#define TEXTOID 25
+#define BPCHAROID 1042
+#define VARCHAROID 1043
+#define DATEOID 1082
+#define TIMESTAMPOID 1114
+
+char errmsg[1024];
+
+/*
+ * The connection is reused by next queries (watch mode, query stream).
+ * The query executed repeatedly is prepared, and then executed by
+ * PQexecPrepared.
+ */
+static PGconn *cached_conn = NULL;
+static char *last_query = NULL;
+static bool last_query_is_prepared = false;
+static bool last_query_cannot_be_prepared = false;
+static bool last_query_binary = false;
+
+static void
+forget_last_query(void)
 {
-	char		align;
+	free(last_query);
+	last_query = NULL;
+
+	last_query_is_prepared = false;
+	last_query_cannot_be_prepared = false;
+	last_query_binary = false;
+}
 
+/*
+ * Returns true, when the value of this type can be received in binary
+ * format and transformed to same text like text output function does.
+ * The date and timestamp types can be used only with ISO DateStyle.
+ */
+static bool
+is_binary_supported_type(Oid ftype, bool iso_datestyle)
+{
 	switch (ftype)
 	{
 		case INT2OID:
@@ -81,170 +302,66 @@ column_type_class(Oid ftype)
 		case OIDOID:
 		case XIDOID:
 		case CIDOID:
-		case CASHOID:
-			align = 'd';
-			break;
+		case BOOLOID:
+		case NAMEOID:
+		case TEXTOID:
+		case BPCHAROID:
+		case VARCHAROID:
+			return true;
+		case DATEOID:
+		case TIMESTAMPOID:
+			return iso_datestyle;
 		default:
-			align = 'a';
-			break;
-	}
-	return align;
-}
-
-
-#endif
-
-#define EXIT_OUT_OF_MEMORY()		do { PQclear(result); PQfinish(conn); leave("out of memory"); } while (0)
-#define RELEASE_AND_LEAVE(s)		do { PQclear(result); PQfinish(conn); *err = s; return false; } while (0)
-#define RELEASE_AND_EXIT(s)			do { PQclear(result); PQfinish(conn); leave(s); } while (0)
-
-#ifdef HAVE_POSTGRESQL
-
-static int
-field_info(char *str, bool *multiline)
-{
-	long int	digits;
-	long int	others;
-
-	if (!use_utf8)
-	{
-		int		cw = 0;
-		int		width = 0;
-
-		while (*str)
-		{
-			if (*str++ == '\n')
-			{
-				*multiline = true;
-				width = cw > width ? cw : width;
-				cw = 0;
-			}
-			else
-				cw++;
-		}
-
-		return cw > width ? cw : width;
+			return false;
 	}
-	else
-		return utf_string_dsplen_multiline(str, strlen(str), multiline, false, &digits, &others, 0);
 }
 
 /*
- * Returns true, when some column should be hidden.
+ * Binary format is used only when all columns of result are
+ * of supported types (libpq doesn't allow to specify format
+ * for any column).
  */
-static int
-mark_hidden_columns(PGresult *result,
-					int nfields,
-					Options *opts,
-					bool *hidden)
+static bool
+is_binary_result_possible(PGconn *conn)
 {
-	char	   *names;
-	char	   *endnames;
-	char	   *ptr;
-	int		i;
-	int		visible_columns = 0;
-
-	for (i = 0; i < nfields; i++)
-		hidden[i] = false;
-
-	if (!opts->csv_skip_columns_like)
-		return nfields;
+	PGresult   *result;
+	const char *datestyle;
+	bool		iso_datestyle;
+	bool		possible;
+	int			i;
 
-	/* prepare list of hidden columns */
-	names = sstrdup(opts->csv_skip_columns_like);
-
-	endnames = names + strlen(names);
-	ptr = names;
-	while (*ptr)
-	{
-		/* space is separator between words */
-		if (*ptr == ' ')
-			*ptr = '\0';
-		ptr += 1;
-	}
+	datestyle = PQparameterStatus(conn, "DateStyle");
+	iso_datestyle = datestyle && strncmp(datestyle, "ISO", 3) == 0;
 
-	for (i = 0; i < nfields; i++)
-	{
-		char	   *fieldname = PQfname(result, i);
+	result = PQdescribePrepared(conn, PSPG_STMT_NAME);
 
-		ptr = names;
-		while (ptr < endnames)
-		{
-			if (*ptr)
-			{
-				size_t		len = strlen(ptr);
-
-				if (*ptr == '^')
-				{
-					if (strncmp(fieldname, ptr + 1, len - 1) == 0)
-						hidden[i] = true;
-				}
-				else if (ptr[len - 1] == '$')
-				{
-					size_t		len2 = strlen(fieldname);
-
-					if (len2 > (len - 1) &&
-						strncmp(fieldname + len2 - len + 1, ptr, len - 1) == 0)
-						hidden[i] = true;
-				}
-				else if (strstr(fieldname, ptr))
-					hidden[i] = true;
-			}
+	possible = PQresultStatus(result) == PGRES_COMMAND_OK && PQnfields(result) > 0;
 
-			ptr += strlen(ptr) + 1;
-		}
+	for (i = 0; possible && i < PQnfields(result); i++)
+		possible = is_binary_supported_type(PQftype(result, i), iso_datestyle);
 
-		if (!hidden[i])
-			visible_columns += 1;
-	}
+	PQclear(result);
 
-	free(names);
+	log_row("binary format of result is %spossible", possible ? "" : "not ");
 
-	return visible_columns;
+	return possible;
 }
 
-
-#endif
-
-
-/*
- * exit on fatal error, or return error
- */
-bool
-pg_exec_query(Options *opts, char *query, RowBucketType *rb, PrintDataDesc *pdesc, const char **err)
+static PGconn *
+connect_db(Options *opts)
 {
-
-	log_row("execute query \"%s\"", query);
-
-#ifdef HAVE_POSTGRESQL
-
-	PGconn	   *conn = NULL;
-	PGresult   *result = NULL;
-
-	int			nfields;
-	int			size;
-	int			i, j;
-	int			n;
-	char	   *locbuf;
-	RowType	   *row;
-	bool		multiline_row;
-	bool		multiline_col;
+	PGconn	   *conn;
 	char	   *password;
 
 	const char *keywords[8];
 	const char *values[8];
 
-	bool	   *hidden;
-
-	rb->nrows = 0;
-	rb->next_bucket = NULL;
-
 	if (opts->force_password_prompt && !opts->password)
 	{
 		password = getpass("Password: ");
 		opts->password = strdup(password);
 		if (!opts->password)
-			EXIT_OUT_OF_MEMORY();
+			leave("out of memory");
 	}
 
 	keywords[0] = "host"; values[0] = opts->host;
@@ -262,141 +379,1367 @@ pg_exec_query(Options *opts, char *query, RowBucketType *rb, PrintDataDesc *pdes
 		PQconnectionNeedsPassword(conn) &&
 		!opts->password)
 	{
+		PQfinish(conn);
+
 		password = getpass("Password: ");
 		opts->password = strdup(password);
 		if (!opts->password)
-				EXIT_OUT_OF_MEMORY();
+			leave("out of memory");
 
 		keywords[3] = "password"; values[3] = opts->password;
 
 		conn = PQconnectdbParams(keywords, values, true);
 	}
 
-	/* Check to see that the backend connection was successfully made */
-	if (PQstatus(conn) != CONNECTION_OK)
-	{
-		snprintf(errmsg, sizeof(errmsg),
-		    "Connection to database failed: %s", PQerrorMessage(conn));
-		RELEASE_AND_LEAVE(errmsg);
-	}
+	return conn;
+}
 
-	/*
-	 * ToDo: Because data are copied to local memory, the result can be fetched.
-	 * It can save 1/2 memory.
-	 */
-	result = PQexec(conn, query);
-	if (PQresultStatus(result) != PGRES_TUPLES_OK)
+/*
+ * Returns cached connection. When the connection is broken, or when
+ * the state of connection is not known (previous query was not
+ * finished), then new connection is created. In watch mode the
+ * same query is executed repeatedly, and an transaction left open by
+ * the query is rolled back (else the query would see the same snapshot
+ * every time). Other queries from query stream can use transactions
+ * explicitly, so the transaction state is kept there.
+ */
+static PGconn *
+get_connection(Options *opts)
+{
+	if (cached_conn && PQstatus(cached_conn) == CONNECTION_BAD)
 	{
-		snprintf(errmsg, sizeof(errmsg),
-		    "Query doesn't return data: %s", PQerrorMessage(conn));
-		RELEASE_AND_LEAVE(errmsg);
+		log_row("connection is broken, reconnect");
+
+		PQfinish(cached_conn);
+		cached_conn = NULL;
 	}
 
-	if ((nfields = PQnfields(result)) > 1024)
-		RELEASE_AND_EXIT("too much columns");
+	if (cached_conn)
+	{
+		PGTransactionStatusType tstatus = PQtransactionStatus(cached_conn);
 
-	hidden = smalloc(1024 * sizeof(bool));
+		if (tstatus == PQTRANS_ACTIVE || tstatus == PQTRANS_UNKNOWN)
+		{
+			log_row("state of connection is not known, reconnect");
 
-	pdesc->nfields = mark_hidden_columns(result, nfields, opts, hidden);
+			PQfinish(cached_conn);
+			cached_conn = NULL;
+		}
+		else if (opts->watch_time > 0 && !opts->querystream &&
+				 (tstatus == PQTRANS_INTRANS || tstatus == PQTRANS_INERROR))
+		{
+			log_row("transaction is open, rollback");
 
-	pdesc->has_header = true;
-	n = 0;
-	for (i = 0; i < nfields; i++)
-		if (!hidden[i])
-			pdesc->types[n++] = column_type_class(PQftype(result, i));
+			PQclear(PQexec(cached_conn, "ROLLBACK"));
+		}
+	}
 
-	/* calculate necessary size of header data */
-	size = 0;
-	for (i = 0; i < nfields; i++)
-		if (!hidden[i])
-			size += strlen(PQfname(result, i)) + 1;
+	if (!cached_conn)
+	{
+		cached_conn = connect_db(opts);
 
-	locbuf = malloc(size);
-	if (!locbuf)
-		EXIT_OUT_OF_MEMORY();
+		/* prepared statements are lost with broken connection */
+		forget_last_query();
+	}
 
-	/* store header */
-	row = malloc(offsetof(RowType, fields) + (pdesc->nfields * sizeof(char *)));
-	if (!row)
-		EXIT_OUT_OF_MEMORY();
+	return cached_conn;
+}
 
-	row->nfields = nfields;
+/*
+ * Sends query. Second execution of same query prepares the query,
+ * and following executions use prepared statement. The query with
+ * more statements cannot be prepared, then PQsendQuery is used every
+ * time. When binary format is wanted, then the query is prepared
+ * immediately, because the types of result should be known before.
+ */
+static int
+send_query(PGconn *conn, char *query, bool binary)
+{
+	PGresult   *result;
 
-	multiline_row = false;
-	n = 0;
-	for (i = 0; i < nfields; i++)
+	if (!last_query || strcmp(last_query, query) != 0)
 	{
-		char   *name = PQfname(result, i);
+		if (last_query_is_prepared)
+			PQclear(PQexec(conn, "DEALLOCATE " PSPG_STMT_NAME));
 
-		if (hidden[i])
-			continue;
+		forget_last_query();
+		last_query = sstrdup(query);
 
-		strcpy(locbuf, name);
-		row->fields[n] = locbuf;
-		locbuf += strlen(name) + 1;
+		if (!binary)
+			return PQsendQuery(conn, query);
+	}
 
-		pdesc->widths[n] = field_info(row->fields[n], &multiline_col);
-		pdesc->multilines[n++] = multiline_col;
+	if (!last_query_is_prepared && !last_query_cannot_be_prepared)
+	{
+		result = PQprepare(conn, PSPG_STMT_NAME, query, 0, NULL);
 
-		multiline_row |= multiline_col;
+		if (PQresultStatus(result) == PGRES_COMMAND_OK)
+		{
+			log_row("query is prepared");
+			last_query_is_prepared = true;
+
+			if (binary)
+				last_query_binary = is_binary_result_possible(conn);
+		}
+		else
+			last_query_cannot_be_prepared = true;
+
+		PQclear(result);
 	}
 
-	rb = push_row(rb, row, multiline_row);
-	if (!rb)
-		EXIT_OUT_OF_MEMORY();
+	if (last_query_is_prepared)
+		return PQsendQueryPrepared(conn, PSPG_STMT_NAME, 0, NULL, NULL, NULL,
+								   last_query_binary ? 1 : 0);
+
+	return PQsendQuery(conn, query);
+}
+
+static RowBucketType *
+push_row(RowBucketType *rb, RowType *row, bool is_multiline)
+{
+	if (rb->nrows >= 1000)
+	{
+		RowBucketType *new = malloc(sizeof(RowBucketType));
+
+		if (!new)
+			return NULL;
+
+		new->nrows = 0;
+		new->allocated = true;
+		new->next_bucket = NULL;
+
+		rb->next_bucket = new;
+		rb = new;
+	}
+
+	rb->rows[rb->nrows] = row;
+	rb->multilines[rb->nrows++] = is_multiline;
+
+	return rb;
+}
+
+static char
+column_type_class(Oid ftype)
+{
+	char		align;
+
+	switch (ftype)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+		case OIDOID:
+		case XIDOID:
+		case CIDOID:
+		case CASHOID:
+			align = 'd';
+			break;
+		default:
+			align = 'a';
+			break;
+	}
+	return align;
+}
+
+/*
+ * Returns true, when the column has native numeric value
+ */
+static bool
+is_typed_column_type(Oid ftype)
+{
+	switch (ftype)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+		case OIDOID:
+		case XIDOID:
+		case CIDOID:
+		case DATEOID:
+		case TIMESTAMPOID:
+			return true;
+		default:
+			return false;
+	}
+}
+
+static uint32_t
+read_uint32(const char *ptr)
+{
+	return ((uint32_t) read_uint16(ptr) << 16) | read_uint16(ptr + 2);
+}
+
+static uint64_t
+read_uint64(const char *ptr)
+{
+	return ((uint64_t) read_uint32(ptr) << 32) | read_uint32(ptr + 4);
+}
+
+/*
+ * Transforms value received in binary format to text. Returns true,
+ * when the value has numeric representation too.
+ */
+static bool
+binary_to_text(Oid ftype, const char *value, int len, char **str, double *d)
+{
+	char		buf[64];
+
+	switch (ftype)
+	{
+		case INT2OID:
+			*d = (int16_t) read_uint16(value);
+			snprintf(buf, sizeof(buf), "%d", (int16_t) read_uint16(value));
+			break;
+
+		case INT4OID:
+			*d = (int32_t) read_uint32(value);
+			snprintf(buf, sizeof(buf), "%d", (int32_t) read_uint32(value));
+			break;
+
+		case INT8OID:
+			*d = (double) (int64_t) read_uint64(value);
+			snprintf(buf, sizeof(buf), "%lld", (long long) (int64_t) read_uint64(value));
+			break;
+
+		case OIDOID:
+		case XIDOID:
+		case CIDOID:
+			*d = read_uint32(value);
+			snprintf(buf, sizeof(buf), "%u", read_uint32(value));
+			break;
+
+		case FLOAT4OID:
+			{
+				uint32_t	bits = read_uint32(value);
+				float		f;
+
+				memcpy(&f, &bits, sizeof(f));
+				*d = f;
+				pg_format_float(buf, sizeof(buf), f, true);
+			}
+			break;
+
+		case FLOAT8OID:
+			{
+				uint64_t	bits = read_uint64(value);
+
+				memcpy(d, &bits, sizeof(double));
+				pg_format_float(buf, sizeof(buf), *d, false);
+			}
+			break;
+
+		case NUMERICOID:
+			*str = pg_numeric_to_text(value);
+			*d = strtod(*str, NULL);
+			return true;
+
+		case BOOLOID:
+			snprintf(buf, sizeof(buf), "%s", *value ? "t" : "f");
+			*str = sstrdup(buf);
+			return false;
+
+		case DATEOID:
+			{
+				int32_t		days = (int32_t) read_uint32(value);
+
+				if (days == INT32_MAX || days == INT32_MIN)
+					snprintf(buf, sizeof(buf), "%s", days == INT32_MAX ? "infinity" : "-infinity");
+				else
+					(void) pg_format_date(buf, sizeof(buf), POSTGRES_EPOCH_UNIX + (int64_t) days * 86400);
+
+				*d = days == INT32_MAX ? HUGE_VAL : (days == INT32_MIN ? -HUGE_VAL : days);
+			}
+			break;
+
+		case TIMESTAMPOID:
+			{
+				int64_t		ts = (int64_t) read_uint64(value);
+
+				if (ts == INT64_MAX || ts == INT64_MIN)
+					snprintf(buf, sizeof(buf), "%s", ts == INT64_MAX ? "infinity" : "-infinity");
+				else
+					pg_format_timestamp(buf, sizeof(buf), ts);
+
+				*d = ts == INT64_MAX ? HUGE_VAL : (ts == INT64_MIN ? -HUGE_VAL : ts / 1000000.0);
+			}
+			break;
+
+		default:
+			/* text types */
+			*str = smalloc(len + 1);
+			memcpy(*str, value, len);
+			return false;
+	}
+
+	*str = sstrdup(buf);
+
+	return true;
+}
+
+
+#endif
+
+#define EXIT_OUT_OF_MEMORY()		do { PQclear(result); pg_close_connection(); leave("out of memory"); } while (0)
+#define RELEASE_AND_EXIT(s)			do { PQclear(result); pg_close_connection(); leave(s); } while (0)
+
+#ifdef HAVE_POSTGRESQL
+
+static int
+field_info(char *str, bool *multiline)
+{
+	long int	digits;
+	long int	others;
+
+	if (!use_utf8)
+	{
+		int		cw = 0;
+		int		width = 0;
+
+		while (*str)
+		{
+			if (*str++ == '\n')
+			{
+				*multiline = true;
+				width = cw > width ? cw : width;
+				cw = 0;
+			}
+			else
+				cw++;
+		}
+
+		return cw > width ? cw : width;
+	}
+	else
+		return utf_string_dsplen_multiline(str, strlen(str), multiline, false, &digits, &others, 0);
+}
+
+/*
+ * Returns number of visible columns
+ */
+static int
+mark_hidden_columns(PGresult *result,
+					int nfields,
+					Options *opts,
+					bool *hidden)
+{
+	int		i;
+	int		visible_columns = 0;
+
+	for (i = 0; i < nfields; i++)
+	{
+		hidden[i] = is_hidden_column(opts, PQfname(result, i), i + 1);
+
+		if (!hidden[i])
+			visible_columns += 1;
+	}
+
+	return visible_columns;
+}
+
+/*
+ * State of asynchronous query. The received rows (in single row mode)
+ * are transformed to row buckets immediately, so the result is not
+ * stored twice, and the number of received rows can be displayed.
+ */
+typedef struct
+{
+	bool		is_running;
+	bool		is_finished;
+	char	   *query;
+	Options	   *opts;
+	RowBucketType *rb;					/* first bucket */
+	RowBucketType *current_rb;			/* bucket for next row */
+	PrintDataDesc *pdesc;
+	ColumnStats *colstats;
+	bool		hidden[1024];
+	bool		binary;					/* result is in binary format */
+	bool		typed[1024];			/* visible column has numeric value */
+	TypedColumn *typed_columns;
+	int			nfields;				/* number of fields of result */
+	bool		header_is_processed;
+	bool		result_is_completed;	/* result of some statement is completed */
+	long		rows;
+	time_t		start_sec;
+	long		start_ms;
+	const char *errstr;
+} AsyncQueryState;
+
+static AsyncQueryState aq;
+
+static void
+free_rowbuckets(RowBucketType *rb)
+{
+	while (rb)
+	{
+		RowBucketType *nextrb = rb->next_bucket;
+		int			i;
+
+		for (i = 0; i < rb->nrows; i++)
+		{
+			RowType	   *r = rb->rows[i];
+
+			/* only first field holds allocated string */
+			if (r->nfields > 0)
+				free(r->fields[0]);
+			free(r);
+		}
+
+		free(rb);
+		rb = nextrb;
+	}
+}
+
+static RowBucketType *
+new_rowbucket(void)
+{
+	RowBucketType *rb = smalloc(sizeof(RowBucketType));
+
+	rb->allocated = true;
+
+	return rb;
+}
+
+/*
+ * Release rows received by previous statement of multi statement query
+ */
+static void
+reset_received_rows(void)
+{
+	colstats_free(aq.colstats, aq.pdesc->nfields);
+	aq.colstats = NULL;
+
+	typed_columns_free(aq.typed_columns, aq.pdesc->nfields);
+	aq.typed_columns = NULL;
+
+	free_rowbuckets(aq.rb);
+	aq.rb = aq.current_rb = new_rowbucket();
+
+	memset(aq.pdesc, 0, sizeof(PrintDataDesc));
+
+	aq.header_is_processed = false;
+	aq.result_is_completed = false;
+	aq.rows = 0;
+}
+
+static void
+reset_async_query(void)
+{
+	if (aq.is_running)
+	{
+		PGresult   *result;
+
+		pg_cancel_query();
+
+		while ((result = PQgetResult(cached_conn)) != NULL)
+			PQclear(result);
+	}
+
+	if (aq.pdesc)
+	{
+		colstats_free(aq.colstats, aq.pdesc->nfields);
+		typed_columns_free(aq.typed_columns, aq.pdesc->nfields);
+	}
+
+	free_rowbuckets(aq.rb);
+	free(aq.pdesc);
+	free(aq.query);
+
+	memset(&aq, 0, sizeof(AsyncQueryState));
+}
+
+static void
+process_header(PGresult *result)
+{
+	PrintDataDesc *pdesc = aq.pdesc;
+	RowType	   *row;
+	char	   *locbuf;
+	bool		multiline_row;
+	bool		multiline_col;
+	int			size;
+	int			i;
+	int			n;
+
+	if ((aq.nfields = PQnfields(result)) > 1024)
+		RELEASE_AND_EXIT("too much columns");
+
+	pdesc->nfields = mark_hidden_columns(result, aq.nfields, aq.opts, aq.hidden);
+
+	if (pdesc->nfields == 0)
+		RELEASE_AND_EXIT("no column is selected");
+
+	aq.colstats = colstats_realloc(NULL, 0, pdesc->nfields);
+
+	pdesc->has_header = true;
+	n = 0;
+	for (i = 0; i < aq.nfields; i++)
+		if (!aq.hidden[i])
+		{
+			aq.typed[n] = aq.binary && is_typed_column_type(PQftype(result, i));
+			pdesc->types[n++] = column_type_class(PQftype(result, i));
+		}
+
+	if (aq.binary)
+		aq.typed_columns = smalloc(pdesc->nfields * sizeof(TypedColumn));
+
+	/* calculate necessary size of header data */
+	size = 0;
+	for (i = 0; i < aq.nfields; i++)
+		if (!aq.hidden[i])
+			size += strlen(PQfname(result, i)) + 1;
+
+	locbuf = malloc(size);
+	if (!locbuf)
+		EXIT_OUT_OF_MEMORY();
+
+	/* store header */
+	row = malloc(offsetof(RowType, fields) + (pdesc->nfields * sizeof(char *)));
+	if (!row)
+		EXIT_OUT_OF_MEMORY();
+
+	row->nfields = pdesc->nfields;
+
+	multiline_row = false;
+	n = 0;
+	for (i = 0; i < aq.nfields; i++)
+	{
+		char   *name = PQfname(result, i);
+
+		if (aq.hidden[i])
+			continue;
+
+		strcpy(locbuf, name);
+		row->fields[n] = locbuf;
+		locbuf += strlen(name) + 1;
+
+		pdesc->widths[n] = field_info(row->fields[n], &multiline_col);
+		pdesc->multilines[n] = multiline_col;
+		pdesc->columns_map[n] = n;
+		n += 1;
+
+		multiline_row |= multiline_col;
+	}
+
+	aq.current_rb = push_row(aq.current_rb, row, multiline_row);
+	if (!aq.current_rb)
+		EXIT_OUT_OF_MEMORY();
+
+	aq.header_is_processed = true;
+}
+
+static void
+process_rows(PGresult *result)
+{
+	PrintDataDesc *pdesc = aq.pdesc;
+	RowType	   *row;
+	char	   *locbuf;
+	char	   *values[1024];
+	double		numbers[1024];
+	bool		is_number[1024];
+	bool		multiline_row;
+	bool		multiline_col;
+	int			size;
+	int			i, j;
+	int			n;
 
 	/* calculate size for any row and store it */
 	for (i = 0; i < PQntuples(result); i++)
 	{
-		size = 0;
-		for (j = 0; j < nfields; j++)
-			if (!hidden[j])
-				size += strlen(PQgetvalue(result, i, j)) + 1;
+		size = 0;
+		for (j = 0; j < aq.nfields; j++)
+		{
+			if (aq.hidden[j])
+				continue;
+
+			/* values in binary format are transformed to text first */
+			if (aq.binary)
+			{
+				is_number[j] = false;
+
+				if (PQgetisnull(result, i, j))
+					values[j] = sstrdup("");
+				else
+					is_number[j] = binary_to_text(PQftype(result, j),
+												  PQgetvalue(result, i, j),
+												  PQgetlength(result, i, j),
+												  &values[j], &numbers[j]);
+			}
+			else
+				values[j] = PQgetvalue(result, i, j);
+
+			size += strlen(values[j]) + 1;
+		}
+
+		locbuf = malloc(size);
+		if (!locbuf)
+			EXIT_OUT_OF_MEMORY();
+
+		/* store data */
+		row = malloc(offsetof(RowType, fields) + (pdesc->nfields * sizeof(char *)));
+		if (!row)
+			EXIT_OUT_OF_MEMORY();
+
+		row->nfields = pdesc->nfields;
+
+		multiline_row = false;
+		n = 0;
+		for (j = 0; j < aq.nfields; j++)
+		{
+			char	*value;
+
+			if (aq.hidden[j])
+				continue;
+
+			value = values[j];
+
+			strcpy(locbuf, value);
+			row->fields[n] = locbuf;
+			locbuf += strlen(value) + 1;
+
+			pdesc->widths[n] = max_int(pdesc->widths[n],
+									  field_info(row->fields[n], &multiline_col));
+			pdesc->multilines[n] |= multiline_col;
+			multiline_row |= multiline_col;
+
+			if (aq.binary)
+			{
+				bool	isnull = PQgetisnull(result, i, j);
+
+				if (aq.typed[n])
+					typed_column_add(&aq.typed_columns[n], isnull ? 0.0 : numbers[j], isnull);
+
+				/* dates are numbers only for sorting */
+				if (is_number[j] && pdesc->types[n] == 'd' && isfinite(numbers[j]))
+					colstats_add_number(&aq.colstats[n], value, numbers[j]);
+				else
+					colstats_add_value(&aq.colstats[n], value, isnull);
+
+				free(value);
+			}
+			else
+				colstats_add_value(&aq.colstats[n], value, PQgetisnull(result, i, j));
+
+			n += 1;
+		}
+
+		aq.current_rb = push_row(aq.current_rb, row, multiline_row);
+		if (!aq.current_rb)
+			EXIT_OUT_OF_MEMORY();
+
+		aq.rows += 1;
+	}
+}
+
+/*
+ * Start asynchronous execution of query. The errors are stored
+ * and returned by pg_exec_query.
+ */
+void
+pg_send_query(Options *opts, char *query)
+{
+	PGconn	   *conn;
+
+	log_row("send query \"%s\"", query);
+
+	reset_async_query();
+
+	aq.query = sstrdup(query);
+	aq.opts = opts;
+	aq.rb = aq.current_rb = new_rowbucket();
+	aq.pdesc = smalloc(sizeof(PrintDataDesc));
+
+	current_time(&aq.start_sec, &aq.start_ms);
+
+	conn = get_connection(opts);
+
+	/* Check to see that the backend connection was successfully made */
+	if (PQstatus(conn) != CONNECTION_OK)
+	{
+		snprintf(errmsg, sizeof(errmsg),
+		    "Connection to database failed: %s", PQerrorMessage(conn));
+
+		pg_close_connection();
+
+		aq.errstr = errmsg;
+		aq.is_finished = true;
+		return;
+	}
+
+	if (!send_query(conn, query, opts->binary_results))
+	{
+		snprintf(errmsg, sizeof(errmsg),
+		    "Query cannot be sent: %s", PQerrorMessage(conn));
+
+		aq.errstr = errmsg;
+		aq.is_finished = true;
+		return;
+	}
+
+	if (!PQsetSingleRowMode(conn))
+		log_row("single row mode is not available");
+
+	aq.binary = last_query_is_prepared && last_query_binary;
+	aq.is_running = true;
+}
+
+/*
+ * Reads received data. Returns true, when query is finished.
+ */
+bool
+pg_consume_query(void)
+{
+	if (!aq.is_running)
+		return aq.is_finished;
+
+	if (!PQconsumeInput(cached_conn))
+	{
+		snprintf(errmsg, sizeof(errmsg),
+		    "Query doesn't return data: %s", PQerrorMessage(cached_conn));
+
+		aq.errstr = errmsg;
+		aq.is_running = false;
+		aq.is_finished = true;
+
+		return true;
+	}
+
+	while (!PQisBusy(cached_conn))
+	{
+		PGresult   *result = PQgetResult(cached_conn);
+		ExecStatusType status;
+
+		if (!result)
+		{
+			if (!aq.errstr && !aq.header_is_processed)
+			{
+				snprintf(errmsg, sizeof(errmsg), "Query doesn't return data");
+				aq.errstr = errmsg;
+			}
+
+			log_row("query is finished (%ld rows)", aq.rows);
+
+			aq.is_running = false;
+			aq.is_finished = true;
+			break;
+		}
+
+		status = PQresultStatus(result);
+
+		if (status == PGRES_SINGLE_TUPLE || status == PGRES_TUPLES_OK)
+		{
+			/* only result of last statement is displayed */
+			if (aq.result_is_completed)
+				reset_received_rows();
+
+			if (!aq.header_is_processed)
+				process_header(result);
+
+			process_rows(result);
+
+			if (status == PGRES_TUPLES_OK)
+				aq.result_is_completed = true;
+		}
+		else if (status != PGRES_COMMAND_OK && !aq.errstr)
+		{
+			snprintf(errmsg, sizeof(errmsg),
+			    "Query doesn't return data: %s", PQresultErrorMessage(result));
+
+			aq.errstr = errmsg;
+		}
+
+		PQclear(result);
+	}
+
+	return aq.is_finished;
+}
+
+/*
+ * Returns socket of connection with running query or -1
+ */
+int
+pg_query_socket(void)
+{
+	return aq.is_running ? PQsocket(cached_conn) : -1;
+}
+
+bool
+pg_query_is_running(void)
+{
+	return aq.is_running;
+}
+
+/*
+ * Returns true, when the result of query is ready
+ */
+bool
+pg_query_is_finished(const char *query)
+{
+	return aq.is_finished && strcmp(aq.query, query) == 0;
+}
+
+/*
+ * Returns false, when there is not running query
+ */
+bool
+pg_query_progress(long *elapsed_ms, long *rows)
+{
+	time_t		sec;
+	long		ms;
+
+	if (!aq.is_running)
+		return false;
+
+	current_time(&sec, &ms);
+
+	*elapsed_ms = time_diff(sec, ms, aq.start_sec, aq.start_ms);
+	*rows = aq.rows;
+
+	return true;
+}
+
+void
+pg_cancel_query(void)
+{
+	PGcancel   *cancel;
+	char		errbuf[256];
+
+	if (!aq.is_running)
+		return;
+
+	cancel = PQgetCancel(cached_conn);
+	if (cancel)
+	{
+		if (!PQcancel(cancel, errbuf, sizeof(errbuf)))
+			log_row("cannot to cancel query: %s", errbuf);
+		else
+			log_row("cancel request was sent");
+
+		PQfreeCancel(cancel);
+	}
+}
+
+/*
+ * Wait until query is finished. The query can be canceled by sigint.
+ */
+static void
+wait_on_query(void)
+{
+	while (aq.is_running)
+	{
+		struct pollfd pfd;
 
-		locbuf = malloc(size);
-		if (!locbuf)
-			EXIT_OUT_OF_MEMORY();
+		pfd.fd = PQsocket(cached_conn);
+		pfd.events = POLLIN;
 
-		/* store data */
-		row = malloc(offsetof(RowType, fields) + (pdesc->nfields * sizeof(char *)));
-		if (!row)
-			EXIT_OUT_OF_MEMORY();
+		if (poll(&pfd, 1, 100) == -1 && errno != EINTR)
+			log_row("poll error (%s)", strerror(errno));
 
-		row->nfields = pdesc->nfields;
+		if (handle_sigint)
+		{
+			handle_sigint = false;
+			pg_cancel_query();
+		}
 
-		multiline_row = false;
-		n = 0;
-		for (j = 0; j < nfields; j++)
+		(void) pg_consume_query();
+	}
+}
+
+/*
+ * Results of queries from query stream are cached. The results received
+ * by pipeline are used when the query is displayed. The results of read
+ * only queries are used again when the same query is displayed again.
+ */
+typedef struct
+{
+	char	   *query;
+	bool		is_prefetched;			/* result was not displayed yet */
+	long		last_usage;
+	RowBucketType *rb;
+	PrintDataDesc pdesc;
+	ColumnStats *colstats;
+	TypedColumn *typed_columns;
+} CachedResult;
+
+static CachedResult query_cache[QUERY_CACHE_SIZE];
+static long query_cache_usage = 0;
+
+/*
+ * Returns true, when the query surely doesn't change data. The query
+ * with more statements is not checked, and it is not read only.
+ */
+static bool
+is_read_only_query(const char *query)
+{
+	static const char *read_only_commands[] = {"select", "values", "table", "show", NULL};
+	const char *semicolon = strchr(query, ';');
+	int			i;
+
+	if (semicolon && semicolon[strspn(semicolon, "; \t\n\r")] != '\0')
+		return false;
+
+	while (*query == ' ' || *query == '\n' || *query == '\t' || *query == '(')
+		query++;
+
+	for (i = 0; read_only_commands[i]; i++)
+	{
+		size_t		len = strlen(read_only_commands[i]);
+
+		if (strncasecmp(query, read_only_commands[i], len) == 0 &&
+			!isalnum((unsigned char) query[len]) && query[len] != '_')
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Only the result of query, that surely doesn't change data, can be
+ * used more times.
+ */
+static bool
+is_cacheable_query(Options *opts, const char *query)
+{
+	/* in watch mode we want fresh data every time */
+	if (opts->watch_time > 0)
+		return false;
+
+	return is_read_only_query(query);
+}
+
+static void
+cached_result_free(CachedResult *cr)
+{
+	free(cr->query);
+	free_rowbuckets(cr->rb);
+	colstats_free(cr->colstats, cr->pdesc.nfields);
+	typed_columns_free(cr->typed_columns, cr->pdesc.nfields);
+
+	memset(cr, 0, sizeof(CachedResult));
+}
+
+static CachedResult *
+cached_result_find(const char *query)
+{
+	int			i;
+
+	for (i = 0; i < QUERY_CACHE_SIZE; i++)
+		if (query_cache[i].query && strcmp(query_cache[i].query, query) == 0)
+			return &query_cache[i];
+
+	return NULL;
+}
+
+/*
+ * Moves the result of finished asynchronous query to cache. The least
+ * recently used entry is replaced when the cache is full.
+ */
+static void
+cached_result_store(bool is_prefetched)
+{
+	CachedResult *cr;
+	int			i;
+
+	cr = cached_result_find(aq.query);
+	if (!cr)
+	{
+		cr = &query_cache[0];
+
+		for (i = 1; i < QUERY_CACHE_SIZE && cr->query; i++)
+			if (!query_cache[i].query || query_cache[i].last_usage < cr->last_usage)
+				cr = &query_cache[i];
+	}
+
+	cached_result_free(cr);
+
+	cr->query = aq.query;
+	cr->is_prefetched = is_prefetched;
+	cr->last_usage = ++query_cache_usage;
+	cr->rb = aq.rb;
+	memcpy(&cr->pdesc, aq.pdesc, sizeof(PrintDataDesc));
+	cr->colstats = aq.colstats;
+	cr->typed_columns = aq.typed_columns;
+
+	aq.query = NULL;
+	aq.rb = NULL;
+	aq.colstats = NULL;
+	aq.typed_columns = NULL;
+}
+
+static RowBucketType *
+copy_rowbuckets(RowBucketType *rb)
+{
+	RowBucketType *result = new_rowbucket();
+	RowBucketType *current_rb = result;
+
+	while (rb)
+	{
+		int			i;
+
+		for (i = 0; i < rb->nrows; i++)
 		{
-			char	*value;
+			RowType	   *r = rb->rows[i];
+			RowType	   *newr;
+			size_t		size;
+			int			j;
 
-			if (hidden[j])
-				continue;
+			newr = smalloc(offsetof(RowType, fields) + (r->nfields * sizeof(char *)));
+			newr->nfields = r->nfields;
 
-			value = PQgetvalue(result, i, j);
+			/* all fields are stored in one block starting by first field */
+			if (r->nfields > 0)
+			{
+				char	   *last = r->fields[r->nfields - 1];
 
-			strcpy(locbuf, value);
-			row->fields[n] = locbuf;
-			locbuf += strlen(value) + 1;
+				size = last + strlen(last) + 1 - r->fields[0];
+				newr->fields[0] = smalloc(size);
+				memcpy(newr->fields[0], r->fields[0], size);
 
-			pdesc->widths[n] = max_int(pdesc->widths[n],
-									  field_info(row->fields[n], &multiline_col));
-			pdesc->multilines[n] |= multiline_col;
-			multiline_row |= multiline_col;
+				for (j = 1; j < r->nfields; j++)
+					newr->fields[j] = newr->fields[0] + (r->fields[j] - r->fields[0]);
+			}
 
-			pdesc->columns_map[n] = n;
-			n += 1;
+			current_rb = push_row(current_rb, newr, rb->multilines[i]);
+			if (!current_rb)
+				leave("out of memory");
 		}
 
-		rb = push_row(rb, row, multiline_row);
-		if (!rb)
-			EXIT_OUT_OF_MEMORY();
+		rb = rb->next_bucket;
 	}
 
-	free(hidden);
+	return result;
+}
 
-	PQclear(result);
-	PQfinish(conn);
+static TypedColumn *
+copy_typed_columns(TypedColumn *typed_columns, int n)
+{
+	TypedColumn *result;
+	int			i;
+
+	if (!typed_columns)
+		return NULL;
+
+	result = smalloc(n * sizeof(TypedColumn));
+
+	for (i = 0; i < n; i++)
+	{
+		TypedColumn *tc = &typed_columns[i];
+
+		if (tc->nvalues == 0)
+			continue;
+
+		result[i].nvalues = result[i].size = tc->nvalues;
+		result[i].values = smalloc(tc->nvalues * sizeof(double));
+		result[i].isnull = smalloc(tc->nvalues * sizeof(bool));
+		memcpy(result[i].values, tc->values, tc->nvalues * sizeof(double));
+		memcpy(result[i].isnull, tc->isnull, tc->nvalues * sizeof(bool));
+	}
+
+	return result;
+}
+
+/*
+ * Returns cached result of query. The result stays in cache when
+ * the query can be displayed again without execution, else the cache
+ * entry is released. Column statistics of copied result are calculated
+ * later from displayed data.
+ */
+static bool
+cached_result_get(Options *opts, const char *query,
+				  RowBucketType *rb, PrintDataDesc *pdesc,
+				  ColumnStats **colstats, TypedColumn **typed_columns)
+{
+	CachedResult *cr = cached_result_find(query);
+	RowBucketType *result_rb;
+
+	if (!cr)
+		return false;
+
+	if (!cr->is_prefetched && !is_cacheable_query(opts, query))
+	{
+		cached_result_free(cr);
+		return false;
+	}
+
+	memcpy(pdesc, &cr->pdesc, sizeof(PrintDataDesc));
+
+	if (is_cacheable_query(opts, query))
+	{
+		log_row("use cached result of query \"%s\"", query);
+
+		result_rb = copy_rowbuckets(cr->rb);
+		*colstats = NULL;
+		*typed_columns = copy_typed_columns(cr->typed_columns, cr->pdesc.nfields);
+
+		cr->is_prefetched = false;
+		cr->last_usage = ++query_cache_usage;
+	}
+	else
+	{
+		log_row("use prefetched result of query \"%s\"", query);
+
+		result_rb = cr->rb;
+		*colstats = cr->colstats;
+		*typed_columns = cr->typed_columns;
+
+		cr->rb = NULL;
+		cr->colstats = NULL;
+		cr->typed_columns = NULL;
+		cached_result_free(cr);
+	}
+
+	/* first bucket is not allocated by caller */
+	memcpy(rb, result_rb, sizeof(RowBucketType));
+	rb->allocated = false;
+	free(result_rb);
+
+	return true;
+}
+
+/*
+ * Sends queries in pipeline mode over one connection, and stores
+ * results to cache. Every query has own sync point, so an error
+ * doesn't break following queries. The queries with an error are
+ * not cached, and they are executed again (and the error is
+ * displayed) when they should be displayed. Only read only queries
+ * can be executed twice, so the pipeline is stopped before first
+ * query that can change data (following queries can depend on
+ * its result).
+ */
+void
+pg_pipeline_queries(Options *opts, char **queries, int nqueries)
+{
+
+#ifdef LIBPQ_HAS_PIPELINING
+
+	PGconn	   *conn;
+	char	   *sent[QUERY_CACHE_SIZE];
+	int			nsent = 0;
+	int			i;
+
+	if (nqueries > QUERY_CACHE_SIZE)
+		nqueries = QUERY_CACHE_SIZE;
+
+	reset_async_query();
+
+	conn = get_connection(opts);
+	if (PQstatus(conn) != CONNECTION_OK)
+		return;
+
+	if (!PQenterPipelineMode(conn))
+	{
+		log_row("cannot to enter pipeline mode: %s", PQerrorMessage(conn));
+		return;
+	}
+
+	for (i = 0; i < nqueries; i++)
+	{
+		if (!is_cacheable_query(opts, queries[i]))
+			break;
+
+		if (cached_result_find(queries[i]))
+			continue;
+
+		if (!PQsendQueryParams(conn, queries[i], 0, NULL, NULL, NULL, NULL, 0) ||
+			!PQpipelineSync(conn))
+		{
+			log_row("cannot to send query to pipeline: %s", PQerrorMessage(conn));
+			break;
+		}
+
+		sent[nsent++] = queries[i];
+	}
+
+	log_row("pipeline of %d queries was sent", nsent);
+
+	for (i = 0; i < nsent; i++)
+	{
+		PGresult   *result;
+
+		aq.query = sstrdup(sent[i]);
+		aq.opts = opts;
+		aq.rb = aq.current_rb = new_rowbucket();
+		aq.pdesc = smalloc(sizeof(PrintDataDesc));
+
+		/* results of query are finished by NULL, then sync result follows */
+		while ((result = PQgetResult(conn)) != NULL)
+		{
+			ExecStatusType status = PQresultStatus(result);
+
+			if (status == PGRES_TUPLES_OK)
+			{
+				process_header(result);
+				process_rows(result);
+			}
+			else if (status != PGRES_COMMAND_OK)
+				aq.errstr = errmsg;
+
+			PQclear(result);
+		}
+
+		result = PQgetResult(conn);
+		if (PQresultStatus(result) != PGRES_PIPELINE_SYNC)
+			log_row("unexpected result status in pipeline");
+		PQclear(result);
+
+		if (!aq.errstr && aq.header_is_processed)
+			cached_result_store(true);
+
+		reset_async_query();
+	}
+
+	if (!PQexitPipelineMode(conn))
+		log_row("cannot to exit pipeline mode: %s", PQerrorMessage(conn));
+
+#else
+
+	(void) opts;
+	(void) queries;
+	(void) nqueries;
+
+#endif
+
+}
+
+#else
+
+void
+pg_send_query(Options *opts, char *query)
+{
+	(void) opts;
+	(void) query;
+}
+
+bool
+pg_consume_query(void)
+{
+	return true;
+}
+
+int
+pg_query_socket(void)
+{
+	return -1;
+}
+
+bool
+pg_query_is_running(void)
+{
+	return false;
+}
+
+/*
+ * Without libpq the error is returned by pg_exec_query immediately
+ */
+bool
+pg_query_is_finished(const char *query)
+{
+	(void) query;
+
+	return true;
+}
+
+bool
+pg_query_progress(long *elapsed_ms, long *rows)
+{
+	(void) elapsed_ms;
+	(void) rows;
+
+	return false;
+}
+
+void
+pg_cancel_query(void)
+{
+}
+
+void
+pg_pipeline_queries(Options *opts, char **queries, int nqueries)
+{
+	(void) opts;
+	(void) queries;
+	(void) nqueries;
+}
+
+#endif
+
+/*
+ * exit on fatal error, or return error. When the result of same query
+ * was received asynchronously already, then this result is used.
+ */
+bool
+pg_exec_query(Options *opts, char *query, RowBucketType *rb, PrintDataDesc *pdesc,
+			  ColumnStats **colstats, TypedColumn **typed_columns, const char **err)
+{
+
+	log_row("execute query \"%s\"", query);
+
+#ifdef HAVE_POSTGRESQL
+
+	if (opts->querystream &&
+		cached_result_get(opts, query, rb, pdesc, colstats, typed_columns))
+	{
+		*err = NULL;
+		return true;
+	}
+
+	if (!pg_query_is_finished(query))
+	{
+		pg_send_query(opts, query);
+		wait_on_query();
+
+		/*
+		 * Connection can be broken after server restart, try to reconnect.
+		 * We don't know if the query was executed or not, so only query,
+		 * that doesn't change data, can be executed again.
+		 */
+		if (aq.errstr && cached_conn && PQstatus(cached_conn) == CONNECTION_BAD &&
+			is_read_only_query(query))
+		{
+			pg_send_query(opts, query);
+			wait_on_query();
+		}
+	}
+
+	if (aq.errstr)
+	{
+		*err = aq.errstr;
+		reset_async_query();
+
+		return false;
+	}
+
+	/* result is returned from cache, when it can be displayed later again */
+	if (opts->querystream && is_cacheable_query(opts, query))
+	{
+		cached_result_store(false);
+		reset_async_query();
+
+		(void) cached_result_get(opts, query, rb, pdesc, colstats, typed_columns);
+
+		*err = NULL;
+		return true;
+	}
+
+	/* first bucket is not allocated by caller */
+	memcpy(rb, aq.rb, sizeof(RowBucketType));
+	rb->allocated = false;
+	free(aq.rb);
+	aq.rb = NULL;
+
+	memcpy(pdesc, aq.pdesc, sizeof(PrintDataDesc));
+
+	*colstats = aq.colstats;
+	aq.colstats = NULL;
+
+	*typed_columns = aq.typed_columns;
+	aq.typed_columns = NULL;
+
+	reset_async_query();
 
 	*err = NULL;
 
@@ -406,6 +1749,8 @@ pg_exec_query(Options *opts, char *query, RowBucketType *rb, PrintDataDesc *pdes
 
 	(void) rb;
 	(void) pdesc;
+	(void) colstats;
+	(void) typed_columns;
 	(void) opts;
 
 	*err = "Query cannot be executed. The Postgres library was not available at compile time.";
@@ -415,3 +1760,24 @@ pg_exec_query(Options *opts, char *query, RowBucketType *rb, PrintDataDesc *pdes
 #endif
 
 }
+
+/*
+ * Close cached connection
+ */
+void
+pg_close_connection(void)
+{
+
+#ifdef HAVE_POSTGRESQL
+
+	if (cached_conn)
+	{
+		PQfinish(cached_conn);
+		cached_conn = NULL;
+	}
+
+	forget_last_query();
+
+#endif
+
+}
@@ -42,7 +42,12 @@ typedef struct
 	int			firstdigit[1024];	/* rows where first char is digit */
 	size_t		widths[1024];			/* column's display width */
 	bool		multilines[1024];		/* true if column has multiline row */
-	bool		hidden[1024];
+	bool		hidden[1024];		/* columns that are not loaded */
+	bool		has_hidden;			/* true, when some column is not loaded */
+	ColumnStats *colstats;			/* statistics of columns */
+	int			ncolstats;			/* number of items of colstats */
+	int			stats_rows;			/* number of rows used for statistics */
+	char	   *nullstr;			/* string used for NULL */
 } LinebufType;
 
 typedef struct
@@ -770,17 +775,14 @@ prepare_pdesc(RowBucketType *rb, LinebufType *linebuf, PrintDataDesc *pdesc, Pri
 	int				i;
 
 	pdesc->nfields_all = linebuf->maxfields;
-	pdesc->nfields = 0;
+	pdesc->nfields = linebuf->maxfields;
 
-	/* copy data from linebuf */
+	/* copy data from linebuf, hidden columns are not loaded */
 	for (i = 0; i < linebuf->maxfields; i++)
 	{
-		if (!linebuf->hidden[i])
-		{
-			pdesc->widths[pdesc->nfields] = linebuf->widths[i];
-			pdesc->multilines[pdesc->nfields] = linebuf->multilines[i];
-			pdesc->columns_map[pdesc->nfields++] = i;
-		}
+		pdesc->widths[i] = linebuf->widths[i];
+		pdesc->multilines[i] = linebuf->multilines[i];
+		pdesc->columns_map[i] = i;
 	}
 
 	if (pconfig->header_mode == 'a')
@@ -802,6 +804,73 @@ prepare_pdesc(RowBucketType *rb, LinebufType *linebuf, PrintDataDesc *pdesc, Pri
 	}
 }
 
+/*
+ * Accumulate statistics of fields
+ */
+static void
+add_row_stats(LinebufType *linebuf, RowType *row)
+{
+	int		i;
+
+	if (row->nfields > linebuf->ncolstats)
+	{
+		linebuf->colstats = colstats_realloc(linebuf->colstats,
+											 linebuf->ncolstats,
+											 row->nfields);
+		linebuf->ncolstats = row->nfields;
+	}
+
+	for (i = 0; i < row->nfields; i++)
+	{
+		char	   *str = row->fields[i];
+
+		if (!str)
+			continue;
+
+		colstats_add_value(&linebuf->colstats[i],
+						   str,
+						   *str == '\0' ||
+						   (linebuf->nullstr && strcmp(str, linebuf->nullstr) == 0));
+	}
+
+	linebuf->stats_rows += 1;
+}
+
+/*
+ * Move statistics of displayed columns to data desc. Missing fields
+ * of short rows are counted as nulls.
+ */
+static void
+prepare_colstats(RowBucketType *rb, LinebufType *linebuf, PrintDataDesc *pdesc, DataDesc *desc)
+{
+	int			i;
+
+	if (!pdesc->has_header && rb->nrows > 0)
+		add_row_stats(linebuf, rb->rows[0]);
+
+	desc->colstats = colstats_realloc(NULL, 0, pdesc->nfields);
+	desc->ncolstats = pdesc->nfields;
+
+	for (i = 0; i < pdesc->nfields; i++)
+	{
+		ColumnStats *cs = &desc->colstats[i];
+		int			fieldno = pdesc->columns_map[i];
+
+		if (fieldno < linebuf->ncolstats)
+		{
+			memcpy(cs, &linebuf->colstats[fieldno], sizeof(ColumnStats));
+			memset(&linebuf->colstats[fieldno], 0, sizeof(ColumnStats));
+		}
+
+		cs->nulls += linebuf->stats_rows - cs->count - cs->nulls;
+		cs->is_valid = true;
+	}
+
+	colstats_free(linebuf->colstats, linebuf->ncolstats);
+	linebuf->colstats = NULL;
+	linebuf->ncolstats = 0;
+}
+
 /*
  * Save append one char to linebuffer
  */
@@ -894,10 +963,6 @@ postprocess_fields(int nfields,
 		long int	total = 0;
 		bool		multiline;
 
-		/* don't calculate width for hidden columns */
-		if (linebuf->hidden[i])
-			continue;
-
 		if (!use_utf8)
 		{
 			size_t		max_width;
@@ -978,6 +1043,13 @@ postprocess_fields(int nfields,
 	if (nfields > linebuf->maxfields)
 		linebuf->maxfields = nfields;
 
+	/*
+	 * First row can be header. It will be added to statistics later,
+	 * when we will know if it is header or not.
+	 */
+	if (!malformed && linebuf->processed > 0)
+		add_row_stats(linebuf, row);
+
 	if (!malformed)
 		linebuf->processed += 1;
 }
@@ -1065,73 +1137,230 @@ postprocess_rows(RowBucketType *rb,
 	}
 }
 
-static bool
+/*
+ * Mark columns that should not be loaded. The names of columns are
+ * taken from first row, when the data can have header row.
+ */
+static void
 mark_hidden_columns(LinebufType *linebuf,
-					RowType *row,
 					int nfields,
+					bool reduced_sizes,			/* the doesn't calculate ending zero */
 					Options *opts)
 {
-	char	   *names;
-	char	   *endnames;
-	char	   *ptr;
 	int		i;
-	bool	result = false;
-
-	/* prepare list of hidden columns */
-	names = sstrdup(opts->csv_skip_columns_like);
 
-	endnames = names + strlen(names);
-	ptr = names;
-	while (*ptr)
+	for (i = 0; i < 1024; i++)
 	{
-		/* space is separator between words */
-		if (*ptr == ' ')
-			*ptr = '\0';
-		ptr += 1;
+		char	   *name = NULL;
+
+		if (i < nfields && opts->csv_header != '-')
+		{
+			int		size = 0;
+
+			if (linebuf->starts[i] != -1)
+				size = linebuf->sizes[i] - (reduced_sizes ? 0 : 1);
+
+			name = smalloc2(size + 1, "prepare list of hidden columns");
+			if (size > 0)
+				memcpy(name, linebuf->buffer + linebuf->starts[i], size);
+			name[size] = '\0';
+		}
+
+		linebuf->hidden[i] = is_hidden_column(opts, name, i + 1);
+		linebuf->has_hidden |= linebuf->hidden[i];
+
+		free(name);
 	}
+}
+
+/*
+ * Remove fields of hidden columns from starts and sizes arrays.
+ * Returns number of remaining fields.
+ */
+static int
+remove_hidden_fields(LinebufType *linebuf, int nfields)
+{
+	int		i;
+	int		n = 0;
 
 	for (i = 0; i < nfields; i++)
 	{
-		ptr = names;
-		while (ptr < endnames)
+		if (!linebuf->hidden[i])
 		{
-			if (*ptr)
-			{
-				size_t		len = strlen(ptr);
+			linebuf->starts[n] = linebuf->starts[i];
+			linebuf->sizes[n++] = linebuf->sizes[i];
+		}
+	}
 
-				if (*ptr == '^')
-				{
-					if (strncmp(row->fields[i], ptr + 1, len - 1) == 0)
-					{
-						linebuf->hidden[i] = true;
-						result = true;
-					}
-				}
-				else if (ptr[len - 1] == '$')
-				{
-					size_t		len2 = strlen(row->fields[i]);
+	return n;
+}
 
-					if (len2 > (len - 1) &&
-						strncmp(row->fields[i] + len2 - len + 1, ptr, len - 1) == 0)
-					{
-						linebuf->hidden[i] = true;
-						result = true;
-					}
-				}
-				else if (strstr(row->fields[i], ptr))
-				{
-					linebuf->hidden[i] = true;
-					result = true;
-				}
+/*
+ * Append row to row buckets
+ */
+static RowBucketType *
+append_row(RowBucketType *rb, RowType *row, bool multiline)
+{
+	rb = prepare_RowBucket(rb);
+
+	rb->multilines[rb->nrows] = multiline;
+	rb->rows[rb->nrows++] = row;
+
+	return rb;
+}
+
+/*
+ * Data row is stored (first rows), or it is stored in ring or
+ * reservoir, or it is released.
+ */
+static RowBucketType *
+capture_row(RowBucketType *rb, RowsCapture *capture, RowType *row, bool multiline)
+{
+	int			pos = capture_record(capture);
+
+	if (pos == CAPTURE_STORE)
+		return append_row(rb, row, multiline);
+
+	if (pos >= 0)
+	{
+		capture->records[pos].row = row;
+		capture->records[pos].multiline = multiline;
+	}
+	else
+	{
+		/* only first field holds allocated string */
+		if (row->nfields > 0)
+			free(row->fields[0]);
+		free(row);
+	}
+
+	return rb;
+}
+
+/*
+ * Store row to row buckets. When only some data rows should be kept
+ * (--max-rows, --tail, --sample), the data rows are captured. The first
+ * row can be header, and then it is stored always. In auto mode the
+ * header is detected when second row is read.
+ */
+static RowBucketType *
+store_row(RowBucketType *rb,
+		  RowsCapture *capture,
+		  char header_mode,
+		  RowType *row,
+		  bool multiline)
+{
+	if (!capture)
+		return append_row(rb, row, multiline);
+
+	if (!capture->started)
+	{
+		if (rb->nrows == 0 && header_mode != '-')
+		{
+			rb = append_row(rb, row, multiline);
+
+			if (header_mode == '+')
+			{
+				capture->started = true;
+				capture->has_header = true;
 			}
 
-			ptr += strlen(ptr) + 1;
+			return rb;
+		}
+
+		capture->started = true;
+
+		if (rb->nrows == 1)
+		{
+			rb->rows[rb->nrows++] = row;
+			capture->has_header = is_header(rb);
+			rb->nrows -= 1;
+
+			/* first row is data row */
+			if (!capture->has_header)
+			{
+				rb->nrows = 0;
+				rb = capture_row(rb, capture, rb->rows[0], rb->multilines[0]);
+			}
 		}
 	}
 
-	free(names);
+	return capture_row(rb, capture, row, multiline);
+}
+
+/*
+ * Store captured rows (in original order), when all data rows was
+ * processed. The statistics of fields are calculated again from
+ * stored rows.
+ */
+static RowBucketType *
+flush_capture(RowBucketType *first_rb,
+			  RowBucketType *rb,
+			  LinebufType *linebuf,
+			  RowsCapture *capture,
+			  bool ignore_short_rows,
+			  Options *opts)
+{
+	int			i;
+
+	sort_captured_records(capture);
+
+	for (i = 0; i < capture->nrecords; i++)
+		rb = append_row(rb, capture->records[i].row, capture->records[i].multiline);
+
+	if (capture->mode != 'm')
+		capture->kept_rows = capture->nrecords;
+
+	free(capture->records);
+	capture->records = NULL;
+	capture->nrecords = 0;
+	capture->allocated = 0;
+
+	capture->closed = true;
 
-	return result;
+	log_row("captured %ld rows from %ld rows", capture->kept_rows, capture->seen_rows);
+
+	memset(linebuf->digits, 0, sizeof(linebuf->digits));
+	memset(linebuf->tsizes, 0, sizeof(linebuf->tsizes));
+	memset(linebuf->firstdigit, 0, sizeof(linebuf->firstdigit));
+	memset(linebuf->widths, 0, sizeof(linebuf->widths));
+	memset(linebuf->multilines, 0, sizeof(linebuf->multilines));
+	linebuf->maxfields = 0;
+	linebuf->processed = 0;
+
+	colstats_free(linebuf->colstats, linebuf->ncolstats);
+	linebuf->colstats = NULL;
+	linebuf->ncolstats = 0;
+	linebuf->stats_rows = 0;
+
+	for (rb = first_rb; rb; rb = rb->next_bucket)
+	{
+		for (i = 0; i < rb->nrows; i++)
+		{
+			RowType	   *row = rb->rows[i];
+			int			j;
+
+			for (j = 0; j < row->nfields; j++)
+				linebuf->sizes[j] = strlen(row->fields[j]);
+
+			postprocess_fields(row->nfields,
+							   row,
+							   linebuf,
+							   ignore_short_rows,
+							   true,
+							   &rb->multilines[i],
+							   opts->csv_trim_width,
+							   opts->csv_trim_rows);
+
+			/* like read routines, count processed row */
+			linebuf->processed += 1;
+		}
+
+		if (!rb->next_bucket)
+			break;
+	}
+
+	return rb;
 }
 
 /*
@@ -1142,8 +1371,10 @@ read_tsv(RowBucketType *rb,
 		 LinebufType *linebuf,
 		 FILE *ifile,
 		 bool ignore_short_rows,
+		 RowsCapture *capture,
 		 Options *opts)
 {
+	RowBucketType *first_rb = rb;
 	bool	closed = false;
 	int		size = 0;
 	int		nfields = 0;
@@ -1227,22 +1458,67 @@ read_tsv(RowBucketType *rb,
 				append_char(linebuf, '\0');
 				linebuf->sizes[nfields++] = size + 1;
 
-				rb = prepare_RowBucket(rb);
+				if (linebuf->processed == 0 &&
+					(opts->csv_skip_columns_like || opts->columns || opts->exclude_columns))
+				{
+					int		start = 0;
+
+					for (i = 0; i < nfields; i++)
+					{
+						linebuf->starts[i] = start;
+						start += linebuf->sizes[i];
+					}
+
+					mark_hidden_columns(linebuf, nfields, false, opts);
+				}
+
+				if (linebuf->has_hidden)
+				{
+					int		start = 0;
+					int		data_size = 0;
+
+					for (i = 0; i < nfields; i++)
+					{
+						linebuf->starts[i] = start;
+						start += linebuf->sizes[i];
+					}
 
-				locbuf = smalloc2(linebuf->used, "import tsv data");
-				memcpy(locbuf, linebuf->buffer, linebuf->used);
+					/* dropped fields are not stored */
+					nfields = remove_hidden_fields(linebuf, nfields);
+					if (nfields == 0)
+						goto next_row;
 
-				row = smalloc2(offsetof(RowType, fields) + (nfields * sizeof(char*)), "import csv data");
-				row->nfields = nfields;
+					for (i = 0; i < nfields; i++)
+						data_size += linebuf->sizes[i];
 
-				for (i = 0; i < nfields; i++)
+					locbuf = smalloc2(data_size, "import tsv data");
+
+					row = smalloc2(offsetof(RowType, fields) + (nfields * sizeof(char*)), "import csv data");
+					row->nfields = nfields;
+
+					for (i = 0; i < nfields; i++)
+					{
+						row->fields[i] = locbuf;
+						memcpy(locbuf, linebuf->buffer + linebuf->starts[i], linebuf->sizes[i]);
+						locbuf += linebuf->sizes[i];
+					}
+				}
+				else
 				{
-					row->fields[i] = locbuf;
-					locbuf += linebuf->sizes[i];
+					locbuf = smalloc2(linebuf->used, "import tsv data");
+					memcpy(locbuf, linebuf->buffer, linebuf->used);
+
+					row = smalloc2(offsetof(RowType, fields) + (nfields * sizeof(char*)), "import csv data");
+					row->nfields = nfields;
+
+					for (i = 0; i < nfields; i++)
+					{
+						row->fields[i] = locbuf;
+						locbuf += linebuf->sizes[i];
+					}
 				}
 
-				if (linebuf->processed == 0 && opts->csv_skip_columns_like)
-					mark_hidden_columns(linebuf, row, nfields, opts);
+				rb = prepare_RowBucket(rb);
 
 				postprocess_fields(nfields,
 								   row,
@@ -1253,9 +1529,9 @@ read_tsv(RowBucketType *rb,
 								   opts->csv_trim_width,
 								   opts->csv_trim_rows);
 
-				rb->multilines[rb->nrows] = multiline;
-				rb->rows[rb->nrows++] = row;
+				rb = store_row(rb, capture, opts->csv_header, row, multiline);
 
+next_row:
 				linebuf->processed += 1;
 			}
 
@@ -1271,6 +1547,9 @@ next_char:
 
 	} while (!closed);
 
+	if (capture)
+		rb = flush_capture(first_rb, rb, linebuf, capture, ignore_short_rows, opts);
+
 	/* append nullstr to missing columns */
 	if (nullstr_size > 0 && !ignore_short_rows)
 		postprocess_rows(rb, linebuf, nullstr);
@@ -1282,8 +1561,10 @@ read_csv(RowBucketType *rb,
 		 char sep,
 		 FILE *ifile,
 		 bool ignore_short_rows,
+		 RowsCapture *capture,
 		 Options *opts)
 {
+	RowBucketType *first_rb = rb;
 	bool	skip_initial = true;
 	bool	closed = false;
 	bool	found_string = false;
@@ -1467,12 +1748,23 @@ read_csv(RowBucketType *rb,
 			if (!linebuf->used)
 				goto next_row;
 
+			if (linebuf->processed == 0 &&
+				(opts->csv_skip_columns_like || opts->columns || opts->exclude_columns))
+				mark_hidden_columns(linebuf, nfields, true, opts);
+
+			/* dropped fields are not stored */
+			if (linebuf->has_hidden)
+			{
+				nfields = remove_hidden_fields(linebuf, nfields);
+				if (nfields == 0)
+					goto next_row;
+			}
+
 			rb = prepare_RowBucket(rb);
 
 			data_size = 0;
 			for (i = 0; i < nfields; i++)
-				if (!linebuf->hidden[i])
-					data_size += linebuf->sizes[i] + 1;
+				data_size += linebuf->sizes[i] + 1;
 
 			locbuf = smalloc2(data_size, "import csv data");
 			memset(locbuf, 0, data_size);
@@ -1484,23 +1776,15 @@ read_csv(RowBucketType *rb,
 
 			for (i = 0; i < nfields; i++)
 			{
-				if (!linebuf->hidden[i])
-				{
-					row->fields[i] = locbuf;
+				row->fields[i] = locbuf;
 
-					if (linebuf->sizes[i] > 0)
-						memcpy(locbuf, linebuf->buffer + linebuf->starts[i], linebuf->sizes[i]);
+				if (linebuf->sizes[i] > 0)
+					memcpy(locbuf, linebuf->buffer + linebuf->starts[i], linebuf->sizes[i]);
 
-					locbuf[linebuf->sizes[i]] = '\0';
-					locbuf += linebuf->sizes[i] + 1;
-				}
-				else
-					row->fields[i] = NULL;
+				locbuf[linebuf->sizes[i]] = '\0';
+				locbuf += linebuf->sizes[i] + 1;
 			}
 
-			if (linebuf->processed == 0 && opts->csv_skip_columns_like)
-				mark_hidden_columns(linebuf, row, nfields, opts);
-
 			postprocess_fields(nfields,
 							   row,
 							   linebuf,
@@ -1510,8 +1794,7 @@ read_csv(RowBucketType *rb,
 							   opts->csv_trim_width,
 							   opts->csv_trim_rows);
 
-			rb->multilines[rb->nrows] = multiline;
-			rb->rows[rb->nrows++] = row;
+			rb = store_row(rb, capture, opts->csv_header, row, multiline);
 
 next_row:
 
@@ -1536,11 +1819,68 @@ next_char:
 	}
 	while (!closed);
 
+	if (capture)
+		rb = flush_capture(first_rb, rb, linebuf, capture, ignore_short_rows, opts);
+
 	/* append nullstr to missing columns */
 	if (nullstr_size > 0 && !ignore_short_rows)
 		postprocess_rows(rb, linebuf, nullstr);
 }
 
+/*
+ * Queries from query stream, that were sent together with some
+ * previous query, but their results were not displayed yet.
+ */
+#define MAX_PENDING_QUERIES		7
+
+static char *pending_queries[MAX_PENDING_QUERIES];
+static int npending_queries = 0;
+
+bool
+has_pending_stream_query(void)
+{
+	return npending_queries > 0;
+}
+
+static char *
+pop_pending_query(void)
+{
+	char	   *query = pending_queries[0];
+
+	memmove(pending_queries, pending_queries + 1,
+			(--npending_queries) * sizeof(char *));
+
+	return query;
+}
+
+/*
+ * When more queries are available in query stream already, then
+ * these queries are sent together with current query in pipeline
+ * mode, and their results are displayed later.
+ */
+static void
+prefetch_stream_queries(Options *opts, char *query)
+{
+	char	   *queries[MAX_PENDING_QUERIES + 1];
+	char	   *q;
+	int			i;
+
+	if (npending_queries > 0)
+		return;
+
+	while (npending_queries < MAX_PENDING_QUERIES && (q = read_stream_query()))
+		pending_queries[npending_queries++] = q;
+
+	if (npending_queries == 0)
+		return;
+
+	queries[0] = query;
+	for (i = 0; i < npending_queries; i++)
+		queries[i + 1] = pending_queries[i];
+
+	pg_pipeline_queries(opts, queries, npending_queries + 1);
+}
+
 /*
  * Read external unformatted data (csv or result of some query
  *
@@ -1587,13 +1927,24 @@ read_and_format(Options *opts, DataDesc *desc, StateData *state)
 			else
 				free(estr.data);
 		}
+		else if (npending_queries > 0)
+		{
+			free(current_state->last_query);
+			current_state->last_query = pop_pending_query();
+		}
 
 		query = current_state->last_query;
+
+		if (query)
+			prefetch_stream_queries(opts, query);
 	}
 	else
 		query = opts->query;
 
 	lb_free(desc);
+	colstats_free(desc->colstats, desc->ncolstats);
+	typed_columns_free(desc->typed_columns, desc->ntyped_columns);
+	free_capture(desc->capture);
 	memset(desc, 0, sizeof(DataDesc));
 
 	if ((name = (char *) get_input_file_basename()))
@@ -1638,6 +1989,7 @@ read_and_format(Options *opts, DataDesc *desc, StateData *state)
 	linebuf.buffer = malloc(10 * 1024);
 	linebuf.used = 0;
 	linebuf.size = 10 * 1024;
+	linebuf.nullstr = opts->nullstr;
 
 	pconfig.linestyle = (opts->force_ascii_art || !use_utf8) ? 'a' : 'u';
 	pconfig.border = opts->border_type;
@@ -1654,6 +2006,12 @@ read_and_format(Options *opts, DataDesc *desc, StateData *state)
 	rowbuckets.nrows = 0;
 	rowbuckets.next_bucket = NULL;
 
+	/* only some data rows are kept (--max-rows, --tail, --sample) */
+	if ((opts->csv_format || opts->tsv_format) && !query &&
+		(opts->max_rows || opts->tail_rows || opts->sample_rows) &&
+		!state->stream_mode)
+		desc->capture = create_capture(opts);
+
 	if (opts->querystream && !query)
 	{
 		free(linebuf.buffer);
@@ -1666,6 +2024,8 @@ read_and_format(Options *opts, DataDesc *desc, StateData *state)
 						   query,
 						   &rowbuckets,
 						   &pdesc,
+						   &desc->colstats,
+						   &desc->typed_columns,
 						   &state->errstr))
 		{
 			log_row("pgclient error: %s\n", state->errstr);
@@ -1674,6 +2034,9 @@ read_and_format(Options *opts, DataDesc *desc, StateData *state)
 
 			return false;
 		}
+
+		desc->ncolstats = pdesc.nfields;
+		desc->ntyped_columns = desc->typed_columns ? pdesc.nfields : 0;
 	}
 	else if (opts->csv_format)
 	{
@@ -1689,9 +2052,23 @@ read_and_format(Options *opts, DataDesc *desc, StateData *state)
 				 &linebuf,
 				 opts->csv_separator,
 				 f_data, opts->ignore_short_rows,
+				 desc->capture,
 				 opts);
 
+		if (linebuf.processed > 0 && linebuf.maxfields == 0)
+		{
+			format_error("no column is selected");
+			free(linebuf.buffer);
+
+			return false;
+		}
+
+		/* the header was detected before capture of data rows */
+		if (desc->capture && desc->capture->started)
+			pconfig.header_mode = desc->capture->has_header ? '+' : '-';
+
 		prepare_pdesc(&rowbuckets, &linebuf, &pdesc, &pconfig);
+		prepare_colstats(&rowbuckets, &linebuf, &pdesc, desc);
 	}
 	else if (opts->tsv_format)
 	{
@@ -1707,9 +2084,60 @@ read_and_format(Options *opts, DataDesc *desc, StateData *state)
 				 &linebuf,
 				 f_data,
 				 opts->ignore_short_rows,
+				 desc->capture,
 				 opts);
 
+		if (linebuf.processed > 0 && linebuf.maxfields == 0)
+		{
+			format_error("no column is selected");
+			free(linebuf.buffer);
+
+			return false;
+		}
+
+		/* the header was detected before capture of data rows */
+		if (desc->capture && desc->capture->started)
+			pconfig.header_mode = desc->capture->has_header ? '+' : '-';
+
 		prepare_pdesc(&rowbuckets, &linebuf, &pdesc, &pconfig);
+		prepare_colstats(&rowbuckets, &linebuf, &pdesc, desc);
+	}
+	else if (opts->arrow_format || opts->copy_binary_format || opts->jsonl_format)
+	{
+		bool		result;
+
+		if (!f_data)
+		{
+			format_error("missing data");
+			free(linebuf.buffer);
+
+			return false;
+		}
+
+		if (opts->jsonl_format)
+			result = read_jsonl_input(opts,
+									  f_data,
+									  &rowbuckets,
+									  &pdesc,
+									  &desc->colstats,
+									  &desc->typed_columns);
+		else
+			result = read_binary_input(opts,
+									   f_data,
+									   &rowbuckets,
+									   &pdesc,
+									   &desc->colstats,
+									   &desc->typed_columns);
+
+		if (!result)
+		{
+			free(linebuf.buffer);
+
+			return false;
+		}
+
+		desc->ncolstats = pdesc.nfields;
+		desc->ntyped_columns = pdesc.nfields;
 	}
 
 	/* reuse allocated memory */
@@ -1784,7 +2212,7 @@ read_and_format(Options *opts, DataDesc *desc, StateData *state)
 		 * When we have not headline. We know structure, so we can
 		 * "translate" headline here (generate translated headline).
 		 */
-		desc->columns = linebuf.maxfields;
+		desc->columns = pdesc.nfields;
 		desc->cranges = smalloc2(desc->columns * sizeof(CRange), "prepare metadata");
 		memset(desc->cranges, 0, desc->columns * sizeof(CRange));
 		desc->headline_transl = smalloc2(desc->maxbytes + 3, "prepare metadata");
@@ -1799,9 +2227,9 @@ read_and_format(Options *opts, DataDesc *desc, StateData *state)
 			*ptr++ = 'd';
 		}
 
-		for (i = 0; i < linebuf.maxfields; i++)
+		for (i = 0; i < pdesc.nfields; i++)
 		{
-			int		width = linebuf.widths[i];
+			int		width = pdesc.widths[i];
 
 			desc->cranges[i].name_offset = -1;
 			desc->cranges[i].name_size = -1;
@@ -426,29 +426,9 @@ set_line_info(Options *opts,
 
 		while (str != NULL)
 		{
-			/*
-			 * When we would to ignore case or lower case (in this case, we know, so
-			 * pattern has not any upper char, then we have to use slower case insensitive
-			 * searching.
-			 */
-			if (opts->ignore_case || (opts->ignore_lower_case && !scrdesc->has_upperchr))
-			{
+			int		match_size;
 
-				if (use_utf8)
-					str = utf8_nstrstr(str, scrdesc->searchterm);
-				else
-					str = nstrstr(str, scrdesc->searchterm);
-			}
-			else if (opts->ignore_lower_case && scrdesc->has_upperchr)
-			{
-				if (use_utf8)
-					str = utf8_nstrstr_ignore_lower_case(str, scrdesc->searchterm);
-				else
-					str = nstrstr_ignore_lower_case(str, scrdesc->searchterm);
-			}
-			else
-				/* we can use case sensitive searching (binary comparation) */
-				str = strstr(str, scrdesc->searchterm);
+			str = pspg_search(opts, scrdesc, rowstr, str, &match_size);
 
 			if (str != NULL)
 			{
@@ -481,12 +461,19 @@ set_line_info(Options *opts,
 					linfo->mask |= LINEINFO_FOUNDSTR;
 
 					if (use_utf8)
+					{
 						linfo->start_char = utf_string_dsplen(rowstr, str - rowstr);
+						linfo->found_char_size = utf_string_dsplen(str, match_size);
+					}
 					else
+					{
 						linfo->start_char = str - rowstr;
+						linfo->found_char_size = match_size;
+					}
 				}
 
-				str += scrdesc->searchterm_size;
+				/* empty match (possible in regex mode) should not to block searching */
+				str += match_size > 0 ? match_size : charlen(str);
 			}
 		}
 	}
@@ -622,13 +609,34 @@ is_in_searched_pattern(int pos,
 	else
 	{
 		if (pos >= linfo->start_char &&
-			 pos < linfo->start_char + scrdesc->searchterm_char_size)
+			 pos < linfo->start_char + linfo->found_char_size)
 			return true;
 	}
 
 	return false;
 }
 
+/*
+ * Returns true, when pos is inside column marked as changed
+ * (in watch mode with highlighting of changes).
+ */
+static bool
+is_changed_cell(DataDesc *desc, const unsigned char *changed_cols, int pos)
+{
+	int		i;
+
+	if (desc->columns == 0)
+		return changed_cols[0] != 0;
+
+	for (i = 0; i < desc->columns; i++)
+	{
+		if (pos > desc->cranges[i].xmin && pos < desc->cranges[i].xmax)
+			return (changed_cols[i / 8] & (1 << (i % 8))) != 0;
+	}
+
+	return false;
+}
+
 typedef struct
 {
 	int		start_pos;
@@ -928,6 +936,7 @@ window_fill(int window_identifier,
 		bool		is_bookmark_row = false;
 		bool		is_cursor_row = false;
 		bool		is_pattern_row = false;
+		const unsigned char *changed_cols = NULL;
 		char		buffer[10];
 		int			positions[100][2];
 		int			npositions = 0;
@@ -953,12 +962,16 @@ window_fill(int window_identifier,
 		/* when rownum is printed, don't process original text */
 		if (is_rownum && line_is_valid)
 		{
-			snprintf(buffer, sizeof(buffer), "%*d ", maxx - 1, rowno);
+			snprintf(buffer, sizeof(buffer), "%*d ", maxx - 1, rowno + desc->retired_rows);
 			rowstr = buffer;
 		}
 
 		is_bookmark_row = (lineinfo != NULL && (lineinfo->mask & LINEINFO_BOOKMARK) != 0) ? true : false;
 
+		if (!is_fix_rows && lineinfo != NULL && (lineinfo->mask & LINEINFO_CHANGED) != 0 &&
+			lbm.lb->changed_cols)
+			changed_cols = lbm.lb->changed_cols + lbm.lb_rowno * CHANGED_COLS_BYTES(desc->columns);
+
 		if (!is_fix_rows && *scrdesc->searchterm != '\0' && !opts->no_highlight_search)
 			lineinfo = set_line_info(opts, scrdesc, desc, &lbm, rowstr);
 
@@ -973,7 +986,9 @@ window_fill(int window_identifier,
 
 			while (str != NULL && npositions < 100)
 			{
-				str = pspg_search(opts, scrdesc, str);
+				int		match_size;
+
+				str = pspg_search(opts, scrdesc, rowstr, str, &match_size);
 
 				if (str != NULL)
 				{
@@ -993,7 +1008,8 @@ window_fill(int window_identifier,
 					}
 
 					positions[npositions][0] = position;
-					positions[npositions][1] = positions[npositions][0] + scrdesc->searchterm_char_size;
+					positions[npositions][1] = positions[npositions][0] +
+											   (use_utf8 ? utf_string_dsplen(str, match_size) : match_size);
 
 					/* don't search more if we are over visible part */
 					if (positions[npositions][1] > srcx + maxx)
@@ -1002,8 +1018,9 @@ window_fill(int window_identifier,
 						break;
 					}
 
-					str += scrdesc->searchterm_size;
 					npositions += 1;
+
+					str += match_size > 0 ? match_size : charlen(str);
 				}
 			}
 		}
@@ -1366,10 +1383,14 @@ window_fill(int window_identifier,
 						else if (specword_typ == 3)
 							new_attr |= A_ITALIC | A_UNDERLINE;
 
+						if (changed_cols && !is_cursor && !is_cross_cursor && !is_in_range &&
+								column_format == 'd' && is_changed_cell(desc, changed_cols, pos))
+							new_attr = new_attr ^ A_REVERSE;
+
 						if (is_cursor || is_cross_cursor)
 						{
 							if (is_found_row && pos >= scrdesc->found_start_x &&
-									pos < scrdesc->found_start_x + scrdesc->searchterm_char_size)
+									pos < scrdesc->found_start_x + scrdesc->found_char_size)
 								new_attr = new_attr ^ ( A_REVERSE | pattern_fix );
 							else if (is_pattern_row)
 							{
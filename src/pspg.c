@@ -119,6 +119,9 @@ static void print_memory_stats(bool enable_memory_debug);
 static long	last_watch_ms = 0;
 static time_t	last_watch_sec = 0;					/* time when we did last refresh */
 static bool	paused = false;							/* true, when watch mode is paused */
+static int	history_age = 0;						/* 0, when the newest data are displayed */
+static bool	history_step = false;					/* other data from history should be displayed */
+static time_t history_timestamp;					/* time of displayed data from history */
 
 static bool active_ncurses = false;
 static bool xterm_mouse_mode_was_initialized = false;
@@ -128,6 +131,7 @@ static void set_scrollbar(ScrDesc *scrdesc, DataDesc *desc, int first_row);
 static bool check_visible_vertical_cursor(DataDesc *desc, Options *opts, int vertical_cursor_column);
 
 static void print_status(Options *opts, ScrDesc *scrdesc, DataDesc *desc);
+static void print_export_progress(ScrDesc *scrdesc);
 
 StateData *current_state = NULL;
 
@@ -381,10 +385,17 @@ print_duration(time_t start_sec, long start_ms, const char *label)
 #endif
 
 /*
- * Multiple used block - searching in string based on configuration
+ * Multiple used block - searching in string based on configuration.
+ * The str can be substring of line. Returns pointer to found pattern,
+ * and size of found pattern in bytes (in regex mode the size of found
+ * patterns can be different).
  */
 const char *
-pspg_search(Options *opts, ScrDesc *scrdesc, const char *str)
+pspg_search(Options *opts,
+			ScrDesc *scrdesc,
+			const char *line,
+			const char *str,
+			int *match_size)
 {
 	bool		ignore_case = opts->ignore_case;
 	bool		ignore_lower_case = opts->ignore_lower_case;
@@ -392,6 +403,18 @@ pspg_search(Options *opts, ScrDesc *scrdesc, const char *str)
 	const char *searchterm = scrdesc->searchterm;
 	const char *result;
 
+	if (opts->regex_search)
+	{
+		/*
+		 * POSIX regular expressions doesn't support mixed case sensitivity,
+		 * so upper case sensitive search is case sensitive search, when
+		 * pattern has upper char.
+		 */
+		return regex_search(searchterm,
+							ignore_case || (ignore_lower_case && !has_upperchr),
+							line, str, match_size);
+	}
+
 	if (ignore_case || (ignore_lower_case && !has_upperchr))
 	{
 		result = use_utf8 ? utf8_nstrstr(str, searchterm) : nstrstr(str, searchterm);
@@ -405,9 +428,36 @@ pspg_search(Options *opts, ScrDesc *scrdesc, const char *str)
 	else
 		result = strstr(str, searchterm);
 
+	*match_size = scrdesc->searchterm_size;
+
 	return result;
 }
 
+/*
+ * In regex mode compile the pattern, and when the pattern is not valid,
+ * show an error.
+ */
+static bool
+check_search_regex(Options *opts, ScrDesc *scrdesc)
+{
+	char		errbuf[256];
+
+	if (!opts->regex_search)
+		return true;
+
+	if (!prepare_search_regex(scrdesc->searchterm,
+							  opts->ignore_case ||
+							  (opts->ignore_lower_case && !scrdesc->has_upperchr),
+							  errbuf, sizeof(errbuf)))
+	{
+		show_info_wait(" Invalid regular expression (%s)",
+					   errbuf, true, true, false, true);
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * Trim footer rows - We should to trim footer rows and calculate footer_char_size
  */
@@ -478,7 +528,7 @@ set_scrollbar_dimensions(Options *opts, DataDesc *desc, ScrDesc *scrdesc)
 			 * This calculation can be processed repeatedly, so we need to
 			 * calculate main_maxx absolutely.
 			 */
-			num_width = opts->show_rownum ? number_width(desc->maxy) + 2 : 0;
+			num_width = opts->show_rownum ? number_width(desc->maxy + desc->retired_rows) + 2 : 0;
 			scrdesc->main_maxx = scrdesc->maxx - num_width - 1;
 
 			t = &scrdesc->themes[WINDOW_VSCROLLBAR];
@@ -1190,6 +1240,9 @@ redraw_screen(void)
 
 #endif
 
+	if (export_is_running())
+		print_export_progress(scrdesc);
+
 #ifdef DEBUG_PIPE
 
 	current_time(&start_doupdate_sec, &start_doupdate_ms);
@@ -1335,6 +1388,7 @@ print_status(Options *opts,
 			if (last_watch_sec > 0)
 			{
 				long	ms, td;
+				long	rows;
 				time_t	sec;
 				struct timespec spec;
 				int		w = number_width(opts->watch_time);
@@ -1350,7 +1404,17 @@ print_status(Options *opts,
 					(desc->title[0] != '\0' || desc->filename[0] != '\0'))
 					x = maxx / 4;
 
-				if (paused)
+				if (history_age > 0)
+				{
+					struct tm	tm;
+
+					localtime_r(&history_timestamp, &tm);
+					mvwprintw(top_bar, 0, x, "history -%d %02d:%02d:%02d",
+							  history_age, tm.tm_hour, tm.tm_min, tm.tm_sec);
+				}
+				else if (pg_query_progress(&td, &rows))
+					mvwprintw(top_bar, 0, x, "query %ld.%ld sec, %ld rows", td / 1000, (td % 1000) / 100, rows);
+				else if (paused)
 					mvwprintw(top_bar, 0, x, "paused %ld sec", td / 1000);
 				else
 					mvwprintw(top_bar, 0, x, "%*ld/%d", w, td/1000 + 1, opts->watch_time);
@@ -1377,6 +1441,30 @@ print_status(Options *opts,
 				return;
 			}
 		}
+		else if (desc->capture && desc->capture->seen_rows > desc->capture->kept_rows)
+		{
+			RowsCapture *capture = desc->capture;
+			int		x = 0;
+
+			if (desc->title[0] != '\0' || desc->filename[0] != '\0')
+				x = maxx / 4;
+
+			mvwprintw(top_bar, 0, x, "%s %ld of %ld rows",
+					  capture->mode == 'm' ? "first" : (capture->mode == 't' ? "last" : "sample"),
+					  capture->kept_rows, capture->seen_rows);
+		}
+		else if (desc->is_tail_preview)
+		{
+			int		x = 0;
+			int		percent = 0;
+
+			if (desc->title[0] != '\0' || desc->filename[0] != '\0')
+				x = maxx / 4;
+
+			(void) background_load_finished(desc, &percent);
+
+			mvwprintw(top_bar, 0, x, "tail, loading %d%%", percent);
+		}
 
 		if (desc->headline_transl)
 		{
@@ -1553,6 +1641,33 @@ print_status(Options *opts,
 	}
 }
 
+/*
+ * Shows progress of background export in bottom bar
+ */
+static void
+print_export_progress(ScrDesc *scrdesc)
+{
+	ExportProgress progress;
+	WINDOW	   *bottom_bar = w_bottom_bar(scrdesc);
+	Theme	   *bottom_bar_theme = &scrdesc->themes[WINDOW_BOTTOM_BAR];
+	double		speed = 0.0;
+
+	if (!bottom_bar || !export_get_progress(&progress) || progress.finished)
+		return;
+
+	if (progress.elapsed_ms > 0)
+		speed = progress.rows / (progress.elapsed_ms / 1000.0);
+
+	wattron(bottom_bar, bottom_bar_theme->prompt_attr);
+
+	mvwprintw(bottom_bar, 0, 0, " saving %ld lines, %.1f MB, %.0f lines/s (Esc to cancel) to %s",
+			  progress.rows, progress.bytes / (1024.0 * 1024.0), speed, progress.path);
+	wclrtoeol(bottom_bar);
+	wnoutrefresh(bottom_bar);
+
+	wattroff(bottom_bar, bottom_bar_theme->prompt_attr);
+}
+
 static void
 make_beep(void)
 {
@@ -1765,15 +1880,27 @@ exit_handler(void)
 
 	close_tty_stream();
 	close_data_stream();
+
+	pg_close_connection();
 }
 
 static void
 DataDescFree(DataDesc *desc)
 {
+	/* background filter reads lines, it should be stopped first */
+	discard_row_filter(desc);
+	discard_background_load(desc);
+
 	lb_free(desc);
 	free(desc->order_map);
+	free(desc->unfiltered_order_map);
 	free(desc->headline_transl);
 	free(desc->cranges);
+	free(desc->projection);
+	free_capture(desc->capture);
+	colstats_free(desc->colstats, desc->ncolstats);
+	typed_columns_free(desc->typed_columns, desc->ntyped_columns);
+	discard_pending_sort(desc);
 }
 
 /*
@@ -1796,10 +1923,14 @@ MergeScrDesc(ScrDesc *new, ScrDesc *old)
 	memcpy(new->searchcolterm, old->searchcolterm, 255);
 	new->searchcolterm_size = old->searchcolterm_size;
 
+	memcpy(&new->filter, &old->filter, sizeof(RowFilter));
+
 	new->has_upperchr = old->has_upperchr;
 	new->found = old->found;
 	new->found_start_x = old->found_start_x;
 	new->found_start_bytes = old->found_start_bytes;
+	new->found_size = old->found_size;
+	new->found_char_size = old->found_char_size;
 	new->found_row = old->found_row;
 
 	new->selected_first_row = old->selected_first_row;
@@ -1808,6 +1939,126 @@ MergeScrDesc(ScrDesc *new, ScrDesc *old)
 	new->selected_columns = old->selected_columns;
 }
 
+/*
+ * Sort and filter data again. The filter is applied over sorted data,
+ * so sort should be applied first. When limit is positive, then only
+ * first limit rows should be sorted immediately (the filter requires
+ * complete sort).
+ */
+static void
+refresh_order_map(ScrDesc *scrdesc, DataDesc *desc, SortSpec *sort, int limit)
+{
+	discard_pending_sort(desc);
+	reset_row_filter(desc);
+
+	if (sort->nkeys > 0)
+		update_order_map(scrdesc, desc, sort,
+						 scrdesc->filter.colno > 0 ? 0 : limit);
+	else if (desc->order_map)
+	{
+		free(desc->order_map);
+		desc->order_map = NULL;
+	}
+
+	if (scrdesc->filter.colno > 0)
+		(void) apply_row_filter(&scrdesc->filter, desc);
+
+	/*
+	 * We cannot to say nothing about found_row, so most
+	 * correct solution is clean it now.
+	 */
+	scrdesc->found_row = -1;
+}
+
+/*
+ * Reads new lines to current data. Returns number of read lines.
+ * The positions of data and footer rows are shifted by row filter,
+ * so the filter should be reset before reading. When no line is
+ * appended, the filter is applied again.
+ */
+static int
+read_appended_data(Options *opts, DataDesc *desc, StateData *state, RowFilter *filter)
+{
+	int		total_rows_before = desc->total_rows;
+	bool	was_filtered = desc->is_filtered;
+
+	discard_row_filter(desc);
+	reset_row_filter(desc);
+
+	desc->completed = false;
+	while (readfile(opts, desc, state) && !desc->completed)
+		;
+
+	if (desc->total_rows > total_rows_before)
+	{
+		/* order map will be recreated for all rows */
+		discard_pending_sort(desc);
+		free(desc->order_map);
+		desc->order_map = NULL;
+		desc->order_map_items = 0;
+
+		log_row("appended %d rows", desc->total_rows - total_rows_before);
+	}
+	else if (was_filtered)
+		(void) apply_row_filter(filter, desc);
+
+	return desc->total_rows - total_rows_before;
+}
+
+/*
+ * After removing oldest rows, the positions should be moved to
+ * hold same rows.
+ */
+static void
+shift_retired_rows(ScrDesc *scrdesc, int retired_rows)
+{
+	cursor_row = max_int(cursor_row - retired_rows, 0);
+	first_row = max_int(first_row - retired_rows, 0);
+	mark_mode_start_row = max_int(mark_mode_start_row - retired_rows, 0);
+
+	if (scrdesc->found_row != -1)
+	{
+		scrdesc->found_row -= retired_rows;
+		if (scrdesc->found_row < 0)
+		{
+			scrdesc->found_row = -1;
+			scrdesc->found = false;
+		}
+	}
+
+	if (scrdesc->selected_first_row != -1)
+	{
+		scrdesc->selected_first_row -= retired_rows;
+		if (scrdesc->selected_first_row < 0)
+		{
+			scrdesc->selected_rows += scrdesc->selected_first_row;
+			scrdesc->selected_first_row = 0;
+
+			if (scrdesc->selected_rows <= 0)
+			{
+				scrdesc->selected_first_row = -1;
+				scrdesc->selected_rows = 0;
+			}
+		}
+	}
+
+	if (scrdesc->search_first_row != -1)
+	{
+		scrdesc->search_first_row -= retired_rows;
+		if (scrdesc->search_first_row < 0)
+		{
+			scrdesc->search_rows += scrdesc->search_first_row;
+			scrdesc->search_first_row = 0;
+
+			if (scrdesc->search_rows <= 0)
+			{
+				scrdesc->search_first_row = -1;
+				scrdesc->search_rows = 0;
+			}
+		}
+	}
+}
+
 /*
  * Ensure so first_row is in correct range
  */
@@ -1932,6 +2183,9 @@ check_clipboard_app(Options *opts, bool *force_refresh)
 	}
 }
 
+/* size of buffer of output stream used for saving to file or pipe */
+#define EXPORT_BUFFER_SIZE		(1024 * 1024)
+
 void
 export_to_file(PspgCommand command,
 			  ClipboardFormat format,
@@ -2011,6 +2265,13 @@ export_to_file(PspgCommand command,
 			copy_to_file = true;
 	}
 
+	if (format == CLIPBOARD_FORMAT_ARROW && !copy_to_file && !use_pipe)
+	{
+		show_info_wait(" Arrow format can be used only for save to file",
+					   NULL, true, true, true, false);
+		return;
+	}
+
 	if (INSERT_FORMAT_TYPE(format))
 	{
 		(void) get_string("target table name: ", table_name, sizeof(table_name) - 1, last_table_name, 'u');
@@ -2059,6 +2320,13 @@ export_to_file(PspgCommand command,
 
 	if (copy_to_file)
 	{
+		if (export_is_running())
+		{
+			show_info_wait(" Previous export is not finished yet",
+						   NULL, true, true, true, false);
+			return;
+		}
+
 		path = tilde(NULL, buffer);
 
 		errno = 0;
@@ -2179,10 +2447,38 @@ export_to_file(PspgCommand command,
 		}
 	}
 
+	/*
+	 * Saving of large data to file can take long time, so it is executed
+	 * in background, and the data can be browsed meanwhile. Export of
+	 * searched or marked lines depends on line info, that is modified
+	 * by pager, so it cannot be executed in background.
+	 */
+	if (fp && copy_to_file && desc->completed &&
+		command != cmd_CopySearchedLines &&
+		command != cmd_CopyMarkedLines)
+	{
+		/* large buffer reduces number of write calls */
+		setvbuf(fp, NULL, _IOFBF, EXPORT_BUFFER_SIZE);
+
+		/* the result is displayed after end of export */
+		if (export_data_background(opts, scrdesc, desc,
+								   _cursor_row, cursor_column,
+								   fp, path,
+								   rows, percent, table_name,
+								   command, format))
+			return;
+
+		fclose(fp);
+		fp = NULL;
+	}
+
 	if (fp)
 	{
 		errno = 0;
 
+		if (copy_to_file || use_pipe)
+			setvbuf(fp, NULL, _IOFBF, EXPORT_BUFFER_SIZE);
+
 		isok = export_data(opts, scrdesc, desc,
 						   _cursor_row, cursor_column,
 						   fp,
@@ -2297,6 +2593,47 @@ export_to_file(PspgCommand command,
 	current_state->_errno = 0;
 }
 
+/*
+ * Release finished background export and show its result
+ */
+static void
+finish_background_export(void)
+{
+	ExportProgress progress;
+	char		buffer[MAXPATHLEN + 1024];
+
+	if (!export_finish(false, &progress))
+		return;
+
+	if (progress.canceled && !progress.isok)
+	{
+		snprintf(buffer, sizeof(buffer), "%s (%ld lines saved)",
+				 progress.path, progress.rows);
+
+		show_info_wait(" Export to %s was canceled",
+					   buffer, true, true, true, false);
+	}
+	else if (!progress.isok)
+	{
+		if (progress._errno != 0)
+			snprintf(buffer, sizeof(buffer), "%s (%s)",
+					 progress.path, strerror(progress._errno));
+		else
+			snprintf(buffer, sizeof(buffer), "%s", progress.path);
+
+		show_info_wait(" Cannot write to %s",
+					   buffer, true, true, false, true);
+	}
+	else
+	{
+		snprintf(buffer, sizeof(buffer), "%ld lines to %s",
+				 progress.rows, progress.path);
+
+		show_info_wait(" Saved %s",
+					   buffer, false, true, true, false);
+	}
+}
+
 /*
  * From "first_row" calculate position of slider of vertical scrollbar
  */
@@ -2383,6 +2720,71 @@ throw_selection(ScrDesc *scrdesc, DataDesc *desc, MarkModeType *_mark_mode)
 		throw_searching(scrdesc, desc);
 }
 
+/*
+ * Use result of row filter evaluated in background. When no row
+ * satisfies the filter, the previous state is preserved.
+ */
+static void
+finish_background_filter(ScrDesc *scrdesc, DataDesc *desc, bool wait)
+{
+	char		buffer[64];
+	int			nrecords;
+
+	nrecords = finish_row_filter(desc, wait, &scrdesc->filter);
+	if (nrecords < 0)
+		return;
+
+	if (nrecords == 0)
+	{
+		show_info_wait(" No row satisfies filter", NULL, true, true, false, false);
+		return;
+	}
+
+	scrdesc->found_row = -1;
+
+	throw_selection(scrdesc, desc, &mark_mode);
+
+	cursor_row = 0;
+	first_row = 0;
+
+	snprintf(buffer, sizeof(buffer), "%d",
+			 desc->last_data_row - desc->first_data_row + 1);
+
+	show_info_wait(" Filtered rows: %s", buffer, false, true, true, false);
+}
+
+/*
+ * Returns true when the command should not be processed before
+ * background sort or row filter is finished (it changes or uses
+ * order of all rows).
+ */
+static bool
+require_complete_order_map(int cmd)
+{
+	switch (cmd)
+	{
+		case cmd_BackwardSearch:
+		case cmd_SearchNext:
+		case cmd_SearchPrev:
+		case cmd_BackwardSearchInSelection:
+		case cmd_ForwardSearchInSelection:
+		case cmd_SearchColumn:
+		case cmd_CopyLine:
+		case cmd_CopyLineExtended:
+		case cmd_CopyColumn:
+		case cmd_CopyAllLines:
+		case cmd_CopySelected:
+		case cmd_CopySearchedLines:
+		case cmd_CopyMarkedLines:
+		case cmd_SaveAsCSV:
+		case cmd_BsCommand:
+			return true;
+
+		default:
+			return require_complete_load(cmd);
+	}
+}
+
 static bool
 is_horizontal_move(int c)
 {
@@ -2440,6 +2842,108 @@ check_visible_vertical_cursor(DataDesc *desc,
 }
 
 
+#define COLSTATS_MAX_LINES			16
+#define COLSTATS_LINE_SIZE			80
+
+/*
+ * Show statistics of column in simple popup window. The window
+ * is closed by any key.
+ */
+static void
+show_column_stats(DataDesc *desc, int colno)
+{
+	ColumnStats *cs;
+	char		lines[COLSTATS_MAX_LINES][COLSTATS_LINE_SIZE];
+	char		column_name[41];
+	int			nlines = 0;
+	int			width = 0;
+	int			maxy, maxx;
+	int			i;
+	double		value;
+	WINDOW	   *win;
+	NCursesEventData nced;
+
+	cs = get_column_stats(desc, colno);
+	if (!cs)
+	{
+		show_info_wait(" Statistics are not available",
+					   NULL, true, true, true, false);
+		return;
+	}
+
+	memset(column_name, 0, sizeof(column_name));
+
+	if (desc->namesline && desc->cranges[colno - 1].name_size > 0)
+		strncpy(column_name,
+				desc->namesline + desc->cranges[colno - 1].name_offset,
+				min_int(40, desc->cranges[colno - 1].name_size));
+	else
+		snprintf(column_name, sizeof(column_name), "%d", colno);
+
+#define ADD_LINE(...)	snprintf(lines[nlines++], COLSTATS_LINE_SIZE, __VA_ARGS__)
+
+	ADD_LINE("Column \"%s\"", column_name);
+	ADD_LINE("%s", "");
+	ADD_LINE("rows:      %ld", cs->count + cs->nulls);
+	ADD_LINE("nulls:     %ld", cs->nulls);
+	ADD_LINE("distinct:  ~%.0f", colstats_distinct(cs));
+
+	if (cs->numbers > 0)
+	{
+		if (cs->numbers != cs->count)
+			ADD_LINE("numbers:   %ld", cs->numbers);
+
+		ADD_LINE("min:       %.10g", cs->min);
+		ADD_LINE("max:       %.10g", cs->max);
+		ADD_LINE("sum:       %.10g", cs->sum);
+		ADD_LINE("avg:       %.10g", cs->sum / cs->numbers);
+
+		if (colstats_quantile(cs, 0.25, &value))
+			ADD_LINE("p25:       ~%.10g", value);
+		if (colstats_quantile(cs, 0.5, &value))
+			ADD_LINE("median:    ~%.10g", value);
+		if (colstats_quantile(cs, 0.75, &value))
+			ADD_LINE("p75:       ~%.10g", value);
+		if (colstats_quantile(cs, 0.95, &value))
+			ADD_LINE("p95:       ~%.10g", value);
+	}
+
+	if (cs->min_str)
+	{
+		ADD_LINE("%s%.40s", cs->numbers > 0 ? "text min:  " : "min:       ", cs->min_str);
+		ADD_LINE("%s%.40s", cs->numbers > 0 ? "text max:  " : "max:       ", cs->max_str);
+	}
+
+#undef ADD_LINE
+
+	for (i = 0; i < nlines; i++)
+		width = max_int(width, use_utf8 ? utf_string_dsplen(lines[i], strlen(lines[i])) : (int) strlen(lines[i]));
+
+	getmaxyx(stdscr, maxy, maxx);
+
+	width = min_int(width + 4, maxx);
+	nlines = min_int(nlines, maxy - 2);
+
+	win = newwin(nlines + 2, width, (maxy - nlines - 2) / 2, (maxx - width) / 2);
+	if (!win)
+		return;
+
+	wbkgd(win, prompt_window_info_attr);
+	werase(win);
+	box(win, 0, 0);
+
+	for (i = 0; i < nlines; i++)
+		mvwaddnstr(win, i + 1, 2, lines[i], -1);
+
+	wrefresh(win);
+
+	(void) get_pspg_event(&nced, true, -1);
+
+	delwin(win);
+
+	current_state->refresh_scr = true;
+}
+
 /*
  * Last check and hacks
  */
@@ -2629,8 +3133,7 @@ main(int argc, char *argv[])
 
 	bool	mouse_was_initialized = false;
 
-	int		last_ordered_column = -1;			/* order by when watch mode is active */
-	bool	last_order_desc = false;			/* true, when sort of data is descend */
+	SortSpec last_sort;							/* order by when watch mode is active */
 
 	long	mouse_event = 0;
 	long	vertical_cursor_changed_mouse_event = 0;
@@ -2696,6 +3199,7 @@ main(int argc, char *argv[])
 	fixedRows = -1;
 
 	memset(&opts, 0, sizeof(opts));
+	memset(&last_sort, 0, sizeof(SortSpec));
 	opts.theme = 1;
 	opts.freezed_cols = -1;				/* default will be 1 if screen width will be enough */
 	opts.csv_separator = -1;			/* auto detection */
@@ -2724,6 +3228,11 @@ main(int argc, char *argv[])
 	opts.nullstr = NULL;
 	opts.last_row_search = true;
 	opts.hist_size = 500;
+	opts.watch_history = 10;
+	opts.stream_max_rows = 0;
+	opts.max_rows = 0;
+	opts.tail_rows = 0;
+	opts.sample_rows = 0;
 	opts.progressive_load_mode = true;
 	opts.highlight_odd_rec = false;
 	opts.hide_header_line = false;
@@ -2965,7 +3474,12 @@ main(int argc, char *argv[])
 	pspg_esc_delay = opts.esc_delay;
 	log_row("esc delay = %d", pspg_esc_delay);
 
-	if (opts.csv_format || opts.tsv_format || opts.query)
+	/* long query can be canceled by sigint */
+	if (opts.query)
+		signal(SIGINT, SigintHandler);
+
+	if (opts.csv_format || opts.tsv_format || opts.arrow_format ||
+		opts.copy_binary_format || opts.jsonl_format || opts.query)
 		result = read_and_format(&opts, &desc, &state);
 	else if (opts.querystream)
 	{
@@ -2993,7 +3507,8 @@ main(int argc, char *argv[])
 
 	log_row("read input %d rows", desc.total_rows);
 
-	if ((opts.csv_format || opts.tsv_format || opts.query) &&
+	if ((opts.csv_format || opts.tsv_format || opts.arrow_format ||
+		 opts.copy_binary_format || opts.jsonl_format || opts.query) &&
 		(state.no_interactive || (!state.interactive && !isatty(STDOUT_FILENO))))
 	{
 		lb_print_all_ddesc(&desc, stdout);
@@ -3388,6 +3903,9 @@ reinit_theme:
 	if (detected_format)
 		finalize_tabular_data(&desc);
 
+	if (opts.watch_time > 0 && opts.watch_history > 0 && watch_history_count() == 0)
+		watch_history_push(&desc, (size_t) opts.watch_history * 1024 * 1024);
+
 	if (opts.tabular_cursor && !opts.no_cursor)
 		opts.no_cursor = desc.headline_transl == NULL;
 
@@ -3427,6 +3945,13 @@ reinit_theme:
 	cmdline[0] = '\0';
 	cmdline_ptr = NULL;
 
+	/* the cursor is moved to last row, when data are loaded */
+	if (state.start_at_end)
+	{
+		next_command = cmd_CursorLastRow;
+		state.start_at_end = false;
+	}
+
 	last_row_search[0] = '\0';
 	last_col_search[0] = '\0';
 	last_line[0] = '\0';
@@ -3502,9 +4027,11 @@ reinit_theme:
 		}
 
 		/*
-		 * Try to read command from commandline buffer first
+		 * Try to read command from commandline buffer first (when
+		 * the rest of commandline is not deferred).
 		 */
-		if (next_command == cmd_Invalid && cmdline_ptr && *cmdline_ptr)
+		if (next_command == cmd_Invalid && deffered_command == cmd_Invalid &&
+			cmdline_ptr && *cmdline_ptr)
 		{
 			while (cmdline_ptr && *cmdline_ptr)
 			{
@@ -3522,6 +4049,19 @@ reinit_theme:
 		 * Draw windows, only when function (key) redirect was not forced.
 		 * Redirect emmit immediate redraw.
 		 */
+		/* show result of finished background export */
+		if (export_is_running())
+			finish_background_export();
+
+		/* show result of finished background row filter */
+		if (desc.pending_filter)
+			finish_background_filter(&scrdesc, &desc, false);
+
+		/* rows after sorted part cannot be displayed before sort is finished */
+		if (desc.pending_sort &&
+			desc.first_data_row + first_row + VISIBLE_DATA_ROWS > desc.pending_sort->lineno)
+			(void) complete_order_map(&desc, true);
+
 		if (next_command == cmd_Invalid || current_state->fmt != NULL)
 		{
 			redraw_screen();
@@ -3551,9 +4091,33 @@ reinit_theme:
 			}
 			else
 			{
-				int		timeout = opts.watch_time > 0 ? 1000 : -1;
+				int		timeout = -1;
 				bool	only_tty = false;
 
+				/*
+				 * In watch mode we want to wake up exactly in time of next
+				 * refresh, and when the time displayed in top bar is changed.
+				 */
+				if (opts.watch_time > 0)
+				{
+					long	ms;
+					time_t	sec;
+					long	ct;
+
+					current_time(&sec, &ms);
+					ct = sec * 1000 + ms;
+
+					timeout = 1000 - (int) ((ct - (last_watch_sec * 1000 + last_watch_ms)) % 1000);
+
+					if (!paused && history_age == 0 && !pg_query_is_running() &&
+						next_watch - ct + 1 < timeout)
+						timeout = next_watch - ct + 1 > 0 ? (int) (next_watch - ct + 1) : 0;
+				}
+
+				/* data from history should be displayed immediately */
+				if (history_step)
+					timeout = 0;
+
 				if (!desc.completed)
 				{
 					bool	res;
@@ -3605,19 +4169,80 @@ reinit_theme:
 					}
 				}
 
+				/*
+				 * Only the end of file is displayed now (--start-at-end). The
+				 * complete file is loaded by background thread, and when it
+				 * is loaded, it replaces the displayed data.
+				 */
+				if (desc.is_tail_preview && desc.completed)
+				{
+					if (!desc.pending_load)
+						start_background_load(&opts, &state, &desc);
+
+					/* the progress of load is displayed in top bar */
+					if (desc.pending_load)
+					{
+						if (timeout <= 0 || timeout > 250)
+							timeout = 250;
+
+						only_tty = true;
+					}
+				}
+
 				/*
 				 * we forced repeated readfile until load is completed, when
 				 * some deferred command requires complete load.
 				 */
 				if (deffered_command != cmd_Invalid)
 				{
-					if (desc.completed)
+					if (desc.completed && !desc.is_tail_preview)
 					{
 						next_command = deffered_command;
 						deffered_command = cmd_Invalid;
 					}
 
-					continue;
+					/*
+					 * The tail preview is replaced by complete data, when
+					 * the background load is finished. The events should
+					 * be processed until this moment.
+					 */
+					if (!desc.completed || !desc.pending_load)
+						continue;
+				}
+
+				/*
+				 * First page of partially sorted data is displayed now,
+				 * and the rest is sorted in background. The order map
+				 * is completed when the sort is finished.
+				 */
+				if (desc.pending_sort && !complete_order_map(&desc, false))
+				{
+					if (timeout <= 0 || timeout > 50)
+						timeout = 50;
+
+					only_tty = true;
+				}
+
+				/*
+				 * The progress of background export is refreshed periodically.
+				 * Other input events are not processed until the export is
+				 * finished, because data cannot be replaced meanwhile.
+				 */
+				if (export_is_running())
+				{
+					if (timeout <= 0 || timeout > 250)
+						timeout = 250;
+
+					only_tty = true;
+				}
+
+				/* the result of row filter is displayed when it is finished */
+				if (desc.pending_filter)
+				{
+					if (timeout <= 0 || timeout > 50)
+						timeout = 50;
+
+					only_tty = true;
 				}
 
 				do
@@ -3658,6 +4283,7 @@ reinit_theme:
 
 				if (force_refresh ||
 					opts.watch_time ||
+					background_load_finished(&desc, NULL) ||
 					((opts.watch_file || state.stream_mode) && (event == PSPG_READ_DATA_EVENT)))
 				{
 					long	ms;
@@ -3667,22 +4293,67 @@ reinit_theme:
 					current_time(&sec, &ms);
 					ct = sec * 1000 + ms;
 
-					if (force_refresh ||
-						(ct > next_watch && !paused) ||
-						((opts.watch_file || state.stream_mode) &&
-						 (event == PSPG_READ_DATA_EVENT)))
+					/*
+					 * data used by background export cannot be released, and
+					 * the data stream cannot be reopened, when the complete
+					 * file is loaded after tail preview.
+					 */
+					if (!export_is_running() &&
+						(!desc.is_tail_preview || background_load_finished(&desc, NULL)) &&
+						(background_load_finished(&desc, NULL) ||
+						 force_refresh ||
+						 history_step ||
+						 (ct > next_watch && !paused && history_age == 0) ||
+						 event == PSPG_QUERY_EVENT ||
+						 ((opts.watch_file || state.stream_mode) &&
+						  (event == PSPG_READ_DATA_EVENT))))
 					{
 						DataDesc	desc2;
 						bool		fresh_data = false;
+						bool		appended_data = false;
+						bool		order_map_reused = false;
+						bool		tail_preview_replaced = false;
 
 						memset(&desc2, 0, sizeof(desc2));
 
+						/*
+						 * The complete file replaces tail preview. The cursor
+						 * holds same distance from the end of data.
+						 */
+						if (desc.pending_load)
+						{
+							if (finish_background_load(&desc, &desc2))
+							{
+								int		delta = desc2.last_row - desc.last_row;
+
+								tail_preview_replaced = true;
+								fresh_data = true;
+
+								cursor_row += delta;
+								first_row += delta;
+							}
+						}
+						/*
+						 * The data from history are processed already. New data
+						 * are not loaded until the newest data are displayed again.
+						 */
+						else if (history_step)
+							fresh_data = watch_history_get(history_age, &desc2, &history_timestamp);
+						else if (history_age > 0)
+							fresh_data = false;
 						/*
 						 * The query doesn't need reopen, and are available every
-						 * time.
+						 * time. The query is executed asynchronously, and the data
+						 * are processed after the query is finished. Until this
+						 * moment the previous data can be browsed.
 						 */
-						if (opts.query)
-							fresh_data = true;
+						else if (opts.query)
+						{
+							if (!pg_query_is_finished(opts.query) && !pg_query_is_running())
+								pg_send_query(&opts, opts.query);
+
+							fresh_data = pg_query_is_finished(opts.query);
+						}
 						/*
 						 * force open stream, where there are not an valid input
 						 * stream. The stream can be closed inside event handler,
@@ -3697,8 +4368,47 @@ reinit_theme:
 							 */
 							if (!state.stream_mode)
 							{
-								close_data_stream();
-								fresh_data = open_data_stream(&opts);
+								/*
+								 * When only new lines were appended to file, then
+								 * only these new lines are read to current data.
+								 */
+								if (desc.completed && !opts.csv_format && !opts.tsv_format &&
+									!opts.arrow_format && !opts.copy_binary_format &&
+									!opts.jsonl_format &&
+									is_append_only_change())
+								{
+									if (desc.pending_filter)
+										finish_background_filter(&scrdesc, &desc, true);
+
+									appended_data = true;
+									fresh_data = read_appended_data(&opts, &desc, &state, &scrdesc.filter) > 0;
+								}
+								else
+								{
+									close_data_stream();
+									fresh_data = open_data_stream(&opts);
+								}
+							}
+							/*
+							 * In log stream mode, the new lines are appended to
+							 * current data, and the oldest rows are removed.
+							 */
+							else if (opts.stream_max_rows > 0 && desc.completed)
+							{
+								if (desc.pending_filter)
+									finish_background_filter(&scrdesc, &desc, true);
+
+								appended_data = true;
+								fresh_data = read_appended_data(&opts, &desc, &state, &scrdesc.filter) > 0;
+
+								if (fresh_data)
+								{
+									int		retired_rows;
+
+									retired_rows = lb_retire_rows(&desc, opts.stream_max_rows);
+									if (retired_rows > 0)
+										shift_retired_rows(&scrdesc, retired_rows);
+								}
 							}
 							else
 							{
@@ -3710,52 +4420,115 @@ reinit_theme:
 							fresh_data = open_data_stream(&opts);
 
 						/* when we wanted fresh data */
-						if (fresh_data)
+						if (fresh_data && !history_step && !appended_data &&
+							!tail_preview_replaced)
 						{
-							if (opts.csv_format || opts.tsv_format || opts.query)
+							if (opts.csv_format || opts.tsv_format || opts.arrow_format ||
+								opts.copy_binary_format || opts.jsonl_format || opts.query)
 								/* returns false when format is broken */
 								fresh_data = read_and_format(&opts, &desc2, &state);
 							else if (opts.querystream)
 							{
-								readfile(&opts, &desc2, &state);
+								/* queries read already should be displayed first */
+								if (!has_pending_stream_query())
+									readfile(&opts, &desc2, &state);
+
 								fresh_data = read_and_format(&opts, &desc2, &state);
 							}
 							else
+							{
 								fresh_data = readfile(&opts, &desc2, &state);
-						}
 
-						/* when we have fresh data */
-						if (fresh_data)
-						{
-							int		max_cursor_row;
-							ScrDesc		aux;
-
-							DataDescFree(&desc);
-							memcpy(&desc, &desc2, sizeof(desc));
+								/*
+								 * Refreshed data can be compared with current data
+								 * only when both are complete. The current data are
+								 * displayed until new data are loaded.
+								 */
+								if (desc.completed)
+								{
+									while (fresh_data && !desc2.completed)
+										fresh_data = readfile(&opts, &desc2, &state);
 
-							if (desc.headline)
-								(void) translate_headline(&desc);
+									fresh_data = desc2.completed;
+								}
+							}
+						}
 
+						/* new lines are processed similary to progressive load */
+						if (fresh_data && appended_data)
+						{
 							if (desc.headline_transl)
 								finalize_tabular_data(&desc);
 
 							trim_footer_rows(&desc);
 
-							if (desc.headline_transl != NULL && !desc.is_expanded_mode)
+							if (!desc.headline_transl)
+								desc.last_data_row = desc.last_row;
+						}
+						/* when we have fresh data */
+						else if (fresh_data && !history_step)
+						{
+							if (desc2.headline)
+								(void) translate_headline(&desc2);
+
+							if (desc2.headline_transl)
+								finalize_tabular_data(&desc2);
+
+							trim_footer_rows(&desc2);
+
+							if (desc2.headline_transl != NULL && !desc2.is_expanded_mode)
 							{
-								if (desc.border_head_row != -1)
-									desc.first_data_row = desc.border_head_row + 1;
+								if (desc2.border_head_row != -1)
+									desc2.first_data_row = desc2.border_head_row + 1;
 							}
-							else if (desc.title_rows > 0 && desc.is_expanded_mode)
-								desc.first_data_row = desc.title_rows;
+							else if (desc2.title_rows > 0 && desc2.is_expanded_mode)
+								desc2.first_data_row = desc2.title_rows;
 							else
 							{
-								desc.first_data_row = 0;
-								desc.last_data_row = desc.last_row;
-								desc.title_rows = 0;
-								desc.title[0] = '\0';
+								desc2.first_data_row = 0;
+								desc2.last_data_row = desc2.last_row;
+								desc2.title_rows = 0;
+								desc2.title[0] = '\0';
+							}
+
+							/*
+							 * When data are not changed, we can use current data,
+							 * layout and order map. Marks of changed rows are kept
+							 * until next change of data. Else unchanged line
+							 * buffers and the order map can be used again.
+							 */
+							if (desc.pending_filter)
+								finish_background_filter(&scrdesc, &desc, true);
+
+							if (!merge_refreshed_data(&desc, &desc2,
+													  opts.highlight_changes && !tail_preview_replaced,
+													  &last_sort, &order_map_reused))
+							{
+								/* desc2 is released later */
+								fresh_data = false;
+								last_watch_sec = sec; last_watch_ms = ms;
+							}
+						}
+
+						if (fresh_data)
+						{
+							int		max_cursor_row;
+							ScrDesc		aux;
+
+							if (!appended_data)
+							{
+								DataDescFree(&desc);
+								memcpy(&desc, &desc2, sizeof(desc));
+
+								if (desc.rows.next)
+									desc.rows.next->prev = &desc.rows;
 							}
 
+							/* appended lines of log stream are not stored in history */
+							if (opts.watch_history > 0 && !history_step &&
+								!(appended_data && state.stream_mode))
+								watch_history_push(&desc, (size_t) opts.watch_history * 1024 * 1024);
+
 							first_data_row = desc.first_data_row;
 
 							detected_format = desc.headline_transl;
@@ -3775,6 +4548,17 @@ reinit_theme:
 
 							MergeScrDesc(&scrdesc, &aux);
 
+							/* filter can change number of rows, so it should be applied before cursor check */
+							if (order_map_reused)
+							{
+								if (scrdesc.filter.colno > 0)
+									(void) apply_row_filter(&scrdesc.filter, &desc);
+
+								scrdesc.found_row = -1;
+							}
+							else if (last_sort.nkeys > 0 || scrdesc.filter.colno > 0)
+								refresh_order_map(&scrdesc, &desc, &last_sort, 0);
+
 							/* new result can have different number of row, check cursor */
 							max_cursor_row = MAX_CURSOR_ROW;
 							cursor_row = cursor_row > max_cursor_row ? max_cursor_row : cursor_row;
@@ -3785,14 +4569,17 @@ reinit_theme:
 							first_row = adjust_first_row(first_row, &desc, &scrdesc);
 
 							last_watch_sec = sec; last_watch_ms = ms;
-
-							if (last_ordered_column != -1)
-								update_order_map(&scrdesc, &desc, last_ordered_column, last_order_desc);
 						}
 						else
 							DataDescFree(&desc2);
 
-						if ((ct - next_watch) < (opts.watch_time * 1000))
+						/* after return to newest data, the data are refreshed immediately */
+						if (history_step)
+							next_watch = ct;
+						/* next query is executed watch time after end of previous query */
+						else if (event == PSPG_QUERY_EVENT)
+							next_watch = ct + 1000 * opts.watch_time;
+						else if ((ct - next_watch) < (opts.watch_time * 1000))
 							next_watch = next_watch + 1000 * opts.watch_time;
 						else
 							next_watch = ct + 100 * opts.watch_time;
@@ -3805,6 +4592,8 @@ reinit_theme:
 							clear();
 							refresh_scr = true;
 						}
+
+						history_step = false;
 					}
 
 					set_scrollbar(&scrdesc, &desc, first_row);
@@ -3840,8 +4629,29 @@ reinit_theme:
 			redirect_mode = true;
 		}
 
+		/*
+		 * Commands that use order of all rows wait for background sort.
+		 * The new sort discards the pending sort.
+		 */
+		if (desc.pending_sort && require_complete_order_map(command) &&
+			command != cmd_SortAsc && command != cmd_SortDesc &&
+			command != cmd_OriginalSort && command != cmd_SortByColumns)
+			(void) complete_order_map(&desc, true);
+
+		if (desc.pending_filter && require_complete_order_map(command))
+			finish_background_filter(&scrdesc, &desc, true);
+
 		/* Exit immediately on F10 or input error */
-		if (event == PSPG_SIGINT_EVENT)
+		if (event == PSPG_SIGINT_EVENT && pg_query_is_running())
+			pg_cancel_query();
+		else if (event == PSPG_SIGINT_EVENT && export_is_running())
+			export_cancel();
+		else if (event == PSPG_SIGINT_EVENT && desc.pending_filter)
+		{
+			discard_row_filter(&desc);
+			show_info_wait(" Row filter was canceled", NULL, true, true, true, false);
+		}
+		else if (event == PSPG_SIGINT_EVENT)
 		{
 			if (!opts.no_sigint_search_reset &&
 				  (*scrdesc.searchterm || *scrdesc.searchcolterm ||
@@ -3928,6 +4738,8 @@ reinit_theme:
 						case cmd_UseClipboard_INSERT_with_comments:
 						case cmd_UseClipboard_SQL_values:
 						case cmd_UseClipboard_pipe_separated:
+						case cmd_UseClipboard_COPY_text:
+						case cmd_UseClipboard_Arrow:
 						case cmd_SetCopyFile:
 						case cmd_SetCopyClipboard:
 						case cmd_TogleEmptyStringIsNULL:
@@ -4025,7 +4837,11 @@ hide_menu:
 		else if (command == cmd_Escape)
 		{
 			/* same like sigint handling */
-			if (!opts.no_sigint_search_reset &&
+			if (pg_query_is_running())
+				pg_cancel_query();
+			else if (export_is_running())
+				export_cancel();
+			else if (!opts.no_sigint_search_reset &&
 				  (*scrdesc.searchterm || *scrdesc.searchcolterm ||
 				   scrdesc.selected_first_row != -1 ||
 				   scrdesc.selected_first_column != -1))
@@ -4045,11 +4861,12 @@ hide_menu:
 
 		/*
 		 * When some commands requires complete load, then save
-		 * the command and complete load before.
+		 * the command and complete load before. The tail preview
+		 * holds only the end of file.
 		 */
 		if ((require_complete_load(command) ||
 			require_complete_load(nested_command)) &&
-			!desc.completed)
+			(!desc.completed || desc.is_tail_preview))
 		{
 			deffered_command = command;
 			continue;
@@ -4252,6 +5069,28 @@ hide_menu:
 
 				refresh_clipboard_options(&opts, menu, !desc.headline_transl);
 
+#endif
+
+				break;
+
+			case cmd_UseClipboard_COPY_text:
+				opts.clipboard_format = CLIPBOARD_FORMAT_COPY_TEXT;
+
+#ifdef COMPILE_MENU
+
+				refresh_clipboard_options(&opts, menu, !desc.headline_transl);
+
+#endif
+
+				break;
+
+			case cmd_UseClipboard_Arrow:
+				opts.clipboard_format = CLIPBOARD_FORMAT_ARROW;
+
+#ifdef COMPILE_MENU
+
+				refresh_clipboard_options(&opts, menu, !desc.headline_transl);
+
 #endif
 
 				break;
@@ -4284,6 +5123,10 @@ hide_menu:
 			case cmd_CSSearchSet:
 				opts.ignore_lower_case = false;
 				opts.ignore_case = false;
+				goto reset_search;
+
+			case cmd_RegexSearchToggle:
+				opts.regex_search = !opts.regex_search;
 
 reset_search:
 				throw_searching(&scrdesc, &desc);
@@ -5651,9 +6494,10 @@ recheck_end:
 			case cmd_OriginalSort:
 				if (desc.order_map)
 				{
-					free(desc.order_map);
-					desc.order_map = NULL;
-					last_ordered_column = -1;
+					last_sort.nkeys = 0;
+
+					/* filtered data are filtered again in original order */
+					refresh_order_map(&scrdesc, &desc, &last_sort, 0);
 
 					throw_selection(&scrdesc, &desc, &mark_mode);
 				}
@@ -5685,13 +6529,18 @@ recheck_end:
 						sortedby_colno = vertical_cursor_column;
 					}
 
-					update_order_map(&scrdesc,
-									 &desc,
-									 sortedby_colno,
-									 command == cmd_SortDesc);
+					last_sort.nkeys = 1;
+					last_sort.colnos[0] = sortedby_colno;
+					last_sort.desc[0] = command == cmd_SortDesc;
 
-					last_ordered_column = sortedby_colno;
-					last_order_desc = command == cmd_SortDesc;
+					/*
+					 * Only rows to end of current page should be sorted
+					 * before first redraw. The rest is sorted later.
+					 */
+					refresh_order_map(&scrdesc,
+									  &desc,
+									  &last_sort,
+									  first_row + scrdesc.main_maxy);
 
 					throw_selection(&scrdesc, &desc, &mark_mode);
 
@@ -5729,6 +6578,87 @@ recheck_end:
 					break;
 				}
 
+			case cmd_ShowColumnStats:
+				{
+					int		colno;
+
+					if (long_argument_is_valid)
+					{
+						colno = (int) long_argument;
+						long_argument_is_valid = false;
+					}
+					else
+					{
+						if (desc.columns == 0)
+						{
+							show_info_wait(" Statistics are available only for tables",
+										   NULL, true, true, true, false);
+							break;
+						}
+
+						if (!opts.vertical_cursor || vertical_cursor_column <= 0)
+						{
+							show_info_wait(" Vertical cursor is not visible",
+										   NULL, true, true, true, false);
+							break;
+						}
+
+						colno = vertical_cursor_column;
+					}
+
+					show_column_stats(&desc, colno);
+					break;
+				}
+
+			case cmd_SortByColumns:
+				{
+					char	buffer[20];
+
+					/* columns are specified by \sort command already */
+					if (scrdesc.sortspec.nkeys == 0)
+						break;
+
+					memcpy(&last_sort, &scrdesc.sortspec, sizeof(SortSpec));
+					memset(&scrdesc.sortspec, 0, sizeof(SortSpec));
+
+					refresh_order_map(&scrdesc, &desc, &last_sort, 0);
+
+					throw_selection(&scrdesc, &desc, &mark_mode);
+
+					snprintf(buffer, 20, "%d", last_sort.nkeys);
+					show_info_wait(" Sorted by %s columns", buffer, false, true, true, false);
+					break;
+				}
+
+			case cmd_ApplyFilter:
+				{
+					/* filter is specified by \filter command already */
+					if (scrdesc.next_filter.colno == 0)
+						break;
+
+					/* result is processed by finish_background_filter */
+					start_row_filter(&scrdesc.next_filter, &desc);
+					memset(&scrdesc.next_filter, 0, sizeof(RowFilter));
+					break;
+				}
+
+			case cmd_CancelFilter:
+				{
+					discard_row_filter(&desc);
+
+					if (!desc.is_filtered)
+						break;
+
+					memset(&scrdesc.filter, 0, sizeof(RowFilter));
+					refresh_order_map(&scrdesc, &desc, &last_sort, 0);
+
+					throw_selection(&scrdesc, &desc, &mark_mode);
+
+					cursor_row = 0;
+					first_row = 0;
+					break;
+				}
+
 			case cmd_SaveData:
 				{
 					export_to_file(cmd_SaveData,
@@ -5775,7 +6705,8 @@ recheck_end:
 				{
 					ClipboardFormat fmt;
 
-					if (DSV_FORMAT_TYPE(opts.clipboard_format))
+					if (DSV_FORMAT_TYPE(opts.clipboard_format) &&
+						opts.clipboard_format != CLIPBOARD_FORMAT_COPY_TEXT)
 						fmt = opts.clipboard_format;
 					else
 						fmt = CLIPBOARD_FORMAT_CSV;
@@ -5908,6 +6839,12 @@ recheck_end:
 
 						reset_searching_lineinfo(&desc);
 
+						if (!check_search_regex(&opts, &scrdesc))
+						{
+							throw_searching(&scrdesc, &desc);
+							break;
+						}
+
 						/* continue to find next: */
 						next_command = cmd_SearchNext;
 					}
@@ -5923,6 +6860,7 @@ recheck_end:
 					int		lineno;
 					char   *line;
 					int		skip_bytes = 0;
+					bool	skip_empty_match = false;
 
 					if (!*scrdesc.searchterm)
 						break;
@@ -5937,7 +6875,12 @@ recheck_end:
 					lineno = cursor_row + CURSOR_ROW_OFFSET;
 
 					if (scrdesc.found && lineno == scrdesc.found_row)
-						skip_bytes = scrdesc.found_start_bytes + scrdesc.searchterm_size;
+					{
+						skip_bytes = scrdesc.found_start_bytes + scrdesc.found_size;
+
+						/* don't stop on same empty match (regex mode) again */
+						skip_empty_match = scrdesc.found_size == 0;
+					}
 
 					scrdesc.found = false;
 
@@ -5946,6 +6889,13 @@ recheck_end:
 					while (lbi_get_line_next(&lbi, &line, NULL, &lineno))
 					{
 						const char   *pttrn;
+						int			match_size = 0;
+
+						if (skip_empty_match)
+						{
+							skip_bytes += charlen(line + skip_bytes);
+							skip_empty_match = false;
+						}
 
 						if (scrdesc.search_rows > 0)
 						{
@@ -5956,7 +6906,7 @@ recheck_end:
 							}
 						}
 
-						pttrn = pspg_search(&opts, &scrdesc, line + skip_bytes);
+						pttrn = pspg_search(&opts, &scrdesc, line, line + skip_bytes, &match_size);
 						while (pttrn)
 						{
 							/* apply column selection filtr */
@@ -5968,7 +6918,7 @@ recheck_end:
 								if (pos < scrdesc.search_first_column)
 								{
 									pttrn += charlen(pttrn);
-									pttrn = pspg_search(&opts, &scrdesc, pttrn);
+									pttrn = pspg_search(&opts, &scrdesc, line, pttrn, &match_size);
 
 									continue;
 								}
@@ -5988,6 +6938,9 @@ recheck_end:
 								use_utf8 ? utf_string_dsplen(line, found_start_bytes) : (int) (found_start_bytes);
 
 							scrdesc.found_start_bytes = found_start_bytes;
+							scrdesc.found_size = match_size;
+							scrdesc.found_char_size =
+								use_utf8 ? utf_string_dsplen(pttrn, match_size) : match_size;
 							scrdesc.found_row = lineno;
 
 							fresh_found = true;
@@ -6060,6 +7013,12 @@ recheck_end:
 
 						reset_searching_lineinfo(&desc);
 
+						if (!check_search_regex(&opts, &scrdesc))
+						{
+							throw_searching(&scrdesc, &desc);
+							break;
+						}
+
 						/* continue to find next: */
 						next_command = cmd_SearchPrev;
 					}
@@ -6106,6 +7065,7 @@ recheck_end:
 					{
 						const char   *ptr;
 						const char   *most_right_pttrn = NULL;
+						int			most_right_size = 0;
 
 						/* inside table don't try search below first data row */
 						if (desc.headline_transl)
@@ -6129,7 +7089,9 @@ recheck_end:
 						/* try to find most right pattern */
 						while (ptr)
 						{
-							ptr = pspg_search(&opts, &scrdesc, ptr);
+							int		match_size;
+
+							ptr = pspg_search(&opts, &scrdesc, _line, ptr, &match_size);
 
 							if (ptr)
 							{
@@ -6150,7 +7112,8 @@ recheck_end:
 								}
 
 								most_right_pttrn = ptr;
-								ptr += scrdesc.searchterm_size;
+								most_right_size = match_size;
+								ptr += match_size > 0 ? match_size : charlen(ptr);
 							}
 						}
 
@@ -6166,6 +7129,9 @@ recheck_end:
 								use_utf8 ? utf8len_start_stop(_line, most_right_pttrn) : (size_t) (found_start_bytes);
 
 							scrdesc.found_start_bytes = found_start_bytes;
+							scrdesc.found_size = most_right_size;
+							scrdesc.found_char_size =
+								use_utf8 ? utf_string_dsplen(most_right_pttrn, most_right_size) : most_right_size;
 							scrdesc.found_row = lineno;
 
 							fresh_found = true;
@@ -6338,6 +7304,26 @@ recheck_end:
 				paused = !paused;
 				break;
 
+			case cmd_HistoryOlder:
+			case cmd_HistoryNewer:
+				{
+					int		age = history_age + (command == cmd_HistoryOlder ? 1 : -1);
+
+					if (age >= 0 && age < watch_history_count())
+					{
+						history_age = age;
+						history_step = true;
+					}
+					else if (opts.watch_history == 0)
+						show_info_wait(" History is disabled (see option --watch-history)",
+									   NULL, true, true, true, false);
+					else
+						show_info_wait(age < 0 ? " The newest data are displayed" : " No older data",
+									   NULL, true, true, true, false);
+
+					break;
+				}
+
 			case cmd_Refresh:
 				refresh_clear = true;
 				break;
@@ -6353,6 +7339,14 @@ recheck_end:
 						cmdline_ptr = cmdline;
 					}
 
+					/* the rest of command line is processed after load */
+					if ((!desc.completed || desc.is_tail_preview) &&
+						bscommand_require_complete_load(cmdline_ptr))
+					{
+						deffered_command = cmd_BsCommand;
+						break;
+					}
+
 					cmdline_ptr = parse_and_eval_bscommand(cmdline_ptr,
 														   &opts, &scrdesc, &desc,
 														   &next_command,
@@ -6889,7 +7883,7 @@ recheck_end:
 			{
 				getmaxyx(w_fix_cols(&scrdesc), maxy_loc, maxx_loc);
 
-				if (scrdesc.found_start_x + scrdesc.searchterm_char_size <= maxx_loc)
+				if (scrdesc.found_start_x + scrdesc.found_char_size <= maxx_loc)
 					fresh_found = false;
 			}
 
@@ -6898,7 +7892,7 @@ recheck_end:
 				getmaxyx(w_rows(&scrdesc), maxy_loc, maxx_loc);
 
 				if (cursor_col + scrdesc.fix_cols_cols <= scrdesc.found_start_x &&
-						cursor_col + scrdesc.fix_cols_cols + maxx_loc >= scrdesc.found_start_x + scrdesc.searchterm_char_size)
+						cursor_col + scrdesc.fix_cols_cols + maxx_loc >= scrdesc.found_start_x + scrdesc.found_char_size)
 				{
 					fresh_found = false;
 				}
@@ -6907,7 +7901,7 @@ recheck_end:
 					/* we would to move cursor_col to left or right to be partially visible */
 					if (cursor_col + scrdesc.fix_cols_cols > scrdesc.found_start_x)
 						next_command = cmd_MoveLeft;
-					else if (cursor_col + scrdesc.fix_cols_cols + maxx_loc < scrdesc.found_start_x + scrdesc.searchterm_char_size)
+					else if (cursor_col + scrdesc.fix_cols_cols + maxx_loc < scrdesc.found_start_x + scrdesc.found_char_size)
 						next_command = cmd_MoveRight;
 				}
 			}
@@ -6917,7 +7911,7 @@ recheck_end:
 				getmaxyx(w_footer(&scrdesc), maxy_loc, maxx_loc);
 
 				if (footer_cursor_col + scrdesc.fix_cols_cols <= scrdesc.found_start_x &&
-						footer_cursor_col + maxx_loc >= scrdesc.found_start_x + scrdesc.searchterm_char_size)
+						footer_cursor_col + maxx_loc >= scrdesc.found_start_x + scrdesc.found_char_size)
 				{
 					fresh_found = false;
 				}
@@ -6926,7 +7920,7 @@ recheck_end:
 					/* we would to move cursor_col to left or right to be partially visible */
 					if (footer_cursor_col > scrdesc.found_start_x)
 						next_command = cmd_MoveLeft;
-					else if (footer_cursor_col + maxx_loc < scrdesc.found_start_x + scrdesc.searchterm_char_size)
+					else if (footer_cursor_col + maxx_loc < scrdesc.found_start_x + scrdesc.found_char_size)
 						next_command = cmd_MoveRight;
 				}
 			}
@@ -7117,10 +8111,27 @@ refresh:
 	 * It is not necessary, but it can helps with debugging of
 	 * memory leaks.
 	 */
+	if (export_is_running())
+	{
+		ExportProgress progress;
+
+		/* unfinished export is canceled, data cannot be released before */
+		export_cancel();
+		(void) export_finish(true, &progress);
+	}
+
+	discard_row_filter(&desc);
+
 	lb_free(&desc);
 	free(desc.cranges);
 	free(desc.headline_transl);
 	free(desc.order_map);
+	free(desc.unfiltered_order_map);
+	free(desc.projection);
+	free_capture(desc.capture);
+
+	/* not finished load of complete file after tail preview */
+	discard_background_load(&desc);
 
 	free(opts.pathname);
 	free(opts.nullstr);
@@ -14,6 +14,8 @@
 #ifndef PSPG_PSPG_H
 #define PSPG_PSPG_H
 
+#include <pthread.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <stdio.h>
 
@@ -29,11 +31,14 @@
 #define LINEINFO_UNKNOWN				8
 #define LINEINFO_CONTINUATION			16
 #define LINEINFO_HASNOT_CONTINUATION	32
+#define LINEINFO_CHANGED				64
 
 #define			FILE_UNDEF			0
 #define			FILE_CSV			1
 #define			FILE_TSV			2
 #define			FILE_MATRIX			3
+#define			FILE_ARROW			4
+#define			FILE_JSONL			5
 
 #define PSPG_VERSION "5.8.16"
 
@@ -46,17 +51,34 @@ typedef struct LineInfo
 {
 	unsigned char	mask;
 	short int		start_char;
+	short int		found_char_size;	/* display size of first found pattern */
 	short int		recno_offset;
 } LineInfo;
 
 #define	LINEBUFFER_LINES		1000
 
+#define CHANGED_COLS_BYTES(columns)		((columns) / 8 + 1)
+
+/*
+ * Position of column's field on row (in bytes). The field holds all
+ * chars between column's bounds (including spaces around value).
+ */
+typedef struct
+{
+	int		offset;
+	int		size;
+} FieldSpan;
+
 typedef struct LineBuffer
 {
 	int		first_row;
 	int		nrows;
 	char   *rows[LINEBUFFER_LINES];
 	LineInfo	   *lineinfo;
+	FieldSpan	   *spans;			/* field spans of one column, can be NULL */
+	int		spans_rows;				/* number of rows with calculated spans */
+	int		spans_colno;			/* column of calculated spans */
+	unsigned char  *changed_cols;	/* bitmaps of changed columns (watch mode), can be NULL */
 	struct LineBuffer *next;
 	struct LineBuffer *prev;
 } LineBuffer;
@@ -74,6 +96,13 @@ typedef enum
 	INFO_STRXFRM
 } SortDataInfo;
 
+typedef struct
+{
+	SortDataInfo	info;
+	double			d;
+	char		   *strxfrm;
+} SortKey;
+
 typedef struct
 {
 	SortDataInfo		info;
@@ -81,8 +110,42 @@ typedef struct
 	char		   *strxfrm;
 	LineBuffer	   *lnb;
 	int				lnb_row;
+	SortKey		   *keys;			/* keys of multi column sort or NULL */
 } SortData;
 
+#define		MAX_SORT_KEYS			8
+
+/*
+ * Sorted columns (\sort a, b desc, c)
+ */
+typedef struct
+{
+	int		nkeys;					/* number of sorted columns, 0 for original order */
+	int		colnos[MAX_SORT_KEYS];	/* column numbers (starts by 1) */
+	bool	desc[MAX_SORT_KEYS];	/* true, when column is sorted descending */
+} SortSpec;
+
+/*
+ * Holds data of partially sorted column. Only first rows are sorted
+ * (and displayed) immediately, and the rest is sorted by background
+ * thread.
+ */
+typedef struct
+{
+	SortData   *sortbuf;
+	int			sorted_items;		/* number of sorted items of sortbuf */
+	int			items;				/* number of all items of sortbuf */
+	int			lineno;				/* first line of order map of not sorted items */
+	bool		desc_sort;
+	bool		text_sort;
+
+	pthread_t	thread;
+	bool		has_thread;			/* false when rest was sorted immediately */
+	pthread_mutex_t mutex;
+	bool		finished;			/* protected by mutex */
+	bool		canceled;			/* protected by mutex */
+} PendingSort;
+
 /*
  * Column range
  */
@@ -104,6 +167,44 @@ typedef struct
  *  d      .. data
  */
 
+/*
+ * Statistics of column. These statistics are accumulated when data
+ * are loaded (csv, tsv and query result), or when they are required
+ * first time (psql's tables).
+ */
+#define COLSTATS_HLL_BITS			10
+#define COLSTATS_HLL_REGISTERS		(1 << COLSTATS_HLL_BITS)
+
+typedef struct _TDigest TDigest;
+
+typedef struct
+{
+	bool	is_valid;				/* true, when statistics are calculated */
+	long	count;					/* number of not null values */
+	long	nulls;					/* number of nulls */
+	long	numbers;				/* number of numeric values */
+	double	min;					/* min of numeric values */
+	double	max;					/* max of numeric values */
+	double	sum;					/* sum of numeric values */
+	char   *min_str;				/* min of not numeric values */
+	char   *max_str;				/* max of not numeric values */
+	unsigned char hll[COLSTATS_HLL_REGISTERS];	/* HyperLogLog registers */
+	TDigest *tdigest;				/* approximate quantiles of numeric values */
+} ColumnStats;
+
+/*
+ * Native (numeric) values of column received in binary format. The
+ * values are indexed by number of data record. Only columns of numeric,
+ * date and timestamp types have values.
+ */
+typedef struct
+{
+	int		nvalues;
+	int		size;					/* allocated items */
+	double *values;
+	bool   *isnull;
+} TypedColumn;
+
 /*
  * This structure should be immutable
  */
@@ -122,8 +223,15 @@ typedef struct
 	char	filename[65];			/* filename (printed on top bar) */
 	LineBuffer rows;				/* list of rows buffers */
 	int		total_rows;				/* number of input rows */
+	int		retired_rows;			/* number of rows removed from start of stream */
 	MappedLine *order_map;			/* maps sorted lines to original lines */
 	int		order_map_items;		/* number of items of order map */
+	PendingSort *pending_sort;		/* not finished sort or NULL */
+	bool	is_filtered;			/* true, when order map is reduced by row filter */
+	int		filtered_rows;			/* number of rows removed by row filter */
+	MappedLine *unfiltered_order_map;	/* order map before row filter was applied */
+	int		unfiltered_order_map_items;	/* number of items of unfiltered order map */
+	struct PendingFilter *pending_filter;	/* row filter evaluated in background or NULL */
 	int		maxy;					/* maxy of used pad area with data */
 	int		maxx;					/* maxx of used pad area with data */
 	int		maxbytes;				/* max length of line in bytes */
@@ -154,8 +262,45 @@ typedef struct
 	LineBuffer *last_buffer;		/* pointer to last LineBuffer */
 
 	bool	load_data_rows;			/* true, when loaded rows holds data */
+
+	ColumnStats *colstats;			/* statistics of columns or NULL */
+	int		ncolstats;				/* number of items of colstats */
+
+	TypedColumn *typed_columns;		/* native values of columns or NULL */
+	int		ntyped_columns;			/* number of items of typed_columns */
+
+	bool   *projection;				/* kept display positions of table lines or NULL */
+	int		projection_size;		/* number of items of projection */
+
+	struct RowsCapture *capture;	/* state of capture of data rows or NULL */
+
+	bool	is_tail_preview;		/* true, when the middle of file was skipped */
+	struct PendingLoad *pending_load;	/* complete file loaded in background or NULL */
 } DataDesc;
 
+/*
+ * Row filter (\filter command)
+ */
+typedef enum
+{
+	FILTER_OP_EQ,
+	FILTER_OP_NE,
+	FILTER_OP_LT,
+	FILTER_OP_LE,
+	FILTER_OP_GT,
+	FILTER_OP_GE,
+	FILTER_OP_CONTAINS
+} FilterOperator;
+
+typedef struct
+{
+	int		colno;					/* filtered column (starts by 1), 0 when filter is not active */
+	FilterOperator op;
+	char	value[256];
+	bool	value_is_num;
+	double	value_num;
+} RowFilter;
+
 #define		PSPG_WINDOW_COUNT				10
 #define		PSPG_WINDOW_THEMES_COUNT		13
 
@@ -191,12 +336,18 @@ typedef struct
 	bool	found;					/* true, when last search was successfull */
 	int		found_start_x;			/* x position of found pattern */
 	int		found_start_bytes;		/* bytes position of found pattern */
+	int		found_size;				/* size of found pattern in bytes */
+	int		found_char_size;		/* display size of found pattern */
 	int		found_row;				/* row of found pattern */
 	int		first_rec_title_y;		/* y of first displayed record title in expanded mode */
 	int		last_rec_title_y;		/* y of last displayed record title in expanded mode */
 	char	searchcolterm[256];		/* last searched column patterm */
 	int		searchcolterm_size;		/* length of searched column pattern in bytes */
 
+	RowFilter filter;				/* active row filter */
+	RowFilter next_filter;			/* row filter specified by \filter command */
+	SortSpec sortspec;				/* requested multi column sort */
+
 	int		scrollbar_maxy;			/* max y of horisontal scrollbar */
 	int		scrollbar_start_y;		/* start y dim of horisontal scrollbar */
 	int		scrollbar_x;			/* x position of horisontal scrollbar */
@@ -244,6 +395,48 @@ typedef struct _rowBucketType
 	struct _rowBucketType *next_bucket;
 } RowBucketType;
 
+/*
+ * Data record captured by options --max-rows, --tail or --sample. The
+ * record of table can be displayed on more lines (multiline fields).
+ */
+typedef struct
+{
+	long	seqno;					/* number of data record */
+	char   *line;					/* first line of record */
+	char  **next_lines;				/* other lines of multiline record */
+	int		nnext_lines;			/* number of other lines */
+	RowType *row;					/* row of csv or tsv data */
+	bool	multiline;				/* row has some multiline field */
+} CapturedRecord;
+
+/*
+ * Data records captured by options --max-rows, --tail or --sample. Only
+ * part of data records is stored, other data records are only counted.
+ */
+typedef struct RowsCapture
+{
+	char	mode;					/* m - first rows, t - last rows, s - sample */
+	int		size;					/* max number of kept data records */
+	CapturedRecord *records;		/* ring (tail) or reservoir (sample) */
+	int		nrecords;				/* number of records in ring or reservoir */
+	int		allocated;				/* allocated items of records */
+	long	seen_rows;				/* number of data records of input */
+	long	kept_rows;				/* number of stored data records */
+	uint64_t random_state;			/* state of generator of random numbers */
+	bool	started;				/* data records are captured */
+	bool	tabular;				/* data records are rows of table */
+	bool	closed;					/* all data records was processed */
+	DataDesc *layout;				/* layout of table used for detection of
+									 * multiline records or NULL */
+	int		current;				/* position of last record or CAPTURE_STORE
+									 * or CAPTURE_SKIP */
+	bool	continued;				/* next line is part of last record */
+	bool	has_header;				/* first row of csv or tsv data is header */
+} RowsCapture;
+
+#define CAPTURE_SKIP			-1	/* the record is not stored */
+#define CAPTURE_STORE			-2	/* the record is stored immediately */
+
 /*
  * Used for formatting
  */
@@ -258,6 +451,21 @@ typedef struct
 	int		columns_map[1024];		/* column numbers - used when some column is hidden */
 } PrintDataDesc;
 
+/*
+ * state of export running in background
+ */
+typedef struct
+{
+	char	path[MAXPATHLEN];
+	long	rows;					/* processed rows */
+	long	bytes;					/* written bytes */
+	long	elapsed_ms;
+	bool	finished;
+	bool	canceled;
+	bool	isok;
+	int		_errno;					/* errno of failed write */
+} ExportProgress;
+
 /*
  * holds pager state data
  */
@@ -270,6 +478,9 @@ typedef struct
 	bool	stream_mode;
 	bool	no_alternate_screen;
 	bool	quit_if_one_screen;
+	bool	start_at_end;			/* show the end of data after start */
+	bool	load_in_background;		/* loaded data are not displayed yet */
+	FILE   *load_stream;			/* stream read by background loader or NULL */
 
 	int		reserved_rows;			/* used by dbcli */
 	int		boot_wait;
@@ -368,7 +579,7 @@ extern const char *nstrstr(const char *haystack, const char *needle);
 extern const char *nstrstr_ignore_lower_case(const char *haystack, const char *needle);
 extern bool nstreq(const char *str1, const char *str2);
 
-extern const char *pspg_search(Options *opts, ScrDesc *scrdesc, const char *str);
+extern const char *pspg_search(Options *opts, ScrDesc *scrdesc, const char *line, const char *str, int *match_size);
 
 /* from menu.c */
 extern void init_menu_config(Options *opts);
@@ -381,12 +592,29 @@ extern void refresh_copy_target_options(Options *opts, struct ST_MENU *menu);
 /* from sort.c */
 extern void sort_column_num(SortData *sortbuf, int rows, bool desc);
 extern void sort_column_text(SortData *sortbuf, int rows, bool desc);
+extern void sort_column_num_partial(SortData *sortbuf, int rows, int k, bool desc);
+extern void sort_column_text_partial(SortData *sortbuf, int rows, int k, bool desc);
+extern void sort_multi_columns(SortData *sortbuf, int rows, SortSpec *spec);
 
 /* from pretty-csv.c */
 extern bool read_and_format(Options *opts, DataDesc *desc, StateData *state);
+extern bool has_pending_stream_query(void);
 
 /* from pgclient.c */
-extern bool pg_exec_query(Options *opts, char *query, RowBucketType *rb, PrintDataDesc *pdesc, const char **err);
+extern bool pg_exec_query(Options *opts, char *query, RowBucketType *rb, PrintDataDesc *pdesc, ColumnStats **colstats, TypedColumn **typed_columns, const char **err);
+extern void pg_close_connection(void);
+extern void pg_send_query(Options *opts, char *query);
+extern bool pg_consume_query(void);
+extern int pg_query_socket(void);
+extern bool pg_query_is_running(void);
+extern bool pg_query_is_finished(const char *query);
+extern bool pg_query_progress(long *elapsed_ms, long *rows);
+extern void pg_cancel_query(void);
+extern void pg_pipeline_queries(Options *opts, char **queries, int nqueries);
+extern void pg_format_float(char *buf, int size, double d, bool is_float4);
+extern char *pg_numeric_to_text(const char *value);
+extern int pg_format_date(char *buf, int size, int64_t unix_sec);
+extern void pg_format_timestamp(char *buf, int size, int64_t value);
 
 /* from args.c */
 extern char **buildargv(const char *input, int *argc, char *appname);
@@ -418,13 +646,37 @@ extern int ExtStrTrimEnd(ExtStr *estr, bool replace_nl);
 extern int rwe_popen(char *command, int *fin, int *fout, int *ferr);
 
 extern char *tilde(char *dest, const char *path);
+extern bool is_hidden_column(Options *opts, const char *name, int colno);
 
 /* from table.c */
 extern bool readfile(Options *opts, DataDesc *desc, StateData *state);
+extern char *read_stream_query(void);
 extern bool translate_headline(DataDesc *desc);
 extern void multilines_detection(DataDesc *desc);
 
-extern void update_order_map(ScrDesc *scrdesc, DataDesc *desc, int sbcn, bool desc_sort);
+extern void start_background_load(Options *opts, StateData *state, DataDesc *desc);
+extern bool background_load_finished(DataDesc *desc, int *percent);
+extern bool finish_background_load(DataDesc *desc, DataDesc *loaded);
+extern void discard_background_load(DataDesc *desc);
+
+extern RowsCapture *create_capture(Options *opts);
+extern int capture_record(RowsCapture *capture);
+extern void sort_captured_records(RowsCapture *capture);
+extern void free_capture(RowsCapture *capture);
+
+extern void update_order_map(ScrDesc *scrdesc, DataDesc *desc, SortSpec *spec, int limit);
+extern bool complete_order_map(DataDesc *desc, bool wait);
+extern void discard_pending_sort(DataDesc *desc);
+extern int apply_row_filter(RowFilter *filter, DataDesc *desc);
+extern void start_row_filter(RowFilter *filter, DataDesc *desc);
+extern int finish_row_filter(DataDesc *desc, bool wait, RowFilter *filter);
+extern void discard_row_filter(DataDesc *desc);
+extern void reset_row_filter(DataDesc *desc);
+extern ColumnStats *get_column_stats(DataDesc *desc, int colno);
+extern void calculate_field_spans(DataDesc *desc, char *row, FieldSpan *spans, int ncolumns);
+extern void typed_columns_free(TypedColumn *typed_columns, int n);
+extern void typed_column_add(TypedColumn *tc, double d, bool isnull);
+extern bool merge_refreshed_data(DataDesc *old, DataDesc *new, bool mark_changes, SortSpec *sort, bool *order_map_reused);
 
 /* from string.c */
 extern const char *nstrstr(const char *haystack, const char *needle);
@@ -434,12 +686,58 @@ extern const char *nstrstr_with_sizes(const char *haystack, const int haystack_s
 				   const char *needle, int needle_size);
 extern bool nstarts_with_with_sizes(const char *str, int str_size, const char *pattern, int pattern_size);
 
+/* from search.c */
+extern bool prepare_search_regex(const char *pattern, bool ignore_case, char *errbuf, int errbuf_size);
+extern const char *regex_search(const char *pattern, bool ignore_case, const char *line, const char *str, int *match_size);
+
+/* from history.c */
+extern void watch_history_push(DataDesc *desc, size_t limit);
+extern bool watch_history_get(int age, DataDesc *desc, time_t *timestamp);
+extern int watch_history_count(void);
+
+/* from colstats.c */
+extern void colstats_add_value(ColumnStats *cs, const char *str, bool isnull);
+extern void colstats_add_number(ColumnStats *cs, const char *str, double d);
+extern double colstats_distinct(ColumnStats *cs);
+extern bool colstats_quantile(ColumnStats *cs, double q, double *result);
+extern ColumnStats *colstats_realloc(ColumnStats *colstats, int oldn, int newn);
+extern void colstats_free_item(ColumnStats *cs);
+extern void colstats_free(ColumnStats *colstats, int n);
+
 /* from export.c */
 extern bool export_data(Options *opts, ScrDesc *scrdesc, DataDesc *desc,
 						int cursor_row, int cursor_column,
 						FILE *fp,
 						int rows, double percent, char *table_name,
 						PspgCommand cmd, ClipboardFormat format);
+extern bool export_data_background(Options *opts, ScrDesc *scrdesc, DataDesc *desc,
+						int cursor_row, int cursor_column,
+						FILE *fp, const char *path,
+						int rows, double percent, char *table_name,
+						PspgCommand cmd, ClipboardFormat format);
+extern bool export_is_running(void);
+extern bool export_get_progress(ExportProgress *progress);
+extern void export_cancel(void);
+extern bool export_finish(bool wait, ExportProgress *progress);
+
+/* from binary-input.c */
+extern bool read_binary_input(Options *opts, FILE *fp, RowBucketType *rb, PrintDataDesc *pdesc, ColumnStats **colstats, TypedColumn **typed_columns);
+
+/* from jsonl.c */
+extern bool read_jsonl_input(Options *opts, FILE *fp, RowBucketType *rb, PrintDataDesc *pdesc, ColumnStats **colstats, TypedColumn **typed_columns);
+
+/* from arrow.c */
+typedef struct ArrowWriter ArrowWriter;
+
+extern ArrowWriter *arrow_writer_new(FILE *fp, int maxcolumns);
+extern void arrow_writer_free(ArrowWriter *aw);
+extern void arrow_set_column_name(ArrowWriter *aw, int colno, const char *name, int size);
+extern void arrow_set_column_numeric(ArrowWriter *aw, int colno);
+extern void arrow_infer_value(ArrowWriter *aw, int colno, const char *str, int size, bool isnull, int lspaces, int rspaces);
+extern bool arrow_write_schema(ArrowWriter *aw);
+extern void arrow_append_value(ArrowWriter *aw, int colno, const char *str, int size, bool isnull);
+extern bool arrow_end_row(ArrowWriter *aw);
+extern bool arrow_write_footer(ArrowWriter *aw);
 
 /* from linebuffer.c */
 extern void init_lbi(LineBufferIter *lbi, LineBuffer *lb, MappedLine *order_map, int order_map_items, int init_pos);
@@ -459,6 +757,7 @@ extern bool ddesc_set_mark(LineBufferMark *lbm, DataDesc *desc, int pos);
 extern void lbm_xor_mask(LineBufferMark *lbm, char mask);
 extern void lbm_recno_offset(LineBufferMark *lbm, short int recno_offset);
 extern void lb_free(DataDesc *desc);
+extern int lb_retire_rows(DataDesc *desc, int max_rows);
 extern void lb_print_all_ddesc(DataDesc *desc, FILE *f);
 extern const char *getline_ddesc(DataDesc *desc, int pos);
 
@@ -467,6 +766,7 @@ extern const char *get_token(const char *instr, const char **token, int *n);
 extern const char *parse_and_eval_bscommand(const char *cmdline, Options *opts, ScrDesc *scrdesc, DataDesc *desc,
 											int *next_command, long *long_argument, bool *long_argument_is_valid,
 											char **string_argument, bool *string_argument_is_valid, bool *refresh_clear);
+extern bool bscommand_require_complete_load(const char *cmdline);
 
 #define IS_TOKEN(str, n, token)		((n == strlen(token)) && (strncmp(str, token, n) == 0))
 
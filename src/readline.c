@@ -110,6 +110,8 @@ static const char *export_opts[] = {
 	"cinsert",
 	"nullstr",
 	"sqlvalues",
+	"pgcopy",
+	"arrow",
 	NULL
 };
 
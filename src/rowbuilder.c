@@ -0,0 +1,551 @@
+/*-------------------------------------------------------------------------
+ *
+ * rowbuilder.c
+ *	  build rows of data read in native (not text) format
+ *
+ * Portions Copyright (c) 2017-2026 Pavel Stehule
+ *
+ * IDENTIFICATION
+ *	  src/rowbuilder.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pspg.h"
+#include "rowbuilder.h"
+#include "unicode.h"
+
+/* 2000-01-01 in unix time (in microseconds) */
+#define POSTGRES_EPOCH_USECS		INT64_C(946684800000000)
+
+static int
+text_width(const char *str, int size, bool *multiline)
+{
+	*multiline = false;
+
+	if (use_utf8)
+	{
+		long int	digits = 0;
+		long int	others = 0;
+		int			width;
+
+		width = utf_string_dsplen_multiline(str, size, multiline, false, &digits, &others, 0);
+
+		return width >= 0 ? width : size;
+	}
+	else
+	{
+		int		cw = 0;
+		int		width = 0;
+
+		while (*str)
+		{
+			if (*str++ == '\n')
+			{
+				*multiline = true;
+				width = cw > width ? cw : width;
+				cw = 0;
+			}
+			else
+				cw++;
+		}
+
+		return cw > width ? cw : width;
+	}
+}
+
+void
+builder_init(RowBuilder *b, Options *opts, RowBucketType *rb, PrintDataDesc *pdesc)
+{
+	bool		multiline;
+
+	memset(b, 0, sizeof(RowBuilder));
+	memset(pdesc, 0, sizeof(PrintDataDesc));
+
+	b->opts = opts;
+	b->current_rb = rb;
+	b->pdesc = pdesc;
+
+	b->nullstr = opts->nullstr ? opts->nullstr : "";
+	b->nullstr_size = strlen(b->nullstr);
+	b->nullstr_width = text_width(b->nullstr, b->nullstr_size, &multiline);
+}
+
+static void
+builder_reserve(RowBuilder *b, int size)
+{
+	if (b->used + size > b->size)
+	{
+		while (b->used + size > b->size)
+			b->size = b->size > 0 ? b->size * 2 : 1024;
+
+		b->buffer = srealloc(b->buffer, b->size);
+	}
+}
+
+/*
+ * Prints decimal value stored as 128bit integer in two's complement
+ */
+static int
+format_decimal(char *buf, int64_t hi, uint64_t lo, int scale)
+{
+	uint32_t	limbs[4];
+	char		digits[48];
+	int			ndigits = 0;
+	bool		negative = hi < 0;
+	char	   *ptr = buf;
+	int			i;
+
+	if (negative)
+	{
+		lo = ~lo + 1;
+		hi = (int64_t) (~(uint64_t) hi + (lo == 0 ? 1 : 0));
+	}
+
+	limbs[0] = (uint32_t) ((uint64_t) hi >> 32);
+	limbs[1] = (uint32_t) hi;
+	limbs[2] = (uint32_t) (lo >> 32);
+	limbs[3] = (uint32_t) lo;
+
+	do
+	{
+		uint64_t	rem = 0;
+
+		for (i = 0; i < 4; i++)
+		{
+			uint64_t	cur = (rem << 32) | limbs[i];
+
+			limbs[i] = (uint32_t) (cur / 10);
+			rem = cur % 10;
+		}
+
+		digits[ndigits++] = '0' + rem;
+	} while (limbs[0] || limbs[1] || limbs[2] || limbs[3]);
+
+	if (negative)
+		*ptr++ = '-';
+
+	if (scale > 0 && ndigits <= scale)
+	{
+		*ptr++ = '0';
+		*ptr++ = '.';
+
+		for (i = ndigits; i < scale; i++)
+			*ptr++ = '0';
+
+		while (ndigits > 0)
+			*ptr++ = digits[--ndigits];
+	}
+	else
+	{
+		bool		is_zero = ndigits == 1 && digits[0] == '0';
+
+		while (ndigits > (scale > 0 ? scale : 0))
+			*ptr++ = digits[--ndigits];
+
+		if (scale > 0)
+		{
+			*ptr++ = '.';
+
+			while (ndigits > 0)
+				*ptr++ = digits[--ndigits];
+		}
+		else if (!is_zero)
+		{
+			for (i = 0; i < -scale; i++)
+				*ptr++ = '0';
+		}
+	}
+
+	*ptr = '\0';
+
+	return ptr - buf;
+}
+
+static int
+format_time(char *buf, int size, int64_t usecs)
+{
+	int64_t		secs;
+	int			len;
+
+	if (usecs < 0)
+		usecs = 0;
+
+	secs = usecs / USECS_PER_SEC;
+	usecs = usecs % USECS_PER_SEC;
+
+	len = snprintf(buf, size, "%02d:%02d:%02d",
+				   (int) (secs / 3600), (int) (secs / 60 % 60), (int) (secs % 60));
+
+	if (usecs > 0)
+	{
+		len += snprintf(buf + len, size - len, ".%06d", (int) usecs);
+
+		/* remove trailing zeros */
+		while (buf[len - 1] == '0')
+			buf[--len] = '\0';
+	}
+
+	return len;
+}
+
+/*
+ * Copy text value to row buffer. The value is cut on first zero byte,
+ * and broken (truncated) multibyte char is replaced by '?', because
+ * other code expects complete chars. Returns size of copied text.
+ */
+static int
+copy_text(char *dest, const char *src, int size)
+{
+	const char *zero;
+	int			i = 0;
+
+	dest[0] = '\0';
+	if (size == 0)
+		return 0;
+
+	zero = memchr(src, '\0', size);
+	if (zero)
+		size = zero - src;
+
+	memcpy(dest, src, size);
+	dest[size] = '\0';
+
+	if (use_utf8)
+	{
+		while (i < size)
+		{
+			int		clen = utf8charlen(dest[i]);
+
+			if (i + clen > size)
+			{
+				memset(dest + i, '?', size - i);
+				break;
+			}
+
+			i += clen;
+		}
+	}
+
+	return size;
+}
+
+/*
+ * Append a value of column header
+ */
+static void
+builder_add_name(RowBuilder *b, const char *name)
+{
+	PrintDataDesc *pdesc = b->pdesc;
+	int			n = b->nvalues++;
+	int			size = strlen(name);
+	bool		multiline;
+
+	builder_reserve(b, size + 1);
+
+	b->offsets[n] = b->used;
+	copy_text(b->buffer + b->used, name, size);
+
+	pdesc->widths[n] = text_width(b->buffer + b->used, size, &multiline);
+	pdesc->multilines[n] = multiline;
+	b->multiline_row |= multiline;
+
+	b->used += size + 1;
+}
+
+/*
+ * Prepare description of columns. The kinds of columns should be
+ * set already. When names are not NULL, then the header row is
+ * stored. Returns false, when no column is displayed.
+ */
+bool
+builder_set_columns(RowBuilder *b, int nfields, const char **names)
+{
+	PrintDataDesc *pdesc = b->pdesc;
+	int			n = 0;
+	int			i;
+
+	for (i = 0; i < nfields; i++)
+	{
+		ValueKind	kind = b->kinds[i];
+
+		b->dropped[i] = is_hidden_column(b->opts, names ? names[i] : NULL, i + 1);
+		if (b->dropped[i])
+			continue;
+
+		pdesc->columns_map[n] = n;
+		pdesc->types[n] = (kind >= VALUE_INT && kind <= VALUE_NUMBER) ? 'd' : 'a';
+
+		b->typed[n] = (kind >= VALUE_INT && kind <= VALUE_NUMBER) ||
+					  kind == VALUE_DATE || kind == VALUE_TIMESTAMP;
+		n += 1;
+	}
+
+	if (n == 0)
+	{
+		format_error("no column is selected");
+		return false;
+	}
+
+	pdesc->nfields = n;
+	pdesc->nfields_all = n;
+	pdesc->has_header = names != NULL;
+
+	b->colstats = colstats_realloc(NULL, 0, n);
+	b->typed_columns = smalloc(n * sizeof(TypedColumn));
+
+	if (names)
+	{
+		for (i = 0; i < nfields; i++)
+			if (!b->dropped[i])
+				builder_add_name(b, names[i]);
+
+		builder_end_row(b);
+	}
+
+	return true;
+}
+
+/*
+ * Transforms value to text and append it to current row
+ */
+void
+builder_add(RowBuilder *b, Value *v)
+{
+	PrintDataDesc *pdesc = b->pdesc;
+	int			input = b->ninputs++;
+	ValueKind	kind = b->kinds[input];
+	char		buf[128];
+	char	   *numstr = NULL;
+	const char *str = buf;
+	int			size = 0;
+	int			width;
+	bool		is_number = false;
+	bool		multiline = false;
+	double		d = 0.0;
+	int			n;
+
+	/* dropped column is not stored */
+	if (b->dropped[input])
+		return;
+
+	n = b->nvalues++;
+
+	if (v->isnull || kind == VALUE_NULL)
+	{
+		v->isnull = true;
+		str = b->nullstr;
+		size = b->nullstr_size;
+	}
+	else
+	{
+		switch (kind)
+		{
+			case VALUE_INT:
+				size = snprintf(buf, sizeof(buf), "%lld", (long long) v->i);
+				d = (double) v->i;
+				is_number = true;
+				break;
+
+			case VALUE_UINT:
+				size = snprintf(buf, sizeof(buf), "%llu", (unsigned long long) v->u);
+				d = (double) v->u;
+				is_number = true;
+				break;
+
+			case VALUE_FLOAT4:
+			case VALUE_FLOAT8:
+				pg_format_float(buf, sizeof(buf), v->d, kind == VALUE_FLOAT4);
+				size = strlen(buf);
+				d = v->d;
+				is_number = true;
+				break;
+
+			case VALUE_DECIMAL:
+				size = format_decimal(buf, v->i, v->u, b->scales[input]);
+				d = strtod(buf, NULL);
+				is_number = true;
+				break;
+
+			case VALUE_NUMERIC:
+				str = numstr = pg_numeric_to_text(v->str);
+				size = strlen(numstr);
+				d = strtod(numstr, NULL);
+				is_number = true;
+				break;
+
+			case VALUE_NUMBER:
+				str = v->str;
+				size = v->size;
+				d = v->d;
+				is_number = true;
+				break;
+
+			case VALUE_BOOL:
+				size = snprintf(buf, sizeof(buf), "%s", v->i ? "t" : "f");
+				break;
+
+			case VALUE_DATE:
+				size = pg_format_date(buf, sizeof(buf), v->i * 86400);
+				d = (double) v->i;
+				break;
+
+			case VALUE_TIME:
+				size = format_time(buf, sizeof(buf), v->i);
+				break;
+
+			case VALUE_TIMESTAMP:
+				pg_format_timestamp(buf, sizeof(buf), v->i - POSTGRES_EPOCH_USECS);
+				size = strlen(buf);
+				d = (double) v->i / USECS_PER_SEC;
+				break;
+
+			case VALUE_TEXT:
+				str = v->str;
+				size = v->size;
+				break;
+
+			case VALUE_BINARY:
+				/* hex is written directly to row buffer */
+				str = NULL;
+				size = 2 + 2 * v->size;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	builder_reserve(b, size + 1);
+	b->offsets[n] = b->used;
+
+	if (kind == VALUE_TEXT && !v->isnull)
+		size = copy_text(b->buffer + b->used, str, size);
+	else if (str)
+		memcpy(b->buffer + b->used, str, size);
+	else
+	{
+		const unsigned char *src = (const unsigned char *) v->str;
+		char	   *ptr = b->buffer + b->used;
+		int			i;
+
+		*ptr++ = '\\';
+		*ptr++ = 'x';
+
+		for (i = 0; i < v->size; i++)
+		{
+			*ptr++ = "0123456789abcdef"[src[i] >> 4];
+			*ptr++ = "0123456789abcdef"[src[i] & 0x0f];
+		}
+	}
+
+	b->buffer[b->used + size] = '\0';
+
+	if (v->isnull)
+		width = b->nullstr_width;
+	else if (kind == VALUE_TEXT)
+		width = text_width(b->buffer + b->used, size, &multiline);
+	else
+		width = size;
+
+	if (width > pdesc->widths[n])
+		pdesc->widths[n] = width;
+
+	pdesc->multilines[n] |= multiline;
+	b->multiline_row |= multiline;
+
+	if (b->typed[n])
+		typed_column_add(&b->typed_columns[n], v->isnull ? 0.0 : d, v->isnull);
+
+	if (is_number && isfinite(d))
+		colstats_add_number(&b->colstats[n], b->buffer + b->used, d);
+	else
+		colstats_add_value(&b->colstats[n], b->buffer + b->used, v->isnull);
+
+	b->used += size + 1;
+
+	free(numstr);
+}
+
+void
+builder_end_row(RowBuilder *b)
+{
+	RowBucketType *rb = b->current_rb;
+	RowType	   *row;
+	char	   *locbuf;
+	int			i;
+
+	locbuf = smalloc(b->used);
+	memcpy(locbuf, b->buffer, b->used);
+
+	row = smalloc(offsetof(RowType, fields) + b->nvalues * sizeof(char *));
+	row->nfields = b->nvalues;
+
+	/* first field holds allocated string */
+	for (i = 0; i < b->nvalues; i++)
+		row->fields[i] = locbuf + b->offsets[i];
+
+	if (rb->nrows >= LINEBUFFER_LINES)
+	{
+		RowBucketType *new = smalloc(sizeof(RowBucketType));
+
+		new->allocated = true;
+		rb->next_bucket = new;
+		rb = b->current_rb = new;
+	}
+
+	rb->multilines[rb->nrows] = b->multiline_row;
+	rb->rows[rb->nrows++] = row;
+
+	b->ninputs = 0;
+	b->nvalues = 0;
+	b->used = 0;
+	b->multiline_row = false;
+}
+
+/*
+ * Release all rows, when the data cannot be loaded
+ */
+void
+builder_free(RowBuilder *b, RowBucketType *rb)
+{
+	bool		is_first = true;
+
+	while (rb)
+	{
+		RowBucketType *nextrb = rb->next_bucket;
+		int			i;
+
+		for (i = 0; i < rb->nrows; i++)
+		{
+			RowType	   *r = rb->rows[i];
+
+			if (r->nfields > 0)
+				free(r->fields[0]);
+			free(r);
+		}
+
+		if (is_first)
+		{
+			rb->nrows = 0;
+			rb->next_bucket = NULL;
+		}
+		else
+			free(rb);
+
+		is_first = false;
+		rb = nextrb;
+	}
+
+	colstats_free(b->colstats, b->pdesc->nfields);
+	typed_columns_free(b->typed_columns, b->pdesc->nfields);
+	free(b->buffer);
+
+	memset(b->pdesc, 0, sizeof(PrintDataDesc));
+}
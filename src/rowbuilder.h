@@ -0,0 +1,102 @@
+/*-------------------------------------------------------------------------
+ *
+ * rowbuilder.h
+ *	  build rows of data read in native (not text) format
+ *
+ * Portions Copyright (c) 2017-2026 Pavel Stehule
+ *
+ * IDENTIFICATION
+ *	  src/rowbuilder.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PSPG_ROWBUILDER_H
+#define PSPG_ROWBUILDER_H
+
+#include <stdint.h>
+
+#include "pspg.h"
+
+#define USECS_PER_SEC				INT64_C(1000000)
+
+/*
+ * Values are received in native format (or already parsed). They are
+ * transformed to text only once, the display width of numbers, dates
+ * and timestamps is the length of text, and numeric values are stored
+ * to typed columns, so they are not parsed again by sort or by
+ * calculation of column statistics.
+ */
+
+typedef enum
+{
+	VALUE_NULL,
+	VALUE_INT,
+	VALUE_UINT,					/* unsigned 64bit integer */
+	VALUE_FLOAT4,
+	VALUE_FLOAT8,
+	VALUE_DECIMAL,				/* Arrow decimal (scaled integer) */
+	VALUE_NUMERIC,				/* binary numeric of Postgres */
+	VALUE_NUMBER,				/* number in text form (JSON), value in d */
+	VALUE_BOOL,
+	VALUE_DATE,					/* days from 1970-01-01 */
+	VALUE_TIME,					/* microseconds from midnight */
+	VALUE_TIMESTAMP,			/* microseconds from 1970-01-01 */
+	VALUE_TEXT,
+	VALUE_BINARY				/* displayed in hex format */
+} ValueKind;
+
+/*
+ * Native value of one field. Integers, booleans, dates, times and
+ * timestamps are stored in i, decimal is stored in i (high part)
+ * and u (low part).
+ */
+typedef struct
+{
+	bool		isnull;
+	int64_t		i;
+	uint64_t	u;
+	double		d;
+	const char *str;
+	int			size;
+} Value;
+
+/*
+ * Rows are stored in same format like rows of query result, so
+ * they are printed by same routine like csv or query result.
+ */
+/*
+ * Values of dropped columns (--columns, --exclude-columns) are not
+ * stored. Arrays kinds, scales and dropped are indexed by input column,
+ * others are indexed by displayed column.
+ */
+typedef struct
+{
+	Options	   *opts;
+	RowBucketType *current_rb;
+	PrintDataDesc *pdesc;
+	ColumnStats *colstats;
+	TypedColumn *typed_columns;
+	ValueKind	kinds[1024];
+	int			scales[1024];		/* scale of decimal columns */
+	bool		dropped[1024];		/* column is not loaded */
+	bool		typed[1024];
+	int			offsets[1024];		/* start of fields in buffer */
+	int			ninputs;			/* number of input values of current row */
+	int			nvalues;			/* number of values of current row */
+	char	   *buffer;
+	int			used;
+	int			size;
+	bool		multiline_row;
+	const char *nullstr;
+	int			nullstr_size;
+	int			nullstr_width;
+} RowBuilder;
+
+extern void builder_init(RowBuilder *b, Options *opts, RowBucketType *rb, PrintDataDesc *pdesc);
+extern bool builder_set_columns(RowBuilder *b, int nfields, const char **names);
+extern void builder_add(RowBuilder *b, Value *v);
+extern void builder_end_row(RowBuilder *b);
+extern void builder_free(RowBuilder *b, RowBucketType *rb);
+
+#endif
@@ -0,0 +1,452 @@
+/*-------------------------------------------------------------------------
+ *
+ * search.c
+ *	  searching based on regular expressions
+ *
+ * Portions Copyright (c) 2017-2026 Pavel Stehule
+ *
+ * IDENTIFICATION
+ *	  src/search.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <ctype.h>
+#include <regex.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pspg.h"
+#include "unicode.h"
+
+#define MAX_REQUIRED_LITERALS		8
+
+/*
+ * Compiled regular expression. The pattern is compiled only once, when
+ * searched term or case sensitivity is changed. Any match of the pattern
+ * should to contain at least one of required literals, so lines without
+ * these literals can be rejected by fast substring search, and the regexp
+ * automaton is started only for remaining lines.
+ */
+typedef struct
+{
+	char	pattern[256];
+	bool	ignore_case;
+	bool	is_valid;
+	regex_t	regex;
+	int		nliterals;				/* zero when prefiltering is not possible */
+	char	literals[MAX_REQUIRED_LITERALS][256];
+} SearchRegex;
+
+static SearchRegex sregex;
+
+/*
+ * POSIX ERE has not perl's escapes \d \s \w. These escapes are very
+ * common in user's patterns, so we translate it to POSIX classes.
+ */
+static bool
+translate_pattern(const char *pattern, char *dest, size_t destsize)
+{
+	bool	in_bracket = false;
+	size_t	used = 0;
+
+	while (*pattern)
+	{
+		const char *subst = NULL;
+
+		if (*pattern == '\\' && pattern[1] != '\0')
+		{
+			switch (pattern[1])
+			{
+				case 'd':
+					subst = in_bracket ? "0-9" : "[0-9]";
+					break;
+				case 'D':
+					subst = in_bracket ? NULL : "[^0-9]";
+					break;
+				case 's':
+					subst = in_bracket ? "[:space:]" : "[[:space:]]";
+					break;
+				case 'S':
+					subst = in_bracket ? NULL : "[^[:space:]]";
+					break;
+				case 'w':
+					subst = in_bracket ? "[:alnum:]_" : "[[:alnum:]_]";
+					break;
+				case 'W':
+					subst = in_bracket ? NULL : "[^[:alnum:]_]";
+					break;
+			}
+
+			if (subst)
+			{
+				size_t		len = strlen(subst);
+
+				if (used + len >= destsize)
+					return false;
+
+				memcpy(dest + used, subst, len);
+				used += len;
+				pattern += 2;
+				continue;
+			}
+		}
+
+		if (used + 2 >= destsize)
+			return false;
+
+		if (!in_bracket && *pattern == '[')
+		{
+			in_bracket = true;
+			dest[used++] = *pattern++;
+
+			/* leading ^ and ] are part of bracket expression */
+			if (*pattern == '^')
+				dest[used++] = *pattern++;
+			if (*pattern == ']' && used + 1 < destsize)
+				dest[used++] = *pattern++;
+
+			continue;
+		}
+		else if (in_bracket && *pattern == '[' &&
+				 (pattern[1] == ':' || pattern[1] == '.' || pattern[1] == '='))
+		{
+			const char *end = strchr(pattern + 2, ']');
+
+			/* copy character class like [:alpha:] as one token */
+			if (end)
+			{
+				size_t		len = end - pattern + 1;
+
+				if (used + len >= destsize)
+					return false;
+
+				memcpy(dest + used, pattern, len);
+				used += len;
+				pattern += len;
+				continue;
+			}
+		}
+		else if (in_bracket && *pattern == ']')
+			in_bracket = false;
+		else if (!in_bracket && *pattern == '\\' && pattern[1] != '\0')
+			dest[used++] = *pattern++;
+
+		dest[used++] = *pattern++;
+	}
+
+	dest[used] = '\0';
+
+	return true;
+}
+
+/*
+ * Returns pointer after bracket expression
+ */
+static const char *
+skip_bracket(const char *ptr)
+{
+	/* skip [ */
+	ptr += 1;
+
+	if (*ptr == '^')
+		ptr += 1;
+	if (*ptr == ']')
+		ptr += 1;
+
+	while (*ptr && *ptr != ']')
+	{
+		if (*ptr == '[' &&
+			(ptr[1] == ':' || ptr[1] == '.' || ptr[1] == '='))
+		{
+			const char *end = strchr(ptr + 2, ']');
+
+			if (end)
+			{
+				ptr = end + 1;
+				continue;
+			}
+		}
+
+		ptr += 1;
+	}
+
+	return *ptr ? ptr + 1 : ptr;
+}
+
+/*
+ * Returns pointer after group (with nested groups)
+ */
+static const char *
+skip_group(const char *ptr)
+{
+	int		level = 0;
+
+	while (*ptr)
+	{
+		if (*ptr == '\\' && ptr[1] != '\0')
+			ptr += 2;
+		else if (*ptr == '[')
+			ptr = skip_bracket(ptr);
+		else
+		{
+			if (*ptr == '(')
+				level += 1;
+			else if (*ptr == ')')
+			{
+				if (--level == 0)
+					return ptr + 1;
+			}
+
+			ptr += 1;
+		}
+	}
+
+	return ptr;
+}
+
+/*
+ * Search longest literal, that should be part of any match of the branch.
+ * The analyze is very simple - groups, bracket expressions and escaped
+ * classes breaks the literal, and the quantifiers that allow zero
+ * occurrences remove last atom from the literal.
+ */
+static int
+branch_required_literal(const char *start, const char *end, char *literal)
+{
+	char	current[256];
+	int		current_size = 0;
+	int		last_atom_size = 0;
+	int		literal_size = 0;
+	const char *ptr = start;
+
+	*literal = '\0';
+
+#define FLUSH_CURRENT() \
+	do { \
+		if (current_size > literal_size) \
+		{ \
+			memcpy(literal, current, current_size); \
+			literal[current_size] = '\0'; \
+			literal_size = current_size; \
+		} \
+		current_size = 0; \
+		last_atom_size = 0; \
+	} while (0)
+
+	while (ptr < end)
+	{
+		if (*ptr == '\\')
+		{
+			if (ptr + 1 >= end || isalnum((unsigned char) ptr[1]))
+			{
+				/* escaped classes, back references, word boundaries */
+				FLUSH_CURRENT();
+				ptr += 2;
+			}
+			else
+			{
+				current[current_size++] = ptr[1];
+				last_atom_size = 1;
+				ptr += 2;
+			}
+		}
+		else if (*ptr == '[')
+		{
+			FLUSH_CURRENT();
+			ptr = skip_bracket(ptr);
+		}
+		else if (*ptr == '(')
+		{
+			FLUSH_CURRENT();
+			ptr = skip_group(ptr);
+		}
+		else if (*ptr == '.' || *ptr == '^' || *ptr == '$')
+		{
+			FLUSH_CURRENT();
+			ptr += 1;
+		}
+		else if (*ptr == '*' || *ptr == '?' || *ptr == '{')
+		{
+			/* previous atom is optional or repeated */
+			current_size -= last_atom_size;
+			FLUSH_CURRENT();
+
+			if (*ptr == '{')
+			{
+				while (ptr < end && *ptr != '}')
+					ptr += 1;
+			}
+
+			ptr += 1;
+		}
+		else if (*ptr == '+')
+		{
+			FLUSH_CURRENT();
+			ptr += 1;
+		}
+		else
+		{
+			int		size = use_utf8 ? utf8charlen(*ptr) : 1;
+
+			if (ptr + size > end)
+				size = end - ptr;
+
+			memcpy(current + current_size, ptr, size);
+			current_size += size;
+			last_atom_size = size;
+			ptr += size;
+		}
+	}
+
+	FLUSH_CURRENT();
+
+#undef FLUSH_CURRENT
+
+	return literal_size;
+}
+
+/*
+ * Fill an array of required literals. When any top level branch has
+ * not required literal, then prefiltering is not possible.
+ */
+static void
+extract_required_literals(SearchRegex *sr)
+{
+	const char *ptr = sr->pattern;
+	const char *branch_start = ptr;
+
+	sr->nliterals = 0;
+
+	while (true)
+	{
+		if (*ptr == '|' || *ptr == '\0')
+		{
+			if (sr->nliterals == MAX_REQUIRED_LITERALS ||
+				branch_required_literal(branch_start, ptr, sr->literals[sr->nliterals]) == 0)
+			{
+				sr->nliterals = 0;
+				return;
+			}
+
+			sr->nliterals += 1;
+
+			if (*ptr == '\0')
+				break;
+
+			branch_start = ++ptr;
+		}
+		else if (*ptr == '\\' && ptr[1] != '\0')
+			ptr += 2;
+		else if (*ptr == '[')
+			ptr = skip_bracket(ptr);
+		else if (*ptr == '(')
+			ptr = skip_group(ptr);
+		else
+			ptr += 1;
+	}
+}
+
+/*
+ * Compile pattern when it is necessary. Returns false, and fills errbuf
+ * when pattern is not valid.
+ */
+bool
+prepare_search_regex(const char *pattern,
+					 bool ignore_case,
+					 char *errbuf,
+					 int errbuf_size)
+{
+	char	translated[2048];
+	int		rc;
+
+	if (sregex.is_valid &&
+		sregex.ignore_case == ignore_case &&
+		strcmp(sregex.pattern, pattern) == 0)
+		return true;
+
+	if (sregex.is_valid)
+	{
+		regfree(&sregex.regex);
+		sregex.is_valid = false;
+	}
+
+	if (!translate_pattern(pattern, translated, sizeof(translated)))
+	{
+		if (errbuf)
+			snprintf(errbuf, errbuf_size, "pattern is too long");
+
+		return false;
+	}
+
+	rc = regcomp(&sregex.regex, translated, REG_EXTENDED | (ignore_case ? REG_ICASE : 0));
+	if (rc != 0)
+	{
+		if (errbuf)
+			regerror(rc, &sregex.regex, errbuf, errbuf_size);
+
+		return false;
+	}
+
+	strncpy(sregex.pattern, pattern, sizeof(sregex.pattern) - 1);
+	sregex.pattern[sizeof(sregex.pattern) - 1] = '\0';
+	sregex.ignore_case = ignore_case;
+	sregex.is_valid = true;
+
+	extract_required_literals(&sregex);
+
+	log_row("regex search \"%s\" has %d required literal(s)", pattern, sregex.nliterals);
+
+	return true;
+}
+
+/*
+ * Returns pointer to first match of the pattern in str, and the size
+ * of match in bytes. The str can be part of line, then the anchor ^
+ * should not to match. The match can be empty, but returned pointer
+ * never points to end of string.
+ */
+const char *
+regex_search(const char *pattern,
+			 bool ignore_case,
+			 const char *line,
+			 const char *str,
+			 int *match_size)
+{
+	regmatch_t	pmatch;
+
+	if (!prepare_search_regex(pattern, ignore_case, NULL, 0))
+		return NULL;
+
+	if (sregex.nliterals > 0)
+	{
+		bool	found = false;
+		int		i;
+
+		for (i = 0; i < sregex.nliterals; i++)
+		{
+			const char *literal = sregex.literals[i];
+
+			if (ignore_case)
+				found = (use_utf8 ? utf8_nstrstr(str, literal) : nstrstr(str, literal)) != NULL;
+			else
+				found = strstr(str, literal) != NULL;
+
+			if (found)
+				break;
+		}
+
+		if (!found)
+			return NULL;
+	}
+
+	if (regexec(&sregex.regex, str, 1, &pmatch, str != line ? REG_NOTBOL : 0) != 0)
+		return NULL;
+
+	/* empty match on the end of string is useless */
+	if (pmatch.rm_so == pmatch.rm_eo && str[pmatch.rm_so] == '\0')
+		return NULL;
+
+	*match_size = pmatch.rm_eo - pmatch.rm_so;
+
+	return str + pmatch.rm_so;
+}
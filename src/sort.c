@@ -16,6 +16,8 @@
 
 #include "pspg.h"
 
+#define SWAP_SORTDATA(a, b)		do { SortData _tmp = (a); (a) = (b); (b) = _tmp; } while (0)
+
 static inline int
 signof(double n)
 {
@@ -76,6 +78,59 @@ compar_num_desc(const void *a, const void *b)
 	}
 }
 
+static void
+sift_down(SortData *heap, int n, int i, int (*compar)(const void *, const void *))
+{
+	while (true)
+	{
+		int		largest = i;
+		int		l = 2 * i + 1;
+		int		r = 2 * i + 2;
+
+		if (l < n && compar(&heap[l], &heap[largest]) > 0)
+			largest = l;
+		if (r < n && compar(&heap[r], &heap[largest]) > 0)
+			largest = r;
+
+		if (largest == i)
+			break;
+
+		SWAP_SORTDATA(heap[i], heap[largest]);
+		i = largest;
+	}
+}
+
+/*
+ * Moves k first items (in sort order) to the begin of sortbuf, and sort
+ * these items. Other items are not sorted. It uses bounded max heap, so
+ * the complexity is O(n log k).
+ */
+static void
+partial_sort(SortData *sortbuf, int rows, int k, int (*compar)(const void *, const void *))
+{
+	int		i;
+
+	if (k >= rows)
+	{
+		qsort(sortbuf, rows, sizeof(SortData), compar);
+		return;
+	}
+
+	for (i = k / 2 - 1; i >= 0; i--)
+		sift_down(sortbuf, k, i, compar);
+
+	for (i = k; i < rows; i++)
+	{
+		if (compar(&sortbuf[i], &sortbuf[0]) < 0)
+		{
+			SWAP_SORTDATA(sortbuf[i], sortbuf[0]);
+			sift_down(sortbuf, k, 0, compar);
+		}
+	}
+
+	qsort(sortbuf, k, sizeof(SortData), compar);
+}
+
 void
 sort_column_num(SortData *sortbuf, int rows, bool desc)
 {
@@ -132,3 +187,67 @@ sort_column_text(SortData *sortbuf, int rows, bool desc)
 {
 	qsort(sortbuf, rows, sizeof(SortData), desc ? compar_text_desc : compar_text_asc);
 }
+
+void
+sort_column_num_partial(SortData *sortbuf, int rows, int k, bool desc)
+{
+	partial_sort(sortbuf, rows, k, desc ? compar_num_desc : compar_num_asc);
+}
+
+void
+sort_column_text_partial(SortData *sortbuf, int rows, int k, bool desc)
+{
+	partial_sort(sortbuf, rows, k, desc ? compar_text_desc : compar_text_asc);
+}
+
+static SortSpec *multi_sort_spec = NULL;
+
+/*
+ * Compare composite keys. Every key can be numeric or text (all not null
+ * values of one column has same type). Nulls (and empty strings) are
+ * always last like for sort by one column. The original order is used
+ * when all keys are equal, so the sort is stable.
+ */
+static int
+compar_multi(const void *a, const void *b)
+{
+	SortData   *sda = (SortData *) a;
+	SortData   *sdb = (SortData *) b;
+	int			i;
+
+	for (i = 0; i < multi_sort_spec->nkeys; i++)
+	{
+		SortKey    *ka = &sda->keys[i];
+		SortKey    *kb = &sdb->keys[i];
+		int			result;
+
+		if (ka->info == INFO_UNKNOWN || kb->info == INFO_UNKNOWN)
+		{
+			if (ka->info == kb->info)
+				continue;
+
+			return ka->info == INFO_UNKNOWN ? 1 : -1;
+		}
+
+		if (ka->info == INFO_DOUBLE)
+			result = signof(ka->d - kb->d);
+		else
+			result = strcmp(ka->strxfrm, kb->strxfrm);
+
+		if (result != 0)
+			return multi_sort_spec->desc[i] ? -result : result;
+	}
+
+	/* keys are allocated in original order of rows */
+	return sda->keys < sdb->keys ? -1 : (sda->keys > sdb->keys ? 1 : 0);
+}
+
+void
+sort_multi_columns(SortData *sortbuf, int rows, SortSpec *spec)
+{
+	multi_sort_spec = spec;
+
+	qsort(sortbuf, rows, sizeof(SortData), compar_multi);
+
+	multi_sort_spec = NULL;
+}
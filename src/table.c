@@ -15,6 +15,8 @@
 #include <errno.h>
 #include <libgen.h>
 #include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -262,6 +264,68 @@ is_line_continuation_char(char *str, DataDesc *desc)
 	}
 }
 
+/*
+ * Returns true when the line of table has some continuation symbol
+ * (the record continues on next line).
+ */
+static bool
+has_continuation_symbol(DataDesc *desc, char *str)
+{
+	bool		border0 = (desc->border_type == 0);
+	bool		border1 = (desc->border_type == 1);
+	bool		border2 = (desc->border_type == 2);
+	int			pos = 0;
+
+	/*
+	 * This implementation doesn't support old-ascii format
+	 *
+	 * Note - processed string can be shorter than headline for last
+	 * column with pset border 1
+	 */
+	while (pos < desc->headline_char_size && *str != '\0')
+	{
+		if (border0)
+		{
+			if (pos + 1 == desc->headline_char_size)
+			{
+				char	*sym;
+
+				sym = str + charlen(str);
+				if (*sym != '\0')
+					return is_line_continuation_char(sym, desc);
+			}
+			else if (desc->headline_transl[pos] == 'I')
+			{
+				if (is_line_continuation_char(str, desc))
+					return true;
+			}
+		}
+		else if (border1)
+		{
+			if ((pos + 1 < desc->headline_char_size && desc->headline_transl[pos + 1] == 'I') ||
+				  (pos + 1 == desc->headline_char_size))
+			{
+				if (is_line_continuation_char(str, desc))
+					return true;
+			}
+		}
+		else if (border2)
+		{
+			if ((pos + 1 < desc->headline_char_size) &&
+				  (desc->headline_transl[pos + 1] == 'I' || desc->headline_transl[pos + 1] == 'R'))
+			{
+				if (is_line_continuation_char(str, desc))
+					return true;
+			}
+		}
+
+		pos += dsplen(str);
+		str += charlen(str);
+	}
+
+	return false;
+}
+
 static bool
 is_cmdtag(char *str)
 {
@@ -663,1561 +727,4346 @@ finish_deescape:
 }
 
 /*
- * Read data from file and fill DataDesc.
+ * Read next query from query stream, but only when some data are
+ * available already. The query is finished by row with only GS.
  */
-bool
-readfile(Options *opts, DataDesc *desc, StateData *state)
+char *
+read_stream_query(void)
 {
+	ExtStr		estr;
 	char	   *line = NULL;
 	size_t		len;
 	ssize_t		read;
-	int			nrows = 0;
-	int			stop_after_nrows = 0;
-	bool		completed = true;
-	bool		initial_run;
-	bool		progressive_load_mode;
-	LineBuffer *rows;
-	int		clen = -1;
-	void	   *tabptr;
-
-#ifdef DEBUG_PIPE
-
-	time_t		start_sec;
-	long		start_ms;
 
-	fprintf(debug_pipe, "readfile start\n");
-	current_time(&start_sec, &start_ms);
+	if (!f_data || !(f_data_opts & STREAM_IS_IN_NONBLOCKING_MODE))
+		return NULL;
 
-#endif
+	read = _getline(&line, &len, f_data, true, false);
+	if (read == -1)
+		return NULL;
 
-	progressive_load_mode = opts->progressive_load_mode;
+	InitExtStr(&estr);
 
-	if (!desc->initialized)
+	do
 	{
-		log_row("DataDesc is initialized");
-
-		desc->title[0] = '\0';
-		desc->title_rows = 0;
-		desc->border_top_row = -1;
-		desc->border_head_row = -1;
-		desc->border_bottom_row = -1;
-		desc->first_data_row = -1;
-		desc->last_data_row = -1;
-		desc->fallback_last_data_row = false;
-		desc->is_expanded_mode = false;
-		desc->headline_transl = NULL;
-		desc->cranges = NULL;
-		desc->columns = 0;
-		desc->footer_row = -1;
-		desc->alt_footer_row = -1;
-		desc->is_pgcli_fmt = false;
-		desc->namesline = NULL;
-		desc->order_map = NULL;
-		desc->total_rows = 0;
-		desc->load_data_rows = false;
+		if (read > 0 && line[read - 1] == '\n')
+			line[--read] = '\0';
 
-		desc->maxbytes = -1;
-		desc->maxx = -1;
+		if (read > 0 && line[read - 1] == '\r')
+			line[--read] = '\0';
 
-		memset(&desc->rows, 0, sizeof(LineBuffer));
-		desc->rows.prev = NULL;
-		desc->freeze_two_cols = false;
-		desc->multilines_already_tested = false;
-		desc->last_buffer = 0;
+		if ((read == 1 && *line == 0x1D) || (read == 0 && estr.len > 0))
+		{
+			free(line);
 
-		/* safe reset */
-		desc->filename[0] = '\0';
+			if (estr.len > 0)
+				return estr.data;
 
-		/* progress load mode */
-		desc->initialized = true;
-		desc->completed = false;
-	}
+			break;
+		}
 
-	nrows = desc->total_rows;
+		if (read > 0)
+			ExtStrAppendNewLine(&estr, line);
 
-	/*
-	 * DataDesc struct can be copied, and then has not
-	 * contain any self reference. So instead to set
-	 * last_buffer to &desc->rows, I use NULL as signal,
-	 * so no other line buffer was created (and used).
-	 */
-	rows = desc->last_buffer ? desc->last_buffer : &desc->rows;
+		free(line);
+		line = NULL;
 
-	state->errstr = NULL;
-	state->_errno = 0;
+		read = _getline(&line, &len, f_data, true, true);
+	} while (read != -1);
 
-	if (opts->pathname != NULL)
-	{
-		char	   *name;
+	free(estr.data);
 
-		name = basename(opts->pathname);
-		strncpy(desc->filename, name, 64);
-		desc->filename[64] = '\0';
-	}
+	return NULL;
+}
 
-	if (!f_data)
-		return false;
+/*
+ * Prepare map of display positions of loaded columns of tabular data
+ * in psql format. The positions of columns are taken from translated
+ * headline, the names of columns from names line. When some column
+ * should not be loaded, then desc->projection holds true for every
+ * display position that should be kept. Returns false, when no column
+ * should be loaded.
+ */
+static bool
+prepare_projection(Options *opts, DataDesc *desc, char *headline, char *namesline)
+{
+	DataDesc   *tmpdesc;
+	bool	   *hidden;
+	bool		result = true;
+	int			first_loaded = -1;
+	int			col = 0;
+	int			i;
 
-	clearerr(f_data);
+	desc->projection = NULL;
+	desc->projection_size = 0;
 
-	if (progressive_load_mode)
-	{
-		if (nrows == 0)
-			stop_after_nrows = max_int(2 * LINES, 500);
-		else
-			stop_after_nrows = nrows + 2000;
-	}
-	else
-	{
-		stop_after_nrows = -1;
-		desc->completed = true;
-	}
+	tmpdesc = smalloc(sizeof(DataDesc));
+	tmpdesc->border_top_row = desc->border_top_row;
+	tmpdesc->border_head_row = desc->border_head_row;
+	tmpdesc->headline = headline;
+	tmpdesc->headline_size = strlen(headline);
+	tmpdesc->namesline = namesline;
 
-	if (nrows == 0)
+	if (!translate_headline(tmpdesc))
 	{
-		/* detection truncating */
-		detect_file_truncation();
-		initial_run = true;
+		free(tmpdesc);
+		return true;
 	}
-	else
-		initial_run = false;
 
-	errno = 0;
-	read = _getline(&line, &len, f_data, f_data_opts & STREAM_IS_IN_NONBLOCKING_MODE, false);
-	if (read == -1)
-		return false;
+	hidden = smalloc(tmpdesc->columns * sizeof(bool));
 
-	do
+	for (i = 0; i < tmpdesc->columns; i++)
 	{
-		bool		is_unicode;
+		CRange	   *cr = &tmpdesc->cranges[i];
+		char	   *name = NULL;
 
-		if (line && read > 0 && line[read - 1] == '\n')
-		{
-			line[read - 1] = '\0';
-			read -= 1;
-		}
+		if (tmpdesc->namesline && cr->name_offset != -1)
+			name = sstrndup(tmpdesc->namesline + cr->name_offset, cr->name_size);
 
-		if (line && read > 0 && line[read - 1] == '\r')
-		{
-			line[read - 1] = '\0';
-			read -= 1;
-		}
+		hidden[i] = is_hidden_column(opts, name, i + 1);
+		if (!hidden[i] && first_loaded == -1)
+			first_loaded = i;
 
-		/*
-		 * In streaming mode go out when you find empty row.
-		 *
-		 * Attention: streaming mode can be used only for tabular data!!!
-		 * on nontabular data (plain text) we have not a possibility
-		 * to detect end of block. In theory we can wait sone time to
-		 * data, and after timeout we can alert end of block, but it
-		 * increase the time of data load (and complexity).
-		 *
-		 * So until we get more possibilities (some marks in stream),
-		 * it is better to hold stream mode as special case. I had an
-		 * idea to set stream mode as default, but it doesn't work with
-		 * non tabular data.
-		 *
-		 * Note: psql helps with it - it redirects only tabular data.
-		 *
-		 */
-		if (state->stream_mode && read == 0)
-		{
-			free(line);
+		free(name);
+	}
 
-			/* ignore this line if we are on second line - probably watch mode */
-			if (nrows == 1)
-				goto next_row;
+	if (first_loaded == -1)
+		result = false;
+	else if (memchr(hidden, true, tmpdesc->columns))
+	{
+		char	   *transl = tmpdesc->headline_transl;
 
-			break;
-		}
+		desc->projection_size = tmpdesc->headline_char_size;
+		desc->projection = smalloc(desc->projection_size * sizeof(bool));
 
-		read = remove_ansi_escape_seq(line, read);
-		if ((tabptr = memchr(line, '\t', read)))
+		/*
+		 * The separator before column is kept only when some previous
+		 * column is kept too. Outer borders are kept always.
+		 */
+		for (i = 0; i < desc->projection_size; i++)
 		{
-			int		tabcount = 1;
-			void   *endptr = line + read - 1;
-			char   *newline, *writeptr, *readptr;
-			int		total_dl = 0;
-
-			while ((tabptr = memchr(((char *) tabptr) + 1, '\t', endptr - tabptr)))
+			if (transl[i] == 'I')
 			{
-				tabcount += 1;
+				col += 1;
+				desc->projection[i] = !hidden[col] && col > first_loaded;
 			}
+			else if (transl[i] == 'L' || transl[i] == 'R')
+				desc->projection[i] = true;
+			else
+				desc->projection[i] = !hidden[col];
+		}
+	}
 
-			/* allocate enough memory for new line */
-			writeptr = newline = smalloc(read + tabcount * 8 + 1);
-			readptr = line;
+	free(hidden);
+	free(tmpdesc->headline_transl);
+	free(tmpdesc->cranges);
+	free(tmpdesc);
 
-			while (read > 0)
-			{
-				if (*readptr == '\t')
-				{
-					do
-					{
-						*writeptr++ = ' ';
-						total_dl += 1;
-					} while (total_dl % 8 != 0);
+	return result;
+}
 
-					read -= 1;
-					readptr += 1;
-				}
-				else
-				{
-					int		cl = charlen(readptr);
-					int		dl = dsplen(readptr);
+/*
+ * Returns new line that holds only chars on kept display positions.
+ * The original line is released.
+ */
+static char *
+project_line(DataDesc *desc, char *line, int *size)
+{
+	bool		keep_tail = desc->projection[desc->projection_size - 1];
+	char	   *result;
+	char	   *writeptr;
+	char	   *ptr = line;
+	char	   *endptr = line + *size;
+	int			pos = 0;
 
-					total_dl += dl;
-					memcpy(writeptr, readptr, cl);
-					writeptr += cl;
-					readptr += cl;
-					read -= cl;
-				}
-			}
+	writeptr = result = smalloc(*size + 1);
 
-			*writeptr = '\0';
+	while (ptr < endptr)
+	{
+		int			cl = charlen(ptr);
+		int			dl = dsplen(ptr);
 
-			free(line);
-			line = newline;
-			read = writeptr - newline;
-		}
+		/* protect against broken multibyte char on the end of line */
+		if (cl > endptr - ptr)
+			cl = endptr - ptr;
 
-		/* In query stream node exit when you find row with only GS - Group Separator */
-		if (opts->querystream && read == 1)
+		if (pos < desc->projection_size ? desc->projection[pos] : keep_tail)
 		{
-			if (*line == 0x1D)
-				break;
+			memcpy(writeptr, ptr, cl);
+			writeptr += cl;
 		}
 
-		/*
-		 * When Unicode border 2 is used, then we can save CPU cycles,
-		 * becase we can very well detect begin and end of table. Inside
-		 * the table we don't need to check display width.
-		 */
-		if (clen == -1 || !desc->load_data_rows)
-			clen = use_utf8 ? utf_string_dsplen(line, read) : read;
+		ptr += cl;
+		pos += dl > 0 ? dl : 0;
+	}
 
-		if (rows->nrows == LINEBUFFER_LINES)
-		{
-			LineBuffer *newrows = smalloc(sizeof(LineBuffer));
+	*writeptr = '\0';
+	*size = writeptr - result;
 
-			rows->next = newrows;
-			newrows->prev = rows;
-			rows = newrows;
-		}
+	free(line);
 
-		rows->rows[rows->nrows++] = line;
+	return srealloc(result, *size + 1);
+}
 
-		/*
-		 * The input file is not an table
-		 */
-		if (opts->querystream)
-		{
-			nrows += 1;
-			desc->last_row = nrows - 1;
-			goto next_row;
-		}
+/*
+ * psql prints number of rows like footer of table
+ */
+static bool
+is_rows_footer(const char *line, int size)
+{
+	return size > 2 && line[0] == '(' && isdigit(line[1]) && line[size - 1] == ')';
+}
 
-		/* save possible table name */
-		if (nrows == 0 && !isTopLeftChar(line))
-		{
-			strncpytrim(desc->title, line, 63, read);
-			desc->title_rows = 1;
-		}
+/*
+ * Append stored line to line buffers, and update size of data
+ */
+static void
+append_line(DataDesc *desc, LineBuffer **rows, int *nrows, char *line)
+{
+	int			size = strlen(line);
+	int			dl = use_utf8 ? utf_string_dsplen(line, size) : size;
 
-		if (desc->border_head_row == -1 && desc->border_top_row == -1 && isTopLeftChar(line))
-		{
-			desc->border_top_row = nrows;
-			desc->is_expanded_mode = is_expanded_header(line, NULL, NULL);
-			if (desc->is_expanded_mode)
-				desc->border_head_row = nrows;
-		}
-		else if (desc->border_head_row == -1 && isHeadLeftChar(line, &is_unicode))
-		{
-			desc->border_head_row = nrows;
+	if ((*rows)->nrows == LINEBUFFER_LINES)
+	{
+		LineBuffer *newrows = smalloc(sizeof(LineBuffer));
 
-			if (is_unicode)
-			{
-				desc->load_data_rows = true;
-				log_row("next row will be data row");
-			}
+		(*rows)->next = newrows;
+		newrows->prev = *rows;
+		*rows = newrows;
+	}
 
-			if (!desc->is_expanded_mode)
-				desc->is_expanded_mode = is_expanded_header(line, NULL, NULL);
+	(*rows)->rows[(*rows)->nrows++] = line;
 
-			/* title surely doesn't it there */
-			if ((!desc->is_expanded_mode && nrows == 1) ||
-			    (desc->is_expanded_mode && nrows == 0))
-			{
-				desc->title[0] = '\0';
-				desc->title_rows = 0;
-			}
-		}
-		else if (!desc->is_expanded_mode && desc->border_bottom_row == -1 && isBottomLeftChar(line))
-		{
-			desc->border_bottom_row = nrows;
-			desc->last_data_row = nrows - 1;
-			desc->fallback_last_data_row = false;
-			desc->load_data_rows = false;
-			log_row("next row will be desc row");
+	if (size + 1 > desc->maxbytes)
+		desc->maxbytes = size + 1;
 
-		}
-		else if (!desc->is_expanded_mode && desc->border_bottom_row != -1 && desc->footer_row == -1)
-		{
-			desc->footer_row = nrows;
-		}
-		else if (desc->is_expanded_mode && isBottomLeftChar(line))
-		{
-			/* Outer border is repeated in expanded mode, use last detected row */
-			desc->border_bottom_row = nrows;
-			desc->last_data_row = nrows - 1;
-			desc->fallback_last_data_row = false;
-			log_row("next row will be desc row");
-		}
+	if (dl > desc->maxx + 1)
+		desc->maxx = dl - 1;
 
-		if (!desc->is_expanded_mode && desc->border_head_row != -1 && desc->border_head_row < nrows
-			 && desc->alt_footer_row == -1)
-		{
-			if (*line != '\0' && *line != ' ')
-				desc->alt_footer_row = nrows;
-		}
+	if (*line)
+		desc->last_row = *nrows;
 
-		if ((int) len > desc->maxbytes)
-			desc->maxbytes = (int) len;
+	*nrows += 1;
+}
 
-		if ((int) clen > desc->maxx + 1)
-			desc->maxx = clen - 1;
+/*
+ * xorshift64* generator, the seed is fixed, so the sample is same
+ * for same data.
+ */
+static uint64_t
+capture_random(RowsCapture *capture)
+{
+	uint64_t	x = capture->random_state;
 
-		if ((int) clen > 1 || (clen == 1 && *line != '\n'))
-			desc->last_row = nrows;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	capture->random_state = x;
 
-		nrows += 1;
+	return x * UINT64_C(2685821657736338717);
+}
 
-		/* Detection of status rows */
-		if (nrows == 1 && is_cmdtag(line))
-			break;
+/*
+ * Returns new capture for options --max-rows, --tail or --sample.
+ */
+RowsCapture *
+create_capture(Options *opts)
+{
+	RowsCapture *capture = smalloc(sizeof(RowsCapture));
 
-next_row:
+	if (opts->max_rows)
+	{
+		capture->mode = 'm';
+		capture->size = opts->max_rows;
+	}
+	else if (opts->tail_rows)
+	{
+		capture->mode = 't';
+		capture->size = opts->tail_rows;
+	}
+	else
+	{
+		capture->mode = 's';
+		capture->size = opts->sample_rows;
+	}
 
-		line = NULL;
+	capture->random_state = UINT64_C(0x9E3779B97F4A7C15);
+	capture->current = CAPTURE_SKIP;
 
-		if (stop_after_nrows > 0 && nrows >= stop_after_nrows)
-		{
-			completed = false;
-			log_row("progressive load stop on %d row", nrows);
-			break;
-		}
+	return capture;
+}
 
-		if ((f_data_opts & STREAM_HAS_NOTIFY_SUPPORT) &&
-				nrows % 1000 == 0)
-		{
-			log_row("sleep 10ms per 1000 rows");
-			usleep(1000 * 10);
-		}
+static void
+free_captured_record(CapturedRecord *record)
+{
+	int			i;
 
-		read = _getline(&line, &len, f_data, f_data_opts & STREAM_IS_IN_NONBLOCKING_MODE, true);
-	} while (read != -1);
+	free(record->line);
 
-	desc->total_rows = nrows;
-	desc->last_buffer = rows != &desc->rows ? rows : NULL;
-	desc->completed = completed;
+	for (i = 0; i < record->nnext_lines; i++)
+		free(record->next_lines[i]);
 
-	if (errno && errno != EAGAIN)
+	free(record->next_lines);
+
+	if (record->row)
 	{
-		log_row("cannot to read from file (%s)", strerror(errno));
+		/* all fields are stored in one block */
+		if (record->row->nfields > 0)
+			free(record->row->fields[0]);
 
-		return false;
+		free(record->row);
 	}
 
-	/* used for file truncation detection */
-	save_file_position();
-
-	log_row("read rows %d", nrows);
-
-	if (opts->querystream)
-		goto final;
+	memset(record, 0, sizeof(CapturedRecord));
+}
 
-	if (initial_run)
+static void
+free_capture_layout(RowsCapture *capture)
+{
+	if (capture->layout)
 	{
-		/*
-		 * border headline cannot be higher than 1000, to simply find it
-		 * in first row block. Higher number is surelly wrong, probably
-		 * some comment.
-		 */
-		if (desc->border_top_row >= 100)
-			desc->border_top_row = -1;
-		if (desc->border_head_row >= 100)
-			desc->border_head_row = -1;
-
-		desc->headline_char_size = 0;
+		free(capture->layout->headline_transl);
+		free(capture->layout->cranges);
+		free(capture->layout);
+		capture->layout = NULL;
 	}
+}
 
-	if (desc->last_row != -1)
-		desc->maxy = desc->last_row;
+void
+free_capture(RowsCapture *capture)
+{
+	int			i;
 
-	if (desc->border_head_row != -1)
-	{
-		if (desc->border_head_row == 0 && !desc->is_expanded_mode)
-			goto broken_format;
+	if (!capture)
+		return;
 
-		if (desc->border_head_row >= LINEBUFFER_LINES)
-			goto broken_format;
+	for (i = 0; i < capture->nrecords; i++)
+		free_captured_record(&capture->records[i]);
 
-		desc->headline = desc->rows.rows[desc->border_head_row];
-		desc->headline_size = strlen(desc->headline);
+	free(capture->records);
+	free_capture_layout(capture);
+	free(capture);
+}
 
-		/*
-		 * fallback, but can be fixed later, when border_type
-		 * will be known.
-		 */
-		if (desc->last_data_row == -1 || desc->fallback_last_data_row)
+/*
+ * Process one data record. Returns CAPTURE_STORE, when the record
+ * should be stored (first rows), CAPTURE_SKIP, when the record should
+ * be released, else the position of record in ring or reservoir.
+ */
+int
+capture_record(RowsCapture *capture)
+{
+	long		seqno = capture->seen_rows++;
+	int			pos;
+
+	if (capture->mode == 'm')
+	{
+		if (capture->kept_rows < capture->size)
 		{
-			desc->last_data_row = desc->last_row - 1;
-			desc->fallback_last_data_row = true;
-			log_row("set fallback_last_data_row to %d", desc->last_data_row);
+			capture->kept_rows += 1;
+			return CAPTURE_STORE;
 		}
 
-		if (desc->border_head_row >= 1)
-			desc->namesline = desc->rows.rows[desc->border_head_row - 1];
+		return CAPTURE_SKIP;
 	}
-	else if (desc->is_expanded_mode && desc->border_top_row != -1)
+
+	if (capture->nrecords < capture->size)
 	{
-		desc->headline = desc->rows.rows[desc->border_top_row];
-		desc->headline_size = strlen(desc->headline);
+		if (capture->nrecords == capture->allocated)
+		{
+			capture->allocated = min_int(capture->allocated * 2 + 1024, capture->size);
+			capture->records = srealloc(capture->records,
+										capture->allocated * sizeof(CapturedRecord));
+		}
+
+		pos = capture->nrecords++;
+		memset(&capture->records[pos], 0, sizeof(CapturedRecord));
 	}
-	else if (desc->border_top_row != -1)
+	else if (capture->mode == 't')
 	{
-		/* note: desc->border_head_row should be always -1 */
-		desc->border_head_row = desc->border_top_row;
-		desc->headline = desc->rows.rows[desc->border_top_row];
-		desc->headline_size = strlen(desc->headline);
+		/* the oldest record is replaced */
+		pos = seqno % capture->size;
+		free_captured_record(&capture->records[pos]);
 	}
 	else
 	{
-broken_format:
+		/* reservoir sampling - the record replaces some record with probability size/seen */
+		uint64_t	r = capture_random(capture) % ((uint64_t) seqno + 1);
 
-		log_row("input format is not tabular");
-
-		desc->headline = NULL;
-		desc->headline_size = 0;
-		desc->headline_char_size = 0;
+		if (r >= (uint64_t) capture->size)
+			return CAPTURE_SKIP;
 
-		/* there are not a data set */
-		desc->last_data_row = desc->last_row;
-		desc->fallback_last_data_row = false;
-		desc->title_rows = 0;
-		desc->title[0] = '\0';
+		pos = r;
+		free_captured_record(&capture->records[pos]);
 	}
 
-final:
+	capture->records[pos].seqno = seqno;
 
-#ifdef DEBUG_PIPE
+	return pos;
+}
 
-	print_duration(start_sec, start_ms, "read file");
+/*
+ * Process one line of data. The lines of multiline record (detected by
+ * continuation symbols) are processed together. Returns true, when the
+ * line should be stored (first rows), otherwise the line is stored in
+ * ring or reservoir, or it is released.
+ */
+static bool
+capture_line(RowsCapture *capture, char *line)
+{
+	bool		continued = capture->continued;
 
-#endif
+	capture->continued = capture->layout &&
+						 has_continuation_symbol(capture->layout, line);
 
-#if defined(HAVE_INOTIFY) || defined(HAVE_KQUEUE)
+	if (!continued)
+	{
+		capture->current = capture_record(capture);
+
+		if (capture->current >= 0)
+		{
+			capture->records[capture->current].line = line;
+			return false;
+		}
+	}
+	else if (capture->current >= 0)
+	{
+		CapturedRecord *record = &capture->records[capture->current];
 
+		record->next_lines = srealloc(record->next_lines,
+									  (record->nnext_lines + 1) * sizeof(char *));
+		record->next_lines[record->nnext_lines++] = line;
+		return false;
+	}
 
-	if (completed && f_data_opts & STREAM_HAS_NOTIFY_SUPPORT) /* clean event buffer */
-		clean_notify_poll();
+	if (capture->current == CAPTURE_STORE)
+		return true;
 
-#endif
+	free(line);
+	return false;
+}
 
-	return true;
+static int
+compare_captured_records(const void *a, const void *b)
+{
+	long		seqno1 = ((const CapturedRecord *) a)->seqno;
+	long		seqno2 = ((const CapturedRecord *) b)->seqno;
+
+	return seqno1 < seqno2 ? -1 : (seqno1 > seqno2 ? 1 : 0);
 }
 
 /*
- * Translate from UTF8 to semantic characters.
+ * Captured records are stored in original order
  */
-bool
-translate_headline(DataDesc *desc)
+void
+sort_captured_records(RowsCapture *capture)
 {
-	char   *srcptr;
-	char   *destptr;
-	char   *last_black_char = NULL;
-	bool	broken_format = false;
-	int		processed_chars = 0;
-	bool	is_expanded_info = false;
-	bool	is_headerless = (desc->border_head_row == desc->border_top_row &&
-							 !desc->is_expanded_mode);
+	if (capture->nrecords > 1)
+		qsort(capture->records, capture->nrecords, sizeof(CapturedRecord), compare_captured_records);
+}
 
-	srcptr = desc->headline;
-	destptr = smalloc(desc->headline_size + 2);
+/*
+ * Store captured lines (in original order), when all data rows was
+ * processed.
+ */
+static void
+flush_capture(DataDesc *desc, LineBuffer **rows, int *nrows)
+{
+	RowsCapture *capture = desc->capture;
+	int			i, j;
 
-	desc->headline_transl = destptr;
+	sort_captured_records(capture);
 
-	desc->linestyle = 'a';
-	desc->border_type = 0;
+	for (i = 0; i < capture->nrecords; i++)
+	{
+		CapturedRecord *record = &capture->records[i];
 
-	desc->expanded_info_minx = -1;
+		append_line(desc, rows, nrows, record->line);
 
-	while (*srcptr != '\0' && *srcptr != '\n' && *srcptr != '\r')
-	{
-		/* only spaces can be after known right border */
-		if (last_black_char != NULL && *last_black_char == 'R')
-		{
-			if (*srcptr != ' ')
-			{
-				broken_format = true;
-				break;
-			}
-		}
+		for (j = 0; j < record->nnext_lines; j++)
+			append_line(desc, rows, nrows, record->next_lines[j]);
 
-		if (*srcptr != ' ')
+		free(record->next_lines);
+	}
+
+	if (capture->mode != 'm')
+		capture->kept_rows = capture->nrecords;
+
+	free(capture->records);
+	capture->records = NULL;
+	capture->nrecords = 0;
+	capture->allocated = 0;
+
+	free_capture_layout(capture);
+
+	capture->closed = true;
+
+	log_row("captured %ld rows from %ld rows", capture->kept_rows, capture->seen_rows);
+}
+
+/*
+ * Returns layout of table used for detection of multiline records,
+ * or NULL, when the layout of table is not known. The headline is
+ * border line below table header or top border of table without header.
+ */
+static DataDesc *
+capture_layout(DataDesc *desc, int lineno, char *headline)
+{
+	DataDesc   *layout;
+
+	layout = smalloc(sizeof(DataDesc));
+	layout->border_top_row = desc->border_top_row;
+	layout->border_head_row = lineno;
+	layout->headline = headline;
+	layout->headline_size = strlen(headline);
+
+	if (!translate_headline(layout))
+	{
+		free(layout->headline_transl);
+		free(layout->cranges);
+		free(layout);
+		return NULL;
+	}
+
+	/* the headline is owned by line buffer */
+	layout->headline = NULL;
+
+	return layout;
+}
+
+/*
+ * When there is not table header, then the capture starts from first
+ * row (or after top border of table without header). Already stored
+ * rows are processed again.
+ */
+static void
+start_capture(DataDesc *desc, LineBuffer **rows, int *nrows)
+{
+	int			first = desc->border_top_row != -1 ? desc->border_top_row + 1 : 0;
+	int			n = desc->rows.nrows;
+	int			i;
+
+	desc->capture->started = true;
+	desc->capture->tabular = desc->border_top_row != -1;
+
+	/* the top border is not in the first 100 rows, then it is broken */
+	if (desc->border_top_row >= 100)
+	{
+		desc->border_top_row = -1;
+		desc->capture->tabular = false;
+		first = 0;
+	}
+	else if (desc->capture->tabular)
+		desc->capture->layout = capture_layout(desc,
+											   desc->border_top_row,
+											   desc->rows.rows[desc->border_top_row]);
+
+	desc->rows.nrows = 0;
+	*rows = &desc->rows;
+	*nrows = 0;
+
+	desc->maxbytes = -1;
+	desc->maxx = -1;
+	desc->last_row = -1;
+
+	for (i = 0; i < n; i++)
+	{
+		char	   *line = desc->rows.rows[i];
+
+		if (desc->capture->tabular && i == desc->border_bottom_row)
+		{
+			/* captured rows are stored before the end of table */
+			flush_capture(desc, rows, nrows);
+			append_line(desc, rows, nrows, line);
+
+			desc->border_bottom_row = *nrows - 1;
+			desc->last_data_row = *nrows - 2;
+		}
+		else if (i < first || desc->capture->closed ||
+				 capture_line(desc->capture, line))
+			append_line(desc, rows, nrows, line);
+	}
+}
+
+/*
+ * Read data from file and fill DataDesc.
+ */
+bool
+readfile(Options *opts, DataDesc *desc, StateData *state)
+{
+	char	   *line = NULL;
+	size_t		len;
+	ssize_t		read;
+	int			nrows = 0;
+	int			stop_after_nrows = 0;
+	bool		completed = true;
+	bool		initial_run;
+	bool		progressive_load_mode;
+	bool		log_stream_mode;
+	bool		tail_preview;
+	LineBuffer *rows;
+	int		clen = -1;
+	int			skipped_rows = 0;
+	void	   *tabptr;
+	FILE	   *fp;
+	bool		is_nonblocking;
+
+#ifdef DEBUG_PIPE
+
+	time_t		start_sec;
+	long		start_ms;
+
+	fprintf(debug_pipe, "readfile start\n");
+	current_time(&start_sec, &start_ms);
+
+#endif
+
+	/* stream is processed like log, new lines are appended to data */
+	log_stream_mode = state->stream_mode && opts->stream_max_rows > 0;
+
+	/*
+	 * In log stream mode all available lines are read every time. The last
+	 * rows or the sample of rows are known after reading of all rows.
+	 */
+	progressive_load_mode = (opts->progressive_load_mode || state->load_in_background) &&
+							!log_stream_mode && !opts->tail_rows && !opts->sample_rows;
+
+	if (!desc->initialized)
+	{
+		log_row("DataDesc is initialized");
+
+		desc->title[0] = '\0';
+		desc->title_rows = 0;
+		desc->border_top_row = -1;
+		desc->border_head_row = -1;
+		desc->border_bottom_row = -1;
+		desc->first_data_row = -1;
+		desc->last_data_row = -1;
+		desc->fallback_last_data_row = false;
+		desc->is_expanded_mode = false;
+		desc->headline_transl = NULL;
+		desc->cranges = NULL;
+		desc->columns = 0;
+		desc->footer_row = -1;
+		desc->alt_footer_row = -1;
+		desc->is_pgcli_fmt = false;
+		desc->namesline = NULL;
+		desc->order_map = NULL;
+		desc->total_rows = 0;
+		desc->retired_rows = 0;
+		desc->load_data_rows = false;
+		desc->colstats = NULL;
+		desc->ncolstats = 0;
+		desc->typed_columns = NULL;
+		desc->ntyped_columns = 0;
+		desc->projection = NULL;
+		desc->projection_size = 0;
+		desc->capture = NULL;
+		desc->is_tail_preview = false;
+		desc->pending_load = NULL;
+
+		if ((opts->max_rows || opts->tail_rows || opts->sample_rows) &&
+			!log_stream_mode && !state->stream_mode && !opts->querystream)
+		{
+			desc->capture = create_capture(opts);
+		}
+
+		desc->maxbytes = -1;
+		desc->maxx = -1;
+
+		memset(&desc->rows, 0, sizeof(LineBuffer));
+		desc->rows.prev = NULL;
+		desc->freeze_two_cols = false;
+		desc->multilines_already_tested = false;
+		desc->last_buffer = 0;
+
+		/* safe reset */
+		desc->filename[0] = '\0';
+
+		/* progress load mode */
+		desc->initialized = true;
+		desc->completed = false;
+	}
+
+	nrows = desc->total_rows;
+
+	/*
+	 * DataDesc struct can be copied, and then has not
+	 * contain any self reference. So instead to set
+	 * last_buffer to &desc->rows, I use NULL as signal,
+	 * so no other line buffer was created (and used).
+	 */
+	rows = desc->last_buffer ? desc->last_buffer : &desc->rows;
+
+	state->errstr = NULL;
+	state->_errno = 0;
+
+	if (opts->pathname != NULL)
+	{
+		char	   *name;
+
+		name = basename(opts->pathname);
+		strncpy(desc->filename, name, 64);
+		desc->filename[64] = '\0';
+	}
+
+	/* the background loader reads file by own stream */
+	if (state->load_stream)
+	{
+		fp = state->load_stream;
+		is_nonblocking = false;
+	}
+	else
+	{
+		fp = f_data;
+		is_nonblocking = f_data_opts & STREAM_IS_IN_NONBLOCKING_MODE;
+	}
+
+	if (!fp)
+		return false;
+
+	clearerr(fp);
+
+	if (progressive_load_mode)
+	{
+		/* data not displayed yet can be loaded by larger parts */
+		if (state->load_in_background)
+			stop_after_nrows = nrows + 50000;
+		else if (nrows == 0)
+			stop_after_nrows = max_int(2 * LINES, 500);
+		else
+			stop_after_nrows = nrows + 2000;
+	}
+	else
+	{
+		stop_after_nrows = -1;
+		desc->completed = true;
+	}
+
+	if (nrows == 0)
+	{
+		/* detection truncating */
+		detect_file_truncation();
+		initial_run = true;
+	}
+	else
+		initial_run = false;
+
+	/*
+	 * With option --start-at-end, only first lines of regular file (for
+	 * detection of table header) and last lines are read in first run.
+	 */
+	tail_preview = state->start_at_end && initial_run && !log_stream_mode &&
+				   !state->stream_mode && !opts->querystream && !desc->capture &&
+				   opts->pathname;
+
+	errno = 0;
+	read = _getline(&line, &len, fp, is_nonblocking, false);
+	if (read == -1)
+	{
+		/* progressive load of file was stopped exactly on the end of file */
+		if (!initial_run && !state->stream_mode && !opts->querystream && feof(fp))
+			desc->completed = true;
+
+		return false;
+	}
+
+	do
+	{
+		bool		is_unicode;
+
+		if (line && read > 0 && line[read - 1] == '\n')
+		{
+			line[read - 1] = '\0';
+			read -= 1;
+		}
+
+		if (line && read > 0 && line[read - 1] == '\r')
+		{
+			line[read - 1] = '\0';
+			read -= 1;
+		}
+
+		/*
+		 * In streaming mode go out when you find empty row.
+		 *
+		 * Attention: streaming mode can be used only for tabular data!!!
+		 * on nontabular data (plain text) we have not a possibility
+		 * to detect end of block. In theory we can wait sone time to
+		 * data, and after timeout we can alert end of block, but it
+		 * increase the time of data load (and complexity).
+		 *
+		 * So until we get more possibilities (some marks in stream),
+		 * it is better to hold stream mode as special case. I had an
+		 * idea to set stream mode as default, but it doesn't work with
+		 * non tabular data.
+		 *
+		 * Note: psql helps with it - it redirects only tabular data.
+		 *
+		 */
+		if (state->stream_mode && !log_stream_mode && read == 0)
+		{
+			free(line);
+
+			/* ignore this line if we are on second line - probably watch mode */
+			if (nrows == 1)
+				goto next_row;
+
+			break;
+		}
+
+		read = remove_ansi_escape_seq(line, read);
+		if ((tabptr = memchr(line, '\t', read)))
+		{
+			int		tabcount = 1;
+			void   *endptr = line + read - 1;
+			char   *newline, *writeptr, *readptr;
+			int		total_dl = 0;
+
+			while ((tabptr = memchr(((char *) tabptr) + 1, '\t', endptr - tabptr)))
+			{
+				tabcount += 1;
+			}
+
+			/* allocate enough memory for new line */
+			writeptr = newline = smalloc(read + tabcount * 8 + 1);
+			readptr = line;
+
+			while (read > 0)
+			{
+				if (*readptr == '\t')
+				{
+					do
+					{
+						*writeptr++ = ' ';
+						total_dl += 1;
+					} while (total_dl % 8 != 0);
+
+					read -= 1;
+					readptr += 1;
+				}
+				else
+				{
+					int		cl = charlen(readptr);
+					int		dl = dsplen(readptr);
+
+					total_dl += dl;
+					memcpy(writeptr, readptr, cl);
+					writeptr += cl;
+					readptr += cl;
+					read -= cl;
+				}
+			}
+
+			*writeptr = '\0';
+
+			free(line);
+			line = newline;
+			read = writeptr - newline;
+		}
+
+		/* In query stream node exit when you find row with only GS - Group Separator */
+		if (opts->querystream && read == 1)
+		{
+			if (*line == 0x1D)
+				break;
+		}
+
+		/*
+		 * When Unicode border 2 is used, then we can save CPU cycles,
+		 * becase we can very well detect begin and end of table. Inside
+		 * the table we don't need to check display width.
+		 */
+		if (clen == -1 || !desc->load_data_rows)
+			clen = use_utf8 ? utf_string_dsplen(line, read) : read;
+
+		if (rows->nrows == LINEBUFFER_LINES)
+		{
+			LineBuffer *newrows = smalloc(sizeof(LineBuffer));
+
+			rows->next = newrows;
+			newrows->prev = rows;
+			rows = newrows;
+		}
+
+		rows->rows[rows->nrows++] = line;
+
+		/*
+		 * The input file is not an table
+		 */
+		if (opts->querystream)
+		{
+			nrows += 1;
+			desc->last_row = nrows - 1;
+			goto next_row;
+		}
+
+		/* the log has not table header, and table detection is skipped */
+		if (log_stream_mode)
+			goto row_size;
+
+		/* the rows of text are captured, and table detection is skipped */
+		if (desc->capture && desc->capture->started && !desc->capture->tabular)
+			goto capture;
+
+		/* save possible table name */
+		if (nrows == 0 && !isTopLeftChar(line))
+		{
+			strncpytrim(desc->title, line, 63, read);
+			desc->title_rows = 1;
+		}
+
+		if (desc->border_head_row == -1 && desc->border_top_row == -1 && isTopLeftChar(line))
+		{
+			desc->border_top_row = nrows;
+			desc->is_expanded_mode = is_expanded_header(line, NULL, NULL);
+			if (desc->is_expanded_mode)
+				desc->border_head_row = nrows;
+		}
+		else if (desc->border_head_row == -1 && isHeadLeftChar(line, &is_unicode))
+		{
+			desc->border_head_row = nrows;
+
+			if (is_unicode)
+			{
+				desc->load_data_rows = true;
+				log_row("next row will be data row");
+			}
+
+			if (!desc->is_expanded_mode)
+				desc->is_expanded_mode = is_expanded_header(line, NULL, NULL);
+
+			/* title surely doesn't it there */
+			if ((!desc->is_expanded_mode && nrows == 1) ||
+			    (desc->is_expanded_mode && nrows == 0))
+			{
+				desc->title[0] = '\0';
+				desc->title_rows = 0;
+			}
+		}
+		else if (!desc->is_expanded_mode && desc->border_bottom_row == -1 && isBottomLeftChar(line))
+		{
+			desc->border_bottom_row = nrows;
+			desc->last_data_row = nrows - 1;
+			desc->fallback_last_data_row = false;
+			desc->load_data_rows = false;
+			log_row("next row will be desc row");
+
+		}
+		else if (!desc->is_expanded_mode && desc->border_bottom_row != -1 && desc->footer_row == -1)
+		{
+			desc->footer_row = nrows;
+		}
+		else if (desc->is_expanded_mode && isBottomLeftChar(line))
+		{
+			/* Outer border is repeated in expanded mode, use last detected row */
+			desc->border_bottom_row = nrows;
+			desc->last_data_row = nrows - 1;
+			desc->fallback_last_data_row = false;
+			log_row("next row will be desc row");
+		}
+
+		/*
+		 * When some columns should not be loaded (--columns, --exclude-columns),
+		 * then the lines of table are cut, and only chars of loaded columns
+		 * are stored. The positions of columns are known from the headline,
+		 * so already stored lines of table header are cut too.
+		 */
+		if (desc->border_head_row == nrows && !desc->is_expanded_mode &&
+			(opts->columns || opts->exclude_columns) &&
+			nrows >= 1 && rows == &desc->rows)
+		{
+			if (!prepare_projection(opts, desc, line, desc->rows.rows[nrows - 1]))
+			{
+				state->errstr = "no column is selected";
+				return false;
+			}
+
+			if (desc->projection)
+			{
+				int			i;
+
+				desc->maxbytes = -1;
+				desc->maxx = -1;
+
+				for (i = 0; i <= nrows; i++)
+				{
+					int			size = strlen(desc->rows.rows[i]);
+
+					if (i >= (desc->border_top_row != -1 ? desc->border_top_row : nrows - 1))
+						desc->rows.rows[i] = project_line(desc, desc->rows.rows[i], &size);
+
+					/* the current line is processed later */
+					if (i < nrows)
+					{
+						int			dl = use_utf8 ? utf_string_dsplen(desc->rows.rows[i], size) : size;
+
+						if (size + 1 > desc->maxbytes)
+							desc->maxbytes = size + 1;
+
+						if (dl > desc->maxx + 1)
+							desc->maxx = dl - 1;
+					}
+					else
+						read = size;
+				}
+
+				line = desc->rows.rows[nrows];
+				len = read + 1;
+				clen = use_utf8 ? utf_string_dsplen(line, read) : read;
+			}
+		}
+		else if (desc->projection)
+		{
+			/* the projection is used only for lines of table */
+			if (read == 0 || is_rows_footer(line, read))
+			{
+				free(desc->projection);
+				desc->projection = NULL;
+			}
+			else
+			{
+				int			size = read;
+
+				line = project_line(desc, line, &size);
+				rows->rows[rows->nrows - 1] = line;
+				read = size;
+				len = read + 1;
+				clen = use_utf8 ? utf_string_dsplen(line, read) : read;
+
+				if (desc->border_bottom_row == nrows)
+				{
+					free(desc->projection);
+					desc->projection = NULL;
+				}
+			}
+		}
+
+capture:
+
+		/*
+		 * Only some data rows are stored (--max-rows, --tail, --sample).
+		 * The rows of table header and footer are stored always.
+		 */
+		if (desc->capture && !desc->capture->closed)
+		{
+			RowsCapture *capture = desc->capture;
+
+			if (!capture->started)
+			{
+				if (desc->border_head_row == nrows && !desc->is_expanded_mode)
+				{
+					capture->started = true;
+					capture->tabular = true;
+					capture->layout = capture_layout(desc, nrows, line);
+				}
+				else if (desc->border_head_row == -1 && nrows >= 100 && rows == &desc->rows)
+				{
+					/* there is not table header, all rows are data rows */
+					start_capture(desc, &rows, &nrows);
+					goto next_row;
+				}
+			}
+			else if (capture->tabular &&
+					 (desc->border_bottom_row == nrows || desc->border_head_row == nrows ||
+					  read == 0 || is_rows_footer(line, read)))
+			{
+				bool		is_bottom_row = desc->border_bottom_row == nrows;
+				bool		is_head_row = desc->border_head_row == nrows;
+
+				/* captured rows are stored before the end of table */
+				rows->nrows -= 1;
+				flush_capture(desc, &rows, &nrows);
+
+				if (rows->nrows == LINEBUFFER_LINES)
+				{
+					LineBuffer *newrows = smalloc(sizeof(LineBuffer));
+
+					rows->next = newrows;
+					newrows->prev = rows;
+					rows = newrows;
+				}
+
+				rows->rows[rows->nrows++] = line;
+
+				if (is_bottom_row)
+				{
+					desc->border_bottom_row = nrows;
+					desc->last_data_row = nrows - 1;
+				}
+				else if (is_head_row)
+					desc->border_head_row = nrows;
+			}
+			else if (!capture_line(capture, line))
+			{
+				/* the line is not stored in line buffer */
+				rows->nrows -= 1;
+				skipped_rows += 1;
+				goto next_row;
+			}
+		}
+
+		if (!desc->is_expanded_mode && desc->border_head_row != -1 && desc->border_head_row < nrows
+			 && desc->alt_footer_row == -1)
+		{
+			if (*line != '\0' && *line != ' ')
+				desc->alt_footer_row = nrows;
+		}
+
+row_size:
+
+		if ((int) len > desc->maxbytes)
+			desc->maxbytes = (int) len;
+
+		if ((int) clen > desc->maxx + 1)
+			desc->maxx = clen - 1;
+
+		if ((int) clen > 1 || (clen == 1 && *line != '\n'))
+			desc->last_row = nrows;
+
+		nrows += 1;
+
+		/* Detection of status rows */
+		if (nrows == 1 && !log_stream_mode && is_cmdtag(line))
+			break;
+
+next_row:
+
+		line = NULL;
+
+		if (tail_preview && (desc->border_head_row != -1 || nrows >= 100))
+		{
+			off_t		offset = get_tail_lines_offset(LINEBUFFER_LINES);
+
+			if (offset != -1 && fseeko(f_data, offset, SEEK_SET) == 0)
+			{
+				log_row("the middle of file is skipped");
+				desc->is_tail_preview = true;
+
+				/* the last lines are displayed immediately */
+				stop_after_nrows = -1;
+			}
+
+			tail_preview = false;
+		}
+
+		if (stop_after_nrows > 0 &&
+			(nrows >= stop_after_nrows || skipped_rows >= 100000))
+		{
+			completed = false;
+			log_row("progressive load stop on %d row", nrows);
+			break;
+		}
+
+		if ((f_data_opts & STREAM_HAS_NOTIFY_SUPPORT) && !state->load_in_background &&
+				(nrows + skipped_rows) % 1000 == 0)
+		{
+			log_row("sleep 10ms per 1000 rows");
+			usleep(1000 * 10);
+		}
+
+		/* log has not end of block, so we read only available lines */
+		read = _getline(&line, &len, fp, is_nonblocking, !log_stream_mode);
+	} while (read != -1);
+
+	/* all rows are read, captured rows can be stored */
+	if (completed && desc->capture && !desc->capture->closed)
+	{
+		if (!desc->capture->started &&
+			desc->border_head_row == -1 && rows == &desc->rows)
+			start_capture(desc, &rows, &nrows);
+
+		if (!desc->capture->closed)
+			flush_capture(desc, &rows, &nrows);
+	}
+
+	desc->total_rows = nrows;
+	desc->last_buffer = rows != &desc->rows ? rows : NULL;
+	desc->completed = completed;
+
+	if (errno && errno != EAGAIN)
+	{
+		log_row("cannot to read from file (%s)", strerror(errno));
+
+		return false;
+	}
+
+	/* used for file truncation detection */
+	if (!state->load_stream)
+		save_file_position();
+
+	log_row("read rows %d", nrows);
+
+	if (opts->querystream)
+		goto final;
+
+	if (initial_run)
+	{
+		/*
+		 * border headline cannot be higher than 1000, to simply find it
+		 * in first row block. Higher number is surelly wrong, probably
+		 * some comment.
+		 */
+		if (desc->border_top_row >= 100)
+			desc->border_top_row = -1;
+		if (desc->border_head_row >= 100)
+			desc->border_head_row = -1;
+
+		desc->headline_char_size = 0;
+	}
+
+	if (desc->last_row != -1)
+		desc->maxy = desc->last_row;
+
+	if (desc->border_head_row != -1)
+	{
+		if (desc->border_head_row == 0 && !desc->is_expanded_mode)
+			goto broken_format;
+
+		if (desc->border_head_row >= LINEBUFFER_LINES)
+			goto broken_format;
+
+		desc->headline = desc->rows.rows[desc->border_head_row];
+		desc->headline_size = strlen(desc->headline);
+
+		/*
+		 * fallback, but can be fixed later, when border_type
+		 * will be known.
+		 */
+		if (desc->last_data_row == -1 || desc->fallback_last_data_row)
+		{
+			desc->last_data_row = desc->last_row - 1;
+			desc->fallback_last_data_row = true;
+			log_row("set fallback_last_data_row to %d", desc->last_data_row);
+		}
+
+		if (desc->border_head_row >= 1)
+			desc->namesline = desc->rows.rows[desc->border_head_row - 1];
+	}
+	else if (desc->is_expanded_mode && desc->border_top_row != -1)
+	{
+		desc->headline = desc->rows.rows[desc->border_top_row];
+		desc->headline_size = strlen(desc->headline);
+	}
+	else if (desc->border_top_row != -1)
+	{
+		/* note: desc->border_head_row should be always -1 */
+		desc->border_head_row = desc->border_top_row;
+		desc->headline = desc->rows.rows[desc->border_top_row];
+		desc->headline_size = strlen(desc->headline);
+	}
+	else
+	{
+broken_format:
+
+		log_row("input format is not tabular");
+
+		desc->headline = NULL;
+		desc->headline_size = 0;
+		desc->headline_char_size = 0;
+
+		/* there are not a data set */
+		desc->last_data_row = desc->last_row;
+		desc->fallback_last_data_row = false;
+		desc->title_rows = 0;
+		desc->title[0] = '\0';
+	}
+
+final:
+
+#ifdef DEBUG_PIPE
+
+	print_duration(start_sec, start_ms, "read file");
+
+#endif
+
+#if defined(HAVE_INOTIFY) || defined(HAVE_KQUEUE)
+
+
+	if (completed && !state->load_stream &&
+		f_data_opts & STREAM_HAS_NOTIFY_SUPPORT) /* clean event buffer */
+		clean_notify_poll();
+
+#endif
+
+	return true;
+}
+
+/*
+ * After tail preview (option --start-at-end) the complete file is loaded
+ * by background thread. The thread reads the file by own stream, and it
+ * uses own copy of options and state, so it doesn't modify any shared
+ * data. The loaded data replaces the tail preview when the load is
+ * finished.
+ */
+typedef struct PendingLoad
+{
+	pthread_t	thread;
+	pthread_mutex_t mutex;
+
+	Options		opts;				/* copy of options */
+	StateData	state;				/* copy of state */
+	DataDesc	desc;				/* loaded data */
+	off_t		size;				/* size of file */
+
+	/* following fields are protected by mutex */
+	int			percent;			/* read part of file */
+	bool		canceled;
+	bool		finished;
+} PendingLoad;
+
+static void *
+load_worker(void *arg)
+{
+	PendingLoad *pl = (PendingLoad *) arg;
+	bool		canceled = false;
+
+	/* the file is read by large parts, so the cancel can be checked */
+	while (!canceled)
+	{
+		bool		res = readfile(&pl->opts, &pl->desc, &pl->state);
+		off_t		pos = ftello(pl->state.load_stream);
+
+		pthread_mutex_lock(&pl->mutex);
+
+		if (pos != -1 && pl->size > 0)
+			pl->percent = pos < pl->size ? (int) (pos * 100 / pl->size) : 100;
+
+		canceled = pl->canceled;
+
+		pthread_mutex_unlock(&pl->mutex);
+
+		if (!res || pl->desc.completed)
+			break;
+	}
+
+	pthread_mutex_lock(&pl->mutex);
+	pl->finished = true;
+	pthread_mutex_unlock(&pl->mutex);
+
+	return NULL;
+}
+
+/*
+ * Starts load of complete file in background thread. When the file
+ * cannot be opened again, the tail preview is used as data. When the
+ * thread cannot be started, the file is loaded immediately.
+ */
+void
+start_background_load(Options *opts, StateData *state, DataDesc *desc)
+{
+	PendingLoad *pl;
+	struct stat stats1, stats2;
+	sigset_t	fullset, oldset;
+	FILE	   *fp;
+	int			res;
+
+	fp = fopen(opts->pathname, "r");
+	if (!fp)
+	{
+		log_row("cannot to open file \"%s\" (%s)", opts->pathname, strerror(errno));
+		desc->is_tail_preview = false;
+		return;
+	}
+
+	/* the file should be same as displayed file */
+	if (!f_data ||
+		fstat(fileno(fp), &stats1) != 0 ||
+		fstat(fileno(f_data), &stats2) != 0 ||
+		stats1.st_dev != stats2.st_dev ||
+		stats1.st_ino != stats2.st_ino)
+	{
+		log_row("file \"%s\" was replaced, complete load is canceled", opts->pathname);
+		fclose(fp);
+		desc->is_tail_preview = false;
+		return;
+	}
+
+	pl = smalloc(sizeof(PendingLoad));
+
+	memcpy(&pl->opts, opts, sizeof(Options));
+	memcpy(&pl->state, state, sizeof(StateData));
+
+	pl->state.start_at_end = false;
+	pl->state.load_in_background = true;
+	pl->state.load_stream = fp;
+	pl->size = stats1.st_size;
+
+	desc->pending_load = pl;
+
+	pthread_mutex_init(&pl->mutex, NULL);
+
+	/* signals should be processed by main thread only */
+	sigfillset(&fullset);
+	pthread_sigmask(SIG_SETMASK, &fullset, &oldset);
+
+	res = pthread_create(&pl->thread, NULL, load_worker, pl);
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+	if (res != 0)
+	{
+		log_row("cannot to start load thread (%s)", strerror(res));
+
+		(void) load_worker(pl);
+		pl->thread = pthread_self();
+	}
+}
+
+/*
+ * Returns true, when the background load is finished. The percent
+ * of read file is returned by percent.
+ */
+bool
+background_load_finished(DataDesc *desc, int *percent)
+{
+	PendingLoad *pl = desc->pending_load;
+	bool		finished;
+
+	if (!pl)
+		return false;
+
+	pthread_mutex_lock(&pl->mutex);
+	finished = pl->finished;
+
+	if (percent)
+		*percent = pl->percent;
+
+	pthread_mutex_unlock(&pl->mutex);
+
+	return finished;
+}
+
+/*
+ * Release pending load. When release_data is true, then loaded data
+ * are released too.
+ */
+static void
+free_pending_load(DataDesc *desc, bool release_data)
+{
+	PendingLoad *pl = desc->pending_load;
+
+	if (!pthread_equal(pl->thread, pthread_self()))
+		pthread_join(pl->thread, NULL);
+
+	if (release_data)
+	{
+		lb_free(&pl->desc);
+		free(pl->desc.projection);
+		free_capture(pl->desc.capture);
+	}
+
+	pthread_mutex_destroy(&pl->mutex);
+
+	fclose(pl->state.load_stream);
+	free(pl);
+
+	desc->pending_load = NULL;
+}
+
+/*
+ * Waits for background load, and returns true, when the complete file
+ * was loaded. Then loaded data are moved to "loaded". Else partially
+ * loaded data are released, and the tail preview is used as data.
+ */
+bool
+finish_background_load(DataDesc *desc, DataDesc *loaded)
+{
+	PendingLoad *pl = desc->pending_load;
+	bool		completed;
+
+	if (!pl)
+		return false;
+
+	if (!pthread_equal(pl->thread, pthread_self()))
+	{
+		pthread_join(pl->thread, NULL);
+		pl->thread = pthread_self();
+	}
+
+	completed = pl->desc.completed;
+
+	if (completed)
+	{
+		memcpy(loaded, &pl->desc, sizeof(DataDesc));
+
+		/* first line buffer is part of DataDesc */
+		if (loaded->rows.next)
+			loaded->rows.next->prev = &loaded->rows;
+	}
+	else
+		log_row("cannot to load complete file");
+
+	free_pending_load(desc, !completed);
+
+	desc->is_tail_preview = false;
+
+	return completed;
+}
+
+/*
+ * Stops load of complete file (when it is running), and releases
+ * loaded data.
+ */
+void
+discard_background_load(DataDesc *desc)
+{
+	PendingLoad *pl = desc->pending_load;
+
+	if (!pl)
+		return;
+
+	pthread_mutex_lock(&pl->mutex);
+	pl->canceled = true;
+	pthread_mutex_unlock(&pl->mutex);
+
+	free_pending_load(desc, true);
+
+	log_row("load of complete file in background was canceled");
+}
+
+/*
+ * Translate from UTF8 to semantic characters.
+ */
+bool
+translate_headline(DataDesc *desc)
+{
+	char   *srcptr;
+	char   *destptr;
+	char   *last_black_char = NULL;
+	bool	broken_format = false;
+	int		processed_chars = 0;
+	bool	is_expanded_info = false;
+	bool	is_headerless = (desc->border_head_row == desc->border_top_row &&
+							 !desc->is_expanded_mode);
+
+	srcptr = desc->headline;
+	destptr = smalloc(desc->headline_size + 2);
+
+	desc->headline_transl = destptr;
+
+	desc->linestyle = 'a';
+	desc->border_type = 0;
+
+	desc->expanded_info_minx = -1;
+
+	while (*srcptr != '\0' && *srcptr != '\n' && *srcptr != '\r')
+	{
+		/* only spaces can be after known right border */
+		if (last_black_char != NULL && *last_black_char == 'R')
+		{
+			if (*srcptr != ' ')
+			{
+				broken_format = true;
+				break;
+			}
+		}
+
+		if (*srcptr != ' ')
 			last_black_char = destptr;
 
-		if (desc->is_expanded_mode && *srcptr == '[')
-		{
-			if (desc->expanded_info_minx != -1)
-			{
-				broken_format = true;
-				break;
-			}
+		if (desc->is_expanded_mode && *srcptr == '[')
+		{
+			if (desc->expanded_info_minx != -1)
+			{
+				broken_format = true;
+				break;
+			}
+
+			/* entry to expanded info mode */
+			is_expanded_info = true;
+			desc->expanded_info_minx = processed_chars;
+
+			*destptr++ = 'd';
+			srcptr += charlen(srcptr);
+		}
+		else if (is_expanded_info)
+		{
+			if (*srcptr == ']')
+			{
+				is_expanded_info = false;
+			}
+			*destptr++ = 'd';
+			srcptr += charlen(srcptr);
+		}
+		else if (strncmp(srcptr, "\342\224\214", 3) == 0 || /* ┌ */
+				 strncmp(srcptr, "\342\225\224", 3) == 0 || /* ╔ */
+				 strncmp(srcptr, "\342\224\217", 3) == 0 || /* ┏ */
+				 strncmp(srcptr, "\342\225\255", 3) == 0)	/* ╭ */
+		{
+			/* should be expanded mode */
+			if (processed_chars > 0 ||
+				(!desc->is_expanded_mode && !is_headerless))
+			{
+				broken_format = true;
+				break;
+			}
+			desc->linestyle = 'u';
+			desc->border_type = 2;
+			*destptr++ = 'L';
+			srcptr += 3;
+		}
+		else if (strncmp(srcptr, "\342\224\220", 3) == 0 || /* ┐ */
+				 strncmp(srcptr, "\342\225\227", 3) == 0 || /* ╗ */
+				 strncmp(srcptr, "\342\224\223", 3) == 0 || /* ┓ */
+				 strncmp(srcptr, "\342\225\256", 3) == 0)	/* ╮ */
+		{
+			if (desc->linestyle != 'u' || desc->border_type != 2 ||
+				(!desc->is_expanded_mode  && !is_headerless))
+			{
+				broken_format = true;
+				break;
+			}
+			*destptr++ = 'R';
+			srcptr += 3;
+		}
+		else if (strncmp(srcptr, "\342\224\254", 3) == 0 || /* ┬╤ */
+				 strncmp(srcptr, "\342\225\244", 3) == 0 ||
+				 strncmp(srcptr, "\342\225\245", 3) == 0 || /* ╥╦ */
+				 strncmp(srcptr, "\342\225\246", 3) == 0 ||
+				 strncmp(srcptr, "\342\224\263", 3) == 0)	/* ┳ */
+		{
+			if (desc->linestyle != 'u' ||
+				(!desc->is_expanded_mode  && !is_headerless))
+			{
+				broken_format = true;
+				break;
+			}
+			if (desc->border_type == 0)
+				desc->border_type = 1;
+
+			*destptr++ = 'I';
+			srcptr += 3;
+		}
+		else if (strncmp(srcptr, "\342\224\234", 3) == 0 || /* ├╟ */
+				 strncmp(srcptr, "\342\225\237", 3) == 0 ||
+				 strncmp(srcptr, "\342\225\236", 3) == 0 || /* ╞╠ */
+				 strncmp(srcptr, "\342\225\240", 3) == 0 ||
+				 strncmp(srcptr, "\342\224\243", 3) == 0)	/* ┣ */
+		{
+			if (processed_chars > 0)
+			{
+				broken_format = true;
+				break;
+			}
+			desc->linestyle = 'u';
+			desc->border_type = 2;
+			*destptr++ = 'L';
+			srcptr += 3;
+		}
+		else if (strncmp(srcptr, "\342\224\244", 3) == 0 || /* ┤╢ */
+				 strncmp(srcptr, "\342\225\242", 3) == 0 ||
+				 strncmp(srcptr, "\342\225\241", 3) == 0 || /* ╡╣ */
+				 strncmp(srcptr, "\342\225\243", 3) == 0 ||
+				 strncmp(srcptr, "\342\224\253", 3) == 0)	/* ┫ */
+		{
+			if (desc->linestyle != 'u' || desc->border_type != 2)
+			{
+				broken_format = true;
+				break;
+			}
+			*destptr++ = 'R';
+			srcptr += 3;
+		}
+		else if (strncmp(srcptr, "\342\224\274", 3) == 0 || /* ┼╪ */
+				 strncmp(srcptr, "\342\225\252", 3) == 0 ||
+				 strncmp(srcptr, "\342\225\253", 3) == 0 || /* ╫╬ */
+				 strncmp(srcptr, "\342\225\254", 3) == 0 ||
+				 strncmp(srcptr, "\342\225\213", 3) == 0)	/* ╋ */
+		{
+			if (desc->linestyle != 'u')
+			{
+				broken_format = true;
+				break;
+			}
+			if (desc->border_type == 0)
+				desc->border_type = 1;
+			*destptr++ = 'I';
+			srcptr += 3;
+		}
+		else if (strncmp(srcptr, "\342\224\200", 3) == 0 || /* ─ */
+				 strncmp(srcptr, "\342\225\220", 3) == 0 || /* ═ */
+				 strncmp(srcptr, "\342\224\201", 3) == 0)	/* ━ */
+		{
+			if (processed_chars == 0)
+			{
+				desc->linestyle = 'u';
+			}
+			else if (desc->linestyle != 'u')
+			{
+				broken_format = true;
+				break;
+			}
+			*destptr++ = 'd';
+			srcptr += 3;
+		}
+		else if (*srcptr == '+' || *srcptr == ':')
+		{
+			if (processed_chars == 0)
+			{
+				*destptr++ = 'L';
+				desc->linestyle = 'a';
+				desc->border_type = 2;
+			}
+			else
+			{
+				if (desc->linestyle != 'a')
+				{
+					broken_format = true;
+					break;
+				}
+				if (desc->border_type == 0)
+					desc->border_type = 1;
+
+				*destptr++ = (srcptr[1] == '-' || srcptr[1] == '=') ? 'I' : 'R';
+			}
+			srcptr += 1;
+		}
+		else if (*srcptr == '-' || *srcptr == '=')
+		{
+			if (processed_chars == 0)
+			{
+				desc->linestyle = 'a';
+			}
+			else if (desc->linestyle != 'a')
+			{
+				broken_format = true;
+				break;
+			}
+			*destptr++ = 'd';
+			srcptr += 1;
+		}
+		else if (*srcptr == '_')
+		{
+			if (processed_chars == 0)
+			{
+				desc->linestyle = 'a';
+				desc->border_type = 0;
+			}
+			else if (desc->linestyle != 'a')
+			{
+				broken_format = true;
+				break;
+			}
+			*destptr++ = 'd';
+			srcptr += 1;
+		}
+		else if (*srcptr == '|')
+		{
+			if (processed_chars == 0 && srcptr[1] == '-')
+			{
+				*destptr++ = 'L';
+				desc->linestyle = 'a';
+				desc->border_type = 2;
+				desc->is_pgcli_fmt = true;
+			}
+			else if (processed_chars > 0 && desc->is_pgcli_fmt && srcptr[-1] == '-')
+			{
+				*destptr++ = 'R';
+			}
+			else
+			{
+				broken_format = true;
+				break;
+			}
+			srcptr += 1;
+		}
+		else if (*srcptr == ' ')
+		{
+			if (desc->border_type != 0)
+			{
+				broken_format = true;
+				break;
+			}
+			*destptr++ = 'I';
+			srcptr += 1;
+		}
+		else
+		{
+			broken_format = true;
+			break;
+		}
+		processed_chars += 1;
+	}
+
+	/* should not be - unclosed header */
+	if (is_expanded_info)
+		broken_format = true;
+	else if (desc->is_expanded_mode && desc->expanded_info_minx == -1)
+		broken_format = true;
+
+	if (!broken_format)
+	{
+		char	   *namesline = desc->namesline;
+		char	   *first_char = NULL;				/* first non space char of column name */
+		int			offset;
+		char	   *ptr;
+		int			i;
+
+		/* Move right corner more right */
+		if (desc->border_type == 0 && last_black_char)
+		{
+			last_black_char[0] = 'd';
+			last_black_char[1] = '\0';
+		}
+
+		/* trim ending spaces */
+		else if (last_black_char)
+		{
+			last_black_char[1] = '\0';
+		}
+
+		desc->headline_char_size = strlen(desc->headline_transl);
+
+		desc->columns = 1;
+
+		ptr = desc->headline_transl;
+		while (*ptr)
+		{
+			if (*ptr++ == 'I')
+				desc->columns += 1;
+		}
+
+		desc->cranges = smalloc(desc->columns * sizeof(CRange));
+
+		i = 0; offset = 0;
+		ptr = desc->headline_transl;
+		desc->cranges[0].xmin = 0;
+		desc->cranges[0].name_offset = -1;
+		desc->cranges[0].name_size = -1;
+
+		while (*ptr)
+		{
+			char	   *nextchar = NULL;
+			int			display_width;
+
+			if (namesline)
+			{
+				/* invalidate namesline if there are not good enough chars */
+				if (!*namesline)
+				{
+					namesline = NULL;
+					nextchar = NULL;
+				}
+				else
+				{
+					nextchar = namesline + charlen(namesline);
+					display_width = dsplen(namesline);
+				}
+			}
+			else
+				display_width = 1;
+
+			if (*ptr == 'I')
+			{
+				desc->cranges[i++].xmax = offset;
+				desc->cranges[i].xmin = offset;
+				desc->cranges[i].name_offset = -1;
+				desc->cranges[i].name_size = -1;
+			}
+			else if (*ptr == 'd')
+			{
+				if (namesline && *namesline != ' ')
+				{
+					if (desc->cranges[i].name_offset == -1)
+					{
+						desc->cranges[i].name_pos = ptr - desc->headline_transl;
+						desc->cranges[i].name_width = display_width;
+						desc->cranges[i].name_offset = namesline - desc->namesline;
+						desc->cranges[i].name_size = nextchar - namesline;
+						first_char = namesline;
+					}
+					else
+					{
+						desc->cranges[i].name_size = nextchar - first_char;
+						desc->cranges[i].name_width = offset + display_width - desc->cranges[i].name_pos;
+					}
+				}
+			}
+
+			/* possibly some chars can hold more display possitions */
+			if (namesline)
+				namesline = nextchar;
+			else
+				display_width = 1;
+
+			offset += display_width;
+			ptr += display_width;
+		}
+
+		desc->cranges[i].xmax = offset - 1;
+
+		if (!namesline)
+			desc->namesline = NULL;
+
+		/*
+		 * New PostgreSQL system tables contains visible oid columns. I would to
+		 * detect this situation and increase by one default freezed columns. So
+		 * second column (with name) will be freezed by default too.
+		 */
+		if (desc->namesline && desc->columns >= 2)
+		{
+			if (desc->cranges[0].name_size == 3 &&
+					nstrstr_with_sizes(desc->namesline + desc->cranges[0].name_offset,
+									   desc->cranges[0].name_size,
+									   "oid",
+									   3))
+			{
+				if (desc->cranges[1].name_size > 4 &&
+						nstrstr_with_sizes(desc->namesline + desc->cranges[1].name_offset + desc->cranges[1].name_size - 4,
+										   4, "name", 4))
+					desc->freeze_two_cols = true;
+			}
+			else if ((desc->cranges[0].name_size == 10 &&
+						  				nstrstr_with_sizes(desc->namesline + desc->cranges[0].name_offset,
+									   desc->cranges[0].name_size,
+									   "schemaname",
+									   10)) ||
+					(desc->cranges[0].name_size == 6 &&
+						  				nstrstr_with_sizes(desc->namesline + desc->cranges[0].name_offset,
+									   desc->cranges[0].name_size,
+									   "schema",
+									   6)))
+			{
+				desc->freeze_two_cols = true;
+			}
+		}
+
+		return true;
+	}
+
+	log_row("headline is not in expected format");
+	free(desc->headline_transl);
+	desc->headline_transl = NULL;
+
+	return false;
+}
+
+/*
+ * Calculate field spans of columns from first_column to ncolumns - 1 on
+ * the row. A char is part of column's field, when it starts after column's
+ * left bound, and the field ends by char that reaches column's right bound.
+ */
+static void
+calculate_spans(DataDesc *desc, char *row, FieldSpan *spans,
+				int first_column, int ncolumns)
+{
+	bool		border0 = (desc->border_type == 0);
+	char	   *str = row;
+	int			pos = 0;
+	int			i;
+
+	for (i = 0; i < ncolumns; i++)
+	{
+		FieldSpan  *span = &spans[i - first_column];
+		int			xmin = desc->cranges[i].xmin;
+		int			xmax = desc->cranges[i].xmax;
+		char	   *endstr;
+		int			endpos;
+		bool		is_empty = false;
+
+		/* without right border, the last char of headline is part of field */
+		if (i == desc->columns - 1 && desc->border_type != 2)
+			xmax += 1;
+
+		/* skip chars before column (the columns are ordered) */
+		while (*str && !(pos > xmin || (border0 && pos >= xmin)))
+		{
+			pos += dsplen(str);
+			str += charlen(str);
+
+			if (pos >= xmax)
+			{
+				is_empty = true;
+				break;
+			}
+		}
+
+		/* the spans of previous columns are not required */
+		if (i < first_column)
+			continue;
+
+		span->offset = str - row;
+		span->size = 0;
+
+		if (is_empty)
+			continue;
+
+		endstr = str;
+		endpos = pos;
+
+		while (*endstr)
+		{
+			endpos += dsplen(endstr);
+			endstr += charlen(endstr);
+
+			if (endpos >= xmax)
+				break;
+		}
+
+		span->size = endstr - str;
+	}
+}
+
+/*
+ * Calculate field spans of first ncolumns columns on the row.
+ */
+void
+calculate_field_spans(DataDesc *desc, char *row, FieldSpan *spans, int ncolumns)
+{
+	calculate_spans(desc, row, spans, 0, ncolumns);
+}
+
+/*
+ * Returns pointer to field of column (columns are numbered from one)
+ * on the row. The size of field is returned in size. The spans of fields
+ * of one column are calculated only once, and they are stored in line
+ * buffer. Sort, filter and column statistics process one column, so
+ * the spans of other columns are not stored.
+ */
+static char *
+get_field(DataDesc *desc, LineBuffer *lnb, int lnb_row, int colno, int *size)
+{
+	FieldSpan  *span;
+
+	if (!lnb->spans)
+	{
+		lnb->spans = smalloc(LINEBUFFER_LINES * sizeof(FieldSpan));
+		lnb->spans_rows = 0;
+	}
+
+	if (lnb->spans_colno != colno)
+	{
+		lnb->spans_colno = colno;
+		lnb->spans_rows = 0;
+	}
+
+	/* rows are only appended to line buffer */
+	while (lnb->spans_rows <= lnb_row)
+	{
+		calculate_spans(desc,
+						lnb->rows[lnb->spans_rows],
+						&lnb->spans[lnb->spans_rows],
+						colno - 1, colno);
+		lnb->spans_rows += 1;
+	}
+
+	span = &lnb->spans[lnb_row];
+
+	*size = span->size;
+
+	return lnb->rows[lnb_row] + span->offset;
+}
+
+/*
+ * Cut text from field.
+ */
+static bool
+cut_text(char *str,
+		 int size,
+		 char **result)
+{
+#define TEXT_STACK_BUFFER_SIZE		1024
+
+	if (str)
+	{
+		char	   *_str = NULL;
+		char	   *after_last_nospc = NULL;
+		char	   *endstr = str + size;
+		bool		skip_left_spaces = true;
+
+		while (str < endstr)
+		{
+			int			chrlen = charlen(str);
+
+			if (skip_left_spaces)
+			{
+				if (*str == ' ')
+				{
+					str += 1;
+					continue;
+				}
+
+				/* first nspc char */
+				skip_left_spaces = false;
+				_str = str;
+			}
+
+			if (*str != ' ')
+				after_last_nospc = str + chrlen;
+
+			str += chrlen;
+		}
+
+		if (_str != NULL)
+		{
+			char		buffer[TEXT_STACK_BUFFER_SIZE];
+			char	   *dynbuf = NULL;
+			char	   *cstr = NULL;
+			int			size;
+
+			cstr = strndup(_str, after_last_nospc - _str);
+			if (!cstr)
+				leave("out of memory");
+
+			if (!use_utf8)
+			{
+				*result = cstr;
+				return true;
+			}
+
+			errno = 0;
+			size = strxfrm(buffer, (const char *) cstr, 1024);
+			if (errno != 0)
+			{
+				/* cannot to sort this string */
+				free(cstr);
+				return false;
+			}
+
+			if (size > TEXT_STACK_BUFFER_SIZE - 1)
+			{
+				int			dynbuf_size = 0;
+
+				while (size > dynbuf_size)
+				{
+					if (dynbuf)
+						free(dynbuf);
+
+					dynbuf_size = size + 1;
+					dynbuf = smalloc(dynbuf_size);
+
+					errno = 0;
+					size = strxfrm(dynbuf, cstr, dynbuf_size);
+					if (errno != 0)
+					{
+						/* cannot to sort this string */
+						free(cstr);
+						return false;
+					}
+				}
+			}
+
+			free(cstr);
+
+			if (!dynbuf)
+			{
+				dynbuf = sstrdup(buffer);
+				if (!dynbuf)
+					leave("out of memory");
+			}
+
+			*result = dynbuf;
+
+			return true;
+		}
+	}
+
+	*result = NULL;
+
+	return false;
+}
+
+/*
+ * Try to cut numeric (double) value from field specified by pointer and size.
+ * Units (bytes, kB, MB, GB, TB) are supported. Returns true, when returned value is valid.
+ */
+static bool
+cut_numeric_value(char *str, int size, double *d, bool *isnull, char **nullstr)
+{
+
+#define BUFFER_MAX_SIZE			101
+
+	char		buffer[BUFFER_MAX_SIZE];
+	char	   *buffptr;
+	char	   *after_last_nospace = NULL;
+	char	   *first_nospace_nodigit = NULL;
+
+	*isnull = false;
+
+	if (str)
+	{
+		bool		found_plus_sign = false;
+		bool		found_minus_sign = false;
+		bool		only_digits = false;
+		bool		only_digits_with_point = false;
+		bool		skip_initial_spaces = true;
+		bool		found_exponent = false;
+		char	   *endstr = str + size;
+
+		char		decimal_point = '\0';
+		long long	mp = 1;
+
+		after_last_nospace = buffptr = buffer;
+		memset(buffer, 0, BUFFER_MAX_SIZE);
+
+		while (str < endstr)
+		{
+			int		chrlen = charlen(str);
+			char	c =  *str;
+
+			if (skip_initial_spaces)
+			{
+				if (c == ' ')
+				{
+					str += 1;
+					continue;
+				}
+				else if ((c == '-' || c == '+') &&
+						  !(found_plus_sign || found_minus_sign))
+				{
+					if (c == '-')
+						found_minus_sign = true;
+					else
+						found_plus_sign = true;
+
+					str += 1;
+					continue;
+				}
+
+				/* first char should be a digit */
+				if (!isdigit(c))
+				{
+					char	   *_nullstr = *nullstr;
+					size_t		len;
+					char	   *saved_str = str;
+
+					after_last_nospace = saved_str;
+
+					/*
+					 * We should to check nullstr if exists, or we should to save
+					 * this string as nullstr.
+					 */
+					while (str < endstr)
+					{
+						if (*str != ' ')
+							after_last_nospace = str + chrlen;
+
+						str += chrlen;
+
+						if (str < endstr)
+							chrlen = charlen(str);
+					}
+
+					len = after_last_nospace - saved_str;
+
+					if (_nullstr)
+					{
+						if (strlen(_nullstr) == len)
+							*isnull = strncmp(_nullstr, saved_str, len) == 0;
+						else
+							*isnull = false;
+					}
+					else
+					{
+						_nullstr = smalloc(len + 1);
+
+						memcpy(_nullstr, saved_str, len);
+						_nullstr[len] = '\0';
+
+						*isnull = true;
+						*nullstr = _nullstr;
+					}
+
+					return false;
+				}
+
+				skip_initial_spaces = false;
+				only_digits = true;
+			}
+
+			memcpy(buffptr, str, chrlen);
+
+			/* trim from right */
+			if (c != ' ')
+			{
+				bool	only_digits_prev = only_digits;
+				bool	only_digits_with_point_prev = only_digits_with_point;
+
+				after_last_nospace = buffptr + chrlen;
+				if (after_last_nospace - buffer > (BUFFER_MAX_SIZE - 1))
+				{
+					/* too long string - should not be translated to number */
+					return false;
+				}
+
+				if (c == '.' || c == ',')
+				{
+					if (only_digits)
+					{
+						only_digits = false;
+						only_digits_with_point = true;
+						decimal_point = c;
+					}
+					else
+						return false;
+				}
+				else if (!isdigit(c))
+				{
+					if (c == 'e' && !found_exponent && chrlen == 1 && decimal_point != '\0')
+					{
+						/* try to skip e+n */
+						if (str[1] == '+' || str[1] == '-')
+						{
+							if (isdigit(str[2]))
+							{
+								found_exponent = true;
+								memcpy(buffptr, str, 3);
+								str += 3;
+								buffptr += 3;
+								continue;
+							}
+						}
+					}
+
+					only_digits = false;
+					only_digits_with_point = false;
+				}
+
+				/* Save point of chage between digits and other */
+				if ((only_digits_prev || only_digits_with_point_prev) &&
+				   !(only_digits || only_digits_with_point))
+				{
+					first_nospace_nodigit = buffptr;
+				}
+			}
+			buffptr += chrlen;
+			str += chrlen;
+		} /* while (str < endstr) */
+
+		/* trim spaces from right */
+		*after_last_nospace = '\0';
+
+		if (first_nospace_nodigit)
+		{
+			/* units used by psql */
+			if (nstreq(first_nospace_nodigit, "bytes"))
+				mp = 1l;
+			else if (nstreq(first_nospace_nodigit, "kB"))
+				mp = 1024l;
+			else if (nstreq(first_nospace_nodigit, "MB"))
+				mp = 1024l * 1024;
+			else if (nstreq(first_nospace_nodigit, "GB"))
+				mp = 1024l * 1024 * 1024;
+			else if (nstreq(first_nospace_nodigit, "TB"))
+				mp = 1024l * 1024 * 1024 * 1024;
+
+			/* units used by nushell */
+			else if (nstreq(first_nospace_nodigit, "B"))
+				mp = 1l;
+			else if (nstreq(first_nospace_nodigit, "KiB"))
+				mp = 1024l;
+			else if (nstreq(first_nospace_nodigit, "MiB"))
+				mp = 1024l * 1024;
+			else if (nstreq(first_nospace_nodigit, "GiB"))
+				mp = 1024l * 1024 * 1024;
+			else if (nstreq(first_nospace_nodigit, "TiB"))
+				mp = 1024l * 1024 * 1024 * 1024;
+
+				/* unknown unit */
+			else
+			{
+				log_row("unknown unit \"%s\"", first_nospace_nodigit);
+				return false;
+			}
+
+			*first_nospace_nodigit = '\0';
+		}
+
+		if (decimal_point == ',')
+		{
+			char   *ptr = buffer;
+
+			while (*ptr)
+			{
+				if (*ptr == ',')
+					*ptr = '.';
+				ptr += 1;
+			}
+		}
+
+		errno = 0;
+
+		*d = strtod(buffer, NULL);
+		if (errno == 0)
+		{
+			*d = *d * mp;
+
+			if (found_minus_sign)
+				*d *= -1;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Try to detect multiline rows.
+ */
+void
+multilines_detection(DataDesc *desc)
+{
+	LineBufferIter	lbi;
+	LineBufferMark	lbm;
+	int				recno = 1;
+
+	bool		has_multilines = false;
+
+	if (desc->multilines_already_tested)
+		return;
+
+	init_lbi_ddesc(&lbi, desc, 0);
+
+	while (lbi_set_mark_next(&lbi, &lbm))
+	{
+		char	   *str;
+		int			lineno;
+		bool		found_continuation_symbol = false;
+		LineInfo   *linfo;
+
+		(void) lbm_get_line(&lbm, &str, &linfo, &lineno);
+
+		if (lineno < desc->first_data_row || lineno > desc->last_data_row)
+			continue;
+
+		/*
+		 * This routine can be repeated until progressive load
+		 * is not finished. But we don't need to repeat searching
+		 * multilines detection.
+		 */
+		if (!linfo ||
+			!(linfo->mask & LINEINFO_CONTINUATION ||
+			  linfo->mask & LINEINFO_HASNOT_CONTINUATION))
+		{
+			found_continuation_symbol = has_continuation_symbol(desc, str);
+
+			if (found_continuation_symbol)
+			{
+				lbm_xor_mask(&lbm, LINEINFO_CONTINUATION);
+				has_multilines = true;
+			}
+			else
+				lbm_xor_mask(&lbm, LINEINFO_HASNOT_CONTINUATION);
+		}
+		else
+			found_continuation_symbol = linfo->mask & LINEINFO_CONTINUATION;
+
+		lbm_recno_offset(&lbm, lineno - recno);
+
+		if (!found_continuation_symbol)
+			recno += 1;
+	}
+
+	if (desc->completed)
+		desc->multilines_already_tested = true;
+
+	desc->has_multilines = has_multilines;
+}
+
+/*
+ * Partial sort is used only for larger data
+ */
+#define PARTIAL_SORT_MIN_ROWS		10000
+#define PARTIAL_SORT_RATIO			8
+
+/*
+ * Assign sorted rows (and their continual lines) to order map.
+ * Returns number of next line of order map.
+ */
+static int
+fill_order_map(DataDesc *desc, SortData *sortbuf, int items, int lineno)
+{
+	LineBuffer *lnb;
+	int			i;
+
+	for (i = 0; i < items; i++)
+	{
+		desc->order_map[lineno].lnb = sortbuf[i].lnb;
+		desc->order_map[lineno].lnb_row = sortbuf[i].lnb_row;
+		lineno += 1;
+
+		/* assign other continual lines */
+		if (desc->has_multilines)
+		{
+			int		lnb_row;
+			bool	continual = false;
+
+			lnb = sortbuf[i].lnb;
+			lnb_row = sortbuf[i].lnb_row;
+
+			continual = lnb->lineinfo &&
+									   (lnb->lineinfo[lnb_row].mask & LINEINFO_CONTINUATION);
+
+			while (lnb && continual)
+			{
+				lnb_row += 1;
+				if (lnb_row >= lnb->nrows)
+				{
+					lnb_row = 0;
+					lnb = lnb->next;
+				}
+
+				desc->order_map[lineno].lnb = lnb;
+				desc->order_map[lineno].lnb_row = lnb_row;
+				lineno += 1;
+
+				continual = lnb && lnb->lineinfo &&
+								(lnb->lineinfo[lnb_row].mask & LINEINFO_CONTINUATION);
+			}
+		}
+	}
+
+	return lineno;
+}
+
+static void
+free_sortbuf(SortData *sortbuf, int items)
+{
+	int		i;
+
+	for (i = 0; i < items; i++)
+		free(sortbuf[i].strxfrm);
+
+	free(sortbuf);
+}
+
+static void
+free_pending_sort(PendingSort *ps)
+{
+	free_sortbuf(ps->sortbuf, ps->items);
+	pthread_mutex_destroy(&ps->mutex);
+	free(ps);
+}
+
+/*
+ * Sort rows that was not sorted by partial sort. When the sort was
+ * canceled meanwhile, the pending sort is released by this thread.
+ */
+static void *
+sort_worker(void *arg)
+{
+	PendingSort *ps = (PendingSort *) arg;
+	SortData   *rest = ps->sortbuf + ps->sorted_items;
+	int			nrest = ps->items - ps->sorted_items;
+	bool		canceled;
+
+	if (ps->text_sort)
+		sort_column_text(rest, nrest, ps->desc_sort);
+	else
+		sort_column_num(rest, nrest, ps->desc_sort);
+
+	pthread_mutex_lock(&ps->mutex);
+	canceled = ps->canceled;
+	ps->finished = true;
+	pthread_mutex_unlock(&ps->mutex);
+
+	if (canceled)
+		free_pending_sort(ps);
+
+	return NULL;
+}
+
+/*
+ * Starts sort of rows that was not sorted by partial sort. When
+ * the thread cannot be started, the rows are sorted immediately.
+ */
+static void
+start_pending_sort(PendingSort *ps)
+{
+	sigset_t	fullset, oldset;
+	int			res;
+
+	pthread_mutex_init(&ps->mutex, NULL);
+
+	/* signals should be processed by main thread only */
+	sigfillset(&fullset);
+	pthread_sigmask(SIG_SETMASK, &fullset, &oldset);
+
+	res = pthread_create(&ps->thread, NULL, sort_worker, ps);
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+	if (res == 0)
+		ps->has_thread = true;
+	else
+	{
+		log_row("cannot to start sort thread (%s)", strerror(res));
+		(void) sort_worker(ps);
+	}
+}
+
+/*
+ * Release not finished sort (when order map will be rebuilt). The
+ * running sort cannot be interrupted, so the thread is detached, and
+ * it releases the data itself.
+ */
+void
+discard_pending_sort(DataDesc *desc)
+{
+	PendingSort *ps = desc->pending_sort;
+
+	if (!ps)
+		return;
+
+	desc->pending_sort = NULL;
+
+	if (ps->has_thread)
+	{
+		bool		finished;
+
+		pthread_mutex_lock(&ps->mutex);
+		finished = ps->finished;
+		ps->canceled = true;
+		pthread_mutex_unlock(&ps->mutex);
+
+		if (!finished)
+		{
+			pthread_detach(ps->thread);
+			log_row("pending sort was canceled");
+			return;
+		}
+
+		pthread_join(ps->thread, NULL);
+	}
+
+	free_pending_sort(ps);
+}
+
+/*
+ * Assign rows sorted in background to the rest of order map. Returns
+ * false when the sort is not finished yet (only when wait is false).
+ */
+bool
+complete_order_map(DataDesc *desc, bool wait)
+{
+	PendingSort *ps = desc->pending_sort;
+	int			nrest;
+
+	if (!ps)
+		return true;
+
+	if (ps->has_thread)
+	{
+		bool		finished;
+
+		pthread_mutex_lock(&ps->mutex);
+		finished = ps->finished;
+		pthread_mutex_unlock(&ps->mutex);
+
+		if (!finished && !wait)
+			return false;
+
+		pthread_join(ps->thread, NULL);
+		ps->has_thread = false;
+	}
+
+	nrest = ps->items - ps->sorted_items;
+
+	(void) fill_order_map(desc, ps->sortbuf + ps->sorted_items, nrest, ps->lineno);
+
+	log_row("sort of %d rows is completed", nrest);
+
+	discard_pending_sort(desc);
+
+	return true;
+}
+
+void
+typed_columns_free(TypedColumn *typed_columns, int n)
+{
+	int			i;
+
+	if (!typed_columns)
+		return;
+
+	for (i = 0; i < n; i++)
+	{
+		free(typed_columns[i].values);
+		free(typed_columns[i].isnull);
+	}
 
-			/* entry to expanded info mode */
-			is_expanded_info = true;
-			desc->expanded_info_minx = processed_chars;
+	free(typed_columns);
+}
 
-			*destptr++ = 'd';
-			srcptr += charlen(srcptr);
-		}
-		else if (is_expanded_info)
-		{
-			if (*srcptr == ']')
-			{
-				is_expanded_info = false;
-			}
-			*destptr++ = 'd';
-			srcptr += charlen(srcptr);
-		}
-		else if (strncmp(srcptr, "\342\224\214", 3) == 0 || /* ┌ */
-				 strncmp(srcptr, "\342\225\224", 3) == 0 || /* ╔ */
-				 strncmp(srcptr, "\342\224\217", 3) == 0 || /* ┏ */
-				 strncmp(srcptr, "\342\225\255", 3) == 0)	/* ╭ */
-		{
-			/* should be expanded mode */
-			if (processed_chars > 0 ||
-				(!desc->is_expanded_mode && !is_headerless))
-			{
-				broken_format = true;
-				break;
-			}
-			desc->linestyle = 'u';
-			desc->border_type = 2;
-			*destptr++ = 'L';
-			srcptr += 3;
-		}
-		else if (strncmp(srcptr, "\342\224\220", 3) == 0 || /* ┐ */
-				 strncmp(srcptr, "\342\225\227", 3) == 0 || /* ╗ */
-				 strncmp(srcptr, "\342\224\223", 3) == 0 || /* ┓ */
-				 strncmp(srcptr, "\342\225\256", 3) == 0)	/* ╮ */
-		{
-			if (desc->linestyle != 'u' || desc->border_type != 2 ||
-				(!desc->is_expanded_mode  && !is_headerless))
-			{
-				broken_format = true;
-				break;
-			}
-			*destptr++ = 'R';
-			srcptr += 3;
-		}
-		else if (strncmp(srcptr, "\342\224\254", 3) == 0 || /* ┬╤ */
-				 strncmp(srcptr, "\342\225\244", 3) == 0 ||
-				 strncmp(srcptr, "\342\225\245", 3) == 0 || /* ╥╦ */
-				 strncmp(srcptr, "\342\225\246", 3) == 0 ||
-				 strncmp(srcptr, "\342\224\263", 3) == 0)	/* ┳ */
-		{
-			if (desc->linestyle != 'u' ||
-				(!desc->is_expanded_mode  && !is_headerless))
-			{
-				broken_format = true;
-				break;
-			}
-			if (desc->border_type == 0)
-				desc->border_type = 1;
+void
+typed_column_add(TypedColumn *tc, double d, bool isnull)
+{
+	if (tc->nvalues == tc->size)
+	{
+		tc->size = tc->size > 0 ? tc->size * 2 : 1024;
+		tc->values = srealloc(tc->values, tc->size * sizeof(double));
+		tc->isnull = srealloc(tc->isnull, tc->size * sizeof(bool));
+	}
 
-			*destptr++ = 'I';
-			srcptr += 3;
-		}
-		else if (strncmp(srcptr, "\342\224\234", 3) == 0 || /* ├╟ */
-				 strncmp(srcptr, "\342\225\237", 3) == 0 ||
-				 strncmp(srcptr, "\342\225\236", 3) == 0 || /* ╞╠ */
-				 strncmp(srcptr, "\342\225\240", 3) == 0 ||
-				 strncmp(srcptr, "\342\224\243", 3) == 0)	/* ┣ */
-		{
-			if (processed_chars > 0)
-			{
-				broken_format = true;
-				break;
-			}
-			desc->linestyle = 'u';
-			desc->border_type = 2;
-			*destptr++ = 'L';
-			srcptr += 3;
-		}
-		else if (strncmp(srcptr, "\342\224\244", 3) == 0 || /* ┤╢ */
-				 strncmp(srcptr, "\342\225\242", 3) == 0 ||
-				 strncmp(srcptr, "\342\225\241", 3) == 0 || /* ╡╣ */
-				 strncmp(srcptr, "\342\225\243", 3) == 0 ||
-				 strncmp(srcptr, "\342\224\253", 3) == 0)	/* ┫ */
+	tc->values[tc->nvalues] = d;
+	tc->isnull[tc->nvalues++] = isnull;
+}
+
+/*
+ * Returns true, when the value of record was received in binary
+ * format, so it is not necessary to parse it from displayed text.
+ */
+static bool
+get_typed_value(DataDesc *desc, int colno, int recno, double *d, bool *isnull)
+{
+	TypedColumn *tc;
+
+	if (!desc->typed_columns || colno < 1 || colno > desc->ntyped_columns)
+		return false;
+
+	tc = &desc->typed_columns[colno - 1];
+	if (recno >= tc->nvalues)
+		return false;
+
+	*d = tc->values[recno];
+	*isnull = tc->isnull[recno];
+
+	return true;
+}
+
+/*
+ * Prepare keys of one column for multi column sort. The numeric keys
+ * are used when all not null values of column are numbers, else the
+ * keys are strings transformed by strxfrm.
+ */
+static void
+prepare_sort_keys(DataDesc *desc, SortData *sortbuf, int items, int colno, int keyno)
+{
+	char	   *nullstr = NULL;
+	bool		is_text = false;
+	int			i;
+
+	for (i = 0; i < items; i++)
+	{
+		SortKey    *key = &sortbuf[i].keys[keyno];
+		bool		isnull;
+		char	   *field;
+		int			size;
+
+		key->strxfrm = NULL;
+
+		if (get_typed_value(desc, colno, i, &key->d, &isnull))
 		{
-			if (desc->linestyle != 'u' || desc->border_type != 2)
-			{
-				broken_format = true;
-				break;
-			}
-			*destptr++ = 'R';
-			srcptr += 3;
+			key->info = isnull ? INFO_UNKNOWN : INFO_DOUBLE;
+			continue;
 		}
-		else if (strncmp(srcptr, "\342\224\274", 3) == 0 || /* ┼╪ */
-				 strncmp(srcptr, "\342\225\252", 3) == 0 ||
-				 strncmp(srcptr, "\342\225\253", 3) == 0 || /* ╫╬ */
-				 strncmp(srcptr, "\342\225\254", 3) == 0 ||
-				 strncmp(srcptr, "\342\225\213", 3) == 0)	/* ╋ */
+
+		field = get_field(desc, sortbuf[i].lnb, sortbuf[i].lnb_row, colno, &size);
+
+		if (cut_numeric_value(field, size,
+							  &key->d,
+							  &isnull,
+							  &nullstr))
+			key->info = INFO_DOUBLE;
+		else
 		{
-			if (desc->linestyle != 'u')
+			key->info = INFO_UNKNOWN;
+			if (!isnull)
 			{
-				broken_format = true;
+				is_text = true;
 				break;
 			}
-			if (desc->border_type == 0)
-				desc->border_type = 1;
-			*destptr++ = 'I';
-			srcptr += 3;
 		}
-		else if (strncmp(srcptr, "\342\224\200", 3) == 0 || /* ─ */
-				 strncmp(srcptr, "\342\225\220", 3) == 0 || /* ═ */
-				 strncmp(srcptr, "\342\224\201", 3) == 0)	/* ━ */
+	}
+
+	free(nullstr);
+
+	if (!is_text)
+		return;
+
+	for (i = 0; i < items; i++)
+	{
+		SortKey    *key = &sortbuf[i].keys[keyno];
+		char	   *field;
+		int			size;
+
+		key->d = 0.0;
+
+		field = get_field(desc, sortbuf[i].lnb, sortbuf[i].lnb_row, colno, &size);
+
+		if (cut_text(field, size, &key->strxfrm))
+			key->info = INFO_STRXFRM;
+		else
+			key->info = INFO_UNKNOWN;		/* empty string */
+	}
+}
+
+/*
+ * Sort by more columns. The composite keys are prepared for all
+ * sorted columns, and then the data are sorted by one qsort.
+ */
+static void
+update_order_map_multi(DataDesc *desc, SortSpec *spec)
+{
+	LineBuffer *lnb;
+	SortData   *sortbuf;
+	SortKey    *keys;
+	int			items = 0;
+	int			lineno = 0;
+	bool		continual_line = false;
+	int			i;
+
+	multilines_detection(desc);
+
+	if (!desc->order_map)
+	{
+		desc->order_map = smalloc(desc->total_rows * sizeof(MappedLine));
+		desc->order_map_items = desc->total_rows;
+	}
+
+	sortbuf = smalloc(desc->total_rows * sizeof(SortData));
+
+	/* collect records, and set order map to original order */
+	lnb = &desc->rows;
+	while (lnb)
+	{
+		for (i = 0; i < lnb->nrows; i++)
 		{
-			if (processed_chars == 0)
-			{
-				desc->linestyle = 'u';
-			}
-			else if (desc->linestyle != 'u')
+			desc->order_map[lineno].lnb = lnb;
+			desc->order_map[lineno].lnb_row = i;
+
+			if (lineno >= desc->first_data_row && lineno <= desc->last_data_row)
 			{
-				broken_format = true;
-				break;
+				if (!continual_line)
+				{
+					sortbuf[items].lnb = lnb;
+					sortbuf[items++].lnb_row = i;
+				}
+
+				if (desc->has_multilines)
+				{
+					continual_line = (lnb->lineinfo &&
+									  (lnb->lineinfo[i].mask & LINEINFO_CONTINUATION));
+				}
 			}
-			*destptr++ = 'd';
-			srcptr += 3;
+
+			lineno += 1;
 		}
-		else if (*srcptr == '+' || *srcptr == ':')
+
+		lnb = lnb->next;
+	}
+
+	if (lineno != desc->total_rows)
+		leave("unexpected processed rows after sort prepare");
+
+	keys = smalloc(items * spec->nkeys * sizeof(SortKey));
+
+	for (i = 0; i < items; i++)
+		sortbuf[i].keys = &keys[i * spec->nkeys];
+
+	for (i = 0; i < spec->nkeys; i++)
+		prepare_sort_keys(desc, sortbuf, items, spec->colnos[i], i);
+
+	log_row("sort by %d columns", spec->nkeys);
+
+	sort_multi_columns(sortbuf, items, spec);
+
+	(void) fill_order_map(desc, sortbuf, items, desc->first_data_row);
+
+	for (i = 0; i < items * spec->nkeys; i++)
+		free(keys[i].strxfrm);
+
+	free(keys);
+	free(sortbuf);
+}
+
+/*
+ * Prepare order map - it is used for printing data in different than
+ * original order. When limit is positive, then only first "limit" rows
+ * can be sorted immediately, and the sort of other rows is finished by
+ * complete_order_map.
+ */
+void
+update_order_map(ScrDesc *scrdesc, DataDesc *desc, SortSpec *spec, int limit)
+{
+	LineBuffer	   *lnb;
+	char		   *nullstr = NULL;
+	char		   *field;
+	int				size;
+	int				lineno = 0;
+	bool			continual_line = false;
+	bool			isnull;
+	bool			detect_string_column = false;
+	SortData	   *sortbuf;
+	int				sortbuf_pos = 0;
+	int				sbcn;
+	bool			desc_sort;
+	bool			partial;
+	int			i;
+
+	discard_pending_sort(desc);
+
+	if (spec->nkeys > 1)
+	{
+		update_order_map_multi(desc, spec);
+
+		/*
+		 * We cannot to say nothing about found_row, so most
+		 * correct solution is clean it now.
+		 */
+		scrdesc->found_row = -1;
+		return;
+	}
+
+	/* sort by one column, "sbcn" - sort by column number */
+	sbcn = spec->colnos[0];
+	desc_sort = spec->desc[0];
+
+	sortbuf = smalloc(desc->total_rows * sizeof(SortData));
+
+	/* multilines should be detected first */
+	multilines_detection(desc);
+
+	lnb = &desc->rows;
+	lineno = 0;
+	sortbuf_pos = 0;
+
+	if (!desc->order_map)
+	{
+		desc->order_map = smalloc(desc->total_rows * sizeof(MappedLine));
+		desc->order_map_items = desc->total_rows;
+	}
+
+	/*
+	 * There are two possible sorting methods: numeric or string.
+	 * We can try numeric sort first if all values are numbers or
+	 * just only one type of string value (like NULL string). This
+	 * value can be repeated,
+	 *
+	 * When there are more different strings, then start again and
+	 * use string sort.
+	 */
+	while (lnb)
+	{
+		for (i = 0; i < lnb->nrows; i++)
 		{
-			if (processed_chars == 0)
-			{
-				*destptr++ = 'L';
-				desc->linestyle = 'a';
-				desc->border_type = 2;
-			}
-			else
+			desc->order_map[lineno].lnb = lnb;
+			desc->order_map[lineno].lnb_row = i;
+
+			if (lineno >= desc->first_data_row && lineno <= desc->last_data_row)
 			{
-				if (desc->linestyle != 'a')
+				if (!continual_line)
 				{
-					broken_format = true;
-					break;
+					sortbuf[sortbuf_pos].lnb = lnb;
+					sortbuf[sortbuf_pos].lnb_row = i;
+					sortbuf[sortbuf_pos].strxfrm = NULL;
+
+					if (get_typed_value(desc, sbcn, sortbuf_pos,
+										&sortbuf[sortbuf_pos].d, &isnull))
+						sortbuf[sortbuf_pos++].info = isnull ? INFO_UNKNOWN : INFO_DOUBLE;
+					else
+					{
+						field = get_field(desc, lnb, i, sbcn, &size);
+
+						if (cut_numeric_value(field, size,
+											  &sortbuf[sortbuf_pos].d,
+											  &isnull,
+											  &nullstr))
+							sortbuf[sortbuf_pos++].info = INFO_DOUBLE;
+						else
+						{
+							sortbuf[sortbuf_pos++].info = INFO_UNKNOWN;
+							if (!isnull)
+							{
+								detect_string_column = true;
+								goto sort_by_string;
+							}
+						}
+					}
 				}
-				if (desc->border_type == 0)
-					desc->border_type = 1;
 
-				*destptr++ = (srcptr[1] == '-' || srcptr[1] == '=') ? 'I' : 'R';
-			}
-			srcptr += 1;
-		}
-		else if (*srcptr == '-' || *srcptr == '=')
-		{
-			if (processed_chars == 0)
-			{
-				desc->linestyle = 'a';
-			}
-			else if (desc->linestyle != 'a')
-			{
-				broken_format = true;
-				break;
+				if (desc->has_multilines)
+				{
+					continual_line = (lnb->lineinfo &&
+									  (lnb->lineinfo[i].mask & LINEINFO_CONTINUATION));
+				}
 			}
-			*destptr++ = 'd';
-			srcptr += 1;
+
+			lineno += 1;
 		}
-		else if (*srcptr == '_')
+
+		lnb = lnb->next;
+	}
+
+sort_by_string:
+
+	free(nullstr);
+
+	if (detect_string_column)
+	{
+		/* read data again and use nls_string */
+		lnb = &desc->rows;
+		lineno = 0;
+		sortbuf_pos = 0;
+		while (lnb)
 		{
-			if (processed_chars == 0)
-			{
-				desc->linestyle = 'a';
-				desc->border_type = 0;
-			}
-			else if (desc->linestyle != 'a')
+			for (i = 0; i < lnb->nrows; i++)
 			{
-				broken_format = true;
-				break;
+				desc->order_map[lineno].lnb = lnb;
+				desc->order_map[lineno].lnb_row = i;
+
+				if (lineno >= desc->first_data_row && lineno <= desc->last_data_row)
+				{
+					if (!continual_line)
+					{
+						sortbuf[sortbuf_pos].lnb = lnb;
+						sortbuf[sortbuf_pos].lnb_row = i;
+						sortbuf[sortbuf_pos].d = 0.0;
+
+						field = get_field(desc, lnb, i, sbcn, &size);
+
+						if (cut_text(field, size, &sortbuf[sortbuf_pos].strxfrm))
+							sortbuf[sortbuf_pos++].info = INFO_STRXFRM;
+						else
+							sortbuf[sortbuf_pos++].info = INFO_UNKNOWN;		/* empty string */
+					}
+
+					if (desc->has_multilines)
+					{
+						continual_line =  (lnb->lineinfo &&
+										   (lnb->lineinfo[i].mask & LINEINFO_CONTINUATION));
+					}
+				}
+
+				lineno += 1;
 			}
-			*destptr++ = 'd';
-			srcptr += 1;
+			lnb = lnb->next;
 		}
-		else if (*srcptr == '|')
+	}
+
+	if (lineno != desc->total_rows)
+		leave("unexpected processed rows after sort prepare");
+
+	/*
+	 * Partial sort has sense only when there are much more rows than
+	 * rows that should be displayed.
+	 */
+	partial = limit > 0 &&
+			  sortbuf_pos >= PARTIAL_SORT_MIN_ROWS &&
+			  sortbuf_pos > PARTIAL_SORT_RATIO * limit;
+
+	if (detect_string_column)
+	{
+		log_row("string sort");
+
+		if (partial)
+			sort_column_text_partial(sortbuf, sortbuf_pos, limit, desc_sort);
+		else
+			sort_column_text(sortbuf, sortbuf_pos, desc_sort);
+	}
+	else
+	{
+		log_row("numeric sort");
+
+		if (partial)
+			sort_column_num_partial(sortbuf, sortbuf_pos, limit, desc_sort);
+		else
+			sort_column_num(sortbuf, sortbuf_pos, desc_sort);
+	}
+
+	lineno = fill_order_map(desc, sortbuf, partial ? limit : sortbuf_pos, desc->first_data_row);
+
+	if (partial)
+	{
+		PendingSort *ps = smalloc(sizeof(PendingSort));
+
+		/* order map should be complete, although the rest is not sorted yet */
+		(void) fill_order_map(desc, sortbuf + limit, sortbuf_pos - limit, lineno);
+
+		ps->sortbuf = sortbuf;
+		ps->sorted_items = limit;
+		ps->items = sortbuf_pos;
+		ps->lineno = lineno;
+		ps->desc_sort = desc_sort;
+		ps->text_sort = detect_string_column;
+
+		desc->pending_sort = ps;
+
+		start_pending_sort(ps);
+
+		log_row("partial sort of %d rows from %d", limit, sortbuf_pos);
+	}
+
+	/*
+	 * We cannot to say nothing about found_row, so most
+	 * correct solution is clean it now.
+	 */
+	scrdesc->found_row = -1;
+
+	if (!partial)
+		free_sortbuf(sortbuf, sortbuf_pos);
+}
+
+/*
+ * Returns pointer to trimmed value of the field specified by pointer
+ * and size. The size of trimmed value is returned in tsize.
+ */
+static char *
+cut_trimmed_value(char *str, int size, int *tsize)
+{
+	char	   *start = NULL;
+	char	   *after_last_nospc = NULL;
+	char	   *endstr = str + size;
+
+	*tsize = 0;
+
+	while (str < endstr)
+	{
+		if (*str != ' ')
 		{
-			if (processed_chars == 0 && srcptr[1] == '-')
-			{
-				*destptr++ = 'L';
-				desc->linestyle = 'a';
-				desc->border_type = 2;
-				desc->is_pgcli_fmt = true;
-			}
-			else if (processed_chars > 0 && desc->is_pgcli_fmt && srcptr[-1] == '-')
-			{
-				*destptr++ = 'R';
-			}
-			else
-			{
-				broken_format = true;
-				break;
-			}
-			srcptr += 1;
+			if (!start)
+				start = str;
+
+			after_last_nospc = str + charlen(str);
 		}
-		else if (*srcptr == ' ')
+
+		str += charlen(str);
+	}
+
+	if (start)
+		*tsize = after_last_nospc - start;
+
+	return start;
+}
+
+/*
+ * Returns true, when the value of filtered column on the row
+ * satisfies the condition of the row filter.
+ */
+static bool
+row_filter_match(RowFilter *filter,
+				 char *field,
+				 int fieldsize,
+				 char **nullstr)
+{
+	char	   *value;
+	char		buffer[1024];
+	int			size;
+	int			cmp;
+
+	if (filter->value_is_num && filter->op != FILTER_OP_CONTAINS)
+	{
+		double		d;
+		bool		isnull;
+
+		if (cut_numeric_value(field, fieldsize, &d, &isnull, nullstr))
 		{
-			if (desc->border_type != 0)
+			switch (filter->op)
 			{
-				broken_format = true;
-				break;
+				case FILTER_OP_EQ:
+					return d == filter->value_num;
+				case FILTER_OP_NE:
+					return d != filter->value_num;
+				case FILTER_OP_LT:
+					return d < filter->value_num;
+				case FILTER_OP_LE:
+					return d <= filter->value_num;
+				case FILTER_OP_GT:
+					return d > filter->value_num;
+				case FILTER_OP_GE:
+					return d >= filter->value_num;
+				default:
+					return false;
 			}
-			*destptr++ = 'I';
-			srcptr += 1;
 		}
+
+		/* NULL is not equal, not less, not greater than anything */
+		if (isnull)
+			return false;
+	}
+
+	value = cut_trimmed_value(field, fieldsize, &size);
+	if (!value)
+	{
+		value = "";
+		size = 0;
+	}
+
+	if (filter->op == FILTER_OP_CONTAINS)
+	{
+		if (use_utf8)
+			return utf8_nstrstr_with_sizes(value, size,
+										   filter->value,
+										   strlen(filter->value)) != NULL;
 		else
-		{
-			broken_format = true;
-			break;
-		}
-		processed_chars += 1;
+			return nstrstr_with_sizes(value, size,
+									  filter->value,
+									  strlen(filter->value)) != NULL;
+	}
+
+	if (size > (int) sizeof(buffer) - 1)
+		size = sizeof(buffer) - 1;
+
+	memcpy(buffer, value, size);
+	buffer[size] = '\0';
+
+	if (filter->op == FILTER_OP_EQ)
+		return strcmp(buffer, filter->value) == 0;
+	else if (filter->op == FILTER_OP_NE)
+		return strcmp(buffer, filter->value) != 0;
+
+	cmp = strcoll(buffer, filter->value);
+
+	switch (filter->op)
+	{
+		case FILTER_OP_LT:
+			return cmp < 0;
+		case FILTER_OP_LE:
+			return cmp <= 0;
+		case FILTER_OP_GT:
+			return cmp > 0;
+		case FILTER_OP_GE:
+			return cmp >= 0;
+		default:
+			return false;
 	}
+}
+
+/*
+ * Move positions of rows after data rows (bottom border and footer) by delta
+ */
+static void
+shift_footer_rows(DataDesc *desc, int delta)
+{
+	if (desc->border_bottom_row != -1 && desc->border_bottom_row > desc->last_data_row)
+		desc->border_bottom_row += delta;
+
+	if (desc->footer_row != -1 && desc->footer_row > desc->last_data_row)
+		desc->footer_row += delta;
+
+	if (desc->alt_footer_row != -1 && desc->alt_footer_row > desc->last_data_row)
+		desc->alt_footer_row += delta;
+
+	desc->last_data_row += delta;
+	desc->last_row += delta;
+	desc->maxy += delta;
+}
+
+/*
+ * Restore the positions of last data row and footer rows, release order
+ * map created by row filter, and restore previous order map.
+ */
+void
+reset_row_filter(DataDesc *desc)
+{
+	if (!desc->is_filtered)
+		return;
+
+	shift_footer_rows(desc, desc->filtered_rows);
+
+	free(desc->order_map);
+	desc->order_map = desc->unfiltered_order_map;
+	desc->order_map_items = desc->unfiltered_order_map_items;
+
+	desc->unfiltered_order_map = NULL;
+	desc->unfiltered_order_map_items = 0;
+
+	desc->is_filtered = false;
+	desc->filtered_rows = 0;
+}
+
+/*
+ * Row filter specified by \filter command is evaluated in background
+ * thread. The thread uses own copy of order map and metadata of DataDesc,
+ * and it doesn't modify any shared data (the bounds of fields are not
+ * cached). The displayed data are not changed until the result is known,
+ * so when no row satisfies the filter, the previous state is preserved.
+ */
+typedef struct PendingFilter
+{
+	pthread_t	thread;
+	pthread_mutex_t mutex;
+
+	RowFilter	filter;
+	DataDesc	desc;				/* copy of metadata */
+	MappedLine *base_map;			/* filtered order */
+	int			base_items;
+
+	/* result */
+	MappedLine *filter_map;
+	int			nitems;
+	int			nrecords;
+
+	/* following fields are protected by mutex */
+	bool		canceled;
+	bool		finished;
+} PendingFilter;
+
+/* how often (in processed lines) the background filter checks cancel */
+#define FILTER_CANCEL_CHECK_LINES		4096
+
+static bool
+filter_is_canceled(PendingFilter *pf)
+{
+	bool		canceled;
 
-	/* should not be - unclosed header */
-	if (is_expanded_info)
-		broken_format = true;
-	else if (desc->is_expanded_mode && desc->expanded_info_minx == -1)
-		broken_format = true;
+	pthread_mutex_lock(&pf->mutex);
+	canceled = pf->canceled;
+	pthread_mutex_unlock(&pf->mutex);
 
-	if (!broken_format)
-	{
-		char	   *namesline = desc->namesline;
-		char	   *first_char = NULL;				/* first non space char of column name */
-		int			offset;
-		char	   *ptr;
-		int			i;
+	return canceled;
+}
 
-		/* Move right corner more right */
-		if (desc->border_type == 0 && last_black_char)
-		{
-			last_black_char[0] = 'd';
-			last_black_char[1] = '\0';
-		}
+/*
+ * Fills filter map by lines (from iterator) that satisfy the row filter.
+ * Header and footer rows are preserved. Returns number of matched records,
+ * or -1 when background filter was canceled. When pf is not NULL, then
+ * the routine runs in background thread, and the bounds of fields are
+ * calculated without cache.
+ */
+static int
+filter_lines(RowFilter *filter, DataDesc *desc, LineBufferIter *lbi,
+			 MappedLine *filter_map, int *nitems, PendingFilter *pf)
+{
+	LineBufferMark lbm;
+	FieldSpan  *spans = NULL;
+	char	   *nullstr = NULL;
+	int			nrecords = 0;
+	int			nlines = 0;
+	bool		continual_line = false;
+	bool		is_matched = false;
 
-		/* trim ending spaces */
-		else if (last_black_char)
-		{
-			last_black_char[1] = '\0';
-		}
+	*nitems = 0;
 
-		desc->headline_char_size = strlen(desc->headline_transl);
+	if (pf)
+		spans = smalloc(filter->colno * sizeof(FieldSpan));
 
-		desc->columns = 1;
+	while (lbi_set_mark_next(lbi, &lbm))
+	{
+		char	   *str;
+		LineInfo   *linfo;
+		int			lineno;
 
-		ptr = desc->headline_transl;
-		while (*ptr)
+		if (pf && ++nlines % FILTER_CANCEL_CHECK_LINES == 0 &&
+			filter_is_canceled(pf))
 		{
-			if (*ptr++ == 'I')
-				desc->columns += 1;
+			nrecords = -1;
+			break;
 		}
 
-		desc->cranges = smalloc(desc->columns * sizeof(CRange));
-
-		i = 0; offset = 0;
-		ptr = desc->headline_transl;
-		desc->cranges[0].xmin = 0;
-		desc->cranges[0].name_offset = -1;
-		desc->cranges[0].name_size = -1;
+		(void) lbm_get_line(&lbm, &str, &linfo, &lineno);
 
-		while (*ptr)
+		if (lineno >= desc->first_data_row && lineno <= desc->last_data_row)
 		{
-			char	   *nextchar = NULL;
-			int			display_width;
-
-			if (namesline)
+			/* continuation lines of multiline records follows first line */
+			if (!continual_line)
 			{
-				/* invalidate namesline if there are not good enough chars */
-				if (!*namesline)
+				char	   *field;
+				int			size;
+
+				if (pf)
 				{
-					namesline = NULL;
-					nextchar = NULL;
+					calculate_field_spans(desc, str, spans, filter->colno);
+					field = str + spans[filter->colno - 1].offset;
+					size = spans[filter->colno - 1].size;
 				}
 				else
-				{
-					nextchar = namesline + charlen(namesline);
-					display_width = dsplen(namesline);
-				}
-			}
-			else
-				display_width = 1;
+					field = get_field(desc, lbm.lb, lbm.lb_rowno, filter->colno, &size);
 
-			if (*ptr == 'I')
-			{
-				desc->cranges[i++].xmax = offset;
-				desc->cranges[i].xmin = offset;
-				desc->cranges[i].name_offset = -1;
-				desc->cranges[i].name_size = -1;
-			}
-			else if (*ptr == 'd')
-			{
-				if (namesline && *namesline != ' ')
-				{
-					if (desc->cranges[i].name_offset == -1)
-					{
-						desc->cranges[i].name_pos = ptr - desc->headline_transl;
-						desc->cranges[i].name_width = display_width;
-						desc->cranges[i].name_offset = namesline - desc->namesline;
-						desc->cranges[i].name_size = nextchar - namesline;
-						first_char = namesline;
-					}
-					else
-					{
-						desc->cranges[i].name_size = nextchar - first_char;
-						desc->cranges[i].name_width = offset + display_width - desc->cranges[i].name_pos;
-					}
-				}
+				is_matched = row_filter_match(filter, field, size, &nullstr);
+				if (is_matched)
+					nrecords += 1;
 			}
 
-			/* possibly some chars can hold more display possitions */
-			if (namesline)
-				namesline = nextchar;
-			else
-				display_width = 1;
+			continual_line = desc->has_multilines && linfo &&
+							 (linfo->mask & LINEINFO_CONTINUATION);
 
-			offset += display_width;
-			ptr += display_width;
+			if (!is_matched)
+				continue;
 		}
 
-		desc->cranges[i].xmax = offset - 1;
+		filter_map[*nitems].lnb = lbm.lb;
+		filter_map[*nitems].lnb_row = lbm.lb_rowno;
+		*nitems += 1;
+	}
 
-		if (!namesline)
-			desc->namesline = NULL;
+	free(nullstr);
+	free(spans);
 
-		/*
-		 * New PostgreSQL system tables contains visible oid columns. I would to
-		 * detect this situation and increase by one default freezed columns. So
-		 * second column (with name) will be freezed by default too.
-		 */
-		if (desc->namesline && desc->columns >= 2)
-		{
-			if (desc->cranges[0].name_size == 3 &&
-					nstrstr_with_sizes(desc->namesline + desc->cranges[0].name_offset,
-									   desc->cranges[0].name_size,
-									   "oid",
-									   3))
-			{
-				if (desc->cranges[1].name_size > 4 &&
-						nstrstr_with_sizes(desc->namesline + desc->cranges[1].name_offset + desc->cranges[1].name_size - 4,
-										   4, "name", 4))
-					desc->freeze_two_cols = true;
-			}
-			else if ((desc->cranges[0].name_size == 10 &&
-						  				nstrstr_with_sizes(desc->namesline + desc->cranges[0].name_offset,
-									   desc->cranges[0].name_size,
-									   "schemaname",
-									   10)) ||
-					(desc->cranges[0].name_size == 6 &&
-						  				nstrstr_with_sizes(desc->namesline + desc->cranges[0].name_offset,
-									   desc->cranges[0].name_size,
-									   "schema",
-									   6)))
-			{
-				desc->freeze_two_cols = true;
-			}
-		}
+	return nrecords;
+}
 
-		return true;
-	}
+/*
+ * Replace current order map by filter map. The current order map is
+ * saved, and it is restored when the filter is reset.
+ */
+static void
+set_filter_map(DataDesc *desc, MappedLine *filter_map, int nitems)
+{
+	desc->unfiltered_order_map = desc->order_map;
+	desc->unfiltered_order_map_items = desc->order_map_items;
 
-	log_row("headline is not in expected format");
-	free(desc->headline_transl);
-	desc->headline_transl = NULL;
+	desc->order_map = filter_map;
+	desc->order_map_items = nitems;
 
-	return false;
+	desc->is_filtered = true;
+	desc->filtered_rows = desc->total_rows - nitems;
+
+	shift_footer_rows(desc, - desc->filtered_rows);
 }
 
 /*
- * Cut text from column.
+ * Prepare order map that holds only rows that satisfy the row filter.
+ * The map is created over the current order, so filtered data can be
+ * sorted (the sort should be applied before). Header and footer rows are
+ * preserved. Returns number of matched records.
  */
-static bool
-cut_text(char *str,
-		 int xmin,
-		 int xmax,
-		 bool border0,
-		 char **result)
+int
+apply_row_filter(RowFilter *filter, DataDesc *desc)
 {
-#define TEXT_STACK_BUFFER_SIZE		1024
+	LineBufferIter lbi;
+	MappedLine *filter_map;
+	int			nitems;
+	int			nrecords;
 
-	if (str)
+	discard_row_filter(desc);
+	reset_row_filter(desc);
+
+	if (filter->colno < 1 || filter->colno > desc->columns)
+		return 0;
+
+	/* multilines should be detected first */
+	multilines_detection(desc);
+
+	filter_map = smalloc(desc->total_rows * sizeof(MappedLine));
+
+	init_lbi_ddesc(&lbi, desc, 0);
+
+	nrecords = filter_lines(filter, desc, &lbi, filter_map, &nitems, NULL);
+
+	set_filter_map(desc, filter_map, nitems);
+
+	log_row("row filter: %d records, %d rows removed", nrecords, desc->filtered_rows);
+
+	return nrecords;
+}
+
+static void *
+filter_worker(void *arg)
+{
+	PendingFilter *pf = (PendingFilter *) arg;
+	LineBufferIter lbi;
+
+	init_lbi(&lbi, NULL, pf->base_map, pf->base_items, 0);
+
+	pf->nrecords = filter_lines(&pf->filter, &pf->desc, &lbi,
+								pf->filter_map, &pf->nitems, pf);
+
+	pthread_mutex_lock(&pf->mutex);
+	pf->finished = true;
+	pthread_mutex_unlock(&pf->mutex);
+
+	return NULL;
+}
+
+/*
+ * Starts evaluation of row filter in background thread. The filter
+ * is applied over the order of data without current row filter. When
+ * the thread cannot be started, the filter is evaluated immediately.
+ * The result should be processed by finish_row_filter.
+ */
+void
+start_row_filter(RowFilter *filter, DataDesc *desc)
+{
+	PendingFilter *pf;
+	MappedLine *order_map;
+	int			order_map_items;
+	sigset_t	fullset, oldset;
+	int			res;
+
+	discard_row_filter(desc);
+
+	/* the filter is applied over completely sorted data */
+	if (desc->pending_sort)
+		(void) complete_order_map(desc, true);
+
+	/* multilines should be detected first */
+	multilines_detection(desc);
+
+	pf = smalloc(sizeof(PendingFilter));
+
+	memcpy(&pf->filter, filter, sizeof(RowFilter));
+	memcpy(&pf->desc, desc, sizeof(DataDesc));
+
+	if (desc->is_filtered)
 	{
-		char	   *_str = NULL;
-		char	   *after_last_nospc = NULL;
-		int			pos = 0;
-		bool		skip_left_spaces = true;
+		order_map = desc->unfiltered_order_map;
+		order_map_items = desc->unfiltered_order_map_items;
+
+		/* positions of data without filter */
+		pf->desc.last_data_row += desc->filtered_rows;
+	}
+	else
+	{
+		order_map = desc->order_map;
+		order_map_items = desc->order_map_items;
+	}
 
-		while (*str)
+	pf->base_items = desc->total_rows;
+	pf->base_map = smalloc(desc->total_rows * sizeof(MappedLine));
+
+	if (order_map)
+		memcpy(pf->base_map, order_map, order_map_items * sizeof(MappedLine));
+	else
+	{
+		LineBuffer *lnb = &desc->rows;
+		int			lineno = 0;
+
+		while (lnb)
 		{
-			int			chrlen = charlen(str);
+			int			i;
 
-			if (pos > xmin || (border0 && pos >= xmin))
+			for (i = 0; i < lnb->nrows; i++)
 			{
-				if (skip_left_spaces)
-				{
-					if (*str == ' ')
-					{
-						pos += 1;
-						str += 1;
-						continue;
-					}
-
-					/* first nspc char */
-					skip_left_spaces = false;
-					_str = str;
-				}
+				pf->base_map[lineno].lnb = lnb;
+				pf->base_map[lineno++].lnb_row = i;
 			}
 
-			if (*str != ' ')
-				after_last_nospc = str + chrlen;
+			lnb = lnb->next;
+		}
+	}
 
-			pos += utf_dsplen(str);
-			str += chrlen;
+	pf->filter_map = smalloc(desc->total_rows * sizeof(MappedLine));
 
-			if (pos >= xmax)
-				break;
-		}
+	desc->pending_filter = pf;
 
-		if (_str != NULL)
-		{
-			char		buffer[TEXT_STACK_BUFFER_SIZE];
-			char	   *dynbuf = NULL;
-			char	   *cstr = NULL;
-			int			size;
+	pthread_mutex_init(&pf->mutex, NULL);
 
-			cstr = strndup(_str, after_last_nospc - _str);
-			if (!cstr)
-				leave("out of memory");
+	/* signals should be processed by main thread only */
+	sigfillset(&fullset);
+	pthread_sigmask(SIG_SETMASK, &fullset, &oldset);
 
-			if (!use_utf8)
-			{
-				*result = cstr;
-				return true;
-			}
+	res = pthread_create(&pf->thread, NULL, filter_worker, pf);
 
-			errno = 0;
-			size = strxfrm(buffer, (const char *) cstr, 1024);
-			if (errno != 0)
-			{
-				/* cannot to sort this string */
-				free(cstr);
-				return false;
-			}
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+	if (res != 0)
+	{
+		log_row("cannot to start filter thread (%s)", strerror(res));
+
+		(void) filter_worker(pf);
+		pf->thread = pthread_self();
+	}
+}
+
+/*
+ * Release pending row filter
+ */
+static void
+free_pending_filter(DataDesc *desc, bool join)
+{
+	PendingFilter *pf = desc->pending_filter;
+
+	if (join && !pthread_equal(pf->thread, pthread_self()))
+		pthread_join(pf->thread, NULL);
+
+	pthread_mutex_destroy(&pf->mutex);
+
+	free(pf->base_map);
+	free(pf->filter_map);
+	free(pf);
+
+	desc->pending_filter = NULL;
+}
+
+/*
+ * Stops evaluation of row filter in background (when it is running).
+ * The thread reads lines, so it should be finished before the lines
+ * are released.
+ */
+void
+discard_row_filter(DataDesc *desc)
+{
+	PendingFilter *pf = desc->pending_filter;
+
+	if (!pf)
+		return;
 
-			if (size > TEXT_STACK_BUFFER_SIZE - 1)
-			{
-				int			dynbuf_size = 0;
+	pthread_mutex_lock(&pf->mutex);
+	pf->canceled = true;
+	pthread_mutex_unlock(&pf->mutex);
 
-				while (size > dynbuf_size)
-				{
-					if (dynbuf)
-						free(dynbuf);
+	free_pending_filter(desc, true);
 
-					dynbuf_size = size + 1;
-					dynbuf = smalloc(dynbuf_size);
+	log_row("row filter in background was canceled");
+}
 
-					errno = 0;
-					size = strxfrm(dynbuf, cstr, dynbuf_size);
-					if (errno != 0)
-					{
-						/* cannot to sort this string */
-						free(cstr);
-						return false;
-					}
-				}
-			}
+/*
+ * Applies result of row filter evaluated in background. Returns -1, when
+ * there is not any pending row filter or when the evaluation is not
+ * finished yet (and wait is false). Else returns number of matched
+ * records. When some rows satisfy the filter, then the filter map is
+ * used, and the filter is copied to "filter". Without matched records
+ * the data are not changed.
+ */
+int
+finish_row_filter(DataDesc *desc, bool wait, RowFilter *filter)
+{
+	PendingFilter *pf = desc->pending_filter;
+	bool		finished;
+	int			nrecords;
 
-			free(cstr);
+	if (!pf)
+		return -1;
 
-			if (!dynbuf)
-			{
-				dynbuf = sstrdup(buffer);
-				if (!dynbuf)
-					leave("out of memory");
-			}
+	pthread_mutex_lock(&pf->mutex);
+	finished = pf->finished;
+	pthread_mutex_unlock(&pf->mutex);
 
-			*result = dynbuf;
+	if (!finished && !wait)
+		return -1;
 
-			return true;
-		}
+	if (!pthread_equal(pf->thread, pthread_self()))
+		pthread_join(pf->thread, NULL);
+
+	nrecords = pf->nrecords;
+
+	if (nrecords > 0)
+	{
+		reset_row_filter(desc);
+		set_filter_map(desc, pf->filter_map, pf->nitems);
+		pf->filter_map = NULL;
+
+		memcpy(filter, &pf->filter, sizeof(RowFilter));
+
+		log_row("row filter: %d records, %d rows removed", nrecords, desc->filtered_rows);
 	}
 
-	*result = NULL;
+	free_pending_filter(desc, false);
 
-	return false;
+	return nrecords;
 }
 
 /*
- * Try to cut numeric (double) value from row defined by specified xmin, xmax positions.
- * Units (bytes, kB, MB, GB, TB) are supported. Returns true, when returned value is valid.
+ * Returns statistics of column (columns are numbered from one). Statistics
+ * of csv data and query results are calculated when data are loaded. For
+ * other formats the bounds of columns are not known when data are loaded,
+ * so the statistics are calculated (only once) when they are required.
  */
-static bool
-cut_numeric_value(char *str, int xmin, int xmax, double *d, bool border0, bool *isnull, char **nullstr)
+ColumnStats *
+get_column_stats(DataDesc *desc, int colno)
 {
+	ColumnStats *cs;
+	LineBuffer *lnb;
+	bool		continual_line = false;
+	int			last_data_row;
+	int			lineno = 0;
+	int			i;
 
-#define BUFFER_MAX_SIZE			101
+	if (!desc->colstats && desc->columns > 0)
+	{
+		desc->colstats = colstats_realloc(NULL, 0, desc->columns);
+		desc->ncolstats = desc->columns;
+	}
 
-	char		buffer[BUFFER_MAX_SIZE];
-	char	   *buffptr;
-	char	   *after_last_nospace = NULL;
-	char	   *first_nospace_nodigit = NULL;
+	if (colno < 1 || colno > desc->ncolstats)
+		return NULL;
 
-	*isnull = false;
+	cs = &desc->colstats[colno - 1];
+	if (cs->is_valid)
+		return cs;
 
-	if (str)
-	{
-		bool		found_plus_sign = false;
-		bool		found_minus_sign = false;
-		bool		only_digits = false;
-		bool		only_digits_with_point = false;
-		bool		skip_initial_spaces = true;
-		bool		found_exponent = false;
-		int			x = 0;
+	if (colno > desc->columns)
+		return NULL;
 
-		char		decimal_point = '\0';
-		long long	mp = 1;
+	/* statistics are calculated from all rows, not only from filtered rows */
+	last_data_row = desc->last_data_row + (desc->is_filtered ? desc->filtered_rows : 0);
 
-		after_last_nospace = buffptr = buffer;
-		memset(buffer, 0, BUFFER_MAX_SIZE);
+	multilines_detection(desc);
 
-		while (*str)
+	lnb = &desc->rows;
+	while (lnb)
+	{
+		for (i = 0; i < lnb->nrows; i++)
 		{
-			int		chrlen = charlen(str);
-
-			if (x > xmin || (border0 && x >= xmin))
+			if (lineno >= desc->first_data_row && lineno <= last_data_row)
 			{
-				char	c =  *str;
-
-				if (skip_initial_spaces)
+				if (!continual_line)
 				{
-					if (c == ' ')
-					{
-						x += 1;
-						str += 1;
-						continue;
-					}
-					else if ((c == '-' || c == '+') &&
-							  !(found_plus_sign || found_minus_sign))
-					{
-						if (c == '-')
-							found_minus_sign = true;
-						else
-							found_plus_sign = true;
-
-						x += 1;
-						str += 1;
-						continue;
-					}
+					char	   *field;
+					char	   *value;
+					char		buffer[1024];
+					int			fieldsize;
+					int			size;
 
-					/* first char should be a digit */
-					if (!isdigit(c))
-					{
-						char	   *_nullstr = *nullstr;
-						size_t		len;
-						char	   *saved_str = str;
+					field = get_field(desc, lnb, i, colno, &fieldsize);
+					value = cut_trimmed_value(field, fieldsize, &size);
 
-						after_last_nospace = saved_str;
+					if (size > (int) sizeof(buffer) - 1)
+						size = sizeof(buffer) - 1;
 
-						/*
-						 * We should to check nullstr if exists, or we should to save
-						 * this string as nullstr.
-						 */
-						while (*str)
-						{
-							if (*str != ' ')
-								after_last_nospace = str + chrlen;
+					if (value)
+						memcpy(buffer, value, size);
 
-							x += dsplen(str);
-							str += chrlen;
+					buffer[size] = '\0';
 
-							if (x >= xmax)
-								break;
+					colstats_add_value(cs, buffer, size == 0);
+				}
 
-							if (*str)
-								chrlen = charlen(str);
-						}
+				if (desc->has_multilines)
+				{
+					continual_line = (lnb->lineinfo &&
+									  (lnb->lineinfo[i].mask & LINEINFO_CONTINUATION));
+				}
+			}
 
-						len = after_last_nospace - saved_str;
+			lineno += 1;
+		}
 
-						if (_nullstr)
-						{
-							if (strlen(_nullstr) == len)
-								*isnull = strncmp(_nullstr, saved_str, len) == 0;
-							else
-								*isnull = false;
-						}
-						else
-						{
-							_nullstr = smalloc(len + 1);
+		lnb = lnb->next;
+	}
 
-							memcpy(_nullstr, saved_str, len);
-							_nullstr[len] = '\0';
+	cs->is_valid = true;
 
-							*isnull = true;
-							*nullstr = _nullstr;
-						}
+	return cs;
+}
 
-						return false;
-					}
+/*
+ * Key of row - the value of first column, or whole line, when the
+ * columns are not known. The keys are used for pairing of changed rows.
+ */
+typedef struct
+{
+	char	   *key;
+	int			size;
+	unsigned int hash;
+} RowKey;
 
-					skip_initial_spaces = false;
-					only_digits = true;
-				}
+static unsigned int
+hash_bytes(const char *str, int size)
+{
+	unsigned int h = 2166136261u;
 
-				memcpy(buffptr, str, chrlen);
+	while (size-- > 0)
+	{
+		h ^= (unsigned char) *str++;
+		h *= 16777619u;
+	}
 
-				/* trim from right */
-				if (c != ' ')
-				{
-					bool	only_digits_prev = only_digits;
-					bool	only_digits_with_point_prev = only_digits_with_point;
+	return h;
+}
 
-					after_last_nospace = buffptr + chrlen;
-					if (after_last_nospace - buffer > (BUFFER_MAX_SIZE - 1))
-					{
-						/* too long string - should not be translated to number */
-						return false;
-					}
+static void
+row_key(DataDesc *desc, char *line, RowKey *rk)
+{
+	if (desc->columns == 0)
+	{
+		rk->key = line;
+		rk->size = strlen(line);
+	}
+	else
+	{
+		FieldSpan	span;
 
-					if (c == '.' || c == ',')
-					{
-						if (only_digits)
-						{
-							only_digits = false;
-							only_digits_with_point = true;
-							decimal_point = c;
-						}
-						else
-							return false;
-					}
-					else if (!isdigit(c))
-					{
-						if (c == 'e' && !found_exponent && chrlen == 1 && decimal_point != '\0')
-						{
-							/* try to skip e+n */
-							if (str[1] == '+' || str[1] == '-')
-							{
-								if (isdigit(str[2]))
-								{
-									found_exponent = true;
-									memcpy(buffptr, str, 3);
-									str += 3;
-									x += 3;
-									buffptr += 3;
-									continue;
-								}
-							}
-						}
+		calculate_field_spans(desc, line, &span, 1);
 
-						only_digits = false;
-						only_digits_with_point = false;
-					}
+		rk->key = cut_trimmed_value(line + span.offset, span.size, &rk->size);
+		if (!rk->key)
+			rk->key = "";
+	}
 
-					/* Save point of chage between digits and other */
-					if ((only_digits_prev || only_digits_with_point_prev) &&
-					   !(only_digits || only_digits_with_point))
-					{
-						first_nospace_nodigit = buffptr;
-					}
-				}
-				buffptr += chrlen;
-			}
+	rk->hash = hash_bytes(rk->key, rk->size);
+}
 
-			x += dsplen(str);
-			str += chrlen;
+static bool
+row_key_eq(RowKey *rk1, RowKey *rk2)
+{
+	return rk1->hash == rk2->hash && rk1->size == rk2->size &&
+		   memcmp(rk1->key, rk2->key, rk1->size) == 0;
+}
 
-			if (x >= xmax)
-				break;
-		} /* while (*str) */
+/*
+ * Hash table of keys of previous data rows. It is created only when
+ * some changed row cannot be paired with row on same position. The
+ * keys are calculated only once.
+ */
+typedef struct
+{
+	RowKey	   *keys;
+	int		   *slots;				/* index of old line + 1 */
+	bool	   *dupkeys;
+	int			nslots;
+} RowKeyIndex;
 
-		/* trim spaces from right */
-		*after_last_nospace = '\0';
+static void
+build_row_key_index(RowKeyIndex *rki, DataDesc *old, char **oldlines, int nold)
+{
+	int			i;
 
-		if (first_nospace_nodigit)
-		{
-			/* units used by psql */
-			if (nstreq(first_nospace_nodigit, "bytes"))
-				mp = 1l;
-			else if (nstreq(first_nospace_nodigit, "kB"))
-				mp = 1024l;
-			else if (nstreq(first_nospace_nodigit, "MB"))
-				mp = 1024l * 1024;
-			else if (nstreq(first_nospace_nodigit, "GB"))
-				mp = 1024l * 1024 * 1024;
-			else if (nstreq(first_nospace_nodigit, "TB"))
-				mp = 1024l * 1024 * 1024 * 1024;
+	rki->nslots = 16;
+	while (rki->nslots < 2 * nold)
+		rki->nslots <<= 1;
 
-			/* units used by nushell */
-			else if (nstreq(first_nospace_nodigit, "B"))
-				mp = 1l;
-			else if (nstreq(first_nospace_nodigit, "KiB"))
-				mp = 1024l;
-			else if (nstreq(first_nospace_nodigit, "MiB"))
-				mp = 1024l * 1024;
-			else if (nstreq(first_nospace_nodigit, "GiB"))
-				mp = 1024l * 1024 * 1024;
-			else if (nstreq(first_nospace_nodigit, "TiB"))
-				mp = 1024l * 1024 * 1024 * 1024;
+	rki->keys = smalloc((nold + 1) * sizeof(RowKey));
+	rki->slots = smalloc(rki->nslots * sizeof(int));
+	rki->dupkeys = smalloc((nold + 1) * sizeof(bool));
 
-				/* unknown unit */
-			else
-			{
-				log_row("unknown unit \"%s\"", first_nospace_nodigit);
-				return false;
-			}
+	for (i = 0; i < nold; i++)
+	{
+		int			slot;
 
-			*first_nospace_nodigit = '\0';
-		}
+		row_key(old, oldlines[i], &rki->keys[i]);
+		slot = rki->keys[i].hash & (rki->nslots - 1);
 
-		if (decimal_point == ',')
+		while (rki->slots[slot] != 0)
 		{
-			char   *ptr = buffer;
+			int			idx = rki->slots[slot] - 1;
 
-			while (*ptr)
+			if (row_key_eq(&rki->keys[i], &rki->keys[idx]))
 			{
-				if (*ptr == ',')
-					*ptr = '.';
-				ptr += 1;
+				rki->dupkeys[idx] = true;
+				break;
 			}
+
+			slot = (slot + 1) & (rki->nslots - 1);
 		}
 
-		errno = 0;
+		if (rki->slots[slot] == 0)
+			rki->slots[slot] = i + 1;
+	}
+}
 
-		*d = strtod(buffer, NULL);
-		if (errno == 0)
-		{
-			*d = *d * mp;
+/*
+ * Returns index of previous row with same key, -1 when there is not
+ * such row, or -2 when the key is not unique.
+ */
+static int
+row_key_index_find(RowKeyIndex *rki, RowKey *rk)
+{
+	int			slot = rk->hash & (rki->nslots - 1);
 
-			if (found_minus_sign)
-				*d *= -1;
+	while (rki->slots[slot] != 0)
+	{
+		int			idx = rki->slots[slot] - 1;
 
-			return true;
+		if (row_key_eq(rk, &rki->keys[idx]))
+			return rki->dupkeys[idx] ? -2 : idx;
+
+		slot = (slot + 1) & (rki->nslots - 1);
+	}
+
+	return -1;
+}
+
+/*
+ * Sets bits of columns with different values. Returns false, when
+ * all values are same. The spans should be an array of 2 * columns
+ * items.
+ */
+static bool
+changed_columns(DataDesc *old, char *oldline,
+				DataDesc *new, char *newline,
+				FieldSpan *spans, unsigned char *changed)
+{
+	FieldSpan  *spans1 = spans;
+	FieldSpan  *spans2 = spans + new->columns;
+	bool		result = false;
+	int			i;
+
+	memset(changed, 0, CHANGED_COLS_BYTES(new->columns));
+
+	if (old->columns != new->columns || new->columns == 0)
+	{
+		if (strcmp(oldline, newline) == 0)
+			return false;
+
+		memset(changed, 0xff, CHANGED_COLS_BYTES(new->columns));
+		return true;
+	}
+
+	calculate_field_spans(old, oldline, spans1, old->columns);
+	calculate_field_spans(new, newline, spans2, new->columns);
+
+	for (i = 0; i < new->columns; i++)
+	{
+		char	   *value1, *value2;
+		int			size1, size2;
+
+		value1 = cut_trimmed_value(oldline + spans1[i].offset, spans1[i].size, &size1);
+		value2 = cut_trimmed_value(newline + spans2[i].offset, spans2[i].size, &size2);
+
+		if (size1 != size2 || (size1 > 0 && memcmp(value1, value2, size1) != 0))
+		{
+			changed[i / 8] |= 1 << (i % 8);
+			result = true;
 		}
 	}
 
-	return false;
+	return result;
 }
 
 /*
- * Try to detect multiline rows.
+ * Store bitmap of changed columns of the row
  */
-void
-multilines_detection(DataDesc *desc)
+static void
+set_changed_row(DataDesc *desc, LineBuffer *lnb, int lnb_row, unsigned char *changed)
 {
-	LineBufferIter	lbi;
-	LineBufferMark	lbm;
-	int				recno = 1;
+	int			bytes = CHANGED_COLS_BYTES(desc->columns);
+	LineBufferMark lbm;
 
-	bool		border0 = (desc->border_type == 0);
-	bool		border1 = (desc->border_type == 1);
-	bool		border2 = (desc->border_type == 2);
+	if (!lnb->changed_cols)
+		lnb->changed_cols = smalloc(LINEBUFFER_LINES * bytes);
+
+	memcpy(lnb->changed_cols + lnb_row * bytes, changed, bytes);
+
+	lbm.lb = lnb;
+	lbm.lb_rowno = lnb_row;
+
+	if (!lnb->lineinfo || !(lnb->lineinfo[lnb_row].mask & LINEINFO_CHANGED))
+		lbm_xor_mask(&lbm, LINEINFO_CHANGED);
+}
+
+/*
+ * Returns number of data rows of line buffer that starts by lineno
+ */
+static int
+block_data_rows(DataDesc *desc, LineBuffer *lnb, int lineno, int last_data_row)
+{
+	int			first = lineno > desc->first_data_row ? lineno : desc->first_data_row;
+	int			last = lineno + lnb->nrows - 1 < last_data_row ?
+					   lineno + lnb->nrows - 1 : last_data_row;
+
+	return last >= first ? last - first + 1 : 0;
+}
+
+/*
+ * Compare data rows of new data with previous data, and mark changed
+ * rows and changed columns (used in watch mode). The row is paired with
+ * row on same position, when both rows has same key (the value of first
+ * column). Else the rows are paired by key (a hash table of previous
+ * rows is used). When the key is not unique, then the rows are paired
+ * by position. When changed_blocks is not NULL, then only rows of
+ * changed line buffers are compared.
+ */
+static void
+mark_changed_rows(DataDesc *old, DataDesc *new, bool *changed_blocks)
+{
+	RowKeyIndex rki;
+	FieldSpan  *spans;
+	unsigned char *changed;
+	char	  **oldlines;
+	int			nold = 0;
+	int			old_last_data_row;
+	int			lineno = 0;
+	int			dataidx = 0;
+	int			blockno = 0;
+	LineBuffer *lnb;
+	int			i;
 
-	bool		has_multilines = false;
+	old_last_data_row = old->last_data_row + (old->is_filtered ? old->filtered_rows : 0);
 
-	if (desc->multilines_already_tested)
+	if (old->first_data_row < 0 || new->first_data_row < 0)
 		return;
 
-	init_lbi_ddesc(&lbi, desc, 0);
+	oldlines = smalloc((old->total_rows + 1) * sizeof(char *));
 
-	while (lbi_set_mark_next(&lbi, &lbm))
+	for (lnb = &old->rows; lnb; lnb = lnb->next)
 	{
-		char	   *str;
-		int			lineno;
-		bool		found_continuation_symbol = false;
-		LineInfo   *linfo;
+		for (i = 0; i < lnb->nrows; i++)
+		{
+			if (lineno >= old->first_data_row && lineno <= old_last_data_row)
+				oldlines[nold++] = lnb->rows[i];
 
-		(void) lbm_get_line(&lbm, &str, &linfo, &lineno);
+			lineno += 1;
+		}
+	}
 
-		if (lineno < desc->first_data_row || lineno > desc->last_data_row)
-			continue;
+	memset(&rki, 0, sizeof(RowKeyIndex));
 
-		/*
-		 * This routine can be repeated until progressive load
-		 * is not finished. But we don't need to repeat searching
-		 * multilines detection.
-		 */
-		if (!linfo ||
-			!(linfo->mask & LINEINFO_CONTINUATION ||
-			  linfo->mask & LINEINFO_HASNOT_CONTINUATION))
+	spans = smalloc((2 * new->columns + 1) * sizeof(FieldSpan));
+	changed = smalloc(CHANGED_COLS_BYTES(new->columns));
+
+	lineno = 0;
+	for (lnb = &new->rows; lnb; lnb = lnb->next, blockno++)
+	{
+		/* unchanged block has same rows on same positions */
+		if (changed_blocks && !changed_blocks[blockno])
 		{
-			int			pos = 0;
+			dataidx += block_data_rows(new, lnb, lineno, new->last_data_row);
+			lineno += lnb->nrows;
+			continue;
+		}
 
-			/*
-			 * This implementation doesn't support old-ascii format
-			 *
-			 * Note - processed string can be shorter than headline for last
-			 * column with pset border 1
-			 */
-			while (pos < desc->headline_char_size && *str != '\0')
+		for (i = 0; i < lnb->nrows; i++)
+		{
+			if (lineno >= new->first_data_row && lineno <= new->last_data_row)
 			{
-				if (border0)
+				char	   *line = lnb->rows[i];
+				int			oldidx = -1;
+
+				if (dataidx < nold && strcmp(oldlines[dataidx], line) == 0)
+				{
+					dataidx += 1;
+					lineno += 1;
+					continue;
+				}
+
+				if (dataidx < nold)
 				{
-					if (pos + 1 == desc->headline_char_size)
+					RowKey		rk1, rk2;
+
+					row_key(new, line, &rk1);
+					row_key(old, oldlines[dataidx], &rk2);
+
+					if (row_key_eq(&rk1, &rk2))
+						oldidx = dataidx;
+					else
 					{
-						char	*sym;
+						if (!rki.keys)
+							build_row_key_index(&rki, old, oldlines, nold);
 
-						sym = str + charlen(str);
-						if (*sym != '\0')
-							found_continuation_symbol = is_line_continuation_char(sym, desc);
+						oldidx = row_key_index_find(&rki, &rk1);
+						if (oldidx == -2)
+							oldidx = dataidx;
 					}
-					else if (desc->headline_transl[pos] == 'I')
-						found_continuation_symbol = is_line_continuation_char(str, desc);
 				}
-				else if (border1)
+				else if (nold > 0)
 				{
-					if ((pos + 1 < desc->headline_char_size && desc->headline_transl[pos + 1] == 'I') ||
-						  (pos + 1 == desc->headline_char_size))
-						found_continuation_symbol = is_line_continuation_char(str, desc);
+					RowKey		rk;
+
+					row_key(new, line, &rk);
+
+					if (!rki.keys)
+						build_row_key_index(&rki, old, oldlines, nold);
+
+					oldidx = row_key_index_find(&rki, &rk);
 				}
-				else if (border2)
+
+				if (oldidx >= 0)
 				{
-					if ((pos + 1 < desc->headline_char_size) &&
-						  (desc->headline_transl[pos + 1] == 'I' || desc->headline_transl[pos + 1] == 'R'))
-						found_continuation_symbol = is_line_continuation_char(str, desc);
+					if (changed_columns(old, oldlines[oldidx], new, line, spans, changed))
+						set_changed_row(new, lnb, i, changed);
 				}
-
-				if (found_continuation_symbol)
+				else
 				{
-					lbm_xor_mask(&lbm, LINEINFO_CONTINUATION);
-					has_multilines = true;
-					break;
+					memset(changed, 0xff, CHANGED_COLS_BYTES(new->columns));
+					set_changed_row(new, lnb, i, changed);
 				}
 
-				pos += dsplen(str);
-				str += charlen(str);
+				dataidx += 1;
 			}
 
-			if (!found_continuation_symbol)
-				lbm_xor_mask(&lbm, LINEINFO_HASNOT_CONTINUATION);
+			lineno += 1;
 		}
-		else
-			found_continuation_symbol = linfo->mask & LINEINFO_CONTINUATION;
-
-		lbm_recno_offset(&lbm, lineno - recno);
-
-		if (!found_continuation_symbol)
-			recno += 1;
 	}
 
-	if (desc->completed)
-		desc->multilines_already_tested = true;
-
-	desc->has_multilines = has_multilines;
+	free(oldlines);
+	free(spans);
+	free(changed);
+	free(rki.keys);
+	free(rki.slots);
+	free(rki.dupkeys);
 }
 
 /*
- * Prepare order map - it is used for printing data in different than
- * original order. "sbcn" - sort by column number
+ * Returns true, when both data has same columns
  */
-void
-update_order_map(ScrDesc *scrdesc, DataDesc *desc, int sbcn, bool desc_sort)
+static bool
+is_same_layout(DataDesc *old, DataDesc *new)
 {
-	LineBuffer	   *lnb;
-	char		   *nullstr = NULL;
-	int				xmin, xmax;
-	int				lineno = 0;
-	bool			continual_line = false;
-	bool			isnull;
-	bool			detect_string_column = false;
-	bool			border0 = (desc->border_type == 0);
-	SortData	   *sortbuf;
-	int				sortbuf_pos = 0;
 	int			i;
 
-	xmin = desc->cranges[sbcn - 1].xmin;
-	xmax = desc->cranges[sbcn - 1].xmax;
+	if (old->columns != new->columns || old->border_type != new->border_type)
+		return false;
 
-	sortbuf = smalloc(desc->total_rows * sizeof(SortData));
+	if (!old->cranges || !new->cranges)
+		return !old->cranges && !new->cranges;
 
-	/* multilines should be detected first */
-	multilines_detection(desc);
+	for (i = 0; i < old->columns; i++)
+		if (old->cranges[i].xmin != new->cranges[i].xmin ||
+			old->cranges[i].xmax != new->cranges[i].xmax)
+			return false;
 
-	lnb = &desc->rows;
-	lineno = 0;
-	sortbuf_pos = 0;
+	return true;
+}
 
-	if (!desc->order_map)
-	{
-		desc->order_map = smalloc(desc->total_rows * sizeof(MappedLine));
-		desc->order_map_items = desc->total_rows;
-	}
+/*
+ * Returns true, when values of sort columns are same in all changed
+ * rows of changed line buffers. Then the order of rows is not changed.
+ */
+static bool
+is_same_order(DataDesc *old, DataDesc *new, SortSpec *sort,
+			  LineBuffer **oldblocks, LineBuffer **newblocks, int nblocks,
+			  bool *changed_blocks)
+{
+	FieldSpan  *spans;
+	int			ncolumns = 0;
+	bool		result = true;
+	int			b, i, k;
 
-	/*
-	 * There are two possible sorting methods: numeric or string.
-	 * We can try numeric sort first if all values are numbers or
-	 * just only one type of string value (like NULL string). This
-	 * value can be repeated,
-	 *
-	 * When there are more different strings, then start again and
-	 * use string sort.
-	 */
-	while (lnb)
+	for (k = 0; k < sort->nkeys; k++)
+		if (sort->colnos[k] > ncolumns)
+			ncolumns = sort->colnos[k];
+
+	if (ncolumns > new->columns)
+		return false;
+
+	spans = smalloc(2 * ncolumns * sizeof(FieldSpan));
+
+	for (b = 0; b < nblocks && result; b++)
 	{
-		for (i = 0; i < lnb->nrows; i++)
+		if (!changed_blocks[b])
+			continue;
+
+		for (i = 0; i < newblocks[b]->nrows && result; i++)
 		{
-			desc->order_map[lineno].lnb = lnb;
-			desc->order_map[lineno].lnb_row = i;
+			char	   *oldline = oldblocks[b]->rows[i];
+			char	   *newline = newblocks[b]->rows[i];
 
-			if (lineno >= desc->first_data_row && lineno <= desc->last_data_row)
-			{
-				if (!continual_line)
-				{
-					sortbuf[sortbuf_pos].lnb = lnb;
-					sortbuf[sortbuf_pos].lnb_row = i;
-					sortbuf[sortbuf_pos].strxfrm = NULL;
+			if (strcmp(oldline, newline) == 0)
+				continue;
 
-					if (cut_numeric_value(lnb->rows[i],
-										   xmin, xmax,
-										   &sortbuf[sortbuf_pos].d,
-										   border0,
-										   &isnull,
-										   &nullstr))
-						sortbuf[sortbuf_pos++].info = INFO_DOUBLE;
-					else
-					{
-						sortbuf[sortbuf_pos++].info = INFO_UNKNOWN;
-						if (!isnull)
-						{
-							detect_string_column = true;
-							goto sort_by_string;
-						}
-					}
-				}
+			calculate_field_spans(old, oldline, spans, ncolumns);
+			calculate_field_spans(new, newline, spans + ncolumns, ncolumns);
 
-				if (desc->has_multilines)
+			for (k = 0; k < sort->nkeys; k++)
+			{
+				int			colno = sort->colnos[k];
+				FieldSpan  *s1 = &spans[colno - 1];
+				FieldSpan  *s2 = &spans[ncolumns + colno - 1];
+
+				if (s1->size != s2->size ||
+					memcmp(oldline + s1->offset, newline + s2->offset, s1->size) != 0)
 				{
-					continual_line = (lnb->lineinfo &&
-									  (lnb->lineinfo[i].mask & LINEINFO_CONTINUATION));
+					result = false;
+					break;
 				}
 			}
-
-			lineno += 1;
 		}
-
-		lnb = lnb->next;
 	}
 
-sort_by_string:
+	free(spans);
 
-	free(nullstr);
+	return result;
+}
 
-	if (detect_string_column)
+/*
+ * Unchanged line buffers of previous data are used by new data. The
+ * content of line buffer structures is exchanged, so the structures
+ * of previous data (referenced by order map) hold new lines. The bounds
+ * of fields calculated for unchanged lines are used again when the
+ * layout is same. The first line buffer is a part of DataDesc, and
+ * it is not moved (the new DataDesc replaces previous DataDesc).
+ */
+static void
+adopt_line_buffers(DataDesc *old, DataDesc *new,
+				   LineBuffer **oldblocks, LineBuffer **newblocks, int nblocks,
+				   bool *changed_blocks, bool same_layout)
+{
+	int			b;
+
+	for (b = 0; b < nblocks; b++)
 	{
-		/* read data again and use nls_string */
-		lnb = &desc->rows;
-		lineno = 0;
-		sortbuf_pos = 0;
-		while (lnb)
-		{
-			for (i = 0; i < lnb->nrows; i++)
-			{
-				desc->order_map[lineno].lnb = lnb;
-				desc->order_map[lineno].lnb_row = i;
+		LineBuffer *o = oldblocks[b];
+		LineBuffer *n = newblocks[b];
+		LineBuffer	aux;
+		bool		keep_spans = same_layout && !changed_blocks[b];
 
-				if (lineno >= desc->first_data_row && lineno <= desc->last_data_row)
-				{
-					if (!continual_line)
-					{
-						sortbuf[sortbuf_pos].lnb = lnb;
-						sortbuf[sortbuf_pos].lnb_row = i;
-						sortbuf[sortbuf_pos].d = 0.0;
+		if (b > 0)
+		{
+			memcpy(&aux, o, sizeof(LineBuffer));
 
-						if (cut_text(lnb->rows[i], xmin, xmax, border0, &sortbuf[sortbuf_pos].strxfrm))
-							sortbuf[sortbuf_pos++].info = INFO_STRXFRM;
-						else
-							sortbuf[sortbuf_pos++].info = INFO_UNKNOWN;		/* empty string */
-					}
+			memcpy(o->rows, n->rows, sizeof(o->rows));
+			o->nrows = n->nrows;
+			o->lineinfo = n->lineinfo;
+			o->changed_cols = n->changed_cols;
 
-					if (desc->has_multilines)
-					{
-						continual_line =  (lnb->lineinfo &&
-										   (lnb->lineinfo[i].mask & LINEINFO_CONTINUATION));
-					}
-				}
+			memcpy(n->rows, aux.rows, sizeof(n->rows));
+			n->nrows = aux.nrows;
+			n->lineinfo = aux.lineinfo;
+			n->changed_cols = aux.changed_cols;
 
-				lineno += 1;
+			if (!keep_spans)
+			{
+				o->spans = n->spans;
+				o->spans_rows = n->spans_rows;
+				o->spans_colno = n->spans_colno;
+				n->spans = aux.spans;
+				n->spans_rows = aux.spans_rows;
+				n->spans_colno = aux.spans_colno;
 			}
-			lnb = lnb->next;
+		}
+		else if (keep_spans)
+		{
+			memcpy(&aux, o, sizeof(LineBuffer));
+
+			o->spans = n->spans;
+			o->spans_rows = n->spans_rows;
+			o->spans_colno = n->spans_colno;
+			n->spans = aux.spans;
+			n->spans_rows = aux.spans_rows;
+			n->spans_colno = aux.spans_colno;
 		}
 	}
 
-	if (lineno != desc->total_rows)
-		leave("unexpected processed rows after sort prepare");
-
-	if (detect_string_column)
+	/* exchange line buffers between chains */
+	for (b = 1; b < nblocks; b++)
 	{
-		log_row("string sort");
-		sort_column_text(sortbuf, sortbuf_pos, desc_sort);
+		LineBuffer *aux = oldblocks[b];
+
+		oldblocks[b] = newblocks[b];
+		newblocks[b] = aux;
 	}
-	else
+
+	for (b = 0; b < nblocks; b++)
 	{
-		log_row("numeric sort");
-		sort_column_num(sortbuf, sortbuf_pos, desc_sort);
+		oldblocks[b]->next = b + 1 < nblocks ? oldblocks[b + 1] : NULL;
+		oldblocks[b]->prev = b > 0 ? oldblocks[b - 1] : NULL;
+		newblocks[b]->next = b + 1 < nblocks ? newblocks[b + 1] : NULL;
+		newblocks[b]->prev = b > 0 ? newblocks[b - 1] : NULL;
 	}
 
-	lineno = desc->first_data_row;
+	old->last_buffer = nblocks > 1 ? oldblocks[nblocks - 1] : NULL;
+	new->last_buffer = nblocks > 1 ? newblocks[nblocks - 1] : NULL;
+}
+
+/*
+ * Returns line buffers of data in array. Returns number of line buffers.
+ */
+static int
+get_line_buffers(DataDesc *desc, LineBuffer ***blocks)
+{
+	LineBuffer *lnb;
+	int			nblocks = 0;
+
+	for (lnb = &desc->rows; lnb; lnb = lnb->next)
+		nblocks += 1;
+
+	*blocks = smalloc(nblocks * sizeof(LineBuffer *));
+
+	nblocks = 0;
+	for (lnb = &desc->rows; lnb; lnb = lnb->next)
+		(*blocks)[nblocks++] = lnb;
+
+	return nblocks;
+}
+
+static bool
+is_same_block(LineBuffer *lnb1, LineBuffer *lnb2)
+{
+	int			i;
+
+	for (i = 0; i < lnb1->nrows; i++)
+		if (strcmp(lnb1->rows[i], lnb2->rows[i]) != 0)
+			return false;
+
+	return true;
+}
 
-	for (i = 0; i < sortbuf_pos; i++)
+/*
+ * Compare refreshed data with current data (watch mode). Returns false,
+ * when data are same, and then new data should not be used. Else the
+ * changed rows are marked (when mark_changes is true). When both data
+ * has same number of rows, then the data are compared by line buffers,
+ * and only changed line buffers are processed. New data use line
+ * buffers of current data then, and when values of sorted columns are
+ * not changed, then the current order map is used by new data too
+ * (and order_map_reused is true). The row filter should be applied
+ * again.
+ */
+bool
+merge_refreshed_data(DataDesc *old, DataDesc *new, bool mark_changes,
+					 SortSpec *sort, bool *order_map_reused)
+{
+	LineBuffer **oldblocks = NULL;
+	LineBuffer **newblocks = NULL;
+	bool	   *changed_blocks = NULL;
+	bool		same_structure;
+	int			nblocks = 0;
+	int			nchanged = 0;
+	int			b;
+
+	*order_map_reused = false;
+
+	same_structure = old->total_rows == new->total_rows &&
+					 old->first_data_row == new->first_data_row &&
+					 old->last_data_row + (old->is_filtered ? old->filtered_rows : 0) ==
+						new->last_data_row;
+
+	if (same_structure)
 	{
-		desc->order_map[lineno].lnb = sortbuf[i].lnb;
-		desc->order_map[lineno].lnb_row = sortbuf[i].lnb_row;
-		lineno += 1;
+		nblocks = get_line_buffers(old, &oldblocks);
 
-		/* assign other continual lines */
-		if (desc->has_multilines)
+		if (get_line_buffers(new, &newblocks) != nblocks)
+			same_structure = false;
+
+		for (b = 0; same_structure && b < nblocks; b++)
+			if (oldblocks[b]->nrows != newblocks[b]->nrows)
+				same_structure = false;
+	}
+
+	if (same_structure)
+	{
+		changed_blocks = smalloc(nblocks * sizeof(bool));
+
+		for (b = 0; b < nblocks; b++)
 		{
-			int		lnb_row;
-			bool	continual = false;
+			changed_blocks[b] = !is_same_block(oldblocks[b], newblocks[b]);
+			if (changed_blocks[b])
+				nchanged += 1;
+		}
 
-			lnb = sortbuf[i].lnb;
-			lnb_row = sortbuf[i].lnb_row;
+		if (nchanged == 0)
+		{
+			free(oldblocks);
+			free(newblocks);
+			free(changed_blocks);
 
-			continual = lnb->lineinfo &&
-									   (lnb->lineinfo[lnb_row].mask & LINEINFO_CONTINUATION);
+			return false;
+		}
 
-			while (lnb && continual)
+		log_row("%d from %d line buffers are changed", nchanged, nblocks);
+	}
+
+	/* lines of previous data can be read by background filter */
+	discard_row_filter(old);
+
+	if (mark_changes)
+		mark_changed_rows(old, new, changed_blocks);
+
+	if (same_structure)
+	{
+		bool		same_layout = is_same_layout(old, new);
+
+		if (sort->nkeys > 0 && same_layout &&
+			(old->is_filtered ? old->unfiltered_order_map : old->order_map))
+		{
+			if (old->pending_sort)
+				(void) complete_order_map(old, true);
+
+			multilines_detection(new);
+
+			if (!old->has_multilines && !new->has_multilines &&
+				is_same_order(old, new, sort, oldblocks, newblocks, nblocks, changed_blocks))
 			{
-				lnb_row += 1;
-				if (lnb_row >= lnb->nrows)
+				if (old->is_filtered)
 				{
-					lnb_row = 0;
-					lnb = lnb->next;
+					new->order_map = old->unfiltered_order_map;
+					new->order_map_items = old->unfiltered_order_map_items;
+					old->unfiltered_order_map = NULL;
+				}
+				else
+				{
+					new->order_map = old->order_map;
+					new->order_map_items = old->order_map_items;
+					old->order_map = NULL;
 				}
 
-				desc->order_map[lineno].lnb = lnb;
-				desc->order_map[lineno].lnb_row = lnb_row;
-				lineno += 1;
+				*order_map_reused = true;
 
-				continual = lnb && lnb->lineinfo &&
-								(lnb->lineinfo[lnb_row].mask & LINEINFO_CONTINUATION);
+				log_row("order map is used again");
 			}
 		}
-	}
 
-	/*
-	 * We cannot to say nothing about found_row, so most
-	 * correct solution is clean it now.
-	 */
-	scrdesc->found_row = -1;
+		adopt_line_buffers(old, new, oldblocks, newblocks, nblocks,
+						   changed_blocks, same_layout);
+	}
 
-	for (i = 0; i < sortbuf_pos; i++)
-		free(sortbuf[i].strxfrm);
+	free(oldblocks);
+	free(newblocks);
+	free(changed_blocks);
 
-	free(sortbuf);
+	return true;
 }
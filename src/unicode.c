@@ -368,6 +368,11 @@ utf_string_dsplen_multiline(const char *s,
 		}
 
 		clen = utf8charlen(*ptr);
+
+		/* don't read behind broken (truncated) multibyte char */
+		if ((size_t) clen > max_bytes)
+			break;
+
 		if (clen == 1 && *ptr == '\t')
 		{
 			/* this code is designed like pg_wcssize */
@@ -0,0 +1,243 @@
+#!/bin/bash
+#
+# Checks of sort, capture of rows (--max-rows, --tail, --sample), tail
+# preview (+G) and Arrow export. The results are verified by export to
+# csv, that is compared with export of unmodified data. The csv input
+# can be checked in non interactive mode (--ni), other checks start
+# pspg inside tmux.
+#
+# usage: tests/export-checks.sh [path to pspg]
+#
+
+PSPG=$(realpath "${1:-./pspg}")
+
+TESTS_DIR=$(dirname "$(realpath "$0")")
+
+TMUX_SOCKET=pspg-checks-test
+WORKDIR=$(mktemp -d)
+
+trap 'tmux -L $TMUX_SOCKET kill-server 2>/dev/null; rm -rf "$WORKDIR"' EXIT
+
+if [ ! -x "$PSPG" ]
+then
+	echo "pspg binary \"$PSPG\" is not available"
+	exit 2
+fi
+
+if ! command -v tmux > /dev/null
+then
+	echo "tmux is required"
+	exit 2
+fi
+
+# export_file format output "options" [commands]
+export_file()
+{
+	local format="$1"
+	local output="$2"
+	local options="$3"
+
+	shift 3
+
+	rm -f "$output" "$output.done"
+
+	tmux -L $TMUX_SOCKET kill-server 2>/dev/null
+	tmux -L $TMUX_SOCKET new-session -d -s checks -x 120 -y 30 \
+		"env HOME=$WORKDIR LANG=C.UTF-8 $PSPG --no-mouse $options"
+
+	sleep 0.3
+
+	for cmd in "$@"
+	do
+		tmux -L $TMUX_SOCKET send-keys -t checks "$cmd" Enter
+		sleep 0.3
+	done
+
+	tmux -L $TMUX_SOCKET send-keys -t checks "\\save all $format |cat > $output; touch $output.done" Enter
+
+	# the load of complete file (tail preview) can take more time
+	for i in $(seq 400)
+	do
+		[ -e "$output.done" ] && break
+		sleep 0.05
+	done
+
+	tmux -L $TMUX_SOCKET kill-server 2>/dev/null
+
+	[ -e "$output.done" ]
+}
+
+# values of data rows of table printed in non interactive mode
+data_rows()
+{
+	awk 'NR > 3 && /^\|/ { gsub(/ /, ""); print }'
+}
+
+failed=0
+passed=0
+
+# check name expected result
+check()
+{
+	if ! cmp -s "$2" "$3"
+	then
+		echo "FAIL $1"
+		diff "$2" "$3" | head -10
+		failed=$((failed + 1))
+	else
+		passed=$((passed + 1))
+	fi
+}
+
+# check_export name output "options" [commands]
+check_export()
+{
+	local name="$1"
+
+	shift
+
+	if ! export_file csv "$@"
+	then
+		echo "FAIL $name (export was not finished)"
+		failed=$((failed + 1))
+		return 1
+	fi
+
+	return 0
+}
+
+PG_CLASS="$TESTS_DIR/pg_class.txt"
+
+check_export "pg_class.txt" "$WORKDIR/all.csv" "-f $PG_CLASS" || exit 1
+
+tail -n +2 "$WORKDIR/all.csv" | LC_ALL=C sort > "$WORKDIR/all.sorted"
+
+#
+# Sort - the sorted rows should be same like original rows, and the
+# sorted column should be ordered.
+#
+# check_sort command sort-options
+check_sort()
+{
+	local name="pg_class.txt $1"
+
+	check_export "$name" "$WORKDIR/sort.csv" "-f $PG_CLASS" "$1" || return
+
+	tail -n +2 "$WORKDIR/sort.csv" | LC_ALL=C sort > "$WORKDIR/sort.sorted"
+	check "$name (rows)" "$WORKDIR/all.sorted" "$WORKDIR/sort.sorted"
+
+	if ! tail -n +2 "$WORKDIR/sort.csv" | LC_ALL=C sort -c -s -t, $2 2> /dev/null
+	then
+		echo "FAIL $name (order)"
+		failed=$((failed + 1))
+	else
+		passed=$((passed + 1))
+	fi
+}
+
+check_sort "\\sort relpages" "-k9,9n"
+check_sort "\\dsort relpages" "-k9,9nr"
+check_sort "\\sort relname" "-k1,1"
+check_sort "\\dsort relname" "-k1,1r"
+check_sort "\\sort relkind, relpages desc" "-k16,16 -k9,9nr"
+
+#
+# Capture of rows in non interactive mode (csv input)
+#
+echo "id,name" > "$WORKDIR/rows.csv"
+seq 5000 | awk '{ print $1 ",name" $1 }' >> "$WORKDIR/rows.csv"
+
+"$PSPG" --csv --ni -f "$WORKDIR/rows.csv" | data_rows > "$WORKDIR/rows.all"
+
+"$PSPG" --csv --ni --max-rows=100 -f "$WORKDIR/rows.csv" | data_rows > "$WORKDIR/rows.result"
+head -n 100 "$WORKDIR/rows.all" > "$WORKDIR/rows.expected"
+check "rows.csv --max-rows=100" "$WORKDIR/rows.expected" "$WORKDIR/rows.result"
+
+"$PSPG" --csv --ni --tail=100 -f "$WORKDIR/rows.csv" | data_rows > "$WORKDIR/rows.result"
+tail -n 100 "$WORKDIR/rows.all" > "$WORKDIR/rows.expected"
+check "rows.csv --tail=100" "$WORKDIR/rows.expected" "$WORKDIR/rows.result"
+
+# sample holds rows in original order
+"$PSPG" --csv --ni --sample=100 -f "$WORKDIR/rows.csv" | data_rows > "$WORKDIR/rows.result"
+grep -F -x -f "$WORKDIR/rows.result" "$WORKDIR/rows.all" > "$WORKDIR/rows.expected"
+if [ $(wc -l < "$WORKDIR/rows.result") -ne 100 ]
+then
+	echo "FAIL rows.csv --sample=100 (rows: $(wc -l < "$WORKDIR/rows.result"))"
+	failed=$((failed + 1))
+else
+	check "rows.csv --sample=100" "$WORKDIR/rows.expected" "$WORKDIR/rows.result"
+fi
+
+#
+# Capture of rows of psql output
+#
+if check_export "pg_class.txt --max-rows=10" "$WORKDIR/capture.csv" "--max-rows=10 -f $PG_CLASS"
+then
+	head -n 11 "$WORKDIR/all.csv" > "$WORKDIR/capture.expected"
+	check "pg_class.txt --max-rows=10" "$WORKDIR/capture.expected" "$WORKDIR/capture.csv"
+fi
+
+if check_export "pg_class.txt --tail=10" "$WORKDIR/capture.csv" "--tail=10 -f $PG_CLASS"
+then
+	(head -n 1 "$WORKDIR/all.csv"; tail -n 10 "$WORKDIR/all.csv") > "$WORKDIR/capture.expected"
+	check "pg_class.txt --tail=10" "$WORKDIR/capture.expected" "$WORKDIR/capture.csv"
+fi
+
+#
+# Tail preview - only the end of file is loaded first, the export
+# should wait for load of complete file.
+#
+awk 'BEGIN {
+	print "   id   |     name     ";
+	print "--------+--------------";
+	for (i = 1; i <= 200000; i++)
+		printf(" %6d | name%-8d\n", i, i);
+	print "(200000 rows)";
+}' > "$WORKDIR/big.txt"
+
+if check_export "big.txt" "$WORKDIR/big.csv" "-f $WORKDIR/big.txt" &&
+   check_export "big.txt +G" "$WORKDIR/tail.csv" "+G -f $WORKDIR/big.txt"
+then
+	check "big.txt +G" "$WORKDIR/big.csv" "$WORKDIR/tail.csv"
+fi
+
+#
+# Arrow export - the values should be same after load of exported
+# file. The codes with leading zeros or with '+' should be preserved.
+#
+cat > "$WORKDIR/codes.txt" <<EOF
+ id | code |   amount | name
+----+------+----------+------
+  1 | 007  |     1.50 | a
+  2 | 010  |    -2.25 | bb
+  3 | +5   | 10000.00 | 010
+ 10 | 12   |     0.00 | +5
+(4 rows)
+EOF
+
+for f in "$PG_CLASS" "$WORKDIR/codes.txt"
+do
+	name=$(basename "$f")
+
+	if check_export "$name" "$WORKDIR/arrow.expected" "-f $f" &&
+	   export_file arrow "$WORKDIR/data.arrow" "-f $f" &&
+	   check_export "$name (arrow)" "$WORKDIR/arrow.csv" "--arrow -f $WORKDIR/data.arrow"
+	then
+		# floats are not displayed with trailing zeros
+		if [ "$name" = "codes.txt" ]
+		then
+			sed -i 's/,1\.50,/,1.5,/; s/,10000\.00,/,10000,/; s/,0\.00,/,0,/' \
+				"$WORKDIR/arrow.expected"
+		fi
+
+		check "$name (arrow)" "$WORKDIR/arrow.expected" "$WORKDIR/arrow.csv"
+	elif [ ! -e "$WORKDIR/data.arrow.done" ]
+	then
+		echo "FAIL $name (arrow export was not finished)"
+		failed=$((failed + 1))
+	fi
+done
+
+echo "passed: $passed, failed: $failed"
+
+[ $failed -eq 0 ]
@@ -0,0 +1,112 @@
+#!/bin/bash
+#
+# Checks export of rows filtered by \filter command. The filtered export
+# should be same like the rows of unfiltered export that satisfy the
+# filter, and it should not contain decoration lines (bottom border).
+# After cancel of filter, the export should be same like before.
+#
+# pspg is interactive application, so it is started inside tmux.
+#
+# usage: tests/export-filter.sh [path to pspg]
+#
+
+PSPG=$(realpath "${1:-./pspg}")
+
+TESTS_DIR=$(dirname "$(realpath "$0")")
+
+TMUX_SOCKET=pspg-filter-test
+WORKDIR=$(mktemp -d)
+
+trap 'tmux -L $TMUX_SOCKET kill-server 2>/dev/null; rm -rf "$WORKDIR"' EXIT
+
+if [ ! -x "$PSPG" ]
+then
+	echo "pspg binary \"$PSPG\" is not available"
+	exit 2
+fi
+
+if ! command -v tmux > /dev/null
+then
+	echo "tmux is required"
+	exit 2
+fi
+
+# export_file file output [commands]
+export_file()
+{
+	local file="$1"
+	local output="$2"
+
+	shift 2
+
+	rm -f "$output" "$output.done"
+
+	tmux -L $TMUX_SOCKET kill-server 2>/dev/null
+	tmux -L $TMUX_SOCKET new-session -d -s filter -x 120 -y 30 \
+		"env HOME=$WORKDIR LANG=C.UTF-8 $PSPG --no-mouse -f $file"
+
+	sleep 0.3
+
+	# the filter is evaluated in background
+	for cmd in "$@"
+	do
+		tmux -L $TMUX_SOCKET send-keys -t filter "$cmd" Enter
+		sleep 0.3
+	done
+
+	tmux -L $TMUX_SOCKET send-keys -t filter "\\save all csv |cat > $output; touch $output.done" Enter
+
+	for i in $(seq 100)
+	do
+		[ -e "$output.done" ] && break
+		sleep 0.05
+	done
+
+	tmux -L $TMUX_SOCKET kill-server 2>/dev/null
+
+	[ -e "$output.done" ]
+}
+
+failed=0
+passed=0
+
+# check_filter file filter column awk-condition
+check_filter()
+{
+	local name="$(basename "$1") $2"
+
+	if ! export_file "$1" "$WORKDIR/all.csv" ||
+	   ! export_file "$1" "$WORKDIR/filtered.csv" "\\filter $2" ||
+	   ! export_file "$1" "$WORKDIR/reset.csv" "\\filter $2" "\\filter"
+	then
+		echo "FAIL $name (export was not finished)"
+		failed=$((failed + 1))
+		return
+	fi
+
+	# the fields before checked column should not contain commas
+	awk -F, "NR == 1 || (\$$3 $4)" "$WORKDIR/all.csv" > "$WORKDIR/expected.csv"
+
+	if ! cmp -s "$WORKDIR/expected.csv" "$WORKDIR/filtered.csv"
+	then
+		echo "FAIL $name"
+		diff "$WORKDIR/expected.csv" "$WORKDIR/filtered.csv" | head -10
+		failed=$((failed + 1))
+	elif ! cmp -s "$WORKDIR/all.csv" "$WORKDIR/reset.csv"
+	then
+		echo "FAIL $name (export after cancel of filter)"
+		diff "$WORKDIR/all.csv" "$WORKDIR/reset.csv" | head -10
+		failed=$((failed + 1))
+	else
+		passed=$((passed + 1))
+	fi
+}
+
+check_filter "$TESTS_DIR/pg_class.txt" "relpages >= 40" 9 ">= 40"
+check_filter "$TESTS_DIR/pg_class.txt" "relnatts < 3" 17 "< 3"
+check_filter "$TESTS_DIR/pg_class.txt" "relkind = i" 16 "== \"i\""
+check_filter "$TESTS_DIR/pg_class.txt" "relname ~ toast" 1 "~ /toast/"
+
+echo "passed: $passed, failed: $failed"
+
+[ $failed -eq 0 ]
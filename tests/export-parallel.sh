@@ -0,0 +1,111 @@
+#!/bin/bash
+#
+# Compares parallel export of test files with serial export. The parallel
+# export is forced for small data by environment variables (small chunks
+# and more workers), and the result should be same byte by byte.
+#
+# pspg is interactive application, so it is started inside tmux.
+#
+# usage: tests/export-parallel.sh [path to pspg] [files]
+#
+
+PSPG=$(realpath "${1:-./pspg}")
+shift
+
+TESTS_DIR=$(dirname "$(realpath "$0")")
+FILES=${@:-$TESTS_DIR/*.txt}
+
+FORMATS="csv tsvc sqlvalues pgcopy insert"
+CHUNKS="1 3"
+WORKERS=4
+
+TMUX_SOCKET=pspg-export-test
+WORKDIR=$(mktemp -d)
+
+trap 'tmux -L $TMUX_SOCKET kill-server 2>/dev/null; rm -rf "$WORKDIR"' EXIT
+
+if [ ! -x "$PSPG" ]
+then
+	echo "pspg binary \"$PSPG\" is not available"
+	exit 2
+fi
+
+if ! command -v tmux > /dev/null
+then
+	echo "tmux is required"
+	exit 2
+fi
+
+# export_file env file format output
+export_file()
+{
+	rm -f "$4" "$4.done"
+
+	tmux -L $TMUX_SOCKET kill-server 2>/dev/null
+	tmux -L $TMUX_SOCKET new-session -d -s export -x 120 -y 30 \
+		"env HOME=$WORKDIR LANG=C.UTF-8 $1 $PSPG --no-mouse -f $2"
+
+	sleep 0.3
+	tmux -L $TMUX_SOCKET send-keys -t export "\\save all $3 |cat > $4; touch $4.done" Enter
+
+	# insert format requires table name
+	if [ "$3" = "insert" ]
+	then
+		sleep 0.2
+		tmux -L $TMUX_SOCKET send-keys -t export "tbl" Enter
+	fi
+
+	for i in $(seq 100)
+	do
+		[ -e "$4.done" ] && break
+		sleep 0.05
+	done
+
+	tmux -L $TMUX_SOCKET kill-server 2>/dev/null
+
+	[ -e "$4.done" ]
+}
+
+failed=0
+passed=0
+skipped=0
+
+for f in $FILES
+do
+	for fmt in $FORMATS
+	do
+		name=$(basename "$f").$fmt
+		serial=$WORKDIR/$name.serial
+
+		# data without table format cannot be exported
+		if ! export_file "PSPG_EXPORT_WORKERS=1" "$f" $fmt "$serial"
+		then
+			echo "SKIP $name (serial export was not finished)"
+			skipped=$((skipped + 1))
+			continue
+		fi
+
+		for chunk in $CHUNKS
+		do
+			parallel=$WORKDIR/$name.parallel$chunk
+
+			if ! export_file "PSPG_EXPORT_WORKERS=$WORKERS PSPG_EXPORT_CHUNK_ROWS=$chunk" \
+							 "$f" $fmt "$parallel"
+			then
+				echo "FAIL $name chunk $chunk (parallel export was not finished)"
+				failed=$((failed + 1))
+			elif ! cmp -s "$serial" "$parallel"
+			then
+				echo "FAIL $name chunk $chunk"
+				diff "$serial" "$parallel" | head -10
+				failed=$((failed + 1))
+			else
+				passed=$((passed + 1))
+			fi
+		done
+	done
+done
+
+echo "passed: $passed, failed: $failed, skipped: $skipped"
+
+[ $failed -eq 0 ]